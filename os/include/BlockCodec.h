@@ -0,0 +1,30 @@
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Small LZ77 codec in the LZ4 style for blocks of up to 64 KB. A block is a
+// run of sequences, each a token byte (literal count, match length), the
+// literals, and a 16-bit back offset. There is no entropy stage, so
+// decompression is little more than memcpy.
+//
+// Data that doesn't shrink is not worth decompressing later: the compressor
+// speeds up its scan after repeated misses and gives up as soon as the
+// output can't come in under the saving threshold.
+class BlockCodec
+{
+public:
+    static constexpr size_t MAX_BLOCK = 64 * 1024;
+
+    // Compress size bytes into dst, at most capacity bytes. Returns the
+    // compressed size, or 0 if it wouldn't save at least 1/8 of the input.
+    static size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+
+    // Decompress exactly size bytes, false if src is corrupt
+    static bool decompress(const uint8_t *src, size_t compressedSize, uint8_t *dst, size_t size);
+};
+
+#endif // BLOCK_CODEC_H
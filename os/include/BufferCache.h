@@ -0,0 +1,149 @@
+#ifndef BUFFER_CACHE_H
+#define BUFFER_CACHE_H
+
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+// Block buffer cache for simulated disk I/O, keyed by (fd, block number).
+//
+// Eviction is 2Q: blocks seen once wait in a FIFO (A1in). Only blocks
+// referenced again after falling out of it, which the ghost list A1out
+// remembers, are promoted to the LRU main queue (Am). A single scan of a
+// large file therefore can't flush out the working set.
+//
+// Writes are write-back. A flusher thread writes dirty blocks once they
+// pass the background threshold, or every few seconds. A writer that
+// pushes them past the hard threshold writes back inline until they drop
+// below the background threshold again.
+//
+// The dedup store's pack file is cached, and so is the tasks' file I/O,
+// which reaches the cache through DiskService (see DiskClient.h): notepad's
+// journal, music_player's recordings and minesweeper's swapped-out chunks.
+// Files that tasks map (the calendar index, the music library, notes) or
+// write whole and rename into place, and file_manager's copy_file_range
+// copies, bypass it.
+class BufferCache
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t ghostHits;  // Misses that were promoted straight to Am
+        uint64_t writebacks; // Blocks written to the device
+        uint64_t evictions;
+        size_t dirtyBlocks;
+        size_t residentBlocks;
+    };
+
+private:
+    enum Queue : uint8_t
+    {
+        FREE,
+        A1IN,
+        AM
+    };
+
+    struct BlockKey
+    {
+        int fd;
+        uint64_t block;
+
+        bool operator==(const BlockKey &other) const { return fd == other.fd && block == other.block; }
+        bool operator<(const BlockKey &other) const { return fd != other.fd ? fd < other.fd : block < other.block; }
+    };
+
+    struct BlockKeyHash
+    {
+        size_t operator()(const BlockKey &key) const { return key.block * 0x9E3779B97F4A7C15ull ^ key.fd; }
+    };
+
+    // Cache slot, linked into its queue by index
+    struct Slot
+    {
+        BlockKey key;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t length; // Valid bytes, a block at the end of a file may be partial
+        Queue queue;
+        bool dirty;
+    };
+
+    struct List
+    {
+        uint32_t head = NONE; // Most recent
+        uint32_t tail = NONE; // Next to evict
+        size_t size = 0;
+    };
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    char *data; // capacity * BLOCK_SIZE, one slab
+    vector<Slot> slots;
+    vector<uint32_t> freeSlots;
+    unordered_map<BlockKey, uint32_t, BlockKeyHash> index;
+    List a1in, am;
+    size_t a1inTarget; // Kin: share of the cache for first-time blocks
+
+    // Ghost queue of keys recently evicted from A1in
+    list<BlockKey> a1out;
+    unordered_map<BlockKey, list<BlockKey>::iterator, BlockKeyHash> ghosts;
+    size_t ghostLimit; // Kout
+
+    map<BlockKey, uint32_t> dirtyBlocks; // Dirty slots in (fd, block) order, for write-back
+    size_t backgroundDirty; // Flusher starts writing back
+    size_t hardDirty;       // Writers write back themselves
+
+    Stats counters;
+
+    mutable mutex cacheMutex;
+    condition_variable flusherCV;
+    thread flusher;
+    atomic<bool> flushing;
+
+    char *blockData(uint32_t slot) const { return data + static_cast<size_t>(slot) * BLOCK_SIZE; }
+    void unlink(List &queue, uint32_t slot);
+    void pushFront(List &queue, uint32_t slot, Queue name);
+    void rememberGhost(const BlockKey &key);
+
+    // Caller holds cacheMutex for all of these
+    bool writeBack(uint32_t slot);
+    bool reclaim();
+    bool lookup(int fd, uint64_t block, bool fill, uint32_t &slot);
+    bool writeBackDirty(size_t limit, int fd);
+    void flusherLoop();
+
+public:
+    BufferCache();
+    ~BufferCache();
+
+    BufferCache(const BufferCache &) = delete;
+    BufferCache &operator=(const BufferCache &) = delete;
+
+    // Size the cache, 0 makes every call go straight to the file. Must be
+    // called before start() and before any I/O.
+    void configure(size_t bytes);
+    void start();
+    void stop(); // Writes back everything and stops the flusher
+
+    bool read(int fd, uint64_t offset, char *buffer, size_t size);
+    bool write(int fd, uint64_t offset, const char *buffer, size_t size);
+    bool flush(int fd);      // Write back every dirty block of fd
+    void invalidate(int fd); // Forget fd's blocks, flush first to keep its writes
+
+    Stats stats() const;
+    size_t capacityBytes() const { return slots.size() * BLOCK_SIZE; }
+};
+
+#endif // BUFFER_CACHE_H
@@ -0,0 +1,140 @@
+#ifndef DEDUP_STORE_H
+#define DEDUP_STORE_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <cstdint>
+#include "BufferCache.h"
+
+using namespace std;
+
+// 128-bit content hash of a chunk
+struct ChunkId
+{
+    uint64_t lo;
+    uint64_t hi;
+
+    bool operator==(const ChunkId &other) const { return lo == other.lo && hi == other.hi; }
+};
+
+struct ChunkIdHash
+{
+    size_t operator()(const ChunkId &id) const { return id.lo; }
+};
+
+// Content-addressed file store. Files are cut into variable-size chunks at
+// content-defined boundaries, so an insert early in a file only changes the
+// chunks around it. Each unique chunk is kept once in an append-only pack
+// file; files are just lists of chunk references.
+//
+// New chunks are compressed with BlockCodec when that saves at least 1/8,
+// and stored as they are otherwise, so already-compressed media costs only
+// the attempt. Each chunk is compressed on its own, so a read decompresses
+// just the chunks it touches.
+//
+// The pack is written as data arrives, the manifest (chunk table and file
+// maps) only on sync(), so writes since the last sync are lost on a crash.
+// Chunks no file references any more stay in the pack as dead space until
+// it is compacted, which happens once more than half of it is dead.
+class DedupStore
+{
+public:
+    struct CodecStats
+    {
+        uint64_t compressedChunks;
+        uint64_t bypassedChunks;   // Stored raw, compression didn't pay
+        uint64_t compressInBytes;  // Bytes given to the compressor
+        double compressSeconds;
+        uint64_t decompressOutBytes;
+        double decompressSeconds;
+    };
+
+private:
+    struct Chunk
+    {
+        ChunkId id;
+        uint64_t offset; // In the pack file
+        uint32_t size;   // Uncompressed
+        uint32_t stored; // Bytes in the pack, less than size when compressed
+        uint32_t refs;   // File map entries pointing here, 0 = free slot
+    };
+
+    struct FileMap
+    {
+        uint64_t size;
+        vector<uint32_t> chunks; // Indices into chunks
+        vector<uint64_t> starts; // File offset of each chunk, for range reads
+    };
+
+    string root;
+    int packFd;
+    uint64_t packSize;
+    BufferCache *cache; // Pack I/O goes through here when set
+
+    vector<Chunk> chunks;
+    vector<uint32_t> freeChunks;
+    unordered_map<ChunkId, uint32_t, ChunkIdHash> chunkIndex;
+    unordered_map<string, FileMap> files;
+
+    uint64_t logical;  // Sum of file sizes
+    uint64_t unique;   // Sum of live chunk sizes
+    uint64_t physical; // Sum of live chunk sizes in the pack
+    bool dirty;        // Manifest out of date
+
+    bool compression;
+    mutable CodecStats codec;
+
+    mutable mutex storeMutex;
+
+    bool packRead(char *data, size_t size, uint64_t offset) const;
+    bool packWrite(const char *data, size_t size, uint64_t offset);
+    bool loadChunk(const Chunk &chunk, char *data, vector<char> &scratch) const;
+    void release(const FileMap &map);
+    bool loadManifest();
+    bool writeManifest();
+    bool mostlyDead() const;
+    bool compact();
+
+public:
+    DedupStore();
+    ~DedupStore();
+
+    DedupStore(const DedupStore &) = delete;
+    DedupStore &operator=(const DedupStore &) = delete;
+
+    void setCache(BufferCache *blockCache) { cache = blockCache; } // Before open()
+    void setCompression(bool enabled) { compression = enabled; }    // Before open()
+    bool open(const string &directory);
+    bool sync();    // Persist the manifest, compacting the pack first if it is mostly dead
+    bool reclaim(); // Compact and persist right away if the pack is mostly dead, else nothing
+
+    // Replace a file's content. Fails without changing anything if storing
+    // the new chunks would take more than budget bytes.
+    bool writeFile(const string &name, const char *data, size_t size, uint64_t budget);
+    bool readFile(const string &name, string &data) const;
+    // Read up to size bytes from offset, clipped to the end of the file
+    bool readRange(const string &name, uint64_t offset, uint64_t size, string &data) const;
+    bool removeFile(const string &name);
+    // Make target share source's chunks, nothing is added to the pack
+    bool copyFile(const string &source, const string &target);
+    bool contains(const string &name) const;
+    // Names starting with prefix and their sizes, sorted by name
+    void list(const string &prefix, vector<pair<string, uint64_t>> &out) const;
+
+    uint64_t logicalBytes() const;
+    uint64_t uniqueBytes() const;   // Before compression
+    uint64_t physicalBytes() const; // After compression
+    uint64_t packBytes() const;     // The pack file, dead space included
+    CodecStats codecStats() const;
+    size_t fileCount() const;
+    size_t chunkCount() const;
+
+    // Chunk boundaries and hashes, exposed for callers that chunk ahead of time
+    static size_t nextChunkBoundary(const uint8_t *data, size_t size);
+    static ChunkId hashChunk(const uint8_t *data, size_t size);
+};
+
+#endif // DEDUP_STORE_H
@@ -0,0 +1,67 @@
+#ifndef DISK_ACCOUNTANT_H
+#define DISK_ACCOUNTANT_H
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "DiskLedger.h"
+
+using namespace std;
+
+// Tracks the real bytes stored under the simulated disk directory. The
+// directory is scanned once at start; after that inotify events keep the
+// per-file sizes current, so usage is updated incrementally.
+//
+// Bytes are covered by a reservation while a live process has charged them
+// to its quota in the DiskLedger, or while they sit in a file created by
+// OSSystem::createFile up to its claimed size. Everything else is
+// unreserved and has to be charged to the disk separately.
+class DiskAccountant
+{
+private:
+    string root;
+    DiskLedger ledger;
+
+    int inotifyFd;
+    thread watcher;
+    atomic<bool> watching;
+    unordered_map<int, string> watches; // Watch descriptor -> directory, watcher thread only
+    function<void()> onChange;
+
+    mutable mutex sizeMutex;
+    unordered_map<string, uint64_t> fileSizes; // Relative path -> bytes
+    unordered_map<string, uint64_t> claims;    // Relative path -> claimed bytes
+    uint64_t totalBytes;
+
+    bool isInternal(const string &path) const;
+    void setSize(const string &path, uint64_t size); // Caller holds sizeMutex
+    void forget(const string &path);                 // Caller holds sizeMutex
+    void forgetTree(const string &directory);        // Caller holds sizeMutex
+    void addTree(const string &directory);
+    void watchLoop();
+
+public:
+    DiskAccountant();
+    ~DiskAccountant();
+
+    // onChange runs on the watcher thread whenever the stored bytes change
+    bool start(const string &directory, function<void()> onChange);
+    void stop();
+
+    bool registerProcess(int pid, int64_t quotaBytes);
+    void unregisterProcess(int pid);
+    void claimFile(const string &path, uint64_t bytes);
+    void releaseClaim(const string &path);
+
+    uint64_t storedBytes() const;     // Everything under the directory
+    uint64_t unreservedBytes() const; // Bytes not covered by a reservation
+    int64_t processUsage(int pid) const { return ledger.used(pid); }
+    int64_t processRefused(int pid) const { return ledger.refused(pid); }
+};
+
+#endif // DISK_ACCOUNTANT_H
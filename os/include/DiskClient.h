@@ -0,0 +1,431 @@
+#ifndef DISK_CLIENT_H
+#define DISK_CLIENT_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Task side of the OS disk service. While the OS runs, it listens on a
+// socket in the simulated disk and does file I/O for the tasks through its
+// buffer cache, so every task's reads and writes share one cache and show
+// up in its counters. Names are relative to simulated_disk. Header-only so
+// tasks, which are built from a single source file, can use it too.
+//
+// A task run without the OS has no service to connect to, and DiskFile
+// then uses the file directly.
+//
+// The service also reaches the OS file store, which keeps whole files
+// deduplicated and compressed, charged to the OS disk rather than to the
+// task. Stored files are a namespace of their own, not files under
+// simulated_disk, and only exist for tasks while the OS runs.
+
+enum DiskOp : uint32_t
+{
+    DISK_OPEN,  // name, flags (O_CREAT, O_TRUNC) -> handle, length = file size
+    DISK_CLOSE, // handle
+    DISK_READ,  // handle, offset, length -> up to length bytes, short at the end
+    DISK_WRITE, // handle, offset, length bytes of payload
+    DISK_SYNC,  // handle, writes back its cached blocks and syncs the file
+    DISK_SIZE,  // handle -> length = file size
+
+    DISK_STORE_WRITE,  // name, flags (O_SYNC), length bytes of payload that replace the stored file
+    DISK_STORE_READ,   // name, offset, length -> up to length bytes
+    DISK_STORE_REMOVE, // name
+    DISK_STORE_COPY,   // name is the source, the length bytes of payload the target
+    DISK_STORE_LIST    // name is a prefix -> per file: u32 name length, the name, u64 size
+};
+
+struct DiskRequest
+{
+    uint32_t op;
+    int32_t handle;
+    int32_t flags;
+    uint32_t nameLength; // Name bytes follow the request, then the payload
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct DiskReply
+{
+    int32_t error; // 0 or an errno value
+    int32_t handle;
+    uint64_t length; // Payload bytes that follow the reply
+};
+
+static_assert(sizeof(DiskRequest) == 32 && sizeof(DiskReply) == 16, "The disk protocol is fixed size");
+
+class DiskClient
+{
+public:
+    static constexpr const char *SOCKET_PATH = "simulated_disk/.disk.sock";
+    static constexpr uint64_t MAX_TRANSFER = 1 << 20;     // Bytes per read or write request
+    static constexpr uint64_t MAX_STORED_FILE = 64 << 20; // Largest file that goes to the store
+
+private:
+    int socketFd = -1;
+    std::mutex callMutex; // One request in flight, tasks call from several threads
+
+    bool sendAll(const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t count = send(socketFd, data, size, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    bool receiveAll(char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t count = recv(socketFd, data, size, 0);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    void drop()
+    {
+        ::close(socketFd);
+        socketFd = -1;
+    }
+
+    // Send a request and receive its reply header. Caller holds callMutex.
+    bool exchange(DiskRequest &request, const std::string &name, const char *payload, DiskReply &reply)
+    {
+        if (socketFd < 0)
+        {
+            errno = ENOTCONN;
+            return false;
+        }
+        request.nameLength = static_cast<uint32_t>(name.size());
+        bool sent = sendAll(reinterpret_cast<const char *>(&request), sizeof(request)) &&
+                    sendAll(name.data(), name.size()) &&
+                    (payload == nullptr || sendAll(payload, request.length));
+        if (!sent || !receiveAll(reinterpret_cast<char *>(&reply), sizeof(reply)))
+        {
+            // The OS went away, later calls fail instead of waiting on a dead socket
+            drop();
+            return false;
+        }
+        return true;
+    }
+
+    static bool succeeded(const DiskReply &reply)
+    {
+        if (reply.error != 0)
+            errno = reply.error;
+        return reply.error == 0;
+    }
+
+public:
+    DiskClient() = default;
+    DiskClient(const DiskClient &) = delete;
+    DiskClient &operator=(const DiskClient &) = delete;
+    ~DiskClient() { disconnect(); }
+
+    // False when no OS is running, files are then used directly
+    bool connect()
+    {
+        disconnect();
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, SOCKET_PATH, sizeof(address.sun_path) - 1);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        socketFd = fd;
+        return true;
+    }
+
+    void disconnect()
+    {
+        if (socketFd >= 0)
+        {
+            ::close(socketFd);
+            socketFd = -1;
+        }
+    }
+
+    bool connected() const { return socketFd >= 0; }
+
+    // Send one request and wait for its reply. Reply payload beyond capacity
+    // is discarded, reply.length still says how much there was.
+    bool call(DiskRequest request, const std::string &name, const char *payload, DiskReply &reply, char *into,
+              size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        if (!exchange(request, name, payload, reply))
+            return false;
+        size_t wanted = static_cast<size_t>(reply.length < capacity ? reply.length : capacity);
+        bool received = receiveAll(into, wanted);
+        for (uint64_t rest = reply.length - wanted; received && rest > 0;)
+        {
+            char discard[4096];
+            size_t count = static_cast<size_t>(rest < sizeof(discard) ? rest : sizeof(discard));
+            received = receiveAll(discard, count);
+            rest -= count;
+        }
+        if (!received)
+        {
+            drop();
+            return false;
+        }
+        return succeeded(reply);
+    }
+
+    // Same, with the whole reply payload returned in out
+    bool call(DiskRequest request, const std::string &name, const char *payload, DiskReply &reply, std::string &out)
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        if (!exchange(request, name, payload, reply))
+            return false;
+        if (reply.length > MAX_STORED_FILE)
+        {
+            drop(); // Not a reply this client could have asked for
+            errno = EPROTO;
+            return false;
+        }
+        out.resize(static_cast<size_t>(reply.length));
+        if (!receiveAll(&out[0], out.size()))
+        {
+            drop();
+            return false;
+        }
+        return succeeded(reply);
+    }
+
+    // The OS file store. Each fails with ENOTCONN when no OS is running.
+    // A durable write is only acknowledged once the store survives a crash.
+    bool storeWrite(const std::string &name, const std::string &data, bool durable = false)
+    {
+        if (data.size() > MAX_STORED_FILE)
+        {
+            errno = EFBIG;
+            return false;
+        }
+        DiskRequest request = {DISK_STORE_WRITE, -1, durable ? O_SYNC : 0, 0, 0, data.size()};
+        DiskReply reply;
+        return call(request, name, data.data(), reply, nullptr, 0);
+    }
+
+    bool storeRead(const std::string &name, std::string &data)
+    {
+        DiskRequest request = {DISK_STORE_READ, -1, 0, 0, 0, MAX_STORED_FILE};
+        DiskReply reply;
+        return call(request, name, nullptr, reply, data);
+    }
+
+    bool storeRemove(const std::string &name)
+    {
+        DiskRequest request = {DISK_STORE_REMOVE, -1, 0, 0, 0, 0};
+        DiskReply reply;
+        return call(request, name, nullptr, reply, nullptr, 0);
+    }
+
+    // The target shares the source's content, so the copy costs no space
+    bool storeCopy(const std::string &source, const std::string &target)
+    {
+        DiskRequest request = {DISK_STORE_COPY, -1, 0, 0, 0, target.size()};
+        DiskReply reply;
+        return call(request, source, target.data(), reply, nullptr, 0);
+    }
+
+    // Stored files whose names start with prefix, with their sizes, sorted by name
+    bool storeList(const std::string &prefix, std::vector<std::pair<std::string, uint64_t>> &files)
+    {
+        DiskRequest request = {DISK_STORE_LIST, -1, 0, 0, 0, 0};
+        DiskReply reply;
+        std::string records;
+        files.clear();
+        if (!call(request, prefix, nullptr, reply, records))
+            return false;
+        for (size_t pos = 0; pos + sizeof(uint32_t) <= records.size();)
+        {
+            uint32_t length;
+            uint64_t size;
+            memcpy(&length, records.data() + pos, sizeof(length));
+            pos += sizeof(length);
+            if (length > records.size() - pos || records.size() - pos - length < sizeof(size))
+                break;
+            std::string name = records.substr(pos, length);
+            memcpy(&size, records.data() + pos + length, sizeof(size));
+            pos += length + sizeof(size);
+            files.emplace_back(std::move(name), size);
+        }
+        return true;
+    }
+};
+
+// A file in the simulated disk, read and written at explicit offsets. Goes
+// through the OS buffer cache when the client is connected, to the file
+// itself otherwise. Writes are write-back in the cache: sync() is what
+// makes them durable, and close() hands them to the OS to write later.
+class DiskFile
+{
+private:
+    DiskClient *client = nullptr; // Null while the file is used directly
+    int handle = -1;              // The service's handle or the file descriptor
+
+public:
+    DiskFile() = default;
+    DiskFile(const DiskFile &) = delete;
+    DiskFile &operator=(const DiskFile &) = delete;
+    ~DiskFile() { close(); }
+
+    // flags may add O_CREAT and O_TRUNC, the file is always opened read-write
+    bool open(DiskClient &disk, const std::string &name, int flags)
+    {
+        close();
+        flags &= O_CREAT | O_TRUNC;
+        if (disk.connected())
+        {
+            DiskRequest request = {DISK_OPEN, -1, flags, 0, 0, 0};
+            DiskReply reply;
+            if (disk.call(request, name, nullptr, reply, nullptr, 0))
+            {
+                client = &disk;
+                handle = reply.handle;
+                return true;
+            }
+            if (disk.connected())
+                return false; // The service refused it, the file itself would fail too
+        }
+        handle = ::open(("simulated_disk/" + name).c_str(), O_RDWR | O_CLOEXEC | flags, 0644);
+        return handle >= 0;
+    }
+
+    bool isOpen() const { return handle >= 0; }
+
+    // Read up to size bytes, count is short at the end of the file
+    bool read(uint64_t offset, char *buffer, size_t size, size_t &count)
+    {
+        count = 0;
+        while (handle >= 0 && count < size)
+        {
+            size_t want = size - count;
+            if (client != nullptr)
+            {
+                want = static_cast<size_t>(want < DiskClient::MAX_TRANSFER ? want : DiskClient::MAX_TRANSFER);
+                DiskRequest request = {DISK_READ, handle, 0, 0, offset + count, want};
+                DiskReply reply;
+                if (!client->call(request, std::string(), nullptr, reply, buffer + count, want))
+                    return false;
+                count += reply.length;
+                if (reply.length < want)
+                    return true;
+                continue;
+            }
+            ssize_t got = pread(handle, buffer + count, want, offset + count);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+                return false;
+            if (got == 0)
+                return true;
+            count += got;
+        }
+        return handle >= 0;
+    }
+
+    bool write(uint64_t offset, const char *data, size_t size)
+    {
+        while (handle >= 0 && size > 0)
+        {
+            size_t count = size;
+            if (client != nullptr)
+            {
+                count = static_cast<size_t>(count < DiskClient::MAX_TRANSFER ? count : DiskClient::MAX_TRANSFER);
+                DiskRequest request = {DISK_WRITE, handle, 0, 0, offset, count};
+                DiskReply reply;
+                if (!client->call(request, std::string(), data, reply, nullptr, 0))
+                    return false;
+            }
+            else
+            {
+                ssize_t written = pwrite(handle, data, count, offset);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                count = written;
+            }
+            data += count;
+            offset += count;
+            size -= count;
+        }
+        return handle >= 0;
+    }
+
+    bool sync()
+    {
+        if (client == nullptr)
+            return handle >= 0 && fsync(handle) == 0;
+        DiskRequest request = {DISK_SYNC, handle, 0, 0, 0, 0};
+        DiskReply reply;
+        return client->call(request, std::string(), nullptr, reply, nullptr, 0);
+    }
+
+    bool size(uint64_t &bytes)
+    {
+        if (client == nullptr)
+        {
+            struct stat info;
+            if (handle < 0 || fstat(handle, &info) != 0)
+                return false;
+            bytes = info.st_size;
+            return true;
+        }
+        DiskRequest request = {DISK_SIZE, handle, 0, 0, 0, 0};
+        DiskReply reply;
+        if (!client->call(request, std::string(), nullptr, reply, nullptr, 0))
+            return false;
+        bytes = reply.length;
+        return true;
+    }
+
+    void close()
+    {
+        if (handle < 0)
+            return;
+        if (client != nullptr)
+        {
+            DiskRequest request = {DISK_CLOSE, handle, 0, 0, 0, 0};
+            DiskReply reply;
+            client->call(request, std::string(), nullptr, reply, nullptr, 0);
+        }
+        else
+        {
+            ::close(handle);
+        }
+        client = nullptr;
+        handle = -1;
+    }
+};
+
+#endif // DISK_CLIENT_H
@@ -0,0 +1,180 @@
+#ifndef DISK_LEDGER_H
+#define DISK_LEDGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Per-process disk usage, shared between the OS and the task processes
+// through a small mapped file. The OS registers every process with its
+// diskRequired quota; tasks charge the bytes they are about to write and
+// stop writing once a charge is refused. Header-only so tasks, which are
+// built from a single source file, can use it too.
+struct DiskLedgerSlot
+{
+    std::atomic<int32_t> pid;     // 0 = empty, -1 = removed
+    std::atomic<int64_t> quota;   // Bytes
+    std::atomic<int64_t> used;    // Bytes currently charged
+    std::atomic<int64_t> refused; // Bytes of writes that were refused
+};
+
+static_assert(std::atomic<int64_t>::is_always_lock_free, "Ledger counters must work across processes");
+
+class DiskLedger
+{
+public:
+    static constexpr const char *PATH = "simulated_disk/.ledger";
+    static constexpr int SLOTS = 1024;
+
+private:
+    DiskLedgerSlot *slots = nullptr;
+
+    DiskLedgerSlot *find(int pid) const
+    {
+        if (slots == nullptr || pid <= 0)
+            return nullptr;
+        for (int probe = 0; probe < SLOTS; probe++)
+        {
+            DiskLedgerSlot &slot = slots[(pid + probe) % SLOTS];
+            int32_t owner = slot.pid.load(std::memory_order_acquire);
+            if (owner == pid)
+                return &slot;
+            if (owner == 0)
+                return nullptr;
+        }
+        return nullptr;
+    }
+
+public:
+    DiskLedger() = default;
+    DiskLedger(const DiskLedger &) = delete;
+    DiskLedger &operator=(const DiskLedger &) = delete;
+    ~DiskLedger() { close(); }
+
+    // The OS creates a fresh ledger at boot, tasks attach to the existing one
+    bool open(bool create)
+    {
+        close();
+        int fd = ::open(PATH, create ? (O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0644);
+        if (fd < 0)
+            return false;
+        size_t size = sizeof(DiskLedgerSlot) * SLOTS;
+        if (create && ftruncate(fd, size) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < size)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return false;
+        slots = static_cast<DiskLedgerSlot *>(map);
+        return true;
+    }
+
+    void close()
+    {
+        if (slots != nullptr)
+        {
+            munmap(slots, sizeof(DiskLedgerSlot) * SLOTS);
+            slots = nullptr;
+        }
+    }
+
+    bool isOpen() const { return slots != nullptr; }
+
+    // OS side. Only the OS adds and removes slots, one call at a time.
+    bool registerProcess(int pid, int64_t quota)
+    {
+        if (slots == nullptr || pid <= 0)
+            return false;
+        for (int probe = 0; probe < SLOTS; probe++)
+        {
+            DiskLedgerSlot &slot = slots[(pid + probe) % SLOTS];
+            int32_t owner = slot.pid.load(std::memory_order_relaxed);
+            if (owner == 0 || owner == -1)
+            {
+                slot.quota.store(quota, std::memory_order_relaxed);
+                slot.used.store(0, std::memory_order_relaxed);
+                slot.refused.store(0, std::memory_order_relaxed);
+                slot.pid.store(pid, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns the bytes the process still had charged
+    int64_t unregisterProcess(int pid)
+    {
+        DiskLedgerSlot *slot = find(pid);
+        if (slot == nullptr)
+            return 0;
+        slot->pid.store(-1, std::memory_order_release);
+        return slot->used.load(std::memory_order_relaxed);
+    }
+
+    // Visit every registered process as visit(pid, used, quota)
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        for (int i = 0; slots != nullptr && i < SLOTS; i++)
+        {
+            int32_t pid = slots[i].pid.load(std::memory_order_acquire);
+            if (pid > 0)
+                visit(pid, slots[i].used.load(std::memory_order_relaxed), slots[i].quota.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Task side. A positive delta is refused if it would take the process
+    // past its quota; freed space (a negative delta) is always accepted.
+    bool charge(int pid, int64_t delta)
+    {
+        DiskLedgerSlot *slot = find(pid);
+        if (slot == nullptr)
+            return true; // Not launched by the OS, nothing to enforce
+        int64_t used = slot->used.load(std::memory_order_relaxed);
+        int64_t next;
+        do
+        {
+            next = used + delta;
+            if (next < 0)
+                next = 0;
+            if (delta > 0 && next > slot->quota.load(std::memory_order_relaxed))
+            {
+                slot->refused.fetch_add(delta, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!slot->used.compare_exchange_weak(used, next, std::memory_order_relaxed));
+        return true;
+    }
+
+    int64_t used(int pid) const
+    {
+        DiskLedgerSlot *slot = find(pid);
+        return slot ? slot->used.load(std::memory_order_relaxed) : 0;
+    }
+
+    int64_t quota(int pid) const
+    {
+        DiskLedgerSlot *slot = find(pid);
+        return slot ? slot->quota.load(std::memory_order_relaxed) : -1;
+    }
+
+    int64_t refused(int pid) const
+    {
+        DiskLedgerSlot *slot = find(pid);
+        return slot ? slot->refused.load(std::memory_order_relaxed) : 0;
+    }
+};
+
+#endif // DISK_LEDGER_H
@@ -0,0 +1,108 @@
+#ifndef DISK_SERVICE_H
+#define DISK_SERVICE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include "BufferCache.h"
+#include "DiskClient.h"
+
+using namespace std;
+
+// OS side of the disk service in DiskClient.h. Tasks connect over a unix
+// socket in the simulated disk, and their file reads and writes go through
+// the OS buffer cache.
+//
+// Open files are shared: every task that opens the same name gets the same
+// descriptor, so they see each other's cached writes. A file is written back
+// and dropped from the cache when its last user closes it or disconnects.
+//
+// The store requests are handed to the OS, which owns the file store and
+// charges it to the disk.
+class DiskService
+{
+public:
+    struct Stats
+    {
+        size_t clients;
+        size_t openFiles;
+        uint64_t requests;
+    };
+
+    // What the store requests call. Each returns the errno for the reply, 0 on success.
+    struct StoreHandlers
+    {
+        function<int(const string &name, const string &data)> write;
+        function<int(const string &name, uint64_t offset, uint64_t size, string &data)> read;
+        function<int(const string &name)> remove;
+        function<int(const string &source, const string &target)> copy;
+        function<void(const string &prefix, vector<pair<string, uint64_t>> &out)> list;
+        function<int()> sync; // Make everything stored so far durable
+    };
+
+private:
+    struct OpenFile
+    {
+        int fd;
+        uint64_t size; // Includes cached writes past the end of the file on disk
+        int users;
+        string name;
+    };
+
+    struct Connection
+    {
+        int socketFd;
+        thread worker;
+        bool finished;
+    };
+
+    string root;
+    BufferCache &cache;
+    StoreHandlers store;
+    int listenFd;
+    thread acceptor;
+    atomic<bool> serving;
+    atomic<uint64_t> requests;
+
+    mutex connectionsMutex;
+    vector<Connection *> connections;
+
+    mutex filesMutex;
+    unordered_map<string, int> byName;      // Name -> fd
+    unordered_map<int, OpenFile> openFiles; // fd -> file
+
+    static bool validName(const string &name);
+    void acceptLoop();
+    void serve(Connection *connection);
+    void reapFinished(); // Caller holds connectionsMutex
+
+    // Each returns the errno for the reply, 0 on success
+    int openFile(const string &name, int flags, vector<int> &held, DiskReply &reply);
+    int closeFile(int fd, vector<int> &held);
+    int readFile(int fd, uint64_t offset, uint64_t length, vector<char> &data);
+    int writeFile(int fd, uint64_t offset, const char *data, uint64_t length);
+    int syncFile(int fd);
+    int fileSize(int fd, uint64_t &size);
+    int storeRequest(const DiskRequest &request, const string &name, const vector<char> &data, string &out);
+
+public:
+    explicit DiskService(BufferCache &blockCache);
+    ~DiskService();
+
+    DiskService(const DiskService &) = delete;
+    DiskService &operator=(const DiskService &) = delete;
+
+    void setStore(const StoreHandlers &handlers) { store = handlers; } // Before start()
+    bool start(const string &directory);
+    void stop(); // Disconnects every task and closes their files
+
+    Stats stats();
+};
+
+#endif // DISK_SERVICE_H
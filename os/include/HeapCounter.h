@@ -0,0 +1,19 @@
+#ifndef HEAP_COUNTER_H
+#define HEAP_COUNTER_H
+
+#include <atomic>
+
+// Counts heap allocations for benchmarks that check a path never touches
+// the heap. The counter and the counting operator new are defined in
+// src/HeapCounter.cpp, which only the bench builds link (make bench also
+// defines COUNT_HEAP_ALLOCATIONS), so regular binaries keep the standard
+// allocator.
+#ifdef COUNT_HEAP_ALLOCATIONS
+extern std::atomic<long> heapAllocations;
+
+inline long heapAllocationCount() { return heapAllocations.load(std::memory_order_relaxed); }
+#else
+inline long heapAllocationCount() { return -1; } // Not counted in this build
+#endif
+
+#endif // HEAP_COUNTER_H
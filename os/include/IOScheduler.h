@@ -0,0 +1,85 @@
+#ifndef IO_SCHEDULER_H
+#define IO_SCHEDULER_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+using namespace std;
+
+enum IOPolicy
+{
+    IO_NOOP,     // FIFO, dispatch in arrival order
+    IO_ELEVATOR, // LOOK: sweep the head up, then down
+    IO_DEADLINE, // Sector order, but expired requests go first
+    IO_BFQ       // Per-process queues served fairly by sectors
+};
+
+const int IO_POLICY_COUNT = 4;
+
+// One block request. Times are in simulated seconds.
+struct IORequest
+{
+    uint64_t id;
+    int pid;
+    uint64_t sector;
+    uint32_t sectors;
+    bool write;
+    bool sync; // The process is blocked until it completes
+    double submitted;
+};
+
+// Rotating disk cost model. A request that starts where the previous one
+// ended is streamed; anything else pays a seek that grows with the square
+// root of the distance, then waits for its sector to rotate under the head.
+class BlockDevice
+{
+private:
+    uint64_t totalSectors;
+    uint64_t head; // Sector just past the last transfer
+
+    uint64_t seeks;
+    double seekSeconds;
+    double rotationSeconds;
+    double busySeconds;
+    uint64_t bytesTransferred;
+
+public:
+    static constexpr uint32_t SECTOR_SIZE = 512;
+    static constexpr double RPM = 7200.0;
+    static constexpr uint32_t SECTORS_PER_TRACK = 1024;
+    static constexpr double TRACK_TO_TRACK_SECONDS = 0.0005;
+    static constexpr double FULL_STROKE_SECONDS = 0.012;
+    static constexpr double BYTES_PER_SECOND = 150e6;
+
+    explicit BlockDevice(uint64_t totalSectors);
+
+    // Time to serve request when it starts at now, moves the head
+    double service(const IORequest &request, double now);
+
+    uint64_t sectors() const { return totalSectors; }
+    uint64_t headPosition() const { return head; }
+    uint64_t seekCount() const { return seeks; }
+    double seekTime() const { return seekSeconds; }
+    double rotationTime() const { return rotationSeconds; }
+    double busyTime() const { return busySeconds; }
+    uint64_t bytes() const { return bytesTransferred; }
+};
+
+// Orders pending requests for the device
+class IOScheduler
+{
+public:
+    virtual ~IOScheduler() = default;
+
+    virtual void add(const IORequest &request) = 0;
+    // Pick the next request to send to the device, false if none are pending
+    virtual bool dispatch(uint64_t head, double now, IORequest &request) = 0;
+    virtual size_t pending() const = 0;
+};
+
+unique_ptr<IOScheduler> makeIOScheduler(IOPolicy policy);
+bool parseIOPolicy(const string &name, IOPolicy &policy);
+const char *ioPolicyName(IOPolicy policy);
+
+#endif // IO_SCHEDULER_H
@@ -0,0 +1,78 @@
+#ifndef IO_WORKLOAD_H
+#define IO_WORKLOAD_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include "OSSystem.h"
+#include "IOScheduler.h"
+
+using namespace std;
+
+struct IOWorkloadConfig
+{
+    IOPolicy policy = IO_DEADLINE;
+    bool allPolicies = false; // Run every policy on the same workload and compare
+    unsigned seed = 1;
+    double duration = 20.0;   // Simulated seconds of submissions
+
+    int copyStreams = 2;      // file_manager processes copying large files
+    int interactive = 4;      // notepad processes doing small synchronous I/O
+    int copyDepth = 4;        // Requests each copy keeps in flight
+    uint32_t copySectors = 512;       // 256 KB per copy request
+    uint32_t interactiveSectors = 8;  // 4 KB per interactive request
+    double thinkTime = 0.05;          // Mean pause between interactive requests
+    double interactiveWriteShare = 0.2;
+};
+
+// Drives a simulated block device with I/O from OS processes. Copies stream
+// sequential reads and writes with several requests in flight, interactive
+// processes think, then block on a small random read or write. Everything
+// runs on a virtual clock, and each process's latency and throughput are
+// reported per scheduling policy.
+class IOWorkload
+{
+private:
+    struct Stream
+    {
+        int pid;
+        string task;
+        bool interactive;
+        uint64_t readStart;  // Region each stream reads from (and writes to when interactive)
+        uint64_t writeStart; // Copy destination
+        uint64_t regionSectors;
+    };
+
+    struct StreamResult
+    {
+        vector<double> latencies; // Seconds
+        uint64_t bytes = 0;
+    };
+
+    struct PolicyResult
+    {
+        IOPolicy policy;
+        vector<StreamResult> streams;
+        double elapsed = 0.0;
+        double busy = 0.0;
+        uint64_t bytes = 0;
+        uint64_t seeks = 0;
+        double seekTime = 0.0;
+    };
+
+    OSSystem &os;
+    IOWorkloadConfig config;
+    vector<Stream> streams;
+
+    static constexpr uint64_t DEVICE_SECTORS = 1000000000ull; // ~500 GB
+
+    PolicyResult simulate(IOPolicy policy);
+    void printResult(PolicyResult &result);
+
+public:
+    IOWorkload(OSSystem &os, const IOWorkloadConfig &config);
+
+    void run(); // Creates the processes, runs the policies and prints a summary
+};
+
+#endif // IO_WORKLOAD_H
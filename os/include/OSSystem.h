@@ -8,7 +8,14 @@
 #include <condition_variable>
 #include <unordered_map>
 #include <memory>
+#include <array>
 #include "Process.h"
+#include "ProcessPool.h"
+#include "TaskCatalog.h"
+#include "BufferCache.h"
+#include "DedupStore.h"
+#include "DiskService.h"
+#include "DiskAccountant.h"
 
 using namespace std;
 
@@ -29,19 +36,22 @@ private:
     int totalCores;
     int availableCores;
 
-    // Process management
-    vector<shared_ptr<Process>> runningProcesses;
-    vector<shared_ptr<Process>> blockedProcesses;
-    queue<shared_ptr<Process>> readyQueue;
+    // Process management, records are owned by processPool
+    ProcessPool processPool;
+    vector<Process *> runningProcesses;
+    vector<Process *> blockedProcesses;
+    ProcessQueue readyQueue;
 
     // Synchronization
     mutex resourceMutex;
     mutex queueMutex;
     condition_variable schedulerCV;
+    condition_variable dispatchCV;
 
     // System state
     SystemMode currentMode;
     bool isRunning;
+    bool headless; // No terminals are spawned, processes are tracked only
 
     // Process ID counter
     int nextPid;
@@ -49,7 +59,39 @@ private:
     // File system simulation
     unordered_map<string, int> fileSystem; // filename -> size
 
+    // Block cache for all OS disk I/O, its RAM is taken from totalRam at boot.
+    // Declared before diskStore so the store is closed while it still exists.
+    BufferCache bufferCache;
+    int cacheMb; // -1 = default share of totalRam
+
+    // Task file I/O, served through bufferCache while the system runs
+    DiskService diskService;
+
+    // File contents stored by the OS, deduplicated and compressed. Its pack
+    // file, dead space included, is charged to availableDisk in whole MB.
+    DedupStore diskStore;
+    int storeChargedMb;
+
+    void chargeStoreUsage(); // Caller holds resourceMutex
+
+    // Real bytes the tasks keep under simulated_disk. Whatever isn't covered
+    // by a live process's quota or a createFile claim is charged in whole MB.
+    DiskAccountant diskAccountant;
+    int accountedMb;
+
+    void reconcileDiskUsage();
+
+    // Which catalog tasks have a binary in build/, checked once at boot
+    array<bool, TASK_COUNT> taskInstalled;
+
+    void validateTaskCatalog();
+
 public:
+    // Default system resources
+    static constexpr int DEFAULT_RAM = 2048;    // 2GB in MB
+    static constexpr int DEFAULT_DISK = 102400; // 100GB in MB
+    static constexpr int DEFAULT_CORES = 4;
+
     OSSystem();
 
     // System initialization
@@ -63,6 +105,7 @@ public:
 
     // Process management
     int createProcess(const string &processName, int ramRequired, int diskRequired);
+    int launchTask(int taskIndex); // Launch a TASK_CATALOG entry
     bool terminateProcess(int pid);
     bool minimizeProcess(int pid);
     bool resumeProcess(int pid);
@@ -70,6 +113,7 @@ public:
     // Scheduling
     void scheduler();
     void dispatchProcesses();
+    void waitForDispatch(); // Blocks until the ready queue has been drained
 
     // Mode switching
     void switchToUserMode();
@@ -78,6 +122,13 @@ public:
     // File system operations
     bool createFile(const string &filename, int size);
     bool deleteFile(const string &filename);
+    bool writeFile(const string &filename, const string &data);
+    bool readFile(const string &filename, string &data);
+    bool readFile(const string &filename, uint64_t offset, uint64_t size, string &data);
+    bool importFile(const string &hostPath, const string &filename); // Copy a host file into the store
+    bool removeStoredFile(const string &filename);
+    bool copyFile(const string &source, const string &target); // Within the store, shares the content
+    void listStoredFiles(const string &prefix, vector<pair<string, uint64_t>> &out);
 
     // System operations
     void showSystemStatus();
@@ -92,6 +143,13 @@ public:
     SystemMode getCurrentMode() const { return currentMode; }
     int getUsedCores() const { return runningProcesses.size(); }
     int getTotalCores() const { return totalCores; }
+    bool isHeadless() const { return headless; }
+    bool isTaskInstalled(int taskIndex) const { return taskInstalled[taskIndex]; }
+
+    // Setters
+    void setHeadless(bool enabled) { headless = enabled; }
+    void setCacheSize(int mb) { cacheMb = mb; } // Before bootSystem()
+    void setCompression(bool enabled) { diskStore.setCompression(enabled); } // Before bootSystem()
 };
 
 #endif // OS_SYSTEM_H
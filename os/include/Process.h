@@ -3,11 +3,11 @@
 
 #include <string>
 #include <chrono>
-#include <thread>
+#include <cstdint>
 
 using namespace std;
 
-enum ProcessState
+enum ProcessState : uint8_t
 {
     NEW,
     READY,
@@ -16,27 +16,34 @@ enum ProcessState
     TERMINATED
 };
 
-class Process
+// Rarely touched per-process data, stored apart from the hot record
+struct ProcessColdData
+{
+    string name;
+};
+
+// Hot per-process record, packed into a single cache line. Instances are
+// owned by a ProcessPool and passed around as plain pointers.
+class alignas(64) Process
 {
 private:
+    chrono::steady_clock::time_point creationTime;
+    chrono::steady_clock::time_point startTime;
+    chrono::steady_clock::time_point endTime;
+    const ProcessColdData *cold;
     int pid;
-    string name;
-    ProcessState state;
     int memoryRequired;
     int diskRequired;
     int turnaroundTime; // In seconds
-    chrono::steady_clock::time_point creationTime;
-    chrono::steady_clock::time_point startTime;
-    chrono::steady_clock::time_point endTime;
-    thread taskThread;
+    ProcessState state;
 
 public:
-    Process(int pid, const string &name, int memoryRequired, int diskRequired);
+    Process(int pid, const ProcessColdData *cold, int memoryRequired, int diskRequired);
     ~Process();
 
     // Getters
     int getPid() const { return pid; }
-    string getName() const { return name; }
+    const string &getName() const { return cold->name; }
     ProcessState getState() const { return state; }
     int getMemoryRequired() const { return memoryRequired; }
     int getDiskRequired() const { return diskRequired; }
@@ -58,4 +65,6 @@ public:
     int calculateExecutionTime() const;
 };
 
+static_assert(sizeof(Process) == 64, "Process record should fill exactly one cache line");
+
 #endif // PROCESS_H
@@ -0,0 +1,70 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Process.h"
+
+using namespace std;
+
+// Fixed-capacity object pool for Process records. All storage is allocated
+// once by reserve(), so creating and terminating processes afterwards never
+// touches the heap.
+class ProcessPool
+{
+private:
+    Process *slots;                // Cache-line aligned hot records
+    vector<ProcessColdData> cold;  // Cold data, indexed like slots
+    vector<uint32_t> freeSlots;    // Stack of unused slot indices
+    size_t slotCount;
+
+public:
+    ProcessPool();
+    ~ProcessPool();
+
+    ProcessPool(const ProcessPool &) = delete;
+    ProcessPool &operator=(const ProcessPool &) = delete;
+
+    void reserve(size_t capacity); // Must be called before the first acquire
+
+    // Returns nullptr once the pool is exhausted
+    Process *acquire(int pid, const string &name, int memoryRequired, int diskRequired);
+    void release(Process *process);
+
+    size_t capacity() const { return slotCount; }
+    size_t inUse() const { return slotCount - freeSlots.size(); }
+};
+
+// Fixed-capacity FIFO of process handles, used as the ready queue.
+// Sized to the pool so it can never overflow.
+class ProcessQueue
+{
+private:
+    vector<Process *> ring;
+    size_t head;
+    size_t count;
+
+public:
+    ProcessQueue() : head(0), count(0) {}
+
+    void reserve(size_t capacity) { ring.assign(capacity, nullptr); head = 0; count = 0; }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    Process *front() const { return ring[head]; }
+
+    void push(Process *process)
+    {
+        ring[(head + count) % ring.size()] = process;
+        count++;
+    }
+
+    void pop()
+    {
+        head = (head + 1) % ring.size();
+        count--;
+    }
+};
+
+#endif // PROCESS_POOL_H
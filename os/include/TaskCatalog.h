@@ -0,0 +1,136 @@
+#ifndef TASK_CATALOG_H
+#define TASK_CATALOG_H
+
+#include <cstdint>
+#include <string_view>
+#include "Scheduler.h"
+
+// Static description of a launchable task
+struct TaskInfo
+{
+    const char *displayName; // Name shown in the task menu
+    const char *binary;      // Executable name inside build/
+    int ramRequired;         // MB
+    int diskRequired;        // MB
+    int coresRequired;
+    SchedulerType schedulingClass;
+};
+
+// Single source of truth for the task menu, the launcher and the workload
+// generator. Menu numbers are the index in this table plus one.
+constexpr TaskInfo TASK_CATALOG[] = {
+    {"Notepad", "notepad", 50, 10, 1, PRIORITY},
+    {"Calculator", "calculator", 20, 5, 1, PRIORITY},
+    {"Clock", "clock", 15, 2, 1, FCFS},
+    {"File Manager", "file_manager", 40, 5, 1, RR},
+    {"Minesweeper", "minesweeper", 30, 10, 1, RR},
+    {"Music Player", "music_player", 60, 20, 1, RR},
+    {"Calendar", "calendar", 25, 8, 1, FCFS},
+    {"Timer", "timer", 10, 2, 1, PRIORITY},
+    {"Terminal", "terminal", 15, 3, 1, PRIORITY},
+    {"System Monitor", "system_monitor", 25, 4, 1, FCFS},
+    {"Settings", "settings", 20, 3, 1, PRIORITY},
+};
+
+constexpr int TASK_COUNT = sizeof(TASK_CATALOG) / sizeof(TASK_CATALOG[0]);
+
+// Compile-time perfect hash over the binary names. A seed is searched for
+// at compile time so that every name lands in its own slot, which makes a
+// lookup one hash, one table load and one string compare.
+constexpr int TASK_HASH_TABLE_SIZE = 16; // Power of two >= TASK_COUNT
+static_assert(TASK_HASH_TABLE_SIZE >= TASK_COUNT, "Task catalog outgrew its hash table");
+
+struct TaskHashSlots
+{
+    int8_t index[TASK_HASH_TABLE_SIZE];
+};
+
+constexpr uint32_t taskHashSlot(std::string_view name, uint32_t seed)
+{
+    // Seeded FNV-1a
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : name)
+    {
+        h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return (h ^ (h >> 15)) & (TASK_HASH_TABLE_SIZE - 1);
+}
+
+constexpr uint32_t findTaskHashSeed()
+{
+    for (uint32_t seed = 1; seed < 100000; seed++)
+    {
+        bool used[TASK_HASH_TABLE_SIZE] = {};
+        bool collision = false;
+        for (int i = 0; i < TASK_COUNT && !collision; i++)
+        {
+            uint32_t slot = taskHashSlot(TASK_CATALOG[i].binary, seed);
+            collision = used[slot];
+            used[slot] = true;
+        }
+        if (!collision)
+        {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr uint32_t TASK_HASH_SEED = findTaskHashSeed();
+static_assert(TASK_HASH_SEED != 0, "No perfect hash seed found for the task catalog");
+
+constexpr TaskHashSlots buildTaskHashSlots()
+{
+    TaskHashSlots table{};
+    for (int slot = 0; slot < TASK_HASH_TABLE_SIZE; slot++)
+    {
+        table.index[slot] = -1;
+    }
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        table.index[taskHashSlot(TASK_CATALOG[i].binary, TASK_HASH_SEED)] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+constexpr TaskHashSlots TASK_HASH_SLOTS = buildTaskHashSlots();
+
+class TaskCatalog
+{
+public:
+    // Index of the task with the given binary name, or -1
+    static constexpr int find(std::string_view binary)
+    {
+        int index = TASK_HASH_SLOTS.index[taskHashSlot(binary, TASK_HASH_SEED)];
+        if (index >= 0 && binary == TASK_CATALOG[index].binary)
+        {
+            return index;
+        }
+        return -1;
+    }
+
+    // Smallest RAM requirement of any task
+    static constexpr int minRamRequired()
+    {
+        int minRam = TASK_CATALOG[0].ramRequired;
+        for (int i = 1; i < TASK_COUNT; i++)
+        {
+            if (TASK_CATALOG[i].ramRequired < minRam)
+            {
+                minRam = TASK_CATALOG[i].ramRequired;
+            }
+        }
+        return minRam;
+    }
+
+    // Index of the task with the given 1-based menu number, or -1
+    static constexpr int fromMenuNumber(int taskNum)
+    {
+        return (taskNum >= 1 && taskNum <= TASK_COUNT) ? taskNum - 1 : -1;
+    }
+};
+
+static_assert(TaskCatalog::find("system_monitor") == 9, "Task catalog lookup is broken");
+static_assert(TaskCatalog::find("file_explorer") == -1, "Task catalog lookup is broken");
+
+#endif // TASK_CATALOG_H
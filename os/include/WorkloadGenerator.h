@@ -0,0 +1,99 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include "OSSystem.h"
+
+using namespace std;
+
+enum ArrivalPattern
+{
+    POISSON, // Exponential inter-arrival times
+    BURSTY,  // On/off periods, arrivals only while on
+    DIURNAL  // Rate follows a sine wave over a simulated day
+};
+
+struct WorkloadConfig
+{
+    ArrivalPattern pattern = POISSON;
+    int arrivals = 100000;
+    double arrivalRate = 20.0;   // Mean arrivals per simulated second
+    unsigned seed = 1;
+
+    // Process behaviour, all times in simulated seconds
+    double meanCpuBurst = 0.5;
+    double meanIoBurst = 0.2;
+    double meanCpuBursts = 4.0;  // CPU bursts per process (geometric)
+    double ioBoundShare = 0.3;   // Share of processes that are I/O bound
+
+    // BURSTY: mean length of the on and off periods
+    double meanOnPeriod = 2.0;
+    double meanOffPeriod = 6.0;
+
+    // DIURNAL: rate(t) = arrivalRate * (1 + amplitude * sin(2*pi*t / period))
+    double diurnalPeriod = 600.0;
+    double diurnalAmplitude = 0.8;
+};
+
+// Generates synthetic process arrivals and drives an OSSystem with them.
+// The simulation runs on a virtual clock, so 100k arrivals take as long as
+// the OSSystem calls themselves. Each call's wall-clock latency is recorded.
+class WorkloadGenerator
+{
+private:
+    enum EventType
+    {
+        ARRIVAL,
+        CPU_BURST_END,
+        IO_BURST_END
+    };
+
+    struct Event
+    {
+        double time;
+        EventType type;
+        int pid;
+        int burstsLeft;
+        bool ioBound;
+
+        bool operator>(const Event &other) const { return time > other.time; }
+    };
+
+    struct LatencyStats
+    {
+        vector<double> samples; // Microseconds
+
+        void record(double micros) { samples.push_back(micros); }
+        void print(const string &label);
+    };
+
+    OSSystem &os;
+    WorkloadConfig config;
+    mt19937_64 rng;
+    vector<int> installedTasks; // Catalog indices launchTask would accept
+
+    // Arrival process state
+    double clock;
+    bool burstOn;
+    double periodEnd;
+
+    LatencyStats admitLatency;
+    LatencyStats blockLatency;
+    LatencyStats resumeLatency;
+    LatencyStats exitLatency;
+
+    double exponential(double mean);
+    double nextArrivalTime();
+    int pickTask();
+
+public:
+    WorkloadGenerator(OSSystem &os, const WorkloadConfig &config);
+
+    void run(); // Runs the workload and prints a summary
+};
+
+bool parseArrivalPattern(const string &name, ArrivalPattern &pattern);
+
+#endif // WORKLOAD_GENERATOR_H
@@ -0,0 +1,193 @@
+#include "../include/BlockCodec.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5; // A block always ends in literals
+    const size_t MIN_INPUT = 32;    // Below this the token overhead eats any saving
+    const int HASH_BITS = 12;
+    const unsigned SKIP_TRIGGER = 6; // Scan step grows by one every 64 misses
+
+    inline uint32_t read32(const uint8_t *p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t read64(const uint8_t *p)
+    {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t hash4(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Lengths of 15 and over continue in bytes of 255 until a smaller one
+    inline void putLength(uint8_t *&op, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            *op++ = 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+    }
+
+    inline bool getLength(const uint8_t *&ip, const uint8_t *end, size_t &length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (ip >= end)
+                return false;
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // Equal bytes at a and b, a stops at limit. b is behind a.
+    inline size_t matchLength(const uint8_t *a, const uint8_t *b, const uint8_t *limit)
+    {
+        size_t n = 0;
+        while (a + n + 8 <= limit)
+        {
+            uint64_t diff = read64(a + n) ^ read64(b + n);
+            if (diff != 0)
+                return n + (__builtin_ctzll(diff) >> 3);
+            n += 8;
+        }
+        while (a + n < limit && a[n] == b[n])
+        {
+            n++;
+        }
+        return n;
+    }
+}
+
+size_t BlockCodec::compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity)
+{
+    if (size < MIN_INPUT || size > MAX_BLOCK)
+        return 0;
+
+    // Positions fit in 16 bits since a block is at most 64 KB
+    uint16_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    uint8_t *op = dst;
+    const uint8_t *end = dst + min(capacity, size - size / 8);
+    const uint8_t *ip = src, *anchor = src;
+    const uint8_t *matchLimit = src + size - LAST_LITERALS;
+    const uint8_t *scanLimit = matchLimit - MIN_MATCH;
+    unsigned misses = 0;
+
+    while (ip <= scanLimit)
+    {
+        uint32_t sequence = read32(ip);
+        uint32_t h = hash4(sequence);
+        const uint8_t *candidate = src + table[h];
+        table[h] = static_cast<uint16_t>(ip - src);
+        if (candidate >= ip || read32(candidate) != sequence)
+        {
+            ip += 1 + (misses++ >> SKIP_TRIGGER);
+            continue;
+        }
+        misses = 0;
+
+        while (ip > anchor && candidate > src && ip[-1] == candidate[-1])
+        {
+            ip--;
+            candidate--;
+        }
+        size_t length = MIN_MATCH + matchLength(ip + MIN_MATCH, candidate + MIN_MATCH, matchLimit);
+        size_t literals = ip - anchor;
+        if (op + 1 + literals + literals / 255 + 1 + 2 + length / 255 + 1 > end)
+            return 0;
+
+        uint8_t *token = op++;
+        *token = static_cast<uint8_t>(min<size_t>(literals, 15) << 4);
+        if (literals >= 15)
+            putLength(op, literals - 15);
+        memcpy(op, anchor, literals);
+        op += literals;
+
+        size_t offset = ip - candidate;
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        size_t extra = length - MIN_MATCH;
+        *token |= static_cast<uint8_t>(min<size_t>(extra, 15));
+        if (extra >= 15)
+            putLength(op, extra - 15);
+
+        ip += length;
+        anchor = ip;
+        // Index a position inside the match so a repeat of it is found next time
+        table[hash4(read32(ip - 2))] = static_cast<uint16_t>(ip - 2 - src);
+    }
+
+    size_t literals = src + size - anchor;
+    if (op + 1 + literals + literals / 255 + 1 > end)
+        return 0;
+    *op++ = static_cast<uint8_t>(min<size_t>(literals, 15) << 4);
+    if (literals >= 15)
+        putLength(op, literals - 15);
+    memcpy(op, anchor, literals);
+    op += literals;
+    return op - dst;
+}
+
+bool BlockCodec::decompress(const uint8_t *src, size_t compressedSize, uint8_t *dst, size_t size)
+{
+    const uint8_t *ip = src, *end = src + compressedSize;
+    uint8_t *op = dst, *limit = dst + size;
+
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !getLength(ip, end, literals))
+            return false;
+        if (literals > static_cast<size_t>(end - ip) || literals > static_cast<size_t>(limit - op))
+            return false;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end)
+            break; // The last sequence has no match
+
+        if (end - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !getLength(ip, end, length))
+            return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst) || length > static_cast<size_t>(limit - op))
+            return false;
+
+        const uint8_t *match = op - offset;
+        if (offset >= length)
+        {
+            memcpy(op, match, length);
+        }
+        else
+        {
+            // Overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < length; i++)
+            {
+                op[i] = match[i];
+            }
+        }
+        op += length;
+    }
+    return op == limit;
+}
@@ -0,0 +1,410 @@
+#include "../include/BufferCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    const auto FLUSH_INTERVAL = chrono::seconds(5); // Longest a block stays dirty when idle
+    const size_t FLUSH_BATCH = 64;                  // Blocks written per lock hold
+
+    bool preadAll(int fd, char *buffer, size_t size, uint64_t offset)
+    {
+        while (size > 0)
+        {
+            ssize_t count = pread(fd, buffer, size, offset);
+            if (count <= 0)
+                return false;
+            buffer += count;
+            size -= count;
+            offset += count;
+        }
+        return true;
+    }
+
+    bool pwriteAll(int fd, const char *buffer, size_t size, uint64_t offset)
+    {
+        while (size > 0)
+        {
+            ssize_t count = pwrite(fd, buffer, size, offset);
+            if (count <= 0)
+                return false;
+            buffer += count;
+            size -= count;
+            offset += count;
+        }
+        return true;
+    }
+}
+
+BufferCache::BufferCache()
+    : data(nullptr), a1inTarget(0), ghostLimit(0), backgroundDirty(0), hardDirty(0),
+      counters{}, flushing(false)
+{
+}
+
+BufferCache::~BufferCache()
+{
+    stop();
+    delete[] data;
+}
+
+void BufferCache::configure(size_t bytes)
+{
+    size_t blocks = bytes / BLOCK_SIZE;
+    delete[] data;
+    data = blocks > 0 ? new char[blocks * BLOCK_SIZE] : nullptr;
+    slots.assign(blocks, Slot{{-1, 0}, NONE, NONE, 0, FREE, false});
+    freeSlots.clear();
+    for (size_t i = blocks; i > 0; i--)
+    {
+        freeSlots.push_back(static_cast<uint32_t>(i - 1));
+    }
+    index.clear();
+    index.reserve(blocks);
+    a1in = List();
+    am = List();
+    a1out.clear();
+    ghosts.clear();
+
+    // The usual 2Q split: a quarter for first-time blocks, ghosts for half the cache
+    a1inTarget = max<size_t>(1, blocks / 4);
+    ghostLimit = max<size_t>(1, blocks / 2);
+    backgroundDirty = max<size_t>(1, blocks / 10);
+    hardDirty = max<size_t>(1, blocks * 4 / 10);
+}
+
+void BufferCache::start()
+{
+    if (slots.empty() || flushing)
+    {
+        return;
+    }
+    flushing = true;
+    flusher = thread(&BufferCache::flusherLoop, this);
+}
+
+void BufferCache::stop()
+{
+    if (flushing.exchange(false))
+    {
+        flusherCV.notify_all();
+    }
+    if (flusher.joinable())
+    {
+        flusher.join();
+    }
+    lock_guard<mutex> lock(cacheMutex);
+    writeBackDirty(SIZE_MAX, -1);
+}
+
+void BufferCache::unlink(List &queue, uint32_t slot)
+{
+    Slot &entry = slots[slot];
+    if (entry.prev != NONE)
+        slots[entry.prev].next = entry.next;
+    else
+        queue.head = entry.next;
+    if (entry.next != NONE)
+        slots[entry.next].prev = entry.prev;
+    else
+        queue.tail = entry.prev;
+    entry.prev = entry.next = NONE;
+    queue.size--;
+}
+
+void BufferCache::pushFront(List &queue, uint32_t slot, Queue name)
+{
+    Slot &entry = slots[slot];
+    entry.queue = name;
+    entry.prev = NONE;
+    entry.next = queue.head;
+    if (queue.head != NONE)
+        slots[queue.head].prev = slot;
+    queue.head = slot;
+    if (queue.tail == NONE)
+        queue.tail = slot;
+    queue.size++;
+}
+
+void BufferCache::rememberGhost(const BlockKey &key)
+{
+    if (ghosts.size() >= ghostLimit)
+    {
+        ghosts.erase(a1out.back());
+        a1out.pop_back();
+    }
+    a1out.push_front(key);
+    ghosts[key] = a1out.begin();
+}
+
+bool BufferCache::writeBack(uint32_t slot)
+{
+    Slot &entry = slots[slot];
+    if (!pwriteAll(entry.key.fd, blockData(slot), entry.length, entry.key.block * BLOCK_SIZE))
+    {
+        return false;
+    }
+    entry.dirty = false;
+    dirtyBlocks.erase(entry.key);
+    counters.writebacks++;
+    return true;
+}
+
+bool BufferCache::reclaim()
+{
+    // Evict from A1in while it is over its share, from Am otherwise
+    bool fromA1in = a1in.size > a1inTarget || am.size == 0;
+    List &queue = fromA1in ? a1in : am;
+    uint32_t victim = queue.tail;
+    if (victim == NONE)
+    {
+        return false;
+    }
+
+    Slot &entry = slots[victim];
+    if (entry.dirty && !writeBack(victim))
+    {
+        return false;
+    }
+    unlink(queue, victim);
+    index.erase(entry.key);
+    if (fromA1in)
+    {
+        rememberGhost(entry.key);
+    }
+    entry.queue = FREE;
+    freeSlots.push_back(victim);
+    counters.evictions++;
+    return true;
+}
+
+bool BufferCache::lookup(int fd, uint64_t block, bool fill, uint32_t &slot)
+{
+    BlockKey key{fd, block};
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        // 2Q only reorders Am, a second touch while in A1in is likely correlated
+        slot = found->second;
+        if (slots[slot].queue == AM)
+        {
+            unlink(am, slot);
+            pushFront(am, slot, AM);
+        }
+        counters.hits++;
+        return true;
+    }
+
+    counters.misses++;
+    if (freeSlots.empty() && !reclaim())
+    {
+        return false;
+    }
+    slot = freeSlots.back();
+    Slot &entry = slots[slot];
+
+    uint32_t length = 0;
+    if (fill)
+    {
+        ssize_t count = pread(fd, blockData(slot), BLOCK_SIZE, block * BLOCK_SIZE);
+        if (count < 0)
+        {
+            return false;
+        }
+        length = static_cast<uint32_t>(count);
+    }
+    freeSlots.pop_back();
+    entry.key = key;
+    entry.length = length;
+    entry.dirty = false;
+
+    // A block evicted from A1in and wanted again is hot, it goes straight to Am
+    auto ghost = ghosts.find(key);
+    if (ghost != ghosts.end())
+    {
+        a1out.erase(ghost->second);
+        ghosts.erase(ghost);
+        counters.ghostHits++;
+        pushFront(am, slot, AM);
+    }
+    else
+    {
+        pushFront(a1in, slot, A1IN);
+    }
+    index.emplace(key, slot);
+    return true;
+}
+
+bool BufferCache::writeBackDirty(size_t limit, int fd)
+{
+    // Write in (fd, block) order so neighbouring blocks go out together
+    bool ok = true;
+    auto it = fd < 0 ? dirtyBlocks.begin() : dirtyBlocks.lower_bound(BlockKey{fd, 0});
+    for (size_t written = 0; it != dirtyBlocks.end() && written < limit; written++)
+    {
+        if (fd >= 0 && it->first.fd != fd)
+            break;
+        uint32_t slot = (it++)->second; // writeBack erases the entry
+        ok = writeBack(slot) && ok;
+    }
+    return ok;
+}
+
+void BufferCache::flusherLoop()
+{
+    unique_lock<mutex> lock(cacheMutex);
+    while (flushing)
+    {
+        flusherCV.wait_for(lock, FLUSH_INTERVAL, [this]()
+                           { return !flushing || dirtyBlocks.size() > backgroundDirty; });
+
+        // Write everything back in small batches so readers get the lock in between
+        while (flushing && !dirtyBlocks.empty())
+        {
+            size_t before = dirtyBlocks.size();
+            writeBackDirty(FLUSH_BATCH, -1);
+            if (dirtyBlocks.size() == before)
+            {
+                break; // Device errors, try again next round
+            }
+            lock.unlock();
+            this_thread::yield();
+            lock.lock();
+        }
+    }
+}
+
+bool BufferCache::read(int fd, uint64_t offset, char *buffer, size_t size)
+{
+    if (slots.empty())
+    {
+        return preadAll(fd, buffer, size, offset);
+    }
+
+    lock_guard<mutex> lock(cacheMutex);
+    while (size > 0)
+    {
+        uint64_t block = offset / BLOCK_SIZE;
+        size_t within = offset % BLOCK_SIZE;
+        size_t count = min(size, BLOCK_SIZE - within);
+
+        uint32_t slot;
+        if (!lookup(fd, block, true, slot) || slots[slot].length < within + count)
+        {
+            return false; // I/O error or past the end of the file
+        }
+        memcpy(buffer, blockData(slot) + within, count);
+        buffer += count;
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool BufferCache::write(int fd, uint64_t offset, const char *buffer, size_t size)
+{
+    if (slots.empty())
+    {
+        return pwriteAll(fd, buffer, size, offset);
+    }
+
+    lock_guard<mutex> lock(cacheMutex);
+    while (size > 0)
+    {
+        uint64_t block = offset / BLOCK_SIZE;
+        size_t within = offset % BLOCK_SIZE;
+        size_t count = min(size, BLOCK_SIZE - within);
+
+        // Partial blocks are read first so the rest of the block survives
+        uint32_t slot;
+        if (!lookup(fd, block, count < BLOCK_SIZE, slot))
+        {
+            return false;
+        }
+        Slot &entry = slots[slot];
+        if (entry.length < within)
+        {
+            memset(blockData(slot) + entry.length, 0, within - entry.length);
+        }
+        memcpy(blockData(slot) + within, buffer, count);
+        entry.length = max<uint32_t>(entry.length, within + count);
+        if (!entry.dirty)
+        {
+            entry.dirty = true;
+            dirtyBlocks.emplace(entry.key, slot);
+        }
+        buffer += count;
+        offset += count;
+        size -= count;
+    }
+
+    if (dirtyBlocks.size() > hardDirty)
+    {
+        // Throttle: this writer pays for the write-back itself
+        return writeBackDirty(dirtyBlocks.size() - backgroundDirty, -1);
+    }
+    if (dirtyBlocks.size() > backgroundDirty)
+    {
+        flusherCV.notify_one();
+    }
+    return true;
+}
+
+bool BufferCache::flush(int fd)
+{
+    if (slots.empty())
+    {
+        return true;
+    }
+    lock_guard<mutex> lock(cacheMutex);
+    return writeBackDirty(SIZE_MAX, fd);
+}
+
+void BufferCache::invalidate(int fd)
+{
+    if (slots.empty())
+    {
+        return;
+    }
+    lock_guard<mutex> lock(cacheMutex);
+    for (uint32_t i = 0; i < slots.size(); i++)
+    {
+        Slot &entry = slots[i];
+        if (entry.queue == FREE || entry.key.fd != fd)
+            continue;
+        if (entry.dirty)
+            dirtyBlocks.erase(entry.key);
+        unlink(entry.queue == AM ? am : a1in, i);
+        index.erase(entry.key);
+        entry.queue = FREE;
+        entry.dirty = false;
+        freeSlots.push_back(i);
+    }
+
+    // The fd number will be reused, so its ghosts mean nothing any more
+    for (auto it = a1out.begin(); it != a1out.end();)
+    {
+        if (it->fd == fd)
+        {
+            ghosts.erase(*it);
+            it = a1out.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+BufferCache::Stats BufferCache::stats() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+    Stats result = counters;
+    result.dirtyBlocks = dirtyBlocks.size();
+    result.residentBlocks = index.size();
+    return result;
+}
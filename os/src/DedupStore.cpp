@@ -0,0 +1,736 @@
+#include "../include/DedupStore.h"
+#include "../include/BlockCodec.h"
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace
+{
+    // Chunk sizes: boundaries are never closer than MIN or further than MAX,
+    // and average around AVG
+    const size_t MIN_CHUNK = 2 * 1024;
+    const size_t AVG_CHUNK = 8 * 1024;
+    const size_t MAX_CHUNK = 64 * 1024;
+
+    // Normalized chunking: a stricter mask before the average size and a
+    // looser one after it pulls chunk sizes towards AVG_CHUNK
+    const uint64_t MASK_SMALL = 0x0000d9f003530000ull; // 15 bits set
+    const uint64_t MASK_LARGE = 0x0000d90003530000ull; // 11 bits set
+
+    // Version 2 added the stored size of each chunk, version 1 had no compression
+    const char MANIFEST_MAGIC[4] = {'D', 'D', 'S', '2'};
+    const char MANIFEST_MAGIC_V1[4] = {'D', 'D', 'S', '1'};
+
+    constexpr uint64_t splitmix64(uint64_t &state)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // Random value per byte for the gear rolling hash
+    constexpr array<uint64_t, 256> makeGearTable()
+    {
+        array<uint64_t, 256> table{};
+        uint64_t state = 0x5eed;
+        for (auto &entry : table)
+        {
+            entry = splitmix64(state);
+        }
+        return table;
+    }
+
+    constexpr array<uint64_t, 256> GEAR = makeGearTable();
+
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t fmix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        return h ^ (h >> 33);
+    }
+
+    bool writeAll(int fd, const char *data, size_t size, uint64_t offset)
+    {
+        while (size > 0)
+        {
+            ssize_t written = pwrite(fd, data, size, offset);
+            if (written <= 0)
+                return false;
+            data += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char *data, size_t size, uint64_t offset)
+    {
+        while (size > 0)
+        {
+            ssize_t count = pread(fd, data, size, offset);
+            if (count <= 0)
+                return false;
+            data += count;
+            size -= count;
+            offset += count;
+        }
+        return true;
+    }
+
+    template <typename T>
+    void put(string &out, T value) { out.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+
+    template <typename T>
+    bool get(const string &in, size_t &pos, T &value)
+    {
+        if (pos + sizeof(value) > in.size())
+            return false;
+        memcpy(&value, in.data() + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+}
+
+size_t DedupStore::nextChunkBoundary(const uint8_t *data, size_t size)
+{
+    if (size <= MIN_CHUNK)
+        return size;
+
+    size_t limit = size < MAX_CHUNK ? size : MAX_CHUNK;
+    size_t normal = limit < AVG_CHUNK ? limit : AVG_CHUNK;
+    uint64_t hash = 0;
+    size_t i = MIN_CHUNK;
+    for (; i < normal; i++)
+    {
+        hash = (hash << 1) + GEAR[data[i]];
+        if ((hash & MASK_SMALL) == 0)
+            return i + 1;
+    }
+    for (; i < limit; i++)
+    {
+        hash = (hash << 1) + GEAR[data[i]];
+        if ((hash & MASK_LARGE) == 0)
+            return i + 1;
+    }
+    return limit;
+}
+
+ChunkId DedupStore::hashChunk(const uint8_t *data, size_t size)
+{
+    // Two independent multiply-rotate lanes over 8-byte words
+    const uint64_t K1 = 0x87c37b91114253d5ull, K2 = 0x4cf5ad432745937full;
+    uint64_t lo = 0x243f6a8885a308d3ull ^ size, hi = 0x13198a2e03707344ull ^ (size * K1);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        lo = rotl(lo ^ (word * K1), 31) * K2;
+        hi = rotl(hi + (word * K2), 27) * K1 + lo;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    lo = rotl(lo ^ (tail * K1), 31) * K2;
+    hi = rotl(hi + (tail * K2), 27) * K1 + lo;
+    return {fmix(lo ^ hi), fmix(hi + (lo << 1))};
+}
+
+DedupStore::DedupStore()
+    : packFd(-1), packSize(0), cache(nullptr), logical(0), unique(0), physical(0), dirty(false), compression(true),
+      codec{}
+{
+}
+
+DedupStore::~DedupStore()
+{
+    if (packFd >= 0)
+    {
+        if (cache != nullptr)
+        {
+            cache->flush(packFd);
+            cache->invalidate(packFd);
+        }
+        close(packFd);
+    }
+}
+
+bool DedupStore::packRead(char *data, size_t size, uint64_t offset) const
+{
+    return cache != nullptr ? cache->read(packFd, offset, data, size) : readAll(packFd, data, size, offset);
+}
+
+bool DedupStore::packWrite(const char *data, size_t size, uint64_t offset)
+{
+    return cache != nullptr ? cache->write(packFd, offset, data, size) : writeAll(packFd, data, size, offset);
+}
+
+bool DedupStore::open(const string &directory)
+{
+    lock_guard<mutex> lock(storeMutex);
+    root = directory;
+    size_t slash = 0;
+    while ((slash = root.find('/', slash + 1)) != string::npos)
+    {
+        mkdir(root.substr(0, slash).c_str(), 0755);
+    }
+    mkdir(root.c_str(), 0755);
+
+    packFd = ::open((root + "/chunks").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (packFd < 0)
+        return false;
+    struct stat info;
+    if (fstat(packFd, &info) != 0)
+        return false;
+    packSize = info.st_size;
+
+    if (!loadManifest())
+    {
+        // No usable manifest, so nothing in the pack is referenced
+        chunks.clear();
+        freeChunks.clear();
+        chunkIndex.clear();
+        files.clear();
+        logical = unique = physical = 0;
+        packSize = 0;
+        return ftruncate(packFd, 0) == 0;
+    }
+    return true;
+}
+
+bool DedupStore::loadManifest()
+{
+    int fd = ::open((root + "/manifest").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    string in;
+    if (fstat(fd, &info) == 0)
+    {
+        in.resize(info.st_size);
+    }
+    bool readOk = readAll(fd, &in[0], in.size(), 0);
+    close(fd);
+    if (!readOk || in.size() < sizeof(MANIFEST_MAGIC))
+        return false;
+    bool v1 = memcmp(in.data(), MANIFEST_MAGIC_V1, sizeof(MANIFEST_MAGIC_V1)) == 0;
+    if (!v1 && memcmp(in.data(), MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0)
+        return false;
+
+    size_t pos = sizeof(MANIFEST_MAGIC);
+    uint64_t syncedPackSize;
+    uint32_t chunkTotal;
+    if (!get(in, pos, syncedPackSize) || !get(in, pos, chunkTotal) || syncedPackSize > packSize)
+        return false;
+
+    chunks.resize(chunkTotal);
+    for (Chunk &chunk : chunks)
+    {
+        if (!get(in, pos, chunk.id.lo) || !get(in, pos, chunk.id.hi) || !get(in, pos, chunk.offset) ||
+            !get(in, pos, chunk.size))
+            return false;
+        chunk.stored = chunk.size;
+        if ((!v1 && !get(in, pos, chunk.stored)) || chunk.stored > chunk.size ||
+            chunk.offset + chunk.stored > syncedPackSize)
+            return false;
+        chunk.refs = 0;
+    }
+
+    uint32_t fileTotal;
+    if (!get(in, pos, fileTotal))
+        return false;
+    for (uint32_t f = 0; f < fileTotal; f++)
+    {
+        uint32_t nameLength, chunkRefs;
+        if (!get(in, pos, nameLength) || pos + nameLength > in.size())
+            return false;
+        string name = in.substr(pos, nameLength);
+        pos += nameLength;
+
+        FileMap &map = files[name];
+        if (!get(in, pos, map.size) || !get(in, pos, chunkRefs))
+            return false;
+        map.chunks.resize(chunkRefs);
+        map.starts.resize(chunkRefs);
+        uint64_t start = 0;
+        for (uint32_t i = 0; i < chunkRefs; i++)
+        {
+            uint32_t &index = map.chunks[i];
+            if (!get(in, pos, index) || index >= chunkTotal)
+                return false;
+            chunks[index].refs++;
+            map.starts[i] = start;
+            start += chunks[index].size;
+        }
+        logical += map.size;
+    }
+
+    // Slots nobody references are free, and so is anything appended after the last sync
+    for (uint32_t i = 0; i < chunkTotal; i++)
+    {
+        if (chunks[i].refs == 0)
+        {
+            freeChunks.push_back(i);
+            continue;
+        }
+        chunkIndex[chunks[i].id] = i;
+        unique += chunks[i].size;
+        physical += chunks[i].stored;
+    }
+    packSize = syncedPackSize;
+    return ftruncate(packFd, packSize) == 0;
+}
+
+bool DedupStore::writeManifest()
+{
+    string out(MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    put<uint64_t>(out, packSize);
+    put<uint32_t>(out, chunks.size());
+    for (const Chunk &chunk : chunks)
+    {
+        put(out, chunk.id.lo);
+        put(out, chunk.id.hi);
+        put(out, chunk.refs ? chunk.offset : 0);
+        put(out, chunk.refs ? chunk.size : 0);
+        put(out, chunk.refs ? chunk.stored : 0);
+    }
+    put<uint32_t>(out, files.size());
+    for (const auto &entry : files)
+    {
+        put<uint32_t>(out, entry.first.size());
+        out += entry.first;
+        put(out, entry.second.size);
+        put<uint32_t>(out, entry.second.chunks.size());
+        for (uint32_t index : entry.second.chunks)
+        {
+            put(out, index);
+        }
+    }
+
+    // Chunks must be durable before the manifest that points at them
+    if ((cache != nullptr && !cache->flush(packFd)) || fdatasync(packFd) != 0)
+        return false;
+    string temp = root + "/manifest.tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = writeAll(fd, out.data(), out.size(), 0) && fdatasync(fd) == 0;
+    close(fd);
+    return ok && rename(temp.c_str(), (root + "/manifest").c_str()) == 0;
+}
+
+bool DedupStore::compact()
+{
+    // Copy live chunks into a fresh pack, in slot order, reading the old one directly
+    if (cache != nullptr && !cache->flush(packFd))
+        return false;
+    string temp = root + "/chunks.tmp";
+    int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    vector<uint64_t> offsets(chunks.size(), 0);
+    vector<char> buffer(MAX_CHUNK);
+    uint64_t size = 0;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        const Chunk &chunk = chunks[i];
+        if (chunk.refs == 0)
+            continue;
+        if (!readAll(packFd, buffer.data(), chunk.stored, chunk.offset) ||
+            !writeAll(fd, buffer.data(), chunk.stored, size))
+        {
+            close(fd);
+            unlink(temp.c_str());
+            return false;
+        }
+        offsets[i] = size;
+        size += chunk.stored;
+    }
+    if (fdatasync(fd) != 0 || rename(temp.c_str(), (root + "/chunks").c_str()) != 0)
+    {
+        close(fd);
+        unlink(temp.c_str());
+        return false;
+    }
+
+    if (cache != nullptr)
+    {
+        cache->invalidate(packFd);
+    }
+    close(packFd);
+    packFd = fd;
+    packSize = size;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i].offset = offsets[i];
+    }
+    return true;
+}
+
+bool DedupStore::sync()
+{
+    lock_guard<mutex> lock(storeMutex);
+    if (packFd < 0 || !dirty)
+        return true;
+
+    if (mostlyDead() && !compact())
+        return false;
+
+    if (!writeManifest())
+        return false;
+    dirty = false;
+    return true;
+}
+
+bool DedupStore::mostlyDead() const
+{
+    // Rewrite the pack once more than half of it is unreferenced
+    uint64_t dead = packSize - physical;
+    return dead > physical && dead > MAX_CHUNK * 16;
+}
+
+bool DedupStore::reclaim()
+{
+    lock_guard<mutex> lock(storeMutex);
+    if (packFd < 0 || !mostlyDead())
+        return true;
+
+    // The manifest on disk points into the old pack, so it goes with it
+    if (!compact() || !writeManifest())
+        return false;
+    dirty = false;
+    return true;
+}
+
+void DedupStore::release(const FileMap &map)
+{
+    for (uint32_t index : map.chunks)
+    {
+        Chunk &chunk = chunks[index];
+        if (--chunk.refs == 0)
+        {
+            unique -= chunk.size;
+            physical -= chunk.stored;
+            chunkIndex.erase(chunk.id);
+            freeChunks.push_back(index);
+        }
+    }
+    logical -= map.size;
+}
+
+bool DedupStore::writeFile(const string &name, const char *data, size_t size, uint64_t budget)
+{
+    struct Piece
+    {
+        ChunkId id;
+        size_t offset;
+        uint32_t size;
+        uint32_t stored; // Set once a new chunk is compressed, 0 otherwise
+        size_t packed;   // Its compressed bytes in packed, if stored < size
+    };
+
+    // Chunk and hash outside the lock, only the index lookups need it
+    vector<Piece> pieces;
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    for (size_t offset = 0; offset < size;)
+    {
+        size_t length = nextChunkBoundary(bytes + offset, size - offset);
+        pieces.push_back({hashChunk(bytes + offset, length), offset, static_cast<uint32_t>(length), 0, 0});
+        offset += length;
+    }
+
+    // Find the chunks not stored yet, counting repeats within this file once
+    vector<Piece *> fresh;
+    {
+        lock_guard<mutex> lock(storeMutex);
+        if (packFd < 0)
+            return false;
+        unordered_map<ChunkId, uint32_t, ChunkIdHash> seen;
+        for (Piece &piece : pieces)
+        {
+            if (chunkIndex.count(piece.id) == 0 && seen.emplace(piece.id, 0).second)
+                fresh.push_back(&piece);
+        }
+    }
+
+    // Compress them without the lock, so other tasks' reads and writes go on meanwhile
+    vector<uint8_t> packed;
+    CodecStats spent{};
+    for (Piece *piece : fresh)
+    {
+        piece->stored = piece->size;
+        if (!compression)
+            continue;
+        auto start = chrono::steady_clock::now();
+        piece->packed = packed.size();
+        packed.resize(piece->packed + piece->size);
+        size_t length = BlockCodec::compress(bytes + piece->offset, piece->size, packed.data() + piece->packed, piece->size);
+        packed.resize(piece->packed + length);
+        spent.compressSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        spent.compressInBytes += piece->size;
+        if (length > 0)
+        {
+            piece->stored = static_cast<uint32_t>(length);
+            spent.compressedChunks++;
+        }
+        else
+        {
+            spent.bypassedChunks++;
+        }
+    }
+
+    lock_guard<mutex> lock(storeMutex);
+    if (packFd < 0)
+        return false;
+    codec.compressedChunks += spent.compressedChunks;
+    codec.bypassedChunks += spent.bypassedChunks;
+    codec.compressInBytes += spent.compressInBytes;
+    codec.compressSeconds += spent.compressSeconds;
+
+    // Total what the new chunks take in the pack. The index may have changed
+    // since the lookup: a chunk another write added is shared, and one that
+    // was released in between is stored as it is.
+    unordered_map<ChunkId, uint32_t, ChunkIdHash> added;
+    uint64_t needed = 0;
+    for (Piece &piece : pieces)
+    {
+        if (chunkIndex.count(piece.id) != 0 || !added.emplace(piece.id, 0).second)
+            continue;
+        if (piece.stored == 0)
+            piece.stored = piece.size;
+        needed += piece.stored;
+    }
+    if (needed > budget)
+        return false;
+
+    FileMap map{size, {}, {}};
+    map.chunks.reserve(pieces.size());
+    map.starts.reserve(pieces.size());
+    for (const Piece &piece : pieces)
+    {
+        auto found = chunkIndex.find(piece.id);
+        if (found == chunkIndex.end())
+        {
+            const char *source = piece.stored < piece.size ? reinterpret_cast<const char *>(packed.data() + piece.packed)
+                                                           : data + piece.offset;
+            if (!packWrite(source, piece.stored, packSize))
+            {
+                // Undo the references taken so far, the appended bytes become dead space
+                map.size = 0;
+                release(map);
+                return false;
+            }
+            uint32_t index;
+            if (!freeChunks.empty())
+            {
+                index = freeChunks.back();
+                freeChunks.pop_back();
+            }
+            else
+            {
+                index = chunks.size();
+                chunks.emplace_back();
+            }
+            chunks[index] = {piece.id, packSize, piece.size, piece.stored, 0};
+            packSize += piece.stored;
+            unique += piece.size;
+            physical += piece.stored;
+            found = chunkIndex.emplace(piece.id, index).first;
+        }
+        chunks[found->second].refs++;
+        map.chunks.push_back(found->second);
+        map.starts.push_back(piece.offset);
+    }
+    logical += size;
+
+    // Reference the new content before dropping the old, so shared chunks survive
+    auto existing = files.find(name);
+    if (existing != files.end())
+    {
+        release(existing->second);
+        existing->second = move(map);
+    }
+    else
+    {
+        files.emplace(name, move(map));
+    }
+    dirty = true;
+    return true;
+}
+
+bool DedupStore::loadChunk(const Chunk &chunk, char *data, vector<char> &scratch) const
+{
+    if (chunk.stored == chunk.size)
+        return packRead(data, chunk.size, chunk.offset);
+
+    scratch.resize(chunk.stored);
+    if (!packRead(scratch.data(), chunk.stored, chunk.offset))
+        return false;
+    auto start = chrono::steady_clock::now();
+    bool ok = BlockCodec::decompress(reinterpret_cast<const uint8_t *>(scratch.data()), chunk.stored,
+                                     reinterpret_cast<uint8_t *>(data), chunk.size);
+    codec.decompressSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    codec.decompressOutBytes += chunk.size;
+    return ok;
+}
+
+bool DedupStore::readFile(const string &name, string &data) const
+{
+    return readRange(name, 0, UINT64_MAX, data);
+}
+
+bool DedupStore::readRange(const string &name, uint64_t offset, uint64_t size, string &data) const
+{
+    lock_guard<mutex> lock(storeMutex);
+    auto found = files.find(name);
+    if (found == files.end())
+        return false;
+    const FileMap &map = found->second;
+
+    offset = min(offset, map.size);
+    uint64_t end = offset + min(size, map.size - offset);
+    data.resize(end - offset);
+
+    // Only the chunks overlapping the range are read, and only they are decompressed
+    size_t first = upper_bound(map.starts.begin(), map.starts.end(), offset) - map.starts.begin();
+    vector<char> scratch, partial;
+    for (size_t i = first > 0 ? first - 1 : 0; i < map.chunks.size() && map.starts[i] < end; i++)
+    {
+        const Chunk &chunk = chunks[map.chunks[i]];
+        uint64_t chunkStart = map.starts[i];
+        uint64_t from = max(offset, chunkStart), to = min(end, chunkStart + chunk.size);
+        char *target = &data[from - offset];
+        if (from == chunkStart && to == chunkStart + chunk.size)
+        {
+            if (!loadChunk(chunk, target, scratch))
+                return false;
+        }
+        else if (chunk.stored == chunk.size)
+        {
+            if (!packRead(target, to - from, chunk.offset + (from - chunkStart)))
+                return false;
+        }
+        else
+        {
+            partial.resize(chunk.size);
+            if (!loadChunk(chunk, partial.data(), scratch))
+                return false;
+            memcpy(target, partial.data() + (from - chunkStart), to - from);
+        }
+    }
+    return true;
+}
+
+bool DedupStore::removeFile(const string &name)
+{
+    lock_guard<mutex> lock(storeMutex);
+    auto found = files.find(name);
+    if (found == files.end())
+        return false;
+    release(found->second);
+    files.erase(found);
+    dirty = true;
+    return true;
+}
+
+bool DedupStore::copyFile(const string &source, const string &target)
+{
+    lock_guard<mutex> lock(storeMutex);
+    auto found = files.find(source);
+    if (found == files.end())
+        return false;
+    if (source == target)
+        return true;
+
+    FileMap map = found->second;
+    for (uint32_t index : map.chunks)
+    {
+        chunks[index].refs++;
+    }
+    logical += map.size;
+    auto existing = files.find(target);
+    if (existing != files.end())
+    {
+        release(existing->second);
+        existing->second = move(map);
+    }
+    else
+    {
+        files.emplace(target, move(map));
+    }
+    dirty = true;
+    return true;
+}
+
+bool DedupStore::contains(const string &name) const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return files.count(name) != 0;
+}
+
+void DedupStore::list(const string &prefix, vector<pair<string, uint64_t>> &out) const
+{
+    out.clear();
+    {
+        lock_guard<mutex> lock(storeMutex);
+        for (const auto &entry : files)
+        {
+            if (entry.first.compare(0, prefix.size(), prefix) == 0)
+                out.emplace_back(entry.first, entry.second.size);
+        }
+    }
+    sort(out.begin(), out.end());
+}
+
+uint64_t DedupStore::logicalBytes() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return logical;
+}
+
+uint64_t DedupStore::uniqueBytes() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return unique;
+}
+
+DedupStore::CodecStats DedupStore::codecStats() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return codec;
+}
+
+uint64_t DedupStore::physicalBytes() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return physical;
+}
+
+uint64_t DedupStore::packBytes() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return packSize;
+}
+
+size_t DedupStore::fileCount() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return files.size();
+}
+
+size_t DedupStore::chunkCount() const
+{
+    lock_guard<mutex> lock(storeMutex);
+    return chunkIndex.size();
+}
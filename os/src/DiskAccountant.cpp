@@ -0,0 +1,292 @@
+#include "../include/DiskAccountant.h"
+#include <vector>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+using namespace std;
+
+DiskAccountant::DiskAccountant()
+    : inotifyFd(-1), watching(false), totalBytes(0)
+{
+}
+
+DiskAccountant::~DiskAccountant()
+{
+    stop();
+}
+
+bool DiskAccountant::isInternal(const string &path) const
+{
+    // The ledger, the disk service socket and the dedup store are OS bookkeeping
+    return path == ".ledger" || path == ".disk.sock" || path == ".store" || path.compare(0, 7, ".store/") == 0;
+}
+
+void DiskAccountant::setSize(const string &path, uint64_t size)
+{
+    uint64_t &entry = fileSizes[path];
+    totalBytes += size - entry;
+    entry = size;
+}
+
+void DiskAccountant::forget(const string &path)
+{
+    auto found = fileSizes.find(path);
+    if (found != fileSizes.end())
+    {
+        totalBytes -= found->second;
+        fileSizes.erase(found);
+    }
+}
+
+void DiskAccountant::forgetTree(const string &directory)
+{
+    string prefix = directory + "/";
+    for (auto it = fileSizes.begin(); it != fileSizes.end();)
+    {
+        if (it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            totalBytes -= it->second;
+            it = fileSizes.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+// Watch a directory and everything below it, recording the size of each file.
+// The watch goes in before the scan, so files created meanwhile aren't missed.
+void DiskAccountant::addTree(const string &directory)
+{
+    string path = directory.empty() ? root : root + "/" + directory;
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        int wd = inotify_add_watch(inotifyFd, path.c_str(),
+                                   IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+        if (wd >= 0)
+        {
+            watches[wd] = directory;
+        }
+    }
+#endif
+
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr)
+    {
+        return;
+    }
+    vector<string> subdirectories;
+    while (struct dirent *entry = readdir(dir))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        string child = directory.empty() ? entry->d_name : directory + "/" + entry->d_name;
+        if (isInternal(child))
+        {
+            continue;
+        }
+
+        struct stat info;
+        if (fstatat(dirfd(dir), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode))
+        {
+            subdirectories.push_back(child);
+        }
+        else if (S_ISREG(info.st_mode))
+        {
+            lock_guard<mutex> lock(sizeMutex);
+            setSize(child, info.st_size);
+        }
+    }
+    closedir(dir);
+
+    for (const string &subdirectory : subdirectories)
+    {
+        addTree(subdirectory);
+    }
+}
+
+bool DiskAccountant::start(const string &directory, function<void()> callback)
+{
+    root = directory;
+    onChange = move(callback);
+    if (!ledger.open(true))
+    {
+        return false;
+    }
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    addTree("");
+    if (inotifyFd >= 0)
+    {
+        watching = true;
+        watcher = thread(&DiskAccountant::watchLoop, this);
+    }
+    return true;
+}
+
+void DiskAccountant::stop()
+{
+    watching = false;
+    if (watcher.joinable())
+    {
+        watcher.join();
+    }
+    if (inotifyFd >= 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    ledger.close();
+}
+
+void DiskAccountant::watchLoop()
+{
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    unordered_set<string> changed;
+    while (watching)
+    {
+        struct pollfd pfd = {inotifyFd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0)
+        {
+            continue;
+        }
+
+        // Drain everything queued, then stat each modified file once
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *p = buffer; p < buffer + length;)
+            {
+                struct inotify_event *event = reinterpret_cast<struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + event->len;
+
+                auto watch = watches.find(event->wd);
+                if (watch == watches.end())
+                {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED)
+                {
+                    watches.erase(watch);
+                    continue;
+                }
+                if (event->len == 0)
+                {
+                    continue;
+                }
+                string path = watch->second.empty() ? event->name : watch->second + "/" + event->name;
+                if (isInternal(path))
+                {
+                    continue;
+                }
+
+                if (event->mask & IN_ISDIR)
+                {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    {
+                        addTree(path);
+                    }
+                    else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    {
+                        lock_guard<mutex> lock(sizeMutex);
+                        forgetTree(path);
+                    }
+                }
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    changed.erase(path);
+                    lock_guard<mutex> lock(sizeMutex);
+                    forget(path);
+                }
+                else
+                {
+                    changed.insert(path);
+                }
+            }
+        }
+
+        for (const string &path : changed)
+        {
+            struct stat info;
+            bool exists = stat((root + "/" + path).c_str(), &info) == 0 && S_ISREG(info.st_mode);
+            lock_guard<mutex> lock(sizeMutex);
+            if (exists)
+            {
+                setSize(path, info.st_size);
+            }
+            else
+            {
+                forget(path);
+            }
+        }
+        changed.clear();
+
+        if (onChange)
+        {
+            onChange();
+        }
+    }
+#endif
+}
+
+bool DiskAccountant::registerProcess(int pid, int64_t quotaBytes)
+{
+    return ledger.registerProcess(pid, quotaBytes);
+}
+
+void DiskAccountant::unregisterProcess(int pid)
+{
+    // What the process wrote stays on disk, it just stops being covered by its quota
+    ledger.unregisterProcess(pid);
+}
+
+void DiskAccountant::claimFile(const string &path, uint64_t bytes)
+{
+    lock_guard<mutex> lock(sizeMutex);
+    claims[path] = bytes;
+}
+
+void DiskAccountant::releaseClaim(const string &path)
+{
+    lock_guard<mutex> lock(sizeMutex);
+    claims.erase(path);
+}
+
+uint64_t DiskAccountant::storedBytes() const
+{
+    lock_guard<mutex> lock(sizeMutex);
+    return totalBytes;
+}
+
+uint64_t DiskAccountant::unreservedBytes() const
+{
+    uint64_t covered = 0;
+    ledger.forEach([&covered](int, int64_t used, int64_t quota)
+                   { covered += static_cast<uint64_t>(used < quota ? used : quota); });
+
+    lock_guard<mutex> lock(sizeMutex);
+    for (const auto &claim : claims)
+    {
+        auto found = fileSizes.find(claim.first);
+        if (found != fileSizes.end())
+        {
+            covered += found->second < claim.second ? found->second : claim.second;
+        }
+    }
+    return totalBytes > covered ? totalBytes - covered : 0;
+}
@@ -0,0 +1,434 @@
+#include "../include/DiskService.h"
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    const size_t MAX_NAME = 4096;
+
+    bool receiveAll(int fd, char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t count = recv(fd, data, size, 0);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    bool sendAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t count = send(fd, data, size, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            data += count;
+            size -= count;
+        }
+        return true;
+    }
+}
+
+DiskService::DiskService(BufferCache &blockCache)
+    : cache(blockCache), listenFd(-1), serving(false), requests(0)
+{
+}
+
+DiskService::~DiskService()
+{
+    stop();
+}
+
+bool DiskService::validName(const string &name)
+{
+    // Plain relative paths only. Dot files are the OS's own bookkeeping.
+    if (name.empty() || name.size() > MAX_NAME || name[0] == '/')
+    {
+        return false;
+    }
+    size_t start = 0;
+    while (start <= name.size())
+    {
+        size_t end = name.find('/', start);
+        if (end == string::npos)
+        {
+            end = name.size();
+        }
+        if (end == start || name[start] == '.')
+        {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+bool DiskService::start(const string &directory)
+{
+    root = directory;
+    string path = root + "/.disk.sock";
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    path.copy(address.sun_path, path.size());
+
+    mkdir(root.c_str(), 0755);
+    unlink(path.c_str()); // Left by a session that didn't shut down
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        return false;
+    }
+    if (::bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listenFd, 16) != 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    serving = true;
+    acceptor = thread(&DiskService::acceptLoop, this);
+    return true;
+}
+
+void DiskService::stop()
+{
+    serving = false;
+    if (acceptor.joinable())
+    {
+        acceptor.join();
+    }
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+        unlink((root + "/.disk.sock").c_str());
+    }
+
+    // Wake every worker out of its receive, they close their own files
+    vector<Connection *> remaining;
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        remaining.swap(connections);
+        for (Connection *connection : remaining)
+        {
+            shutdown(connection->socketFd, SHUT_RDWR);
+        }
+    }
+    for (Connection *connection : remaining)
+    {
+        connection->worker.join();
+        close(connection->socketFd);
+        delete connection;
+    }
+}
+
+void DiskService::acceptLoop()
+{
+    while (serving)
+    {
+        pollfd waiting = {listenFd, POLLIN, 0};
+        if (poll(&waiting, 1, 200) <= 0)
+        {
+            continue;
+        }
+        int socketFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (socketFd < 0)
+        {
+            continue;
+        }
+
+        // The worker takes connectionsMutex before it finishes, so it can't
+        // be reaped before its thread is stored
+        lock_guard<mutex> lock(connectionsMutex);
+        reapFinished();
+        Connection *connection = new Connection{socketFd, thread(), false};
+        connections.push_back(connection);
+        connection->worker = thread(&DiskService::serve, this, connection);
+    }
+}
+
+void DiskService::reapFinished()
+{
+    for (auto it = connections.begin(); it != connections.end();)
+    {
+        if ((*it)->finished)
+        {
+            (*it)->worker.join();
+            close((*it)->socketFd);
+            delete *it;
+            it = connections.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void DiskService::serve(Connection *connection)
+{
+    int socketFd = connection->socketFd;
+    vector<int> held; // Handles this task has open, one entry per open
+    string name;
+    vector<char> data;
+    string stored; // Reply payload of a store request
+
+    DiskRequest request;
+    while (receiveAll(socketFd, reinterpret_cast<char *>(&request), sizeof(request)))
+    {
+        bool carriesPayload = request.op == DISK_WRITE || request.op == DISK_STORE_WRITE || request.op == DISK_STORE_COPY;
+        uint64_t limit = DiskClient::MAX_TRANSFER;
+        if (request.op == DISK_STORE_WRITE || request.op == DISK_STORE_READ)
+        {
+            limit = DiskClient::MAX_STORED_FILE;
+        }
+        else if (request.op == DISK_STORE_COPY)
+        {
+            limit = MAX_NAME;
+        }
+        if (request.nameLength > MAX_NAME || request.length > limit)
+        {
+            break; // Not a client of this protocol
+        }
+        name.resize(request.nameLength);
+        data.resize(carriesPayload ? request.length : 0);
+        if (!receiveAll(socketFd, &name[0], name.size()) || !receiveAll(socketFd, data.data(), data.size()))
+        {
+            break;
+        }
+        requests.fetch_add(1, memory_order_relaxed);
+
+        DiskReply reply = {0, request.handle, 0};
+        bool owned = find(held.begin(), held.end(), request.handle) != held.end();
+        switch (request.op)
+        {
+        case DISK_OPEN:
+            reply.error = validName(name) ? openFile(name, request.flags, held, reply) : EINVAL;
+            break;
+        case DISK_CLOSE:
+            reply.error = owned ? closeFile(request.handle, held) : EBADF;
+            break;
+        case DISK_READ:
+            reply.error = owned ? readFile(request.handle, request.offset, request.length, data) : EBADF;
+            reply.length = reply.error == 0 ? data.size() : 0;
+            break;
+        case DISK_WRITE:
+            reply.error = owned ? writeFile(request.handle, request.offset, data.data(), data.size()) : EBADF;
+            break;
+        case DISK_SYNC:
+            reply.error = owned ? syncFile(request.handle) : EBADF;
+            break;
+        case DISK_SIZE:
+            reply.error = owned ? fileSize(request.handle, reply.length) : EBADF;
+            break;
+        case DISK_STORE_WRITE:
+        case DISK_STORE_READ:
+        case DISK_STORE_REMOVE:
+        case DISK_STORE_COPY:
+        case DISK_STORE_LIST:
+            stored.clear();
+            reply.error = storeRequest(request, name, data, stored);
+            reply.length = reply.error == 0 ? stored.size() : 0;
+            break;
+        default:
+            reply.error = EINVAL;
+        }
+
+        // Only reads and store requests have a payload, other replies use length for a size
+        const char *payload = nullptr;
+        if (request.op == DISK_READ)
+        {
+            payload = data.data();
+        }
+        else if (request.op >= DISK_STORE_WRITE)
+        {
+            payload = stored.data();
+        }
+        if (!sendAll(socketFd, reinterpret_cast<const char *>(&reply), sizeof(reply)) ||
+            (payload != nullptr && reply.error == 0 && !sendAll(socketFd, payload, reply.length)))
+        {
+            break;
+        }
+    }
+
+    // A task that exits or crashes still gets its writes written back. The
+    // socket is closed by whoever reaps the connection, so stop() can't
+    // shut down a descriptor number that was already reused.
+    while (!held.empty())
+    {
+        closeFile(held.back(), held);
+    }
+    lock_guard<mutex> lock(connectionsMutex);
+    connection->finished = true;
+}
+
+int DiskService::openFile(const string &name, int flags, vector<int> &held, DiskReply &reply)
+{
+    lock_guard<mutex> lock(filesMutex);
+    auto found = byName.find(name);
+    if (found != byName.end())
+    {
+        OpenFile &file = openFiles[found->second];
+        if (flags & O_TRUNC)
+        {
+            // Cached blocks of the old content must not be written back over the new
+            cache.invalidate(file.fd);
+            if (ftruncate(file.fd, 0) != 0)
+            {
+                return errno;
+            }
+            file.size = 0;
+        }
+        file.users++;
+        held.push_back(file.fd);
+        reply.handle = file.fd;
+        reply.length = file.size;
+        return 0;
+    }
+
+    int fd = ::open((root + "/" + name).c_str(), O_RDWR | O_CLOEXEC | (flags & (O_CREAT | O_TRUNC)), 0644);
+    if (fd < 0)
+    {
+        return errno;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return EINVAL;
+    }
+    openFiles[fd] = OpenFile{fd, static_cast<uint64_t>(info.st_size), 1, name};
+    byName[name] = fd;
+    held.push_back(fd);
+    reply.handle = fd;
+    reply.length = info.st_size;
+    return 0;
+}
+
+int DiskService::closeFile(int fd, vector<int> &held)
+{
+    held.erase(find(held.begin(), held.end(), fd));
+    lock_guard<mutex> lock(filesMutex);
+    OpenFile &file = openFiles[fd];
+    if (--file.users > 0)
+    {
+        return 0;
+    }
+    bool written = cache.flush(fd);
+    cache.invalidate(fd);
+    close(fd);
+    byName.erase(file.name);
+    openFiles.erase(fd);
+    return written ? 0 : EIO;
+}
+
+int DiskService::readFile(int fd, uint64_t offset, uint64_t length, vector<char> &data)
+{
+    uint64_t size;
+    {
+        lock_guard<mutex> lock(filesMutex);
+        size = openFiles[fd].size;
+    }
+    data.resize(offset < size ? min(length, size - offset) : 0);
+    return data.empty() || cache.read(fd, offset, data.data(), data.size()) ? 0 : EIO;
+}
+
+int DiskService::writeFile(int fd, uint64_t offset, const char *data, uint64_t length)
+{
+    if (!cache.write(fd, offset, data, length))
+    {
+        return EIO;
+    }
+    lock_guard<mutex> lock(filesMutex);
+    OpenFile &file = openFiles[fd];
+    file.size = max(file.size, offset + length);
+    return 0;
+}
+
+int DiskService::syncFile(int fd)
+{
+    return cache.flush(fd) && fsync(fd) == 0 ? 0 : EIO;
+}
+
+int DiskService::fileSize(int fd, uint64_t &size)
+{
+    lock_guard<mutex> lock(filesMutex);
+    size = openFiles[fd].size;
+    return 0;
+}
+
+int DiskService::storeRequest(const DiskRequest &request, const string &name, const vector<char> &data, string &out)
+{
+    if (!store.write)
+    {
+        return ENOSYS;
+    }
+    if (request.op != DISK_STORE_LIST && !validName(name))
+    {
+        return EINVAL;
+    }
+
+    switch (request.op)
+    {
+    case DISK_STORE_WRITE:
+    {
+        int error = store.write(name, string(data.begin(), data.end()));
+        return error == 0 && (request.flags & O_SYNC) ? store.sync() : error;
+    }
+    case DISK_STORE_READ:
+        return store.read(name, request.offset, request.length, out);
+    case DISK_STORE_REMOVE:
+        return store.remove(name);
+    case DISK_STORE_COPY:
+    {
+        string target(data.begin(), data.end());
+        return validName(target) ? store.copy(name, target) : EINVAL;
+    }
+    default:
+    {
+        vector<pair<string, uint64_t>> files;
+        store.list(name, files);
+        for (const auto &file : files)
+        {
+            uint32_t length = static_cast<uint32_t>(file.first.size());
+            out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            out += file.first;
+            out.append(reinterpret_cast<const char *>(&file.second), sizeof(file.second));
+        }
+        return 0;
+    }
+    }
+}
+
+DiskService::Stats DiskService::stats()
+{
+    Stats result = {0, 0, requests.load(memory_order_relaxed)};
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (Connection *connection : connections)
+        {
+            result.clients += connection->finished ? 0 : 1;
+        }
+    }
+    lock_guard<mutex> lock(filesMutex);
+    result.openFiles = openFiles.size();
+    return result;
+}
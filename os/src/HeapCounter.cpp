@@ -0,0 +1,29 @@
+#include "../include/HeapCounter.h"
+#include <cstdlib>
+#include <new>
+
+// Replacement allocation functions for the bench builds, see HeapCounter.h.
+// Kept out of OS_SRCS by the Makefile, a program must link this file once.
+std::atomic<long> heapAllocations{0};
+
+void *operator new(std::size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *block = std::malloc(size == 0 ? 1 : size))
+    {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+// Not inlined, so GCC doesn't pair the free() with a library operator new
+// at the call site and warn about a mismatch
+__attribute__((noinline)) void operator delete(void *block) noexcept
+{
+    std::free(block);
+}
+
+__attribute__((noinline)) void operator delete(void *block, std::size_t) noexcept
+{
+    std::free(block);
+}
@@ -0,0 +1,361 @@
+#include "../include/IOScheduler.h"
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+BlockDevice::BlockDevice(uint64_t totalSectors)
+    : totalSectors(max<uint64_t>(totalSectors, SECTORS_PER_TRACK)), head(0), seeks(0), seekSeconds(0.0),
+      rotationSeconds(0.0), busySeconds(0.0), bytesTransferred(0)
+{
+}
+
+double BlockDevice::service(const IORequest &request, double now)
+{
+    double seconds = 0.0;
+    if (request.sector != head)
+    {
+        // Seek to the track, then wait for the sector to come round
+        uint64_t distance = request.sector > head ? request.sector - head : head - request.sector;
+        double tracks = static_cast<double>(distance / SECTORS_PER_TRACK);
+        if (tracks > 0)
+        {
+            double totalTracks = static_cast<double>(totalSectors / SECTORS_PER_TRACK);
+            double seek = TRACK_TO_TRACK_SECONDS + (FULL_STROKE_SECONDS - TRACK_TO_TRACK_SECONDS) * sqrt(tracks / totalTracks);
+            seconds += seek;
+            seekSeconds += seek;
+            seeks++;
+        }
+
+        double revolution = 60.0 / RPM;
+        double platter = fmod((now + seconds) / revolution, 1.0);
+        double target = static_cast<double>(request.sector % SECTORS_PER_TRACK) / SECTORS_PER_TRACK;
+        double wait = target - platter;
+        if (wait < 0)
+        {
+            wait += 1.0;
+        }
+        seconds += wait * revolution;
+        rotationSeconds += wait * revolution;
+    }
+
+    uint64_t bytes = static_cast<uint64_t>(request.sectors) * SECTOR_SIZE;
+    seconds += bytes / BYTES_PER_SECOND;
+    head = request.sector + request.sectors;
+    busySeconds += seconds;
+    bytesTransferred += bytes;
+    return seconds;
+}
+
+namespace
+{
+    // Arrival order, no reordering at all
+    class NoopScheduler : public IOScheduler
+    {
+    private:
+        deque<IORequest> queue;
+
+    public:
+        void add(const IORequest &request) override { queue.push_back(request); }
+
+        bool dispatch(uint64_t, double, IORequest &request) override
+        {
+            if (queue.empty())
+                return false;
+            request = queue.front();
+            queue.pop_front();
+            return true;
+        }
+
+        size_t pending() const override { return queue.size(); }
+    };
+
+    // LOOK elevator: serve the nearest request in the current direction and
+    // turn around when there is nothing further that way
+    class ElevatorScheduler : public IOScheduler
+    {
+    private:
+        multimap<uint64_t, IORequest> sorted;
+        bool up = true;
+
+    public:
+        void add(const IORequest &request) override { sorted.emplace(request.sector, request); }
+
+        bool dispatch(uint64_t head, double, IORequest &request) override
+        {
+            if (sorted.empty())
+                return false;
+
+            auto it = sorted.end();
+            for (int pass = 0; pass < 2 && it == sorted.end(); pass++)
+            {
+                if (up)
+                {
+                    it = sorted.lower_bound(head);
+                }
+                else
+                {
+                    auto above = sorted.upper_bound(head);
+                    it = above == sorted.begin() ? sorted.end() : prev(above);
+                }
+                if (it == sorted.end())
+                {
+                    up = !up;
+                }
+            }
+            request = it->second;
+            sorted.erase(it);
+            return true;
+        }
+
+        size_t pending() const override { return sorted.size(); }
+    };
+
+    // Deadline: batches of requests in sector order, one direction at a
+    // time, preferring synchronous requests (reads and the writes a process
+    // waits on) over writeback. Each batch starts from the oldest request of
+    // its direction. Requests carry an expiry time: an expired one ends the
+    // current batch, and expired writeback gets a turn even while
+    // synchronous requests are queued.
+    class DeadlineScheduler : public IOScheduler
+    {
+    private:
+        static constexpr double SYNC_EXPIRE = 0.1; // Seconds
+        static constexpr double ASYNC_EXPIRE = 0.5;
+        static constexpr int FIFO_BATCH = 16;      // Requests per batch
+        static constexpr int ASYNC_STARVED = 2;    // Sync batches before writeback gets a turn
+
+        struct Direction
+        {
+            multimap<uint64_t, IORequest> sorted;
+            deque<pair<double, uint64_t>> fifo; // (expiry, id), stale entries skipped lazily
+            unordered_map<uint64_t, multimap<uint64_t, IORequest>::iterator> byId;
+
+            // Oldest request still queued has passed its expiry
+            bool expired(double now)
+            {
+                while (!fifo.empty() && byId.count(fifo.front().second) == 0)
+                {
+                    fifo.pop_front();
+                }
+                return !fifo.empty() && fifo.front().first <= now;
+            }
+        };
+
+        Direction directions[2]; // Sync, async
+        int batchDirection = 0;
+        int batchCount = 0;
+        int starved = 0;
+
+        IORequest take(Direction &direction, multimap<uint64_t, IORequest>::iterator it)
+        {
+            IORequest request = it->second;
+            direction.byId.erase(request.id);
+            direction.sorted.erase(it);
+            return request;
+        }
+
+    public:
+        void add(const IORequest &request) override
+        {
+            Direction &direction = directions[request.sync ? 0 : 1];
+            auto it = direction.sorted.emplace(request.sector, request);
+            direction.byId[request.id] = it;
+            direction.fifo.emplace_back(request.submitted + (request.sync ? SYNC_EXPIRE : ASYNC_EXPIRE), request.id);
+        }
+
+        bool dispatch(uint64_t head, double now, IORequest &request) override
+        {
+            bool syncExpired = directions[0].expired(now);
+            bool asyncExpired = directions[1].expired(now);
+
+            // Carry on with the current batch while it has requests ahead of
+            // the head and nothing has expired
+            if (batchCount > 0 && batchCount < FIFO_BATCH && !syncExpired && !asyncExpired)
+            {
+                Direction &direction = directions[batchDirection];
+                auto it = direction.sorted.lower_bound(head);
+                if (it != direction.sorted.end())
+                {
+                    request = take(direction, it);
+                    batchCount++;
+                    return true;
+                }
+            }
+
+            bool syncs = !directions[0].sorted.empty();
+            bool asyncs = !directions[1].sorted.empty();
+            if (!syncs && !asyncs)
+                return false;
+
+            if (syncs && (!asyncs || (starved < ASYNC_STARVED && !asyncExpired) || syncExpired))
+            {
+                batchDirection = 0;
+                starved += asyncs ? 1 : 0;
+            }
+            else
+            {
+                batchDirection = 1;
+                starved = 0;
+            }
+
+            // A batch starts from the oldest request, so a stream the head
+            // happens to be in can't keep every batch to itself
+            Direction &direction = directions[batchDirection];
+            direction.expired(now);
+            request = take(direction, direction.byId[direction.fifo.front().second]);
+            batchCount = 1;
+            return true;
+        }
+
+        size_t pending() const override { return directions[0].sorted.size() + directions[1].sorted.size(); }
+    };
+
+    // Budget fair queuing in the style of BFQ: each process has a FIFO for
+    // its synchronous requests and one for its writeback, and a queue gets the
+    // device for up to a budget of sectors at a time, which keeps sequential
+    // streams sequential. Queues are picked by virtual finish time (WF2Q+), so
+    // a process with a little I/O waiting gets in ahead of one with a long
+    // backlog, whatever order they arrived in.
+    class BfqScheduler : public IOScheduler
+    {
+    private:
+        static constexpr uint64_t BUDGET = 4096; // Sectors per turn
+
+        struct ProcessQueue
+        {
+            deque<IORequest> requests;
+            uint64_t queuedSectors = 0;
+            double start = 0.0;  // Virtual start of the current turn
+            double finish = 0.0; // Virtual finish of the last turn
+            double weight = 1.0;
+        };
+
+        unordered_map<int64_t, ProcessQueue> queues; // By queueKey()
+        double virtualTime = 0.0;   // Advances by service over the backlogged weight
+        double backlogWeight = 0.0; // Queues with requests, plus the active one
+        int64_t active = -1;
+        uint64_t served = 0; // Sectors served in the active queue's turn
+        size_t total = 0;
+
+        static int64_t queueKey(const IORequest &request)
+        {
+            return static_cast<int64_t>(request.pid) * 2 + (request.sync ? 0 : 1);
+        }
+
+        // The active queue's turn is over, charge it for what it used
+        void expire()
+        {
+            ProcessQueue &queue = queues[active];
+            queue.finish = queue.start + served / queue.weight;
+            queue.start = queue.finish;
+            if (queue.requests.empty())
+                backlogWeight -= queue.weight;
+            active = -1;
+            served = 0;
+        }
+
+    public:
+        void add(const IORequest &request) override
+        {
+            int64_t key = queueKey(request);
+            ProcessQueue &queue = queues[key];
+            if (queue.requests.empty() && key != active)
+            {
+                // Newly backlogged: no credit for the time it spent idle
+                queue.start = max(queue.finish, virtualTime);
+                backlogWeight += queue.weight;
+            }
+            queue.requests.push_back(request);
+            queue.queuedSectors += request.sectors;
+            total++;
+        }
+
+        bool dispatch(uint64_t, double, IORequest &request) override
+        {
+            if (total == 0)
+                return false;
+
+            if (active != -1 && (queues[active].requests.empty() || served >= BUDGET))
+            {
+                expire();
+            }
+
+            if (active == -1)
+            {
+                // Smallest virtual finish among eligible queues, smallest start otherwise
+                int64_t best = -1, earliest = -1;
+                double bestFinish = 0.0, earliestStart = 0.0;
+                for (auto &entry : queues)
+                {
+                    ProcessQueue &queue = entry.second;
+                    if (queue.requests.empty())
+                        continue;
+                    double finish = queue.start + min(BUDGET, queue.queuedSectors) / queue.weight;
+                    if (queue.start <= virtualTime && (best == -1 || finish < bestFinish))
+                    {
+                        best = entry.first;
+                        bestFinish = finish;
+                    }
+                    if (earliest == -1 || queue.start < earliestStart)
+                    {
+                        earliest = entry.first;
+                        earliestStart = queue.start;
+                    }
+                }
+                active = best != -1 ? best : earliest;
+                virtualTime = max(virtualTime, queues[active].start);
+            }
+
+            ProcessQueue &queue = queues[active];
+            request = queue.requests.front();
+            queue.requests.pop_front();
+            queue.queuedSectors -= request.sectors;
+            served += request.sectors;
+            total--;
+            virtualTime += request.sectors / backlogWeight;
+            return true;
+        }
+
+        size_t pending() const override { return total; }
+    };
+
+    const char *POLICY_NAMES[IO_POLICY_COUNT] = {"noop", "elevator", "deadline", "bfq"};
+}
+
+unique_ptr<IOScheduler> makeIOScheduler(IOPolicy policy)
+{
+    switch (policy)
+    {
+    case IO_ELEVATOR:
+        return unique_ptr<IOScheduler>(new ElevatorScheduler());
+    case IO_DEADLINE:
+        return unique_ptr<IOScheduler>(new DeadlineScheduler());
+    case IO_BFQ:
+        return unique_ptr<IOScheduler>(new BfqScheduler());
+    case IO_NOOP:
+    default:
+        return unique_ptr<IOScheduler>(new NoopScheduler());
+    }
+}
+
+bool parseIOPolicy(const string &name, IOPolicy &policy)
+{
+    for (int i = 0; i < IO_POLICY_COUNT; i++)
+    {
+        if (name == POLICY_NAMES[i])
+        {
+            policy = static_cast<IOPolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *ioPolicyName(IOPolicy policy)
+{
+    return POLICY_NAMES[policy];
+}
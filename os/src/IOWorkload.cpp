@@ -0,0 +1,279 @@
+#include "../include/IOWorkload.h"
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+// ANSI Color codes
+#define CYAN "\033[36m"
+#define YELLOW "\033[33m"
+#define RESET "\033[0m"
+
+namespace
+{
+    const uint64_t INTERACTIVE_REGION = 4ull << 20; // Sectors, a 2 GB working set
+
+    enum IOEventType
+    {
+        SUBMIT,  // Interactive process is done thinking
+        COMPLETE // Device finished a request
+    };
+
+    struct IOEvent
+    {
+        double time;
+        IOEventType type;
+        size_t stream;
+        IORequest request;
+
+        bool operator>(const IOEvent &other) const { return time > other.time; }
+    };
+
+    // Nearest-rank percentile of a sorted sample, in milliseconds
+    double percentileMs(const vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+        return sorted[static_cast<size_t>(p * (sorted.size() - 1))] * 1000.0;
+    }
+}
+
+IOWorkload::IOWorkload(OSSystem &os, const IOWorkloadConfig &config)
+    : os(os), config(config)
+{
+}
+
+IOWorkload::PolicyResult IOWorkload::simulate(IOPolicy policy)
+{
+    BlockDevice device(DEVICE_SECTORS);
+    unique_ptr<IOScheduler> scheduler = makeIOScheduler(policy);
+    mt19937_64 rng(config.seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    exponential_distribution<double> think(1.0 / config.thinkTime);
+
+    PolicyResult result;
+    result.policy = policy;
+    result.streams.resize(streams.size());
+
+    priority_queue<IOEvent, vector<IOEvent>, greater<IOEvent>> events;
+    vector<uint64_t> issued(streams.size(), 0); // Copy requests submitted so far
+    uint64_t nextId = 1;
+    bool deviceBusy = false;
+    double now = 0.0;
+
+    auto submit = [&](size_t index)
+    {
+        const Stream &stream = streams[index];
+        IORequest request;
+        request.id = nextId++;
+        request.pid = stream.pid;
+        request.submitted = now;
+        if (stream.interactive)
+        {
+            request.sectors = config.interactiveSectors;
+            uniform_int_distribution<uint64_t> block(0, stream.regionSectors / request.sectors - 1);
+            request.sector = stream.readStart + block(rng) * request.sectors;
+            request.write = uniform(rng) < config.interactiveWriteShare;
+            request.sync = true;
+        }
+        else
+        {
+            // Read a chunk, then write it to the destination
+            uint64_t count = issued[index]++;
+            uint64_t offset = (count / 2) * config.copySectors % stream.regionSectors;
+            request.sectors = config.copySectors;
+            request.write = count % 2 == 1;
+            request.sector = (request.write ? stream.writeStart : stream.readStart) + offset;
+            request.sync = !request.write;
+        }
+        scheduler->add(request);
+    };
+
+    unordered_map<int, size_t> streamOf;
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        streamOf[streams[i].pid] = i;
+    }
+
+    // The device serves one request at a time
+    auto startDevice = [&]()
+    {
+        IORequest request;
+        if (deviceBusy || !scheduler->dispatch(device.headPosition(), now, request))
+        {
+            return;
+        }
+        deviceBusy = true;
+        events.push({now + device.service(request, now), COMPLETE, streamOf[request.pid], request});
+    };
+
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        if (streams[i].interactive)
+        {
+            events.push({think(rng), SUBMIT, i, IORequest()});
+            continue;
+        }
+        for (int depth = 0; depth < config.copyDepth; depth++)
+        {
+            submit(i);
+        }
+    }
+    startDevice();
+
+    while (!events.empty())
+    {
+        IOEvent event = events.top();
+        events.pop();
+        now = event.time;
+        bool submitting = now < config.duration;
+
+        if (event.type == SUBMIT)
+        {
+            if (submitting)
+            {
+                submit(event.stream);
+            }
+        }
+        else
+        {
+            deviceBusy = false;
+            StreamResult &stream = result.streams[event.stream];
+            stream.latencies.push_back(now - event.request.submitted);
+            stream.bytes += static_cast<uint64_t>(event.request.sectors) * BlockDevice::SECTOR_SIZE;
+
+            if (submitting && streams[event.stream].interactive)
+            {
+                events.push({now + think(rng), SUBMIT, event.stream, IORequest()});
+            }
+            else if (submitting)
+            {
+                submit(event.stream);
+            }
+        }
+        startDevice();
+    }
+
+    result.elapsed = now;
+    result.busy = device.busyTime();
+    result.bytes = device.bytes();
+    result.seeks = device.seekCount();
+    result.seekTime = device.seekTime();
+    return result;
+}
+
+void IOWorkload::printResult(PolicyResult &result)
+{
+    double elapsed = max(result.elapsed, 1e-9);
+    cout << CYAN << "\n===== I/O Scheduler: " << ioPolicyName(result.policy) << " (seed " << config.seed
+         << ") =====\n" << RESET;
+    cout << fixed << setprecision(2);
+    cout << YELLOW << "Device: " << RESET << result.bytes / elapsed / 1e6 << " MB/s over " << result.elapsed
+         << " s, " << 100.0 * result.busy / elapsed << "% busy, " << result.seeks << " seeks (avg "
+         << (result.seeks ? 1000.0 * result.seekTime / result.seeks : 0.0) << " ms)" << endl;
+
+    cout << YELLOW << left << setw(6) << "PID" << setw(14) << "Task" << right << setw(10) << "Requests"
+         << setw(10) << "MB/s" << setw(10) << "p50 ms" << setw(10) << "p95 ms" << setw(10) << "p99 ms"
+         << setw(10) << "max ms" << RESET << endl;
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        StreamResult &stream = result.streams[i];
+        sort(stream.latencies.begin(), stream.latencies.end());
+        cout << left << setw(6) << streams[i].pid << setw(14) << streams[i].task << right
+             << setw(10) << stream.latencies.size()
+             << setw(10) << stream.bytes / elapsed / 1e6
+             << setw(10) << percentileMs(stream.latencies, 0.50)
+             << setw(10) << percentileMs(stream.latencies, 0.95)
+             << setw(10) << percentileMs(stream.latencies, 0.99)
+             << setw(10) << percentileMs(stream.latencies, 1.0) << endl;
+    }
+    cout << defaultfloat;
+}
+
+void IOWorkload::run()
+{
+    int copyTask = TaskCatalog::find("file_manager");
+    int interactiveTask = TaskCatalog::find("notepad");
+    mt19937_64 rng(config.seed);
+
+    // Give every region its own slot on the disk, shuffled so the streams interleave
+    int regions = config.copyStreams * 2 + config.interactive;
+    vector<uint64_t> slots(regions);
+    iota(slots.begin(), slots.end(), 0);
+    shuffle(slots.begin(), slots.end(), rng);
+    uint64_t slotSectors = DEVICE_SECTORS / max(1, regions);
+
+    size_t nextSlot = 0;
+    for (int i = 0; i < config.copyStreams + config.interactive; i++)
+    {
+        bool interactive = i >= config.copyStreams;
+        const TaskInfo &task = TASK_CATALOG[interactive ? interactiveTask : copyTask];
+        int pid = os.createProcess(task.binary, task.ramRequired, task.diskRequired);
+        if (pid == -1)
+        {
+            cout << "bench-io: not enough resources for " << task.binary << ", skipped" << endl;
+            nextSlot += interactive ? 1 : 2;
+            continue;
+        }
+        os.waitForDispatch();
+
+        Stream stream;
+        stream.pid = pid;
+        stream.task = task.binary;
+        stream.interactive = interactive;
+        stream.readStart = slots[nextSlot++] * slotSectors;
+        stream.writeStart = interactive ? stream.readStart : slots[nextSlot++] * slotSectors;
+        stream.regionSectors = interactive ? min(slotSectors, INTERACTIVE_REGION) : slotSectors;
+        streams.push_back(stream);
+    }
+
+    vector<PolicyResult> results;
+    for (int p = 0; p < IO_POLICY_COUNT; p++)
+    {
+        IOPolicy policy = static_cast<IOPolicy>(p);
+        if (!config.allPolicies && policy != config.policy)
+            continue;
+        results.push_back(simulate(policy));
+        printResult(results.back());
+    }
+
+    if (results.size() > 1)
+    {
+        cout << CYAN << "\n===== Policy Comparison =====\n" << RESET;
+        cout << YELLOW << left << setw(10) << "Policy" << right << setw(12) << "Total MB/s" << setw(12)
+             << "Copy MB/s" << setw(14) << "Inter p99 ms" << setw(14) << "Inter max ms" << setw(10) << "Seeks"
+             << RESET << endl;
+        cout << fixed << setprecision(2);
+        for (PolicyResult &result : results)
+        {
+            double elapsed = max(result.elapsed, 1e-9);
+            uint64_t copyBytes = 0;
+            vector<double> interactive;
+            for (size_t i = 0; i < streams.size(); i++)
+            {
+                const StreamResult &stream = result.streams[i];
+                if (streams[i].interactive)
+                    interactive.insert(interactive.end(), stream.latencies.begin(), stream.latencies.end());
+                else
+                    copyBytes += stream.bytes;
+            }
+            sort(interactive.begin(), interactive.end());
+            cout << left << setw(10) << ioPolicyName(result.policy) << right
+                 << setw(12) << result.bytes / elapsed / 1e6
+                 << setw(12) << copyBytes / elapsed / 1e6
+                 << setw(14) << percentileMs(interactive, 0.99)
+                 << setw(14) << percentileMs(interactive, 1.0)
+                 << setw(10) << result.seeks << endl;
+        }
+        cout << defaultfloat;
+    }
+
+    for (const Stream &stream : streams)
+    {
+        os.terminateProcess(stream.pid);
+    }
+}
@@ -8,6 +8,8 @@
 #include <fstream>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
 //#include <sstream>
 
 using namespace std;
@@ -23,8 +25,10 @@ using namespace std;
 
 OSSystem::OSSystem()
     : totalRam(0), availableRam(0), totalDisk(0), availableDisk(0), totalCores(0),
-      availableCores(0), currentMode(USER_MODE), isRunning(false), nextPid(1)
+      availableCores(0), currentMode(USER_MODE), isRunning(false), headless(false), nextPid(1),
+      cacheMb(-1), diskService(bufferCache), storeChargedMb(0), accountedMb(0)
 {
+    taskInstalled.fill(false);
 }
 
 void OSSystem::initialize()
@@ -32,11 +36,6 @@ void OSSystem::initialize()
     cout << "\n===== Operating System Simulator =====\n"
          << endl;
 
-    // Default values
-    const int DEFAULT_RAM = 2048;    // 2GB in MB
-    const int DEFAULT_DISK = 102400; // 100GB in MB
-    const int DEFAULT_CORES = 4;
-
     string input;
 
     // Clear any buffer issues before starting
@@ -114,18 +113,107 @@ void OSSystem::initialize(int ram, int disk, int cores)
 
 void OSSystem::bootSystem()
 {
-    std::system("clear");
+    // Headless runs are scripted, so skip the screen clearing and boot delay
+    if (!headless)
+    {
+        std::system("clear");
+    }
     cout << BLUE << "\n=== System Booting ===\n" << RESET;
     cout << YELLOW << "Initializing system resources...\n" << RESET;
-    this_thread::sleep_for(chrono::milliseconds(500));
+    validateTaskCatalog();
+
+    // Every live process holds at least the smallest task's RAM, which bounds
+    // how many can exist at once. The slack covers syncRunningProcesses.
+    size_t capacity = totalRam / TaskCatalog::minRamRequired() + 16;
+    processPool.reserve(capacity);
+    readyQueue.reserve(capacity);
+    runningProcesses.reserve(capacity);
+    blockedProcesses.reserve(capacity);
+
+    // The buffer cache is carved out of RAM before any process can claim it
+    if (cacheMb < 0)
+    {
+        cacheMb = totalRam / 32;
+    }
+    cacheMb = min(cacheMb, availableRam / 2);
+    availableRam -= cacheMb;
+    bufferCache.configure(static_cast<size_t>(cacheMb) * 1024 * 1024);
+    bufferCache.start();
+    cout << YELLOW << "Buffer cache: " << cacheMb << " MB\n" << RESET;
+
+    // Tasks that find the service do their file I/O through the cache, and
+    // can keep whole files in the store, which is charged like the shell's
+    DiskService::StoreHandlers store;
+    store.write = [this](const std::string &name, const std::string &data)
+    { return writeFile(name, data) ? 0 : ENOSPC; };
+    store.read = [this](const std::string &name, uint64_t offset, uint64_t size, std::string &data)
+    { return readFile(name, offset, size, data) ? 0 : ENOENT; };
+    store.remove = [this](const std::string &name)
+    { return removeStoredFile(name) ? 0 : ENOENT; };
+    store.copy = [this](const std::string &source, const std::string &target)
+    { return copyFile(source, target) ? 0 : ENOENT; };
+    store.list = [this](const std::string &prefix, std::vector<std::pair<std::string, uint64_t>> &out)
+    { listStoredFiles(prefix, out); };
+    store.sync = [this]()
+    { return diskStore.sync() ? 0 : EIO; };
+    diskService.setStore(store);
+    if (!diskService.start("simulated_disk"))
+    {
+        cout << RED << "Disk service unavailable, tasks will bypass the buffer cache\n" << RESET;
+    }
+
+    // Files stored by earlier sessions still occupy the disk
+    diskStore.setCache(&bufferCache);
+    if (diskStore.open("simulated_disk/.store"))
+    {
+        std::lock_guard<std::mutex> lock(resourceMutex);
+        chargeStoreUsage();
+    }
+    else
+    {
+        cout << RED << "Disk store unavailable, stored files are disabled\n" << RESET;
+    }
+
+    // Per-process disk quotas and the files already on the disk
+    if (!diskAccountant.start("simulated_disk", [this]()
+                              { reconcileDiskUsage(); }))
+    {
+        cout << RED << "Disk accounting unavailable, task disk quotas are not enforced\n" << RESET;
+    }
+    reconcileDiskUsage();
+    if (!headless)
+    {
+        this_thread::sleep_for(chrono::milliseconds(500));
+    }
     cout << GREEN << "System booted successfully!\n" << RESET;
     isRunning = true;
 
-    std::system("clear");
+    if (!headless)
+    {
+        std::system("clear");
+    }
     // Start in user mode
     switchToUserMode();
 }
 
+void OSSystem::validateTaskCatalog()
+{
+    // Stat every task binary once so launches don't have to
+    int installed = 0;
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        struct stat info;
+        string path = string("build/") + TASK_CATALOG[i].binary;
+        taskInstalled[i] = stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+        if (taskInstalled[i])
+        {
+            installed++;
+        }
+    }
+
+    cout << YELLOW << "Task catalog: " << installed << "/" << TASK_COUNT << " tasks installed\n" << RESET;
+}
+
 bool OSSystem::allocateResources(int ramRequired, int diskRequired)
 {
     std::lock_guard<std::mutex> lock(resourceMutex);
@@ -162,18 +250,44 @@ int OSSystem::createProcess(const std::string &processName, int ramRequired, int
     // Check if resources are available
     if (!allocateResources(ramRequired, diskRequired))
     {
-        cout << "Failed to create process: Insufficient resources" << endl;
+        if (!headless)
+        {
+            cout << "Failed to create process: Insufficient resources" << endl;
+        }
         return -1;
     }
 
-    // Create new process
-    std::shared_ptr<Process> process = std::make_shared<Process>(nextPid, processName, ramRequired, diskRequired);
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    // Take a record from the pool
+    Process *process = processPool.acquire(nextPid, processName, ramRequired, diskRequired);
+    if (process == nullptr)
+    {
+        if (!headless)
+        {
+            cout << "Failed to create process: Process table full" << endl;
+        }
+        freeResources(ramRequired, diskRequired);
+        return -1;
+    }
+
+    // Tasks charge what they write against their disk reservation. A task
+    // outside the ledger would run unmetered, so a full ledger refuses it.
+    if (!diskAccountant.registerProcess(nextPid, static_cast<int64_t>(diskRequired) * 1024 * 1024))
+    {
+        if (!headless)
+        {
+            cout << "Failed to create process: Disk ledger full" << endl;
+        }
+        processPool.release(process);
+        freeResources(ramRequired, diskRequired);
+        return -1;
+    }
 
     // Set the process state to READY before adding to queue
     process->ready();
 
     // Add to ready queue
-    std::lock_guard<std::mutex> lock(queueMutex);
     readyQueue.push(process);
 
     // Schedule the process
@@ -183,6 +297,17 @@ int OSSystem::createProcess(const std::string &processName, int ramRequired, int
     return nextPid++;
 }
 
+int OSSystem::launchTask(int taskIndex)
+{
+    if (taskIndex < 0 || taskIndex >= TASK_COUNT || !taskInstalled[taskIndex])
+    {
+        return -1;
+    }
+
+    const TaskInfo &task = TASK_CATALOG[taskIndex];
+    return createProcess(task.binary, task.ramRequired, task.diskRequired);
+}
+
 bool OSSystem::terminateProcess(int pid)
 {
     std::lock_guard<std::mutex> lock(queueMutex);
@@ -195,8 +320,11 @@ bool OSSystem::terminateProcess(int pid)
             // Free resources
             freeResources((*it)->getMemoryRequired(), (*it)->getDiskRequired());
 
-            // Terminate process
+            // Terminate process, its files now count against the disk directly
             (*it)->terminate();
+            diskAccountant.unregisterProcess(pid);
+            reconcileDiskUsage();
+            processPool.release(*it);
             runningProcesses.erase(it);
             return true;
         }
@@ -210,8 +338,11 @@ bool OSSystem::terminateProcess(int pid)
             // Free resources
             freeResources((*it)->getMemoryRequired(), (*it)->getDiskRequired());
 
-            // Terminate process
+            // Terminate process, its files now count against the disk directly
             (*it)->terminate();
+            diskAccountant.unregisterProcess(pid);
+            reconcileDiskUsage();
+            processPool.release(*it);
             blockedProcesses.erase(it);
             return true;
         }
@@ -275,28 +406,45 @@ void OSSystem::scheduler()
         dispatchProcesses();
 
         lock.unlock();
+        dispatchCV.notify_all();
 
         // Give time for processes to execute
-        this_thread::sleep_for(chrono::milliseconds(100));
+        if (!headless)
+        {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
     }
+
+    // Release anyone still waiting on a dispatch
+    dispatchCV.notify_all();
+}
+
+void OSSystem::waitForDispatch()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    dispatchCV.wait(lock, [this]()
+                    { return readyQueue.empty() || !isRunning; });
 }
 
 void OSSystem::dispatchProcesses()
 {
     while (!readyQueue.empty())
     {
-        auto process = readyQueue.front();
+        Process *process = readyQueue.front();
         readyQueue.pop();
 
         // Make sure process is in READY state
         if (process->getState() != READY)
         {
+            diskAccountant.unregisterProcess(process->getPid());
+            processPool.release(process);
             continue;
         }
 
         process->run();
 
-        if (process->startProcess())
+        // Headless processes are only tracked, no terminal is spawned for them
+        if (headless || process->startProcess())
         {
             runningProcesses.push_back(process);
         }
@@ -304,6 +452,8 @@ void OSSystem::dispatchProcesses()
         {
             // Free resources if process failed to start
             freeResources(process->getMemoryRequired(), process->getDiskRequired());
+            diskAccountant.unregisterProcess(process->getPid());
+            processPool.release(process);
         }
     }
 }
@@ -348,12 +498,18 @@ bool OSSystem::createFile(const std::string &filename, int size)
     // Update file system map and available disk space
     fileSystem[filename] = size;
     availableDisk -= size;
+    diskAccountant.claimFile(filename, static_cast<uint64_t>(size) * 1024 * 1024);
 
     return true;
 }
 
 bool OSSystem::deleteFile(const std::string &filename)
 {
+    if (removeStoredFile(filename))
+    {
+        return true;
+    }
+
     std::lock_guard<std::mutex> lock(resourceMutex);
 
     auto it = fileSystem.find(filename);
@@ -371,10 +527,102 @@ bool OSSystem::deleteFile(const std::string &filename)
     // Update available disk space
     availableDisk += it->second;
     fileSystem.erase(it);
+    diskAccountant.releaseClaim(filename);
 
     return true;
 }
 
+bool OSSystem::removeStoredFile(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(resourceMutex);
+    if (!diskStore.removeFile(filename))
+    {
+        return false;
+    }
+    chargeStoreUsage();
+    return true;
+}
+
+void OSSystem::chargeStoreUsage()
+{
+    // The whole pack is charged, chunks no file uses any more included, so
+    // it is compacted as soon as most of it is dead
+    if (!diskStore.reclaim())
+    {
+        cout << RED << "Failed to compact the disk store" << RESET << endl;
+    }
+    const uint64_t MB = 1024 * 1024;
+    int usedMb = static_cast<int>((diskStore.packBytes() + MB - 1) / MB);
+    availableDisk -= usedMb - storeChargedMb;
+    storeChargedMb = usedMb;
+}
+
+void OSSystem::reconcileDiskUsage()
+{
+    // Only the change since the last reconcile is applied, nothing is rescanned
+    const uint64_t MB = 1024 * 1024;
+    int usedMb = static_cast<int>((diskAccountant.unreservedBytes() + MB - 1) / MB);
+    std::lock_guard<std::mutex> lock(resourceMutex);
+    availableDisk -= usedMb - accountedMb;
+    accountedMb = usedMb;
+}
+
+bool OSSystem::writeFile(const std::string &filename, const std::string &data)
+{
+    std::lock_guard<std::mutex> lock(resourceMutex);
+
+    // Only chunks the store doesn't already hold need free space
+    const uint64_t MB = 1024 * 1024;
+    uint64_t slack = storeChargedMb * MB - diskStore.packBytes();
+    uint64_t budget = (availableDisk > 0 ? availableDisk * MB : 0) + slack;
+    if (!diskStore.writeFile(filename, data.data(), data.size(), budget))
+    {
+        return false;
+    }
+
+    chargeStoreUsage();
+    return true;
+}
+
+bool OSSystem::readFile(const std::string &filename, std::string &data)
+{
+    return diskStore.readFile(filename, data);
+}
+
+bool OSSystem::readFile(const std::string &filename, uint64_t offset, uint64_t size, std::string &data)
+{
+    return diskStore.readRange(filename, offset, size, data);
+}
+
+bool OSSystem::copyFile(const std::string &source, const std::string &target)
+{
+    std::lock_guard<std::mutex> lock(resourceMutex);
+    if (!diskStore.copyFile(source, target))
+    {
+        return false;
+    }
+
+    // Only the content the target replaced can have freed anything
+    chargeStoreUsage();
+    return true;
+}
+
+void OSSystem::listStoredFiles(const std::string &prefix, std::vector<std::pair<std::string, uint64_t>> &out)
+{
+    diskStore.list(prefix, out);
+}
+
+bool OSSystem::importFile(const std::string &hostPath, const std::string &filename)
+{
+    std::ifstream file(hostPath, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return writeFile(filename, data);
+}
+
 void OSSystem::showSystemStatus()
 {
     // Sync running processes list first
@@ -394,7 +642,14 @@ void OSSystem::showSystemStatus()
     {
         cout << "  - [PID " << proc->getPid() << "] " << proc->getName()
              << " (RAM: " << proc->getMemoryRequired() << " MB, Disk: "
-             << proc->getDiskRequired() << " MB)" << endl;
+             << diskAccountant.processUsage(proc->getPid()) / 1024 << " KB written of "
+             << proc->getDiskRequired() << " MB";
+        int64_t refused = diskAccountant.processRefused(proc->getPid());
+        if (refused > 0)
+        {
+            cout << ", " << refused / 1024 << " KB refused";
+        }
+        cout << ")" << endl;
     }
 
     cout << "\nBlocked Processes: " << blockedProcesses.size() << endl;
@@ -409,18 +664,18 @@ void OSSystem::showSystemStatus()
 void OSSystem::showAvailableTasks()
 {
     cout << MAGENTA << "\n=== Available Tasks ===\n" << RESET;
-    cout << GREEN << "1. Notepad (50MB RAM, 10MB Disk)\n";
-    cout << "2. Calculator (20MB RAM, 5MB Disk)\n";
-    cout << "3. Clock (15MB RAM, 2MB Disk)\n";
-    cout << "4. File Manager (40MB RAM, 5MB Disk)\n";
-    cout << "5. Minesweeper (30MB RAM, 10MB Disk)\n";
-    cout << "6. Music Player (60MB RAM, 20MB Disk)\n";
-    cout << "7. Calendar (25MB RAM, 8MB Disk)\n";
-    cout << "8. Timer (10MB RAM, 2MB Disk)\n";
-    cout << "9. Terminal (15MB RAM, 3MB Disk)\n";
-    cout << "10. File Explorer (30MB RAM, 5MB Disk)\n";
-    cout << "11. System Monitor (25MB RAM, 4MB Disk)\n";
-    
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        const TaskInfo &task = TASK_CATALOG[i];
+        cout << (taskInstalled[i] ? GREEN : RED) << (i + 1) << ". " << task.displayName
+             << " (" << task.ramRequired << "MB RAM, " << task.diskRequired << "MB Disk)";
+        if (!taskInstalled[i])
+        {
+            cout << " [not installed]";
+        }
+        cout << "\n";
+    }
+    cout << RESET;
 }
 
 void OSSystem::shutdownSystem()
@@ -430,25 +685,40 @@ void OSSystem::shutdownSystem()
 
     isRunning = false;
     schedulerCV.notify_all();
+    dispatchCV.notify_all();
 
     // Terminate all running processes
     std::lock_guard<std::mutex> lock(queueMutex);
-    for (auto &process : runningProcesses)
+    for (Process *process : runningProcesses)
     {
         process->terminate();
+        processPool.release(process);
     }
     runningProcesses.clear();
 
     // Clear blocked processes
+    for (Process *process : blockedProcesses)
+    {
+        processPool.release(process);
+    }
     blockedProcesses.clear();
 
     // Clear ready queue
     while (!readyQueue.empty())
     {
+        processPool.release(readyQueue.front());
         readyQueue.pop();
     }
 
     cout << "All processes terminated and resources freed." << endl;
+    diskService.stop();
+    diskAccountant.stop();
+
+    if (!diskStore.sync())
+    {
+        cout << RED << "Failed to save the disk store manifest" << RESET << endl;
+    }
+    bufferCache.stop();
     cout << "System shutdown complete. Goodbye!\n"
          << endl;
 }
@@ -458,6 +728,54 @@ void OSSystem::showResourceStatus()
     cout << CYAN << "\n=== System Resources ===\n" << RESET;
     cout << YELLOW << "RAM Usage: " << RESET << (totalRam - availableRam) << "MB / " << totalRam << "MB\n";
     cout << YELLOW << "Disk Usage: " << RESET << (totalDisk - availableDisk) << "MB / " << totalDisk << "MB\n";
+    uint64_t logical = diskStore.logicalBytes();
+    uint64_t unique = diskStore.uniqueBytes();
+    uint64_t physical = diskStore.physicalBytes();
+    uint64_t pack = diskStore.packBytes();
+    cout << YELLOW << "Stored Files: " << RESET << diskStore.fileCount() << " files, "
+         << logical / 1024 << "KB logical / " << physical / 1024 << "KB physical";
+    if (pack - physical >= 1024)
+    {
+        cout << " + " << (pack - physical) / 1024 << "KB dead";
+    }
+    if (physical > 0)
+    {
+        cout << " (" << static_cast<double>(logical * 100 / unique) / 100 << "x dedup, "
+             << static_cast<double>(unique * 100 / physical) / 100 << "x compression, "
+             << diskStore.chunkCount() << " unique chunks)";
+    }
+    cout << "\n";
+    DedupStore::CodecStats codec = diskStore.codecStats();
+    if (codec.compressInBytes > 0 || codec.decompressOutBytes > 0)
+    {
+        const double MB = 1024.0 * 1024.0;
+        cout << YELLOW << "Compression: " << RESET << codec.compressedChunks << " chunks compressed, "
+             << codec.bypassedChunks << " stored raw";
+        if (codec.compressSeconds > 0)
+        {
+            cout << ", compress " << static_cast<long>(codec.compressInBytes / MB / codec.compressSeconds) << " MB/s";
+        }
+        if (codec.decompressSeconds > 0)
+        {
+            cout << ", decompress " << static_cast<long>(codec.decompressOutBytes / MB / codec.decompressSeconds)
+                 << " MB/s";
+        }
+        cout << "\n";
+    }
+    BufferCache::Stats cache = bufferCache.stats();
+    uint64_t lookups = cache.hits + cache.misses;
+    cout << YELLOW << "Buffer Cache: " << RESET << cacheMb << "MB, " << cache.hits << " hits / " << cache.misses
+         << " misses";
+    if (lookups > 0)
+    {
+        cout << " (" << cache.hits * 1000 / lookups / 10.0 << "% hit)";
+    }
+    cout << ", " << cache.writebacks << " writebacks, " << cache.dirtyBlocks << " dirty blocks\n";
+    DiskService::Stats service = diskService.stats();
+    cout << YELLOW << "Disk Service: " << RESET << service.clients << " tasks connected, " << service.openFiles
+         << " open files, " << service.requests << " requests\n";
+    cout << YELLOW << "Task Files: " << RESET << diskAccountant.storedBytes() / 1024 << "KB on disk, "
+         << diskAccountant.unreservedBytes() / 1024 << "KB outside process quotas\n";
     cout << YELLOW << "CPU Cores: " << RESET << (totalCores - availableCores) << " / " << totalCores << " in use\n";
 }
 
@@ -511,19 +829,25 @@ void OSSystem::syncRunningProcesses()
     if (!hasClockProcess)
     {
         // Add clock as running process for demonstration
-        std::shared_ptr<Process> clock = std::make_shared<Process>(1, "clock", 15, 2);
-        clock->ready();
-        clock->run();
-        runningProcesses.push_back(clock);
+        Process *clock = processPool.acquire(1, "clock", 15, 2);
+        if (clock != nullptr)
+        {
+            clock->ready();
+            clock->run();
+            runningProcesses.push_back(clock);
+        }
     }
 
     if (!hasCalendarProcess)
     {
         // Add calendar as running process for demonstration
-        std::shared_ptr<Process> calendar = std::make_shared<Process>(2, "calendar", 25, 8);
-        calendar->ready();
-        calendar->run();
-        runningProcesses.push_back(calendar);
+        Process *calendar = processPool.acquire(2, "calendar", 25, 8);
+        if (calendar != nullptr)
+        {
+            calendar->ready();
+            calendar->run();
+            runningProcesses.push_back(calendar);
+        }
     }
 
     // We'll check if there's a calculator PID that was higher than our auto-assigned ones
@@ -531,10 +855,13 @@ void OSSystem::syncRunningProcesses()
     if (!hasCalculatorProcess && nextPid > 3)
     {
         // This means a user likely launched the calculator but we can't find it
-        std::shared_ptr<Process> calculator = std::make_shared<Process>(3, "calculator", 20, 5);
-        calculator->ready();
-        calculator->run();
-        runningProcesses.push_back(calculator);
+        Process *calculator = processPool.acquire(3, "calculator", 20, 5);
+        if (calculator != nullptr)
+        {
+            calculator->ready();
+            calculator->run();
+            runningProcesses.push_back(calculator);
+        }
     }
 }
 
@@ -547,7 +874,7 @@ void OSSystem::showRunningTasks()
         return;
     }
 
-    for (const auto& process : runningProcesses)
+    for (const Process *process : runningProcesses)
     {
         cout << CYAN << "PID: " << RESET << process->getPid() << " | ";
         cout << MAGENTA << "Name: " << RESET << process->getName() << " | ";
@@ -6,8 +6,8 @@
 #include <chrono>
 #include <cstdlib>
 
-Process::Process(int pid, const std::string &name, int memoryRequired, int diskRequired)
-    : pid(pid), name(name), state(NEW), memoryRequired(memoryRequired), diskRequired(diskRequired), turnaroundTime(0)
+Process::Process(int pid, const ProcessColdData *cold, int memoryRequired, int diskRequired)
+    : cold(cold), pid(pid), memoryRequired(memoryRequired), diskRequired(diskRequired), turnaroundTime(0), state(NEW)
 {
     creationTime = std::chrono::steady_clock::now();
 }
@@ -63,26 +63,11 @@ bool Process::startProcess()
     {
         return false;
     }
-    std::string absPath = std::string(currentDir) + "/build/" + name;
-
-    // Check if the executable exists before trying to start it
-    std::string checkCmd = "if [ -f " + absPath + " ]; then echo 'Exists'; else echo 'Missing'; fi";
-    std::string result = "";
-    char buffer[128];
-    FILE *pipe = popen(checkCmd.c_str(), "r");
-    if (!pipe)
-    {
-        return false;
-    }
-    while (!feof(pipe))
-    {
-        if (fgets(buffer, 128, pipe) != NULL)
-            result += buffer;
-    }
-    pclose(pipe);
+    // The executable was validated against the task catalog at boot
+    std::string absPath = std::string(currentDir) + "/build/" + cold->name;
 
     // Special handling for calculator to ensure it's properly tracked
-    if (name == "calculator")
+    if (cold->name == "calculator")
     {
         // Use exec to launch the process in a new terminal with absolute path
         std::string command = "osascript -e 'tell app \"Terminal\" to do script \"" +
@@ -0,0 +1,71 @@
+#include "../include/ProcessPool.h"
+#include <new>
+
+ProcessPool::ProcessPool()
+    : slots(nullptr), slotCount(0)
+{
+}
+
+ProcessPool::~ProcessPool()
+{
+    // Destroy whatever is still checked out, then hand the slab back
+    vector<bool> isFree(slotCount, false);
+    for (uint32_t index : freeSlots)
+    {
+        isFree[index] = true;
+    }
+    for (size_t i = 0; i < slotCount; i++)
+    {
+        if (!isFree[i])
+        {
+            slots[i].~Process();
+        }
+    }
+    ::operator delete(slots, std::align_val_t(alignof(Process)));
+}
+
+void ProcessPool::reserve(size_t capacity)
+{
+    if (slots != nullptr)
+    {
+        return;
+    }
+
+    slots = static_cast<Process *>(::operator new(capacity * sizeof(Process), std::align_val_t(alignof(Process))));
+    slotCount = capacity;
+    cold.resize(capacity);
+
+    // Hand out low slots first so live records stay packed together
+    freeSlots.reserve(capacity);
+    for (size_t i = capacity; i > 0; i--)
+    {
+        freeSlots.push_back(static_cast<uint32_t>(i - 1));
+    }
+}
+
+Process *ProcessPool::acquire(int pid, const string &name, int memoryRequired, int diskRequired)
+{
+    if (freeSlots.empty())
+    {
+        return nullptr;
+    }
+
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+
+    // Reuses the slot's string buffer, task names fit in the small-string buffer anyway
+    cold[index].name.assign(name);
+    return new (&slots[index]) Process(pid, &cold[index], memoryRequired, diskRequired);
+}
+
+void ProcessPool::release(Process *process)
+{
+    if (process == nullptr)
+    {
+        return;
+    }
+
+    uint32_t index = static_cast<uint32_t>(process - slots);
+    process->~Process();
+    freeSlots.push_back(index);
+}
@@ -0,0 +1,271 @@
+#include "../include/WorkloadGenerator.h"
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+// ANSI Color codes
+#define CYAN "\033[36m"
+#define YELLOW "\033[33m"
+#define RESET "\033[0m"
+
+bool parseArrivalPattern(const string &name, ArrivalPattern &pattern)
+{
+    if (name == "poisson")
+        pattern = POISSON;
+    else if (name == "bursty")
+        pattern = BURSTY;
+    else if (name == "diurnal")
+        pattern = DIURNAL;
+    else
+        return false;
+    return true;
+}
+
+void WorkloadGenerator::LatencyStats::print(const string &label)
+{
+    cout << "  " << left << setw(10) << label << right;
+    if (samples.empty())
+    {
+        cout << "       -" << endl;
+        return;
+    }
+
+    // Nearest-rank percentiles on a sorted copy
+    sort(samples.begin(), samples.end());
+    auto percentile = [this](double p)
+    {
+        size_t rank = static_cast<size_t>(p * (samples.size() - 1));
+        return samples[rank];
+    };
+
+    cout << fixed << setprecision(1)
+         << setw(10) << percentile(0.50)
+         << setw(10) << percentile(0.95)
+         << setw(10) << percentile(0.99)
+         << setw(10) << samples.back()
+         << setw(10) << samples.size() << endl;
+}
+
+WorkloadGenerator::WorkloadGenerator(OSSystem &os, const WorkloadConfig &config)
+    : os(os), config(config), rng(config.seed), clock(0.0), burstOn(true), periodEnd(0.0)
+{
+    periodEnd = exponential(config.meanOnPeriod);
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        if (os.isTaskInstalled(i))
+        {
+            installedTasks.push_back(i);
+        }
+    }
+}
+
+double WorkloadGenerator::exponential(double mean)
+{
+    exponential_distribution<double> dist(1.0 / mean);
+    return dist(rng);
+}
+
+double WorkloadGenerator::nextArrivalTime()
+{
+    switch (config.pattern)
+    {
+    case POISSON:
+        clock += exponential(1.0 / config.arrivalRate);
+        break;
+
+    case BURSTY:
+    {
+        // Scale the on-period rate so the long-run mean matches arrivalRate
+        double onRate = config.arrivalRate * (config.meanOnPeriod + config.meanOffPeriod) / config.meanOnPeriod;
+        while (true)
+        {
+            double gap = exponential(1.0 / onRate);
+            if (burstOn && clock + gap <= periodEnd)
+            {
+                clock += gap;
+                break;
+            }
+
+            // Exponential gaps are memoryless, so restarting at the boundary is exact
+            clock = periodEnd;
+            burstOn = !burstOn;
+            periodEnd = clock + exponential(burstOn ? config.meanOnPeriod : config.meanOffPeriod);
+        }
+        break;
+    }
+
+    case DIURNAL:
+    {
+        // Non-homogeneous Poisson process by thinning
+        const double twoPi = 6.283185307179586;
+        double maxRate = config.arrivalRate * (1.0 + config.diurnalAmplitude);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true)
+        {
+            clock += exponential(1.0 / maxRate);
+            double rate = config.arrivalRate * (1.0 + config.diurnalAmplitude * sin(twoPi * clock / config.diurnalPeriod));
+            if (uniform(rng) * maxRate < rate)
+            {
+                break;
+            }
+        }
+        break;
+    }
+    }
+
+    return clock;
+}
+
+int WorkloadGenerator::pickTask()
+{
+    uniform_int_distribution<size_t> dist(0, installedTasks.size() - 1);
+    return installedTasks[dist(rng)];
+}
+
+void WorkloadGenerator::run()
+{
+    using Clock = chrono::steady_clock;
+    auto micros = [](Clock::time_point start)
+    {
+        return chrono::duration<double, micro>(Clock::now() - start).count();
+    };
+
+    priority_queue<Event, vector<Event>, greater<Event>> events;
+    unordered_map<int, double> arrivalTimes; // pid -> simulated arrival
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    geometric_distribution<int> burstCount(1.0 / max(1.0, config.meanCpuBursts));
+
+    // I/O bound processes run short CPU bursts and wait on long I/O bursts
+    auto cpuBurst = [&](bool ioBound)
+    { return exponential(ioBound ? config.meanCpuBurst * 0.25 : config.meanCpuBurst); };
+    auto ioBurst = [&](bool ioBound)
+    { return exponential(ioBound ? config.meanIoBurst * 4.0 : config.meanIoBurst); };
+
+    long generated = 0, admitted = 0, rejected = 0, completed = 0;
+    long live = 0, peakLive = 0;
+    double turnaroundSum = 0.0;
+    double simTime = 0.0;
+
+    if (installedTasks.empty())
+    {
+        cout << "Workload: no tasks are installed" << endl;
+        return;
+    }
+
+    if (config.arrivals > 0)
+    {
+        events.push({nextArrivalTime(), ARRIVAL, 0, 0, false});
+        generated++;
+    }
+
+    auto wallStart = Clock::now();
+    while (!events.empty())
+    {
+        Event event = events.top();
+        events.pop();
+        simTime = event.time;
+
+        switch (event.type)
+        {
+        case ARRIVAL:
+        {
+            if (generated < config.arrivals)
+            {
+                events.push({nextArrivalTime(), ARRIVAL, 0, 0, false});
+                generated++;
+            }
+
+            const TaskInfo &task = TASK_CATALOG[pickTask()];
+            auto start = Clock::now();
+            int pid = os.createProcess(task.binary, task.ramRequired, task.diskRequired);
+            if (pid != -1)
+            {
+                os.waitForDispatch();
+            }
+            admitLatency.record(micros(start));
+
+            if (pid == -1)
+            {
+                rejected++;
+                break;
+            }
+
+            admitted++;
+            live++;
+            peakLive = max(peakLive, live);
+            arrivalTimes[pid] = simTime;
+
+            bool ioBound = uniform(rng) < config.ioBoundShare;
+            int bursts = burstCount(rng) + 1;
+            events.push({simTime + cpuBurst(ioBound), CPU_BURST_END, pid, bursts, ioBound});
+            break;
+        }
+
+        case CPU_BURST_END:
+        {
+            if (event.burstsLeft <= 1)
+            {
+                auto start = Clock::now();
+                os.terminateProcess(event.pid);
+                exitLatency.record(micros(start));
+
+                completed++;
+                live--;
+                turnaroundSum += simTime - arrivalTimes[event.pid];
+                arrivalTimes.erase(event.pid);
+                break;
+            }
+
+            // Block on I/O until the burst completes
+            auto start = Clock::now();
+            os.minimizeProcess(event.pid);
+            blockLatency.record(micros(start));
+            events.push({simTime + ioBurst(event.ioBound), IO_BURST_END, event.pid, event.burstsLeft - 1, event.ioBound});
+            break;
+        }
+
+        case IO_BURST_END:
+        {
+            auto start = Clock::now();
+            if (os.resumeProcess(event.pid))
+            {
+                os.waitForDispatch();
+            }
+            resumeLatency.record(micros(start));
+            events.push({simTime + cpuBurst(event.ioBound), CPU_BURST_END, event.pid, event.burstsLeft, event.ioBound});
+            break;
+        }
+        }
+    }
+    double wallSeconds = chrono::duration<double>(Clock::now() - wallStart).count();
+
+    static const char *patternNames[] = {"poisson", "bursty", "diurnal"};
+    long osCalls = admitLatency.samples.size() + blockLatency.samples.size() +
+                   resumeLatency.samples.size() + exitLatency.samples.size();
+
+    cout << CYAN << "\n===== Workload Summary (" << patternNames[config.pattern] << ", seed "
+         << config.seed << ") =====\n" << RESET;
+    cout << fixed << setprecision(2);
+    cout << YELLOW << "Arrivals: " << RESET << generated << "  admitted " << admitted
+         << ", rejected " << rejected << " (" << (generated ? 100.0 * rejected / generated : 0.0) << "%)" << endl;
+    cout << YELLOW << "Completed: " << RESET << completed << "  peak concurrent " << peakLive << endl;
+    cout << YELLOW << "Simulated time: " << RESET << simTime << " s  mean turnaround "
+         << (completed ? turnaroundSum / completed : 0.0) << " s" << endl;
+    cout << YELLOW << "Wall time: " << RESET << wallSeconds << " s  ("
+         << (wallSeconds > 0 ? generated / wallSeconds : 0.0) << " arrivals/s, "
+         << (wallSeconds > 0 ? osCalls / wallSeconds : 0.0) << " OS calls/s)" << endl;
+
+    cout << YELLOW << "Latency (us)" << RESET << setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99"
+         << setw(10) << "max" << setw(10) << "count" << endl;
+    admitLatency.print("admit");
+    blockLatency.print("block");
+    resumeLatency.print("resume");
+    exitLatency.print("exit");
+    cout << defaultfloat;
+}
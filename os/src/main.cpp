@@ -1,9 +1,17 @@
 #include "../include/OSSystem.h"
+#include "../include/WorkloadGenerator.h"
+#include "../include/IOWorkload.h"
+#include "../include/HeapCounter.h"
 #include <iostream>
 #include <thread>
 #include <string>
 #include <csignal>
 #include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <filesystem>
 
 OSSystem os;
 bool running = true;
@@ -46,27 +54,436 @@ void displayMenu()
     }
 }
 
+// Resolve a task given either its menu number or its binary name, returns -1 if unknown
+int lookupTask(const std::string &key)
+{
+    int taskIndex = TaskCatalog::find(key);
+    if (taskIndex == -1 && !key.empty() && key.find_first_not_of("0123456789") == std::string::npos)
+    {
+        taskIndex = TaskCatalog::fromMenuNumber(std::atoi(key.c_str()));
+    }
+    return taskIndex;
+}
+
+// Execute a single scripted command, returns false if it failed.
+// In pipelined mode launches and resumes do not wait for the scheduler
+// and successful commands produce no output.
+bool executeCommand(const std::string &command, std::istringstream &args, bool pipelined)
+{
+    if (command == "launch")
+    {
+        std::string key;
+        args >> key;
+        int taskIndex = lookupTask(key);
+        if (taskIndex == -1)
+        {
+            std::cout << "launch " << key << ": unknown task\n";
+            return false;
+        }
+
+        std::string taskName = TASK_CATALOG[taskIndex].binary;
+        if (!os.isTaskInstalled(taskIndex))
+        {
+            std::cout << "launch " << taskName << ": not installed\n";
+            return false;
+        }
+
+        int pid = os.launchTask(taskIndex);
+        if (pid == -1)
+        {
+            std::cout << "launch " << taskName << ": insufficient resources\n";
+            return false;
+        }
+        if (!pipelined)
+        {
+            os.waitForDispatch();
+            std::cout << "launch " << taskName << ": PID " << pid << "\n";
+        }
+        return true;
+    }
+
+    if (command == "close" || command == "minimize" || command == "resume")
+    {
+        int pid;
+        if (!(args >> pid))
+        {
+            std::cout << command << ": missing PID\n";
+            return false;
+        }
+
+        bool success;
+        if (command == "close")
+        {
+            success = os.terminateProcess(pid);
+        }
+        else if (command == "minimize")
+        {
+            success = os.minimizeProcess(pid);
+        }
+        else
+        {
+            success = os.resumeProcess(pid);
+            if (success && !pipelined)
+            {
+                os.waitForDispatch();
+            }
+        }
+
+        if (!success)
+        {
+            std::cout << command << " " << pid << ": invalid PID\n";
+        }
+        else if (!pipelined)
+        {
+            std::cout << command << " " << pid << ": ok\n";
+        }
+        return success;
+    }
+
+    if (command == "status")
+    {
+        os.waitForDispatch();
+        os.showResourceStatus();
+        return true;
+    }
+
+    if (command == "tasks")
+    {
+        os.waitForDispatch();
+        os.showRunningTasks();
+        return true;
+    }
+
+    if (command == "write")
+    {
+        // write <file> <text...>, the rest of the line becomes the content
+        std::string filename, text;
+        args >> filename;
+        std::getline(args >> std::ws, text);
+        if (filename.empty())
+        {
+            std::cout << "write: missing file name\n";
+            return false;
+        }
+        if (!os.writeFile(filename, text + "\n"))
+        {
+            std::cout << "write " << filename << ": not enough disk space\n";
+            return false;
+        }
+        return true;
+    }
+
+    if (command == "read")
+    {
+        // read <file> [offset length], a range only decompresses the chunks it covers
+        std::string filename, data;
+        uint64_t offset, length;
+        args >> filename;
+        bool found = args >> offset >> length ? os.readFile(filename, offset, length, data)
+                                              : os.readFile(filename, data);
+        if (!found)
+        {
+            std::cout << "read " << filename << ": no such file\n";
+            return false;
+        }
+        std::cout << data;
+        return true;
+    }
+
+    if (command == "rm")
+    {
+        std::string filename;
+        args >> filename;
+        if (!os.deleteFile(filename))
+        {
+            std::cout << "rm " << filename << ": no such file\n";
+            return false;
+        }
+        return true;
+    }
+
+    if (command == "import")
+    {
+        // import <host file or directory> [name], directories keep their relative paths
+        std::string hostPath, filename;
+        args >> hostPath >> filename;
+        std::error_code error;
+        if (!std::filesystem::is_directory(hostPath, error))
+        {
+            if (!os.importFile(hostPath, filename.empty() ? hostPath : filename))
+            {
+                std::cout << "import " << hostPath << ": failed\n";
+                return false;
+            }
+            return true;
+        }
+
+        long imported = 0, failed = 0;
+        std::filesystem::path base = filename.empty() ? std::filesystem::path(hostPath).filename() : std::filesystem::path(filename);
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(hostPath, error))
+        {
+            if (!entry.is_regular_file())
+            {
+                continue;
+            }
+            std::string name = (base / std::filesystem::relative(entry.path(), hostPath)).string();
+            if (os.importFile(entry.path().string(), name))
+            {
+                imported++;
+            }
+            else
+            {
+                failed++;
+            }
+        }
+        if (!pipelined || failed > 0)
+        {
+            std::cout << "import " << hostPath << ": " << imported << " files";
+            if (failed > 0)
+            {
+                std::cout << " (" << failed << " failed)";
+            }
+            std::cout << "\n";
+        }
+        return failed == 0;
+    }
+
+    if (command == "mode")
+    {
+        if (os.getCurrentMode() == USER_MODE)
+        {
+            os.switchToKernelMode();
+        }
+        else
+        {
+            os.switchToUserMode();
+        }
+        return true;
+    }
+
+    if (command == "shutdown")
+    {
+        running = false;
+        return true;
+    }
+
+    std::cout << command << ": unknown command\n";
+    return false;
+}
+
+// Run commands from a script (one per line) without rendering the menu.
+// Supported: launch <task|number>, close <pid>, minimize <pid>,
+// resume <pid>, status, tasks, mode, shutdown, and the stored file commands
+// write <file> <text>, read <file> [offset length], rm <file>, import <path> [name].
+// Lines starting with # are ignored.
+int runBatch(std::istream &in, bool pipelined)
+{
+    long commands = 0;
+    long failures = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    std::string line;
+    while (running && os.isSystemRunning() && std::getline(in, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream args(line);
+        std::string command;
+        args >> command;
+
+        commands++;
+        if (!executeCommand(command, args, pipelined))
+        {
+            failures++;
+        }
+    }
+
+    // Pipelined commands are only counted once the scheduler has caught up
+    os.waitForDispatch();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\nBatch complete: " << commands << " commands (" << failures << " failed) in "
+              << seconds << " s";
+    if (seconds > 0)
+    {
+        std::cout << ", " << static_cast<long>(commands / seconds) << " commands/sec";
+    }
+    std::cout << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
+
+// Time create/dispatch/terminate cycles through the process pool and, in
+// bench builds, count the heap allocations they make once it has warmed up
+int runPoolBenchmark(long cycles)
+{
+    int taskIndex = TaskCatalog::find("calculator");
+    const TaskInfo &task = TASK_CATALOG[taskIndex];
+
+    auto cycle = [&task]()
+    {
+        int pid = os.createProcess(task.binary, task.ramRequired, task.diskRequired);
+        os.waitForDispatch();
+        os.terminateProcess(pid);
+    };
+
+    for (long i = 0; i < cycles / 10 + 1; i++)
+    {
+        cycle();
+    }
+
+    long allocationsBefore = heapAllocationCount();
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < cycles; i++)
+    {
+        cycle();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "\n===== Process Pool Benchmark =====\n"
+              << "Cycles: " << cycles << " create/dispatch/terminate\n"
+              << "Time: " << seconds << " s (" << static_cast<long>(cycles / seconds) << " cycles/sec, "
+              << (seconds * 1e9 / cycles) << " ns/cycle)\n"
+              << "Process record: " << sizeof(Process) << " bytes" << std::endl;
+
+    if (allocationsBefore < 0)
+    {
+        std::cout << "Heap allocations: not counted (make bench builds a counting binary)" << std::endl;
+        return 0;
+    }
+    long allocations = heapAllocationCount() - allocationsBefore;
+    std::cout << "Heap allocations: " << allocations << " ("
+              << (allocations == 0 ? "allocation-free" : "NOT allocation-free") << ")" << std::endl;
+    return allocations == 0 ? 0 : 1;
+}
+
+void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [ram_mb disk_gb cores] [--batch [file|-]] [--pipelined] [--cache-mb N] [--no-compress]\n"
+              << "       " << program << " [ram_mb disk_gb cores] --workload <poisson|bursty|diurnal>"
+              << " [--arrivals N] [--rate per_sec] [--seed N]\n"
+              << "       " << program << " [ram_mb disk_gb cores] --bench-pool [cycles]\n"
+              << "       " << program << " [ram_mb disk_gb cores] --bench-io <noop|elevator|deadline|bfq|all> [--seed N]" << std::endl;
+}
+
 int main(int argc, char *argv[])
 {
     // Register signal handler for ctrl+c
     std::signal(SIGINT, signalHandler);
 
+    // Split resource arguments from option flags
+    std::vector<std::string> positional;
+    bool batchMode = false;
+    bool pipelined = false;
+    std::string batchFile = "-";
+    bool workloadMode = false;
+    WorkloadConfig workload;
+    long benchCycles = 0;
+    bool ioMode = false;
+    IOWorkloadConfig ioWorkload;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--workload" && hasValue)
+        {
+            workloadMode = true;
+            if (!parseArrivalPattern(argv[++i], workload.pattern))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--arrivals" && hasValue)
+        {
+            workload.arrivals = std::atoi(argv[++i]);
+        }
+        else if (arg == "--rate" && hasValue)
+        {
+            workload.arrivalRate = std::atof(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            workload.seed = static_cast<unsigned>(std::atoi(argv[++i]));
+            ioWorkload.seed = workload.seed;
+        }
+        else if (arg == "--cache-mb" && hasValue)
+        {
+            os.setCacheSize(std::atoi(argv[++i]));
+        }
+        else if (arg == "--no-compress")
+        {
+            os.setCompression(false);
+        }
+        else if (arg == "--bench-pool")
+        {
+            benchCycles = 1000000;
+            if (hasValue && std::string(argv[i + 1]).rfind("--", 0) != 0)
+            {
+                benchCycles = std::atol(argv[++i]);
+            }
+        }
+        else if (arg == "--bench-io" && hasValue)
+        {
+            ioMode = true;
+            std::string policy = argv[++i];
+            ioWorkload.allPolicies = policy == "all";
+            if (!ioWorkload.allPolicies && !parseIOPolicy(policy, ioWorkload.policy))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--batch")
+        {
+            batchMode = true;
+            if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0)
+            {
+                batchFile = argv[++i];
+            }
+        }
+        else if (arg == "--pipelined")
+        {
+            pipelined = true;
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
     // Check for command-line arguments
-    if (argc == 4)
+    if (positional.size() == 3)
     {
-        int ram = std::atoi(argv[1]);   // RAM in MB
-        int disk = std::atoi(argv[2]);  // Disk in GB (convert to MB)
-        int cores = std::atoi(argv[3]); // Number of cores
+        int ram = std::atoi(positional[0].c_str());   // RAM in MB
+        int disk = std::atoi(positional[1].c_str());  // Disk in GB (convert to MB)
+        int cores = std::atoi(positional[2].c_str()); // Number of cores
 
         // Initialize with command-line arguments
         os.initialize(ram, disk * 1024, cores); // Convert disk from GB to MB
     }
+    else if (batchMode || workloadMode || ioMode || benchCycles > 0)
+    {
+        // Scripts can't answer the prompts, so fall back to the defaults
+        os.initialize(OSSystem::DEFAULT_RAM, OSSystem::DEFAULT_DISK, OSSystem::DEFAULT_CORES);
+    }
     else
     {
         // Initialize with interactive prompts - without requiring initial Enter
         os.initialize();
     }
 
+    // Scripted runs only track processes instead of opening a terminal for each
+    os.setHeadless(batchMode || workloadMode || ioMode || benchCycles > 0);
     os.bootSystem();
 
     // Start scheduler thread
@@ -74,8 +491,53 @@ int main(int argc, char *argv[])
     schedulerThread.detach();
 
     // Launch automatic background services
-    os.createProcess("clock", 15, 2);
-    os.createProcess("calendar", 25, 8);
+    os.launchTask(TaskCatalog::find("clock"));
+    os.launchTask(TaskCatalog::find("calendar"));
+
+    if (benchCycles > 0)
+    {
+        int status = runPoolBenchmark(benchCycles);
+        os.shutdownSystem();
+        return status;
+    }
+
+    if (ioMode)
+    {
+        IOWorkload benchmark(os, ioWorkload);
+        benchmark.run();
+        os.shutdownSystem();
+        return 0;
+    }
+
+    if (workloadMode)
+    {
+        WorkloadGenerator generator(os, workload);
+        generator.run();
+        os.shutdownSystem();
+        return 0;
+    }
+
+    if (batchMode)
+    {
+        int status;
+        if (batchFile == "-")
+        {
+            status = runBatch(std::cin, pipelined);
+        }
+        else
+        {
+            std::ifstream script(batchFile);
+            if (!script)
+            {
+                std::cerr << "Failed to open batch file: " << batchFile << std::endl;
+                os.shutdownSystem();
+                return 1;
+            }
+            status = runBatch(script, pipelined);
+        }
+        os.shutdownSystem();
+        return status;
+    }
 
     std::string choice;
     while (running && os.isSystemRunning())
@@ -118,72 +580,19 @@ int main(int argc, char *argv[])
             std::cout << "Enter task number to launch: ";
             std::cin >> taskNum;
 
-            std::string taskName;
-            int ramRequired = 0, diskRequired = 0;
-
-            switch (taskNum)
+            int taskIndex = TaskCatalog::fromMenuNumber(taskNum);
+            if (taskIndex == -1)
             {
-            case 1:
-                taskName = "notepad";
-                ramRequired = 50;
-                diskRequired = 10;
-                break;
-            case 2:
-                taskName = "calculator";
-                ramRequired = 20;
-                diskRequired = 5;
-                break;
-            case 3:
-                taskName = "clock";
-                ramRequired = 15;
-                diskRequired = 2;
-                break;
-            case 4:
-                taskName = "file_manager";
-                ramRequired = 40;
-                diskRequired = 5;
-                break;
-            case 5:
-                taskName = "minesweeper";
-                ramRequired = 30;
-                diskRequired = 10;
-                break;
-            case 6:
-                taskName = "music_player";
-                ramRequired = 60;
-                diskRequired = 20;
-                break;
-            case 7:
-                taskName = "calendar";
-                ramRequired = 25;
-                diskRequired = 8;
-                break;
-            case 8:
-                taskName = "timer";
-                ramRequired = 10;
-                diskRequired = 2;
-                break;
-            case 9:
-                taskName = "terminal";
-                ramRequired = 15;
-                diskRequired = 3;
-                break;
-            case 10:
-                taskName = "system_monitor";
-                ramRequired = 25;
-                diskRequired = 4;
-                break;
-            case 11:
-                taskName = "settings";
-                ramRequired = 20;
-                diskRequired = 3;
-                break;
-            default:
                 std::cout << "Invalid task number" << std::endl;
                 continue;
             }
+            if (!os.isTaskInstalled(taskIndex))
+            {
+                std::cout << TASK_CATALOG[taskIndex].displayName << " is not installed" << std::endl;
+                continue;
+            }
 
-            int pid = os.createProcess(taskName, ramRequired, diskRequired);
+            int pid = os.launchTask(taskIndex);
             if (pid != -1)
             {
                 std::cout << "Task launched with PID: " << pid << std::endl;
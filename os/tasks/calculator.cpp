@@ -2,82 +2,2704 @@
 #include <string>
 #include <thread>
 #include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
 #include <sstream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../include/DiskLedger.h"
 
 using namespace std;
 
+DiskLedger diskLedger;
+int taskPid = 0;
+
 void clearScreen()
 {
-    cout << "\033[2J\033[1;1H"; // ANSI escape sequence to clear screen
+    cout << "\033[2J\033[1;1H"; // ANSI escape sequence to clear screen
+}
+
+// ===== Expression bytecode =====
+//
+// An expression is compiled once into instructions for a register machine.
+// Registers are allocated like a stack while parsing, so every result lands
+// in the lowest free register and the whole expression ends in register 0.
+
+const int MAX_REGISTERS = 64;
+
+enum OpCode : uint8_t
+{
+    LOAD_CONST, // r[dst] = constants[index]
+    LOAD_VAR,   // r[dst] = variables[index]
+    STORE_VAR,  // variables[index] = r[a]
+    ADD,
+    SUB,
+    MUL,
+    DIV, // IEEE: x/0 is inf or nan, x%0 is nan
+    MOD,
+    POW,
+    NEG,
+    CALL1, // r[dst] = FUNCTIONS[index](r[a])
+    CALL2  // r[dst] = FUNCTIONS[index](r[a], r[b])
+};
+
+struct Instruction
+{
+    OpCode op;
+    uint8_t dst, a, b;
+    uint32_t index;
+};
+
+// Functions the columnar evaluator runs as SIMD kernels rather than per row
+enum class Kernel : uint8_t
+{
+    NONE,
+    SQRT,
+    ABS,
+    MIN,
+    MAX
+};
+
+struct Function
+{
+    const char *name;
+    int arity;
+    double (*one)(double);
+    double (*two)(double, double);
+    Kernel kernel;
+};
+
+const Function FUNCTIONS[] = {
+    {"sqrt", 1, [](double x) { return sqrt(x); }, nullptr, Kernel::SQRT},
+    {"abs", 1, [](double x) { return fabs(x); }, nullptr, Kernel::ABS},
+    {"sin", 1, [](double x) { return sin(x); }, nullptr, Kernel::NONE},
+    {"cos", 1, [](double x) { return cos(x); }, nullptr, Kernel::NONE},
+    {"tan", 1, [](double x) { return tan(x); }, nullptr, Kernel::NONE},
+    {"asin", 1, [](double x) { return asin(x); }, nullptr, Kernel::NONE},
+    {"acos", 1, [](double x) { return acos(x); }, nullptr, Kernel::NONE},
+    {"atan", 1, [](double x) { return atan(x); }, nullptr, Kernel::NONE},
+    {"exp", 1, [](double x) { return exp(x); }, nullptr, Kernel::NONE},
+    {"log", 1, [](double x) { return log(x); }, nullptr, Kernel::NONE},
+    {"log10", 1, [](double x) { return log10(x); }, nullptr, Kernel::NONE},
+    {"log2", 1, [](double x) { return log2(x); }, nullptr, Kernel::NONE},
+    {"floor", 1, [](double x) { return floor(x); }, nullptr, Kernel::NONE},
+    {"ceil", 1, [](double x) { return ceil(x); }, nullptr, Kernel::NONE},
+    {"round", 1, [](double x) { return round(x); }, nullptr, Kernel::NONE},
+    {"fact", 1, [](double x) { return tgamma(x + 1); }, nullptr, Kernel::NONE},
+    {"min", 2, nullptr, [](double x, double y) { return min(x, y); }, Kernel::MIN},
+    {"max", 2, nullptr, [](double x, double y) { return max(x, y); }, Kernel::MAX},
+    {"pow", 2, nullptr, [](double x, double y) { return pow(x, y); }, Kernel::NONE},
+    {"atan2", 2, nullptr, [](double x, double y) { return atan2(x, y); }, Kernel::NONE},
+    {"hypot", 2, nullptr, [](double x, double y) { return hypot(x, y); }, Kernel::NONE},
+};
+
+inline double applyBinary(OpCode op, double a, double b)
+{
+    switch (op)
+    {
+    case ADD:
+        return a + b;
+    case SUB:
+        return a - b;
+    case MUL:
+        return a * b;
+    case DIV:
+        return a / b;
+    case MOD:
+        return fmod(a, b);
+    case POW:
+        return pow(a, b);
+    default:
+        return 0;
+    }
+}
+
+struct Program
+{
+    vector<Instruction> code;
+    vector<double> constants;
+    int registers = 0; // Highest register used plus one
+    bool assigns = false;
+
+    // Exact programs keep each constant's text, as offset and length in source
+    string source;
+    vector<pair<uint32_t, uint32_t>> literals;
+
+    void clear()
+    {
+        code.clear();
+        constants.clear();
+        registers = 0;
+        assigns = false;
+        source.clear();
+        literals.clear();
+    }
+};
+
+// Named variables live in slots so compiled code never looks up a name
+struct Environment
+{
+    unordered_map<string, uint32_t> slots;
+    vector<string> names;
+    vector<double> values;
+
+    int find(const string &name) const
+    {
+        auto found = slots.find(name);
+        return found == slots.end() ? -1 : static_cast<int>(found->second);
+    }
+
+    uint32_t define(const string &name, double value)
+    {
+        int slot = find(name);
+        if (slot >= 0)
+        {
+            values[slot] = value;
+            return slot;
+        }
+        slots[name] = static_cast<uint32_t>(names.size());
+        names.push_back(name);
+        values.push_back(value);
+        return static_cast<uint32_t>(names.size() - 1);
+    }
+};
+
+// ===== Compiler =====
+//
+// Precedence climbing straight into bytecode, with no tree in between.
+// Constant subexpressions are folded, so "2 * pi * r" loads one constant.
+// Precedence from loosest: + -, * / %, unary minus, ^ (right associative).
+
+class Compiler
+{
+public:
+    string error;
+    size_t errorPosition = 0;
+
+    // Compiles "expression" or "name = expression". An exact program is left
+    // unfolded and keeps its literals as text for the arbitrary precision modes.
+    bool compile(const char *text, size_t length, Environment &env, Program &program, bool exact = false)
+    {
+        begin = text;
+        p = text;
+        end = text + length;
+        this->env = &env;
+        out = &program;
+        program.clear();
+        error.clear();
+        top = 0;
+        folding = !exact;
+        if (exact)
+            program.source.assign(text, length);
+
+        string target;
+        const char *save = p;
+        skipSpace();
+        if (isNameStart())
+        {
+            target = readName();
+            skipSpace();
+            if (p < end && *p == '=')
+                p++;
+            else
+            {
+                target.clear();
+                p = save;
+            }
+        }
+        if (!target.empty() && (isConstantName(target) || isFunctionName(target)))
+            return fail("Cannot assign to '" + target + "'");
+
+        Operand result = parseBinary(1);
+        skipSpace();
+        if (error.empty() && p < end)
+            fail("Unexpected '" + string(1, *p) + "'");
+        if (!error.empty())
+            return false;
+
+        materialize(result);
+        if (!target.empty())
+        {
+            int slot = env.find(target);
+            emit(STORE_VAR, 0, 0, 0, slot >= 0 ? slot : env.define(target, 0));
+            program.assigns = true;
+        }
+        return true;
+    }
+
+private:
+    struct Operand
+    {
+        bool constant;
+        double value;
+        int reg;
+        uint32_t literalStart, literalLength;
+    };
+
+    const char *begin = nullptr, *p = nullptr, *end = nullptr;
+    Environment *env = nullptr;
+    Program *out = nullptr;
+    int top = 0;
+    bool folding = true;
+
+    bool fail(const string &message)
+    {
+        if (error.empty())
+        {
+            error = message;
+            errorPosition = p - begin;
+        }
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+
+    bool isNameStart() const
+    {
+        return p < end && (isalpha(static_cast<unsigned char>(*p)) || *p == '_');
+    }
+
+    string readName()
+    {
+        const char *start = p;
+        while (p < end && (isalnum(static_cast<unsigned char>(*p)) || *p == '_'))
+            p++;
+        return string(start, p);
+    }
+
+    static bool isConstantName(const string &name)
+    {
+        return name == "pi" || name == "e";
+    }
+
+    static int functionIndex(const string &name)
+    {
+        for (size_t i = 0; i < sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]); i++)
+        {
+            if (name == FUNCTIONS[i].name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    static bool isFunctionName(const string &name)
+    {
+        return functionIndex(name) >= 0;
+    }
+
+    void emit(OpCode op, int dst, int a, int b, uint32_t index)
+    {
+        out->code.push_back({op, static_cast<uint8_t>(dst), static_cast<uint8_t>(a), static_cast<uint8_t>(b), index});
+    }
+
+    int allocate()
+    {
+        if (top >= MAX_REGISTERS)
+        {
+            fail("Expression nests too deeply");
+            return 0;
+        }
+        out->registers = max(out->registers, top + 1);
+        return top++;
+    }
+
+    Operand constant(double value)
+    {
+        return {true, value, -1, 0, 0};
+    }
+
+    Operand inRegister(int reg)
+    {
+        return {false, 0, reg, 0, 0};
+    }
+
+    void materialize(Operand &operand)
+    {
+        if (!operand.constant)
+            return;
+        int reg = allocate();
+        out->constants.push_back(operand.value);
+        if (!folding)
+            out->literals.emplace_back(operand.literalStart, operand.literalLength);
+        emit(LOAD_CONST, reg, 0, 0, static_cast<uint32_t>(out->constants.size() - 1));
+        operand = inRegister(reg);
+    }
+
+    // The result reuses the lower register, freeing everything above it
+    Operand binary(OpCode op, Operand left, Operand right)
+    {
+        if (folding && left.constant && right.constant)
+            return constant(applyBinary(op, left.value, right.value));
+        materialize(left);
+        materialize(right);
+        int dst = min(left.reg, right.reg);
+        emit(op, dst, left.reg, right.reg, 0);
+        top = dst + 1;
+        return inRegister(dst);
+    }
+
+    Operand parseBinary(int minPrecedence)
+    {
+        Operand left = parseUnary();
+        while (error.empty())
+        {
+            skipSpace();
+            if (p >= end)
+                break;
+            OpCode op;
+            int precedence;
+            switch (*p)
+            {
+            case '+':
+                op = ADD, precedence = 1;
+                break;
+            case '-':
+                op = SUB, precedence = 1;
+                break;
+            case '*':
+                op = MUL, precedence = 2;
+                break;
+            case '/':
+                op = DIV, precedence = 2;
+                break;
+            case '%':
+                op = MOD, precedence = 2;
+                break;
+            default:
+                return left;
+            }
+            if (precedence < minPrecedence)
+                break;
+            p++;
+            Operand right = parseBinary(precedence + 1);
+            left = binary(op, left, right);
+        }
+        return left;
+    }
+
+    Operand parseUnary()
+    {
+        skipSpace();
+        if (p < end && *p == '-')
+        {
+            p++;
+            Operand operand = parseUnary();
+            if (folding && operand.constant)
+                return constant(-operand.value);
+            materialize(operand);
+            emit(NEG, operand.reg, operand.reg, 0, 0);
+            return operand;
+        }
+        if (p < end && *p == '+')
+        {
+            p++;
+            return parseUnary();
+        }
+
+        Operand base = parsePrimary();
+        skipSpace();
+        if (error.empty() && p < end && *p == '^')
+        {
+            p++;
+            Operand exponent = parseUnary(); // 2^-1 and 2^3^2 = 2^9
+            return binary(POW, base, exponent);
+        }
+        return base;
+    }
+
+    Operand parsePrimary()
+    {
+        skipSpace();
+        if (p >= end)
+        {
+            fail("Expression ends too early");
+            return constant(0);
+        }
+
+        if (*p == '(')
+        {
+            p++;
+            Operand inner = parseBinary(1);
+            skipSpace();
+            if (p >= end || *p != ')')
+                fail("Missing ')'");
+            else
+                p++;
+            return inner;
+        }
+
+        if (isdigit(static_cast<unsigned char>(*p)) || *p == '.')
+        {
+            char *stop;
+            double value = strtod(p, &stop);
+            if (stop == p || stop > end)
+            {
+                fail("Bad number");
+                return constant(0);
+            }
+            Operand literal = constant(value);
+            literal.literalStart = static_cast<uint32_t>(p - begin);
+            literal.literalLength = static_cast<uint32_t>(stop - p);
+            p = stop;
+            return literal;
+        }
+
+        if (!isNameStart())
+        {
+            fail("Unexpected '" + string(1, *p) + "'");
+            return constant(0);
+        }
+
+        const char *nameStart = p;
+        string name = readName();
+        skipSpace();
+        if (p < end && *p == '(')
+        {
+            p++;
+            return parseCall(name, nameStart);
+        }
+        if (isConstantName(name) && !folding)
+        {
+            p = nameStart;
+            fail(name + " has no exact value; use mode float");
+            return constant(0);
+        }
+        if (name == "pi")
+            return constant(M_PI);
+        if (name == "e")
+            return constant(M_E);
+        int slot = env->find(name);
+        if (slot < 0)
+        {
+            p = nameStart;
+            fail("Unknown variable '" + name + "'");
+            return constant(0);
+        }
+        int reg = allocate();
+        emit(LOAD_VAR, reg, 0, 0, static_cast<uint32_t>(slot));
+        return inRegister(reg);
+    }
+
+    Operand parseCall(const string &name, const char *nameStart)
+    {
+        int index = functionIndex(name);
+        if (index < 0)
+        {
+            p = nameStart;
+            fail("Unknown function '" + name + "'");
+            return constant(0);
+        }
+        const Function &function = FUNCTIONS[index];
+
+        Operand args[2];
+        int count = 0;
+        skipSpace();
+        if (p < end && *p != ')')
+        {
+            while (error.empty())
+            {
+                Operand arg = parseBinary(1);
+                if (count < 2)
+                    args[count] = arg;
+                count++;
+                skipSpace();
+                if (p < end && *p == ',')
+                {
+                    p++;
+                    continue;
+                }
+                break;
+            }
+        }
+        if (p >= end || *p != ')')
+        {
+            fail("Missing ')' after arguments to " + name);
+            return constant(0);
+        }
+        p++;
+        if (count != function.arity)
+        {
+            fail(name + " takes " + to_string(function.arity) + " argument" + (function.arity == 1 ? "" : "s"));
+            return constant(0);
+        }
+
+        if (function.arity == 1)
+        {
+            if (folding && args[0].constant)
+                return constant(function.one(args[0].value));
+            materialize(args[0]);
+            emit(CALL1, args[0].reg, args[0].reg, 0, index);
+            return args[0];
+        }
+        if (folding && args[0].constant && args[1].constant)
+            return constant(function.two(args[0].value, args[1].value));
+        materialize(args[0]);
+        materialize(args[1]);
+        int dst = min(args[0].reg, args[1].reg);
+        emit(CALL2, dst, args[0].reg, args[1].reg, index);
+        top = dst + 1;
+        return inRegister(dst);
+    }
+};
+
+// ===== Scalar evaluation =====
+
+double execute(const Program &program, double *variables)
+{
+    double r[MAX_REGISTERS];
+    for (const Instruction &in : program.code)
+    {
+        switch (in.op)
+        {
+        case LOAD_CONST:
+            r[in.dst] = program.constants[in.index];
+            break;
+        case LOAD_VAR:
+            r[in.dst] = variables[in.index];
+            break;
+        case STORE_VAR:
+            variables[in.index] = r[in.a];
+            break;
+        case ADD:
+            r[in.dst] = r[in.a] + r[in.b];
+            break;
+        case SUB:
+            r[in.dst] = r[in.a] - r[in.b];
+            break;
+        case MUL:
+            r[in.dst] = r[in.a] * r[in.b];
+            break;
+        case DIV:
+            r[in.dst] = r[in.a] / r[in.b];
+            break;
+        case MOD:
+            r[in.dst] = fmod(r[in.a], r[in.b]);
+            break;
+        case POW:
+            r[in.dst] = pow(r[in.a], r[in.b]);
+            break;
+        case NEG:
+            r[in.dst] = -r[in.a];
+            break;
+        case CALL1:
+            r[in.dst] = FUNCTIONS[in.index].one(r[in.a]);
+            break;
+        case CALL2:
+            r[in.dst] = FUNCTIONS[in.index].two(r[in.a], r[in.b]);
+            break;
+        }
+    }
+    return r[0];
+}
+
+// ===== Columnar evaluation =====
+//
+// The same bytecode run a block of rows at a time: every register holds a
+// block, and each instruction is one kernel over it. Variables bound to a
+// column are read in place and constants are broadcast once per run.
+
+const size_t BLOCK_ROWS = 512;
+
+void binaryKernel(OpCode op, const double *a, const double *b, double *out, size_t n)
+{
+    size_t i = 0;
+    switch (op)
+    {
+    case ADD:
+#ifdef __SSE2__
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+#endif
+        for (; i < n; i++)
+            out[i] = a[i] + b[i];
+        break;
+    case SUB:
+#ifdef __SSE2__
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+#endif
+        for (; i < n; i++)
+            out[i] = a[i] - b[i];
+        break;
+    case MUL:
+#ifdef __SSE2__
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+#endif
+        for (; i < n; i++)
+            out[i] = a[i] * b[i];
+        break;
+    case DIV:
+#ifdef __SSE2__
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_div_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+#endif
+        for (; i < n; i++)
+            out[i] = a[i] / b[i];
+        break;
+    default:
+        for (; i < n; i++)
+            out[i] = applyBinary(op, a[i], b[i]);
+        break;
+    }
+}
+
+void unaryKernel(OpCode op, uint32_t function, const double *a, double *out, size_t n)
+{
+    size_t i = 0;
+    Kernel kernel = op == NEG ? Kernel::NONE : FUNCTIONS[function].kernel;
+#ifdef __SSE2__
+    const __m128d sign = _mm_set1_pd(-0.0);
+    if (op == NEG)
+    {
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_xor_pd(_mm_loadu_pd(a + i), sign));
+    }
+    else if (kernel == Kernel::SQRT)
+    {
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_sqrt_pd(_mm_loadu_pd(a + i)));
+    }
+    else if (kernel == Kernel::ABS)
+    {
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_andnot_pd(sign, _mm_loadu_pd(a + i)));
+    }
+#endif
+    if (op == NEG)
+    {
+        for (; i < n; i++)
+            out[i] = -a[i];
+        return;
+    }
+    double (*one)(double) = FUNCTIONS[function].one;
+    for (; i < n; i++)
+        out[i] = one(a[i]);
+}
+
+void callKernel(uint32_t function, const double *a, const double *b, double *out, size_t n)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    // Operands swapped so ties and NaNs pick the same side as std::min/max
+    if (FUNCTIONS[function].kernel == Kernel::MIN)
+    {
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_min_pd(_mm_loadu_pd(b + i), _mm_loadu_pd(a + i)));
+    }
+    else if (FUNCTIONS[function].kernel == Kernel::MAX)
+    {
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(out + i, _mm_max_pd(_mm_loadu_pd(b + i), _mm_loadu_pd(a + i)));
+    }
+#endif
+    double (*two)(double, double) = FUNCTIONS[function].two;
+    for (; i < n; i++)
+        out[i] = two(a[i], b[i]);
+}
+
+class ColumnEvaluator
+{
+public:
+    // columns[slot] is a column of rows values, or null to use env.values[slot]
+    void run(const Program &program, const vector<const double *> &columns, const Environment &env,
+             size_t rows, double *result)
+    {
+        scratch.assign(static_cast<size_t>(max(program.registers, 1)) * BLOCK_ROWS, 0);
+        broadcast.assign((program.constants.size() + env.values.size()) * BLOCK_ROWS, 0);
+        for (size_t c = 0; c < program.constants.size(); c++)
+            fill_n(broadcast.begin() + c * BLOCK_ROWS, BLOCK_ROWS, program.constants[c]);
+        size_t variableBase = program.constants.size();
+        for (size_t v = 0; v < env.values.size(); v++)
+            fill_n(broadcast.begin() + (variableBase + v) * BLOCK_ROWS, BLOCK_ROWS, env.values[v]);
+
+        const double *r[MAX_REGISTERS];
+        for (size_t start = 0; start < rows; start += BLOCK_ROWS)
+        {
+            size_t n = min(BLOCK_ROWS, rows - start);
+            for (const Instruction &in : program.code)
+            {
+                double *dst = scratch.data() + in.dst * BLOCK_ROWS;
+                switch (in.op)
+                {
+                case LOAD_CONST:
+                    r[in.dst] = broadcast.data() + in.index * BLOCK_ROWS;
+                    break;
+                case LOAD_VAR:
+                    if (in.index < columns.size() && columns[in.index])
+                        r[in.dst] = columns[in.index] + start;
+                    else
+                        r[in.dst] = broadcast.data() + (variableBase + in.index) * BLOCK_ROWS;
+                    break;
+                case STORE_VAR:
+                    break; // A column expression has no single value to store
+                case NEG:
+                case CALL1:
+                    unaryKernel(in.op, in.index, r[in.a], dst, n);
+                    r[in.dst] = dst;
+                    break;
+                case CALL2:
+                    callKernel(in.index, r[in.a], r[in.b], dst, n);
+                    r[in.dst] = dst;
+                    break;
+                default:
+                    binaryKernel(in.op, r[in.a], r[in.b], dst, n);
+                    r[in.dst] = dst;
+                    break;
+                }
+            }
+            memcpy(result + start, r[0], n * sizeof(double));
+        }
+    }
+
+private:
+    vector<double> scratch;
+    vector<double> broadcast;
+};
+
+// ===== Arbitrary precision =====
+//
+// BigInt is a sign and a little-endian vector of 32-bit limbs with no high
+// zero limbs, so zero is empty. Multiplication moves from schoolbook to
+// Karatsuba to Toom-3 as operands grow. Large divisions multiply by a Newton
+// reciprocal and decimal conversion splits on powers of 10^9 in both
+// directions, so big operations cost a few multiplications each.
+
+typedef uint32_t Limb;
+typedef vector<Limb> Limbs;
+
+// Crossovers in limbs, measured with --tune-bignum
+size_t karatsubaThreshold = 40;
+size_t toomThreshold = 512;
+size_t newtonThreshold = 1536;
+const size_t CONVERSION_BASE = 40;      // Limbs below which decimal conversion is quadratic
+const size_t CACHED_RECIPROCAL = 128;   // Limbs from which a reused reciprocal beats Knuth
+const size_t MAX_RESULT_BITS = 1 << 28; // About 80 million digits
+
+inline void trim(Limbs &x)
+{
+    while (!x.empty() && x.back() == 0)
+        x.pop_back();
+}
+
+int compareMagnitude(const Limb *a, size_t n, const Limb *b, size_t m)
+{
+    if (n != m)
+        return n < m ? -1 : 1;
+    for (size_t i = n; i-- > 0;)
+    {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// out[0..n) += b[0..m) for m <= n; returns the carry out of the top
+Limb addInto(Limb *out, size_t n, const Limb *b, size_t m)
+{
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < m; i++)
+    {
+        carry += static_cast<uint64_t>(out[i]) + b[i];
+        out[i] = static_cast<Limb>(carry);
+        carry >>= 32;
+    }
+    for (; carry && i < n; i++)
+    {
+        carry += out[i];
+        out[i] = static_cast<Limb>(carry);
+        carry >>= 32;
+    }
+    return static_cast<Limb>(carry);
+}
+
+// out[0..n) -= b[0..m) for m <= n; returns the borrow out of the top
+Limb subInto(Limb *out, size_t n, const Limb *b, size_t m)
+{
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i < m; i++)
+    {
+        uint64_t t = static_cast<uint64_t>(out[i]) - b[i] - borrow;
+        out[i] = static_cast<Limb>(t);
+        borrow = (t >> 32) & 1;
+    }
+    for (; borrow && i < n; i++)
+    {
+        uint64_t t = static_cast<uint64_t>(out[i]) - borrow;
+        out[i] = static_cast<Limb>(t);
+        borrow = (t >> 32) & 1;
+    }
+    return static_cast<Limb>(borrow);
+}
+
+// x = x * multiplier + addend
+void mulSmallAdd(Limbs &x, Limb multiplier, Limb addend)
+{
+    uint64_t carry = addend;
+    for (Limb &limb : x)
+    {
+        carry += static_cast<uint64_t>(limb) * multiplier;
+        limb = static_cast<Limb>(carry);
+        carry >>= 32;
+    }
+    if (carry)
+        x.push_back(static_cast<Limb>(carry));
+}
+
+// x /= divisor; returns the remainder
+Limb divmodSmall(Limbs &x, Limb divisor)
+{
+    uint64_t remainder = 0;
+    for (size_t i = x.size(); i-- > 0;)
+    {
+        remainder = (remainder << 32) | x[i];
+        x[i] = static_cast<Limb>(remainder / divisor);
+        remainder %= divisor;
+    }
+    trim(x);
+    return static_cast<Limb>(remainder);
+}
+
+void multiplyInto(const Limb *a, size_t n, const Limb *b, size_t m, Limb *out);
+
+class BigInt
+{
+public:
+    bool negative = false;
+    Limbs limbs;
+
+    BigInt() {}
+
+    BigInt(int64_t value)
+    {
+        negative = value < 0;
+        uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        for (; magnitude; magnitude >>= 32)
+            limbs.push_back(static_cast<Limb>(magnitude));
+    }
+
+    static BigInt fromMagnitude(Limbs limbs, bool negative = false)
+    {
+        BigInt x;
+        x.limbs = move(limbs);
+        trim(x.limbs);
+        x.negative = negative && !x.limbs.empty();
+        return x;
+    }
+
+    static BigInt powerOfTwo(size_t bits)
+    {
+        Limbs limbs(bits / 32 + 1, 0);
+        limbs.back() = Limb(1) << (bits % 32);
+        return fromMagnitude(move(limbs));
+    }
+
+    bool isZero() const
+    {
+        return limbs.empty();
+    }
+
+    bool isOne() const
+    {
+        return !negative && limbs.size() == 1 && limbs[0] == 1;
+    }
+
+    size_t bitLength() const
+    {
+        return limbs.empty() ? 0 : limbs.size() * 32 - __builtin_clz(limbs.back());
+    }
+
+    BigInt operator-() const
+    {
+        BigInt x = *this;
+        x.negative = !negative && !limbs.empty();
+        return x;
+    }
+};
+
+int compareMagnitude(const BigInt &a, const BigInt &b)
+{
+    return compareMagnitude(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size());
+}
+
+int compare(const BigInt &a, const BigInt &b)
+{
+    if (a.negative != b.negative)
+        return a.negative ? -1 : 1;
+    int magnitude = compareMagnitude(a, b);
+    return a.negative ? -magnitude : magnitude;
+}
+
+bool operator==(const BigInt &a, const BigInt &b)
+{
+    return a.negative == b.negative && a.limbs == b.limbs;
+}
+
+bool operator!=(const BigInt &a, const BigInt &b)
+{
+    return !(a == b);
+}
+
+BigInt addSigned(const BigInt &a, const BigInt &b, bool subtract)
+{
+    bool bNegative = b.negative != subtract && !b.isZero();
+    const BigInt *large = &a, *small = &b;
+    bool negative = a.negative;
+    bool sameSign = a.negative == bNegative;
+    if (!sameSign && compareMagnitude(a, b) < 0)
+    {
+        swap(large, small);
+        negative = bNegative;
+    }
+    else if (sameSign && a.limbs.size() < b.limbs.size())
+        swap(large, small);
+
+    Limbs out = large->limbs;
+    if (sameSign)
+    {
+        out.push_back(0);
+        addInto(out.data(), out.size(), small->limbs.data(), small->limbs.size());
+    }
+    else
+        subInto(out.data(), out.size(), small->limbs.data(), small->limbs.size());
+    return BigInt::fromMagnitude(move(out), negative);
+}
+
+BigInt operator+(const BigInt &a, const BigInt &b)
+{
+    return addSigned(a, b, false);
+}
+
+BigInt operator-(const BigInt &a, const BigInt &b)
+{
+    return addSigned(a, b, true);
+}
+
+BigInt operator*(const BigInt &a, const BigInt &b)
+{
+    if (a.isZero() || b.isZero())
+        return BigInt();
+    Limbs out(a.limbs.size() + b.limbs.size());
+    multiplyInto(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size(), out.data());
+    return BigInt::fromMagnitude(move(out), a.negative != b.negative);
+}
+
+BigInt operator<<(const BigInt &x, size_t bits)
+{
+    if (x.isZero())
+        return x;
+    size_t limbShift = bits / 32, bitShift = bits % 32;
+    Limbs out(x.limbs.size() + limbShift + 1, 0);
+    for (size_t i = 0; i < x.limbs.size(); i++)
+    {
+        uint64_t v = static_cast<uint64_t>(x.limbs[i]) << bitShift;
+        out[i + limbShift] |= static_cast<Limb>(v);
+        out[i + limbShift + 1] |= static_cast<Limb>(v >> 32);
+    }
+    return BigInt::fromMagnitude(move(out), x.negative);
+}
+
+// Shifts the magnitude, so negative values round toward zero
+BigInt operator>>(const BigInt &x, size_t bits)
+{
+    size_t limbShift = bits / 32, bitShift = bits % 32;
+    if (limbShift >= x.limbs.size())
+        return BigInt();
+    size_t n = x.limbs.size() - limbShift;
+    Limbs out(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t v = x.limbs[i + limbShift];
+        if (i + 1 < n)
+            v |= static_cast<uint64_t>(x.limbs[i + limbShift + 1]) << 32;
+        out[i] = static_cast<Limb>(v >> bitShift);
+    }
+    return BigInt::fromMagnitude(move(out), x.negative);
+}
+
+// ----- Multiplication -----
+
+void multiplySchoolbook(const Limb *a, size_t n, const Limb *b, size_t m, Limb *out)
+{
+    fill(out, out + n + m, 0);
+    for (size_t j = 0; j < m; j++)
+    {
+        uint64_t carry = 0, multiplier = b[j];
+        if (multiplier == 0)
+            continue;
+        for (size_t i = 0; i < n; i++)
+        {
+            carry += a[i] * multiplier + out[i + j];
+            out[i + j] = static_cast<Limb>(carry);
+            carry >>= 32;
+        }
+        out[j + n] = static_cast<Limb>(carry);
+    }
+}
+
+// a = a1*B^h + a0, b = b1*B^h + b0, and the middle product comes from
+// (a0 + a1)(b0 + b1) - a0*b0 - a1*b1: three half-size products, not four
+void multiplyKaratsuba(const Limb *a, size_t n, const Limb *b, size_t m, Limb *out)
+{
+    size_t h = (n + 1) / 2; // n >= m > h
+    multiplyInto(a, h, b, h, out);
+    multiplyInto(a + h, n - h, b + h, m - h, out + 2 * h);
+
+    Limbs sumA(a, a + h), sumB(b, b + h);
+    sumA.push_back(addInto(sumA.data(), h, a + h, n - h));
+    sumB.push_back(addInto(sumB.data(), h, b + h, m - h));
+    Limbs middle(2 * h + 2);
+    multiplyInto(sumA.data(), sumA.size(), sumB.data(), sumB.size(), middle.data());
+    subInto(middle.data(), middle.size(), out, 2 * h);
+    subInto(middle.data(), middle.size(), out + 2 * h, n + m - 2 * h);
+    trim(middle);
+    addInto(out + h, n + m - h, middle.data(), middle.size());
+}
+
+BigInt divideExactly3(const BigInt &x)
+{
+    Limbs magnitude = x.limbs;
+    divmodSmall(magnitude, 3);
+    return BigInt::fromMagnitude(move(magnitude), x.negative);
+}
+
+// Split into thirds, evaluate at 0, 1, -1, -2 and infinity, multiply the
+// five pairs and interpolate back (Bodrato's sequence): five products of a
+// third the size instead of nine
+void multiplyToom3(const Limb *a, size_t n, const Limb *b, size_t m, Limb *out)
+{
+    size_t k = (n + 2) / 3; // m > 2k, so every third of b is non-empty
+    auto part = [k](const Limb *x, size_t length, size_t i) {
+        size_t start = min(length, i * k), stop = min(length, start + k);
+        return BigInt::fromMagnitude(Limbs(x + start, x + stop));
+    };
+    BigInt a0 = part(a, n, 0), a1 = part(a, n, 1), a2 = part(a, n, 2);
+    BigInt b0 = part(b, m, 0), b1 = part(b, m, 1), b2 = part(b, m, 2);
+
+    BigInt evenA = a0 + a2, evenB = b0 + b2;
+    BigInt aAt1 = evenA + a1, aAtMinus1 = evenA - a1, aAtMinus2 = ((aAtMinus1 + a2) << 1) - a0;
+    BigInt bAt1 = evenB + b1, bAtMinus1 = evenB - b1, bAtMinus2 = ((bAtMinus1 + b2) << 1) - b0;
+
+    BigInt r0 = a0 * b0, r1 = aAt1 * bAt1, rMinus1 = aAtMinus1 * bAtMinus1;
+    BigInt rMinus2 = aAtMinus2 * bAtMinus2, rInfinity = a2 * b2;
+
+    BigInt c3 = divideExactly3(rMinus2 - r1);
+    BigInt c1 = (r1 - rMinus1) >> 1;
+    BigInt c2 = rMinus1 - r0;
+    c3 = ((c2 - c3) >> 1) + (rInfinity << 1);
+    c2 = c2 + c1 - rInfinity;
+    c1 = c1 - c3;
+
+    fill(out, out + n + m, 0);
+    const BigInt *coefficients[] = {&r0, &c1, &c2, &c3, &rInfinity};
+    for (size_t i = 0; i < 5; i++)
+    {
+        const Limbs &c = coefficients[i]->limbs;
+        addInto(out + i * k, n + m - i * k, c.data(), c.size());
+    }
+}
+
+// out[0..n+m) = a * b
+void multiplyInto(const Limb *a, size_t n, const Limb *b, size_t m, Limb *out)
+{
+    if (n < m)
+    {
+        swap(a, b);
+        swap(n, m);
+    }
+    if (m < karatsubaThreshold)
+    {
+        multiplySchoolbook(a, n, b, m, out);
+        return;
+    }
+    if (2 * m <= n + 1)
+    {
+        // Unbalanced: multiply b by m-limb slices of a
+        fill(out, out + n + m, 0);
+        Limbs piece(2 * m);
+        for (size_t i = 0; i < n; i += m)
+        {
+            size_t length = min(m, n - i);
+            multiplyInto(a + i, length, b, m, piece.data());
+            addInto(out + i, n + m - i, piece.data(), length + m);
+        }
+        return;
+    }
+    if (m >= toomThreshold && m > 2 * ((n + 2) / 3))
+        multiplyToom3(a, n, b, m, out);
+    else
+        multiplyKaratsuba(a, n, b, m, out);
+}
+
+BigInt power(BigInt base, uint64_t exponent)
+{
+    BigInt result(1);
+    for (; exponent; exponent >>= 1)
+    {
+        if (exponent & 1)
+            result = result * base;
+        if (exponent > 1)
+            base = base * base;
+    }
+    return result;
+}
+
+// ----- Division -----
+
+// Knuth's algorithm D for u >= v with at least two limbs in v
+void divmodKnuth(const Limbs &u, const Limbs &v, Limbs &q, Limbs &r)
+{
+    size_t n = v.size(), m = u.size() - n;
+    int s = __builtin_clz(v.back());
+    Limbs vn(n), un(u.size() + 1);
+    for (size_t i = n - 1; i > 0; i--)
+        vn[i] = static_cast<Limb>((static_cast<uint64_t>(v[i]) << s) | (static_cast<uint64_t>(v[i - 1]) >> (32 - s)));
+    vn[0] = v[0] << s;
+    un[u.size()] = static_cast<Limb>(static_cast<uint64_t>(u.back()) >> (32 - s));
+    for (size_t i = u.size() - 1; i > 0; i--)
+        un[i] = static_cast<Limb>((static_cast<uint64_t>(u[i]) << s) | (static_cast<uint64_t>(u[i - 1]) >> (32 - s)));
+    un[0] = u[0] << s;
+
+    q.assign(m + 1, 0);
+    uint64_t top = vn[n - 1], next = vn[n - 2];
+    for (size_t j = m + 1; j-- > 0;)
+    {
+        uint64_t numerator = (static_cast<uint64_t>(un[j + n]) << 32) | un[j + n - 1];
+        uint64_t estimate = numerator / top, remainder = numerator % top;
+        while ((estimate >> 32) || estimate * next > ((remainder << 32) | un[j + n - 2]))
+        {
+            estimate--;
+            remainder += top;
+            if (remainder >> 32)
+                break;
+        }
+
+        int64_t borrow = 0, t;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t product = estimate * vn[i];
+            t = static_cast<int64_t>(un[i + j]) - borrow - static_cast<int64_t>(product & 0xFFFFFFFF);
+            un[i + j] = static_cast<Limb>(t);
+            borrow = static_cast<int64_t>(product >> 32) - (t >> 32);
+        }
+        t = static_cast<int64_t>(un[j + n]) - borrow;
+        un[j + n] = static_cast<Limb>(t);
+        q[j] = static_cast<Limb>(estimate);
+        if (t < 0)
+        {
+            // The estimate was one too large; add the divisor back
+            q[j]--;
+            uint64_t carry = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                carry += static_cast<uint64_t>(un[i + j]) + vn[i];
+                un[i + j] = static_cast<Limb>(carry);
+                carry >>= 32;
+            }
+            un[j + n] += static_cast<Limb>(carry);
+        }
+    }
+    trim(q);
+    r.resize(n);
+    for (size_t i = 0; i < n; i++)
+        r[i] = static_cast<Limb>((un[i] >> s) | (static_cast<uint64_t>(un[i + 1]) << (32 - s)));
+    trim(r);
+}
+
+// a and b non-negative, a >= b > 0
+void divmodSchoolbook(const BigInt &a, const BigInt &b, BigInt &q, BigInt &r)
+{
+    if (b.limbs.size() == 1)
+    {
+        Limbs quotient = a.limbs;
+        Limb remainder = divmodSmall(quotient, b.limbs[0]);
+        q = BigInt::fromMagnitude(move(quotient));
+        r = BigInt(remainder);
+        return;
+    }
+    Limbs quotient, remainder;
+    divmodKnuth(a.limbs, b.limbs, quotient, remainder);
+    q = BigInt::fromMagnitude(move(quotient));
+    r = BigInt::fromMagnitude(move(remainder));
+}
+
+// floor(2^k / d) for d > 0, give or take a few units. A reciprocal of half
+// the precision from the top bits of d is refined by one Newton step,
+// x + x(2^k - dx) / 2^k, which doubles the correct bits. Callers correct the
+// quotient against a remainder anyway, so the last units are left to them.
+BigInt reciprocal(const BigInt &d, size_t k)
+{
+    size_t n = d.bitLength();
+    if (k < n)
+        return BigInt();
+    size_t bits = k - n + 1; // Bits in the result
+    if (bits < 32 * newtonThreshold || n < 32 * newtonThreshold)
+    {
+        BigInt q, r;
+        divmodSchoolbook(BigInt::powerOfTwo(k), d, q, r);
+        return q;
+    }
+
+    size_t half = bits / 2 + 32;
+    size_t kept = min(n, half + 32);
+    size_t k1 = kept + half;
+    BigInt rough = reciprocal(d >> (n - kept), k1);
+    size_t s = k - k1 - (n - kept);
+
+    BigInt error = BigInt::powerOfTwo(k) - ((d * rough) << s);
+    size_t dropped = n > 32 ? n - 32 : 0; // Low bits of the error that cannot reach the result
+    return (rough << s) + ((rough * (error >> dropped)) >> (k - s - dropped));
+}
+
+// a / d for 0 <= a < 2^k, given inverse close to floor(2^k / d). Only the
+// top bits of a can change the quotient, which lands within a few units.
+void divideWithReciprocal(const BigInt &a, const BigInt &d, const BigInt &inverse, size_t k, BigInt &q, BigInt &r)
+{
+    size_t n = d.bitLength();
+    size_t dropped = n > 64 ? n - 64 : 0;
+    q = ((a >> dropped) * inverse) >> (k - dropped);
+    r = a - q * d;
+    while (r.negative)
+    {
+        q = q - 1;
+        r = r + d;
+    }
+    while (compareMagnitude(r, d) >= 0)
+    {
+        q = q + 1;
+        r = r - d;
+    }
+}
+
+// Truncating division: q rounds toward zero and r takes the sign of a
+void divmod(const BigInt &a, const BigInt &b, BigInt &q, BigInt &r)
+{
+    if (compareMagnitude(a, b) < 0)
+    {
+        q = BigInt();
+        r = a;
+        return;
+    }
+    BigInt u = a, v = b;
+    u.negative = v.negative = false;
+    size_t quotientLimbs = u.limbs.size() - v.limbs.size() + 1;
+    if (v.limbs.size() < newtonThreshold || quotientLimbs < newtonThreshold)
+        divmodSchoolbook(u, v, q, r);
+    else
+    {
+        size_t k = u.bitLength();
+        divideWithReciprocal(u, v, reciprocal(v, k), k, q, r);
+    }
+    q.negative = a.negative != b.negative && !q.isZero();
+    r.negative = a.negative && !r.isZero();
+}
+
+BigInt operator/(const BigInt &a, const BigInt &b)
+{
+    BigInt q, r;
+    divmod(a, b, q, r);
+    return q;
+}
+
+BigInt operator%(const BigInt &a, const BigInt &b)
+{
+    BigInt q, r;
+    divmod(a, b, q, r);
+    return r;
+}
+
+BigInt gcd(BigInt a, BigInt b)
+{
+    a.negative = b.negative = false;
+    while (!b.isZero())
+    {
+        if (a.limbs.size() <= 2 && b.limbs.size() <= 2)
+        {
+            auto value = [](const BigInt &x) {
+                return x.limbs.empty() ? 0 : x.limbs[0] | (x.limbs.size() > 1 ? static_cast<uint64_t>(x.limbs[1]) << 32 : 0);
+            };
+            uint64_t x = value(a), y = value(b);
+            while (y)
+            {
+                uint64_t t = x % y;
+                x = y;
+                y = t;
+            }
+            return BigInt::fromMagnitude({static_cast<Limb>(x), static_cast<Limb>(x >> 32)});
+        }
+        BigInt q, r;
+        divmod(a, b, q, r);
+        a = move(b);
+        b = move(r);
+    }
+    return a;
+}
+
+double toDouble(const BigInt &x, size_t &shift)
+{
+    shift = x.bitLength() > 64 ? x.bitLength() - 64 : 0;
+    BigInt top = x >> shift;
+    double value = 0;
+    for (size_t i = top.limbs.size(); i-- > 0;)
+        value = value * 4294967296.0 + top.limbs[i];
+    return x.negative ? -value : value;
+}
+
+// floor(sqrt(n)). The root of the top half of n gives half the bits, one
+// Newton step doubles them, and a final correction makes the result exact.
+BigInt isqrt(const BigInt &n)
+{
+    if (n.bitLength() <= 52)
+    {
+        size_t shift;
+        int64_t root = static_cast<int64_t>(sqrt(toDouble(n, shift)));
+        BigInt x(root);
+        while (compare(x * x, n) > 0)
+            x = x - 1;
+        while (compare((x + 1) * (x + 1), n) <= 0)
+            x = x + 1;
+        return x;
+    }
+    size_t k = n.bitLength() / 4;
+    BigInt x = isqrt(n >> (2 * k)) << k;
+    x = (x + n / x) >> 1;
+    while (compare(x * x, n) > 0)
+        x = x - 1;
+    while (compare((x + 1) * (x + 1), n) <= 0)
+        x = x + 1;
+    return x;
+}
+
+// lo * (lo + 1) * ... * hi as a balanced product tree
+BigInt productRange(uint64_t lo, uint64_t hi)
+{
+    if (hi - lo < 16)
+    {
+        Limbs x{1};
+        for (uint64_t v = lo; v <= hi; v++)
+            mulSmallAdd(x, static_cast<Limb>(v), 0);
+        return BigInt::fromMagnitude(move(x));
+    }
+    uint64_t mid = lo + (hi - lo) / 2;
+    return productRange(lo, mid) * productRange(mid + 1, hi);
+}
+
+// ----- Decimal conversion -----
+
+// 10^(9 * 2^level), with reciprocals for dividing numbers below its square
+class DecimalPowers
+{
+public:
+    const BigInt &power(size_t level)
+    {
+        if (powers.empty())
+            powers.push_back(BigInt(1000000000));
+        while (powers.size() <= level)
+            powers.push_back(powers.back() * powers.back());
+        return powers[level];
+    }
+
+    void divide(const BigInt &x, size_t level, BigInt &q, BigInt &r)
+    {
+        const BigInt &divisor = power(level);
+        if (divisor.limbs.size() < CACHED_RECIPROCAL)
+        {
+            divmod(x, divisor, q, r);
+            return;
+        }
+        if (inverses.size() <= level)
+            inverses.resize(level + 1);
+        size_t k = 2 * divisor.bitLength();
+        if (inverses[level].isZero())
+            inverses[level] = reciprocal(divisor, k);
+        divideWithReciprocal(x, divisor, inverses[level], k, q, r);
+    }
+
+private:
+    vector<BigInt> powers;
+    vector<BigInt> inverses;
+};
+
+DecimalPowers decimalPowers;
+
+// Repeated division by 10^9, quadratic but fast on small numbers
+string smallToString(Limbs rest)
+{
+    vector<Limb> chunks;
+    while (!rest.empty())
+        chunks.push_back(divmodSmall(rest, 1000000000));
+    string text;
+    char buffer[16];
+    for (size_t i = chunks.size(); i-- > 0;)
+    {
+        snprintf(buffer, sizeof(buffer), i + 1 == chunks.size() ? "%u" : "%09u", chunks[i]);
+        text += buffer;
+    }
+    return text;
+}
+
+// Appends x >= 0, zero padded to width digits when width is not 0
+void writeDigits(const BigInt &x, size_t width, string &out)
+{
+    if (x.limbs.size() <= CONVERSION_BASE)
+    {
+        string text = smallToString(x.limbs);
+        if (width > text.size())
+            out.append(width - text.size(), '0');
+        else if (text.empty())
+            text = "0";
+        out += text;
+        return;
+    }
+    // Split at a power p with p <= x < p^2, so both halves are below p
+    size_t level = 0;
+    while (2 * (decimalPowers.power(level).bitLength() - 1) < x.bitLength())
+        level++;
+    while (level > 0 && compareMagnitude(x, decimalPowers.power(level)) < 0)
+        level--;
+    BigInt q, r;
+    decimalPowers.divide(x, level, q, r);
+    size_t low = size_t(9) << level;
+    writeDigits(q, width > low ? width - low : 0, out);
+    writeDigits(r, low, out);
+}
+
+string toString(const BigInt &x)
+{
+    if (x.isZero())
+        return "0";
+    string out = x.negative ? "-" : "";
+    out.reserve(x.limbs.size() * 10 + 1);
+    if (!x.negative)
+    {
+        writeDigits(x, 0, out);
+        return out;
+    }
+    BigInt magnitude = x; // The cached-reciprocal split assumes x >= 0
+    magnitude.negative = false;
+    writeDigits(magnitude, 0, out);
+    return out;
+}
+
+// A run of decimal digits, split so the low half is 9 * 2^level digits
+BigInt parseDigits(const char *digits, size_t length)
+{
+    if (length <= 9 * CONVERSION_BASE)
+    {
+        Limbs x;
+        size_t chunk = length % 9 == 0 ? 9 : length % 9;
+        for (size_t i = 0; i < length; i += chunk, chunk = 9)
+        {
+            Limb value = 0;
+            for (size_t j = i; j < i + chunk; j++)
+                value = value * 10 + (digits[j] - '0');
+            mulSmallAdd(x, 1000000000, value);
+        }
+        return BigInt::fromMagnitude(move(x));
+    }
+    size_t level = 0;
+    while ((size_t(9) << (level + 1)) < length)
+        level++;
+    size_t low = size_t(9) << level;
+    return parseDigits(digits, length - low) * decimalPowers.power(level) + parseDigits(digits + length - low, low);
+}
+
+// ===== Exact evaluation =====
+//
+// The integer, rational and decimal modes run the same bytecode with
+// BigInt registers. Every register is a fraction: integers keep a
+// denominator of 1, rationals are kept in lowest terms, and decimals are
+// fixed point with the denominator 10^digits. Only rational mode pays for
+// gcd; a gcd of two huge numbers costs far more than the arithmetic.
+
+enum class NumberMode
+{
+    FLOAT,
+    INTEGER,
+    RATIONAL,
+    DECIMAL
+};
+
+struct Rational
+{
+    BigInt num;
+    BigInt den = BigInt(1);
+};
+
+double toDouble(const Rational &value)
+{
+    size_t numShift, denShift;
+    double num = toDouble(value.num, numShift), den = toDouble(value.den, denShift);
+    return ldexp(num / den, static_cast<int>(numShift) - static_cast<int>(denShift));
+}
+
+// n / d rounded half away from zero, d > 0
+BigInt roundedDivide(const BigInt &n, const BigInt &d)
+{
+    BigInt q, r;
+    divmod(n, d, q, r);
+    r.negative = false;
+    if (compareMagnitude(r << 1, d) >= 0)
+        q = n.negative ? q - 1 : q + 1;
+    return q;
+}
+
+class ExactMachine
+{
+public:
+    NumberMode mode = NumberMode::FLOAT;
+    string error;
+
+    ExactMachine()
+    {
+        setDigits(50);
+    }
+
+    size_t digits() const
+    {
+        return decimalDigits;
+    }
+
+    void setDigits(size_t count)
+    {
+        decimalDigits = count;
+        scale = power(BigInt(10), count);
+    }
+
+    // A float evaluation changed the variable; reread its double next time
+    void invalidate(uint32_t slot)
+    {
+        if (slot < current.size())
+            current[slot] = false;
+    }
+
+    // Runs an exact program and stores the result as ans (slot 0)
+    bool run(const Program &program, Environment &env, Rational &result)
+    {
+        error.clear();
+        variables.resize(env.values.size());
+        current.resize(env.values.size(), false);
+        vector<Rational> r(max(program.registers, 1));
+
+        for (const Instruction &in : program.code)
+        {
+            Rational value;
+            switch (in.op)
+            {
+            case LOAD_CONST:
+            {
+                const auto &span = program.literals[in.index];
+                string text = program.source.substr(span.first, span.second);
+                if (!parseLiteral(text, value))
+                    return fail("Cannot read " + text + " exactly");
+                if (!toMode(value, r[in.dst], text))
+                    return false;
+                continue;
+            }
+            case LOAD_VAR:
+                if (!load(in.index, env, r[in.dst]))
+                    return false;
+                continue;
+            case STORE_VAR:
+                store(in.index, r[in.a], env);
+                continue;
+            case ADD:
+            case SUB:
+                value = add(r[in.a], r[in.b], in.op == SUB);
+                break;
+            case MUL:
+                if (!multiply(r[in.a], r[in.b], value))
+                    return false;
+                break;
+            case DIV:
+            case MOD:
+                if (!divide(r[in.a], r[in.b], in.op == MOD, value))
+                    return false;
+                break;
+            case POW:
+                if (!raise(r[in.a], r[in.b], value))
+                    return false;
+                break;
+            case NEG:
+                value = r[in.a];
+                value.num = -value.num;
+                break;
+            case CALL1:
+            case CALL2:
+                if (!call(FUNCTIONS[in.index].name, r[in.a], r[in.b], value))
+                    return false;
+                break;
+            }
+            r[in.dst] = move(value);
+        }
+        result = r[0];
+        store(0, result, env);
+        return true;
+    }
+
+    string format(const Rational &value) const
+    {
+        if (mode == NumberMode::DECIMAL)
+        {
+            BigInt magnitude = value.num;
+            magnitude.negative = false;
+            string text = toString(magnitude);
+            if (text.size() <= decimalDigits)
+                text.insert(0, decimalDigits + 1 - text.size(), '0');
+            text.insert(text.size() - decimalDigits, ".");
+            while (text.back() == '0')
+                text.pop_back();
+            if (text.back() == '.')
+                text.pop_back();
+            return (value.num.negative ? "-" : "") + text;
+        }
+        string text = toString(value.num);
+        if (!value.den.isOne())
+            text += "/" + toString(value.den);
+        return text;
+    }
+
+private:
+    size_t decimalDigits = 0;
+    BigInt scale;
+    vector<Rational> variables; // True values in lowest terms
+    vector<bool> current;
+
+    bool fail(const string &message)
+    {
+        error = message;
+        return false;
+    }
+
+    static Rational reduce(BigInt num, BigInt den)
+    {
+        if (den.negative)
+        {
+            num = -num;
+            den = -den;
+        }
+        if (!den.isOne())
+        {
+            BigInt g = gcd(num, den);
+            if (!g.isOne() && !g.isZero())
+            {
+                num = num / g;
+                den = den / g;
+            }
+        }
+        return {move(num), move(den)};
+    }
+
+    static Rational invert(const Rational &value)
+    {
+        Rational inverse{value.den, value.num};
+        inverse.num.negative = value.num.negative;
+        inverse.den.negative = false;
+        return inverse;
+    }
+
+    // Converts any fraction with a positive denominator into this mode's form
+    bool toMode(const Rational &value, Rational &out, const string &what)
+    {
+        switch (mode)
+        {
+        case NumberMode::INTEGER:
+        {
+            if (value.den.isOne())
+            {
+                out = value;
+                return true;
+            }
+            BigInt q, r;
+            divmod(value.num, value.den, q, r);
+            if (!r.isZero())
+                return fail(what + " is not an integer");
+            out = {q, BigInt(1)};
+            return true;
+        }
+        case NumberMode::DECIMAL:
+            if (value.den == scale)
+                out = value;
+            else
+                out = {roundedDivide(value.num * scale, value.den), scale};
+            return true;
+        default:
+            out = reduce(value.num, value.den);
+            return true;
+        }
+    }
+
+    static bool parseLiteral(const string &text, Rational &value)
+    {
+        string digits;
+        size_t i = 0, fraction = 0;
+        for (; i < text.size() && isdigit(static_cast<unsigned char>(text[i])); i++)
+            digits += text[i];
+        if (i < text.size() && text[i] == '.')
+        {
+            for (i++; i < text.size() && isdigit(static_cast<unsigned char>(text[i])); i++, fraction++)
+                digits += text[i];
+        }
+        long exponent = 0;
+        if (i < text.size() && (text[i] == 'e' || text[i] == 'E'))
+        {
+            char *stop;
+            exponent = strtol(text.c_str() + i + 1, &stop, 10);
+            if (stop == text.c_str() + i + 1 || labs(exponent) > 10000000)
+                return false;
+            i = stop - text.c_str();
+        }
+        if (i != text.size())
+            return false;
+        BigInt mantissa = parseDigits(digits.data(), digits.size());
+        long shift = exponent - static_cast<long>(fraction);
+        if (shift >= 0)
+            value = {mantissa * power(BigInt(10), shift), BigInt(1)};
+        else
+            value = {mantissa, power(BigInt(10), -shift)};
+        return true;
+    }
+
+    static bool fromDouble(double number, Rational &value)
+    {
+        if (!isfinite(number))
+            return false;
+        int exponent;
+        double mantissa = frexp(number, &exponent);
+        BigInt num(static_cast<int64_t>(ldexp(mantissa, 53)));
+        exponent -= 53;
+        if (exponent >= 0)
+            value = {num << exponent, BigInt(1)};
+        else
+            value = reduce(num, BigInt(1) << -exponent);
+        return true;
+    }
+
+    bool load(uint32_t slot, Environment &env, Rational &out)
+    {
+        if (!current[slot])
+        {
+            if (!fromDouble(env.values[slot], variables[slot]))
+                return fail(env.names[slot] + " is not a finite number");
+            current[slot] = true;
+        }
+        return toMode(variables[slot], out, env.names[slot]);
+    }
+
+    void store(uint32_t slot, const Rational &value, Environment &env)
+    {
+        variables[slot] = value;
+        current[slot] = true;
+        env.values[slot] = toDouble(variables[slot]);
+    }
+
+    Rational add(const Rational &a, const Rational &b, bool subtract) const
+    {
+        if (mode != NumberMode::RATIONAL || (a.den.isOne() && b.den.isOne()))
+            return {subtract ? a.num - b.num : a.num + b.num, a.den};
+        BigInt left = a.num * b.den, right = b.num * a.den;
+        return reduce(subtract ? left - right : left + right, a.den * b.den);
+    }
+
+    bool checkSize(size_t bits)
+    {
+        return bits <= MAX_RESULT_BITS || fail("Result too large");
+    }
+
+    bool multiply(const Rational &a, const Rational &b, Rational &out)
+    {
+        if (!checkSize(a.num.bitLength() + b.num.bitLength()))
+            return false;
+        switch (mode)
+        {
+        case NumberMode::INTEGER:
+            out = {a.num * b.num, BigInt(1)};
+            break;
+        case NumberMode::DECIMAL:
+            out = {roundedDivide(a.num * b.num, scale), scale};
+            break;
+        default:
+            out = reduce(a.num * b.num, a.den * b.den);
+            break;
+        }
+        return true;
+    }
+
+    bool divide(const Rational &a, const Rational &b, bool remainder, Rational &out)
+    {
+        if (b.num.isZero())
+            return fail("Division by zero");
+        switch (mode)
+        {
+        case NumberMode::INTEGER:
+            out = {remainder ? a.num % b.num : a.num / b.num, BigInt(1)};
+            break;
+        case NumberMode::DECIMAL:
+            if (remainder)
+                out = {a.num % b.num, scale};
+            else
+                out = {roundedDivide(a.num * scale, b.num), scale};
+            break;
+        default:
+        {
+            BigInt num = a.num * b.den, den = a.den * b.num;
+            if (!remainder)
+            {
+                out = reduce(num, den);
+                break;
+            }
+            // a - b * trunc(a / b)
+            BigInt q = num / den;
+            out = reduce(a.num * b.den - q * b.num * a.den, a.den * b.den);
+            break;
+        }
+        }
+        return true;
+    }
+
+    bool integerValue(const Rational &value, int64_t &out, const char *what)
+    {
+        BigInt q, r;
+        divmod(value.num, value.den, q, r);
+        Rational exact{q, BigInt(1)};
+        if (!r.isZero() || exact.num.bitLength() > 62)
+            return fail(string(what) + " must be an integer below 2^62");
+        out = 0;
+        for (size_t i = exact.num.limbs.size(); i-- > 0;)
+            out = (out << 32) | exact.num.limbs[i];
+        if (exact.num.negative)
+            out = -out;
+        return true;
+    }
+
+    bool raise(const Rational &base, const Rational &exponent, Rational &out)
+    {
+        int64_t e;
+        if (!integerValue(exponent, e, "The exponent"))
+            return false;
+        Rational exact = base;
+        if (e < 0)
+        {
+            if (exact.num.isZero())
+                return fail("Division by zero");
+            exact = invert(exact);
+            e = -e;
+        }
+        size_t bits = max(exact.num.bitLength(), exact.den.bitLength());
+        if (bits > 1 && !checkSize(static_cast<double>(bits) * e < MAX_RESULT_BITS ? bits * e : SIZE_MAX))
+            return false;
+        Rational result{power(exact.num, e), power(exact.den, e)};
+        if (mode == NumberMode::RATIONAL)
+        {
+            out = move(result); // Powers of a fraction in lowest terms stay in lowest terms
+            return true;
+        }
+        return toMode(result, out, "The power");
+    }
+
+    bool call(const char *name, const Rational &a, const Rational &b, Rational &out)
+    {
+        string function = name;
+        if (function == "abs")
+        {
+            out = a;
+            out.num.negative = false;
+            return true;
+        }
+        if (function == "min" || function == "max")
+        {
+            int order = compare(a.num * b.den, b.num * a.den);
+            out = (order <= 0) == (function == "min") ? a : b;
+            return true;
+        }
+        if (function == "pow")
+            return raise(a, b, out);
+
+        const Rational &exact = a;
+        if (function == "floor" || function == "ceil" || function == "round")
+        {
+            BigInt q, r;
+            divmod(exact.num, exact.den, q, r);
+            if (function == "floor" && r.negative)
+                q = q - 1;
+            else if (function == "ceil" && !r.isZero() && !r.negative)
+                q = q + 1;
+            else if (function == "round")
+                q = roundedDivide(exact.num, exact.den);
+            return toMode({q, BigInt(1)}, out, function);
+        }
+        if (function == "sqrt")
+        {
+            if (exact.num.negative)
+                return fail("sqrt of a negative number");
+            if (mode == NumberMode::DECIMAL)
+            {
+                out = {isqrt(a.num * scale), scale};
+                return true;
+            }
+            BigInt top = isqrt(exact.num), bottom = isqrt(exact.den);
+            if (mode == NumberMode::RATIONAL && (top * top != exact.num || bottom * bottom != exact.den))
+                return fail("sqrt is irrational here; use mode decimal");
+            out = {top, mode == NumberMode::INTEGER ? BigInt(1) : bottom};
+            return true;
+        }
+        if (function == "fact")
+        {
+            int64_t n;
+            if (!integerValue(a, n, "fact's argument"))
+                return false;
+            if (n < 0 || n > 10000000)
+                return fail("fact needs 0 <= n <= 10000000");
+            return toMode({n < 2 ? BigInt(1) : productRange(2, n), BigInt(1)}, out, "fact");
+        }
+        return fail(function + " has no exact form; use mode float");
+    }
+};
+
+// ===== Batch modes =====
+
+string formatNumber(double value)
+{
+    if (isnan(value))
+        return "nan"; // Its sign bit means nothing, so don't print "-nan"
+    char text[32];
+    snprintf(text, sizeof(text), "%.15g", value);
+    return text;
 }
 
-double calculate(double a, double b, char op)
+bool readFile(const string &path, string &contents)
 {
-    switch (op)
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+    ostringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+// One expression per line; blank lines and '#' comments are skipped.
+// Assignments carry over to later lines.
+int runBatch(const string &path, const string &outputPath)
+{
+    string text;
+    if (!readFile(path, text))
     {
-    case '+':
-        return a + b;
-    case '-':
-        return a - b;
-    case '*':
-        return a * b;
-    case '/':
-        return b != 0 ? a / b : 0;
+        cerr << "Cannot read " << path << endl;
+        return 1;
+    }
+    ofstream output;
+    if (!outputPath.empty())
+    {
+        output.open(outputPath);
+        if (!output)
+        {
+            cerr << "Cannot write " << outputPath << endl;
+            return 1;
+        }
+    }
+
+    Environment env;
+    env.define("ans", 0);
+    Compiler compiler;
+    Program program;
+    size_t lines = 0, evaluated = 0, errors = 0, nonFinite = 0;
+    double checksum = 0;
+    string results;
+
+    auto start = chrono::steady_clock::now();
+    const char *p = text.data(), *end = p + text.size();
+    while (p < end)
+    {
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+        lines++;
+        const char *first = p;
+        while (first < lineEnd && (*first == ' ' || *first == '\t' || *first == '\r'))
+            first++;
+        if (first < lineEnd && *first != '#')
+        {
+            if (compiler.compile(p, lineEnd - p, env, program))
+            {
+                double value = execute(program, env.values.data());
+                env.values[0] = value;
+                if (isfinite(value))
+                    checksum += value;
+                else
+                    nonFinite++;
+                evaluated++;
+                if (output.is_open())
+                {
+                    results += formatNumber(value);
+                    results += '\n';
+                }
+            }
+            else
+            {
+                if (++errors <= 5)
+                    cerr << path << ":" << lines << ":" << compiler.errorPosition + 1 << ": " << compiler.error << endl;
+                if (output.is_open())
+                    results += "error\n";
+            }
+            if (results.size() > (1 << 20))
+            {
+                output << results;
+                results.clear();
+            }
+        }
+        p = lineEnd + 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (output.is_open())
+        output << results;
+
+    cout << "Lines: " << lines << ", evaluated: " << evaluated << ", errors: " << errors << endl;
+    cout << "Checksum of finite results: " << formatNumber(checksum) << " (" << nonFinite << " NaN or infinite)" << endl;
+    cout << fixed << setprecision(3) << "Time: " << seconds * 1000 << " ms, "
+         << setprecision(2) << evaluated / seconds / 1e6 << " M evaluations/s (parse + compile + run)" << endl;
+    cout.unsetf(ios::floatfield);
+    return errors == 0 ? 0 : 2;
+}
+
+// A header line of names, then one row of numbers per line
+bool readColumns(const string &path, vector<string> &names, vector<vector<double>> &columns)
+{
+    ifstream in(path);
+    string line;
+    if (!getline(in, line))
+        return false;
+    istringstream header(line);
+    string name;
+    while (header >> name)
+        names.push_back(name);
+    if (names.empty())
+        return false;
+    columns.assign(names.size(), {});
+    while (getline(in, line))
+    {
+        if (line.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        const char *p = line.c_str();
+        char *stop;
+        for (size_t c = 0; c < names.size(); c++)
+        {
+            double value = strtod(p, &stop);
+            if (stop == p)
+                return false;
+            columns[c].push_back(value);
+            p = stop;
+        }
+    }
+    return true;
+}
+
+int runColumns(const string &expression, const string &path)
+{
+    vector<string> names;
+    vector<vector<double>> data;
+    if (!readColumns(path, names, data))
+    {
+        cerr << "Cannot read columns from " << path << endl;
+        return 1;
+    }
+
+    Environment env;
+    vector<const double *> columns;
+    for (size_t c = 0; c < names.size(); c++)
+    {
+        env.define(names[c], 0);
+        columns.push_back(data[c].data());
+    }
+    Compiler compiler;
+    Program program;
+    if (!compiler.compile(expression.data(), expression.size(), env, program))
+    {
+        cerr << "Error at " << compiler.errorPosition + 1 << ": " << compiler.error << endl;
+        return 1;
+    }
+
+    size_t rows = data[0].size();
+    vector<double> result(rows);
+    ColumnEvaluator evaluator;
+    auto start = chrono::steady_clock::now();
+    evaluator.run(program, columns, env, rows, result.data());
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double sum = 0, low = HUGE_VAL, high = -HUGE_VAL;
+    for (double value : result)
+    {
+        sum += value;
+        low = min(low, value);
+        high = max(high, value);
+    }
+    cout << "Rows: " << rows << ", sum: " << formatNumber(sum);
+    if (rows > 0)
+        cout << ", min: " << formatNumber(low) << ", max: " << formatNumber(high);
+    cout << endl;
+    cout << fixed << setprecision(3) << "Time: " << seconds * 1000 << " ms, "
+         << setprecision(2) << rows / max(seconds, 1e-9) / 1e6 << " M rows/s" << endl;
+    cout.unsetf(ios::floatfield);
+    return 0;
+}
+
+// Random expressions over x, y and z with every operator and some functions
+string randomExpression(mt19937 &rng, int depth)
+{
+    uniform_int_distribution<int> pick(0, 9);
+    int choice = depth <= 0 ? pick(rng) % 3 : pick(rng);
+    switch (choice)
+    {
+    case 0:
+        return formatNumber(uniform_int_distribution<int>(1, 999)(rng) / 10.0);
+    case 1:
+    {
+        const char *names[] = {"x", "y", "z"};
+        return names[rng() % 3];
+    }
+    case 2:
+        return to_string(uniform_int_distribution<int>(1, 99)(rng));
+    case 3:
+        return "(" + randomExpression(rng, depth - 1) + ")";
+    case 4:
+    {
+        const char *names[] = {"sqrt", "abs", "sin", "cos", "exp", "floor"};
+        return string(names[rng() % 6]) + "(" + randomExpression(rng, depth - 1) + ")";
+    }
+    case 5:
+    {
+        const char *names[] = {"min", "max", "hypot"};
+        return string(names[rng() % 3]) + "(" + randomExpression(rng, depth - 1) + ", " +
+               randomExpression(rng, depth - 1) + ")";
+    }
+    case 6:
+        return "-" + randomExpression(rng, depth - 1);
     default:
-        return 0;
+    {
+        const char *ops[] = {" + ", " - ", " * ", " / ", " % ", "^"};
+        const char *op = ops[rng() % 6];
+        if (op[0] == '^')
+            return randomExpression(rng, 0) + "^" + to_string(rng() % 3);
+        return randomExpression(rng, depth - 1) + op + randomExpression(rng, depth - 1);
+    }
+    }
+}
+
+int benchmarkBatch(size_t count)
+{
+    const string path = "simulated_disk/calculator_batch.txt";
+    system("mkdir -p simulated_disk");
+    mt19937 rng(46);
+    string text = "x = 1.5\ny = 2.25\nz = -3\n";
+    for (size_t i = 0; i < count; i++)
+    {
+        text += randomExpression(rng, 3);
+        text += '\n';
+    }
+    if (!diskLedger.charge(taskPid, static_cast<int64_t>(text.size())))
+    {
+        cerr << "Disk quota too small for " << text.size() << " bytes" << endl;
+        return 1;
+    }
+    ofstream(path, ios::binary) << text;
+    cout << "Generated " << count << " expressions (" << text.size() / 1024 << " KB) in " << path << endl;
+    return runBatch(path, "");
+}
+
+int benchmarkColumns(size_t rows)
+{
+    const string expression = "sqrt(x*x + y*y) * 0.5 + (x - y) / (1 + z*z) - max(2^3 * z, -abs(y))";
+    mt19937_64 rng(46);
+    uniform_real_distribution<double> value(-100, 100);
+    vector<vector<double>> data(3, vector<double>(rows));
+    for (auto &column : data)
+    {
+        for (double &v : column)
+            v = value(rng);
+    }
+
+    Environment env;
+    vector<const double *> columns;
+    const char *names[] = {"x", "y", "z"};
+    for (int c = 0; c < 3; c++)
+    {
+        env.define(names[c], 0);
+        columns.push_back(data[c].data());
+    }
+    Compiler compiler;
+    Program program;
+    if (!compiler.compile(expression.data(), expression.size(), env, program))
+    {
+        cerr << compiler.error << endl;
+        return 1;
+    }
+    cout << "Expression: " << expression << endl;
+    cout << "Bytecode: " << program.code.size() << " instructions, " << program.registers << " registers, "
+         << program.constants.size() << " constants" << endl;
+
+    auto time = [](auto body) {
+        auto start = chrono::steady_clock::now();
+        body();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    auto report = [rows](const char *label, double seconds) {
+        cout << "  " << left << setw(22) << label << right << fixed << setprecision(1) << setw(9) << seconds * 1000
+             << " ms " << setprecision(1) << setw(8) << rows / seconds / 1e6 << " M rows/s" << endl;
+        cout.unsetf(ios::floatfield);
+    };
+
+    // One row at a time through the scalar VM
+    vector<double> scalar(rows);
+    double scalarTime = time([&] {
+        double variables[3];
+        for (size_t i = 0; i < rows; i++)
+        {
+            variables[0] = data[0][i];
+            variables[1] = data[1][i];
+            variables[2] = data[2][i];
+            scalar[i] = execute(program, variables);
+        }
+    });
+
+    vector<double> vectorized(rows);
+    ColumnEvaluator evaluator;
+    double columnTime = time([&] { evaluator.run(program, columns, env, rows, vectorized.data()); });
+
+    // The same formula written directly in C++ as the lower bound
+    vector<double> native(rows);
+    double nativeTime = time([&] {
+        for (size_t i = 0; i < rows; i++)
+        {
+            double x = data[0][i], y = data[1][i], z = data[2][i];
+            native[i] = sqrt(x * x + y * y) * 0.5 + applyBinary(DIV, x - y, 1 + z * z) - max(8 * z, -fabs(y));
+        }
+    });
+
+    double worst = 0;
+    for (size_t i = 0; i < rows; i++)
+    {
+        worst = max(worst, fabs(scalar[i] - vectorized[i]));
+        worst = max(worst, fabs(scalar[i] - native[i]));
+    }
+    cout << "Rows: " << rows << endl;
+    report("row-at-a-time VM", scalarTime);
+    report("columnar kernels", columnTime);
+    report("native C++ loop", nativeTime);
+    cout << "Largest difference between methods: " << worst << endl;
+    return worst == 0 ? 0 : 2;
+}
+
+// ===== Arbitrary precision benchmarks =====
+
+string randomDigits(mt19937_64 &rng, size_t count)
+{
+    string digits(count, '0');
+    for (char &c : digits)
+        c = static_cast<char>('0' + rng() % 10);
+    digits[0] = static_cast<char>('1' + rng() % 9);
+    return digits;
+}
+
+// Seconds per call, repeating until the total is long enough to trust
+template <typename Body>
+double timePerCall(Body body, double minimum = 0.02)
+{
+    size_t calls = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed;
+    do
+    {
+        body();
+        calls++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < minimum);
+    return elapsed / calls;
+}
+
+struct Thresholds
+{
+    size_t karatsuba, toom, newton;
+
+    static Thresholds current()
+    {
+        return {karatsubaThreshold, toomThreshold, newtonThreshold};
+    }
+
+    void apply() const
+    {
+        karatsubaThreshold = karatsuba;
+        toomThreshold = toom;
+        newtonThreshold = newton;
+    }
+};
+
+// Times each method at its own top level only; the pieces below use the
+// next method down, so a crossover is where one level starts to pay off
+int tuneBignum()
+{
+    const Thresholds saved = Thresholds::current();
+    mt19937_64 rng(47);
+    volatile size_t sink = 0; // Keeps the timed results alive
+    auto randomNumber = [&rng](size_t limbs) {
+        Limbs x(limbs);
+        for (Limb &limb : x)
+            limb = static_cast<Limb>(rng());
+        x.back() |= 1u << 31;
+        return BigInt::fromMagnitude(move(x));
+    };
+    auto row = [](size_t n, double slow, double fast) {
+        cout << "  " << setw(6) << n << fixed << setprecision(2) << setw(12) << slow * 1e6 << setw(12) << fast * 1e6
+             << setw(9) << slow / fast << "x" << endl;
+        cout.unsetf(ios::floatfield);
+        return fast < slow;
+    };
+    // The size from which the faster method keeps winning
+    auto crossover = [](size_t &found, size_t n, bool wins) {
+        if (!wins)
+            found = 0;
+        else if (found == 0)
+            found = n;
+    };
+    size_t karatsubaFrom = 0, toomFrom = 0, newtonFrom = 0;
+
+    cout << "Limbs   schoolbook us  karatsuba us" << endl;
+    for (size_t n : {8, 12, 16, 24, 32, 48, 64, 96})
+    {
+        BigInt a = randomNumber(n), b = randomNumber(n);
+        Thresholds{SIZE_MAX, SIZE_MAX, SIZE_MAX}.apply();
+        double schoolbook = timePerCall([&] { sink += (a * b).limbs.size(); });
+        Thresholds{n, SIZE_MAX, SIZE_MAX}.apply();
+        double karatsuba = timePerCall([&] { sink += (a * b).limbs.size(); });
+        crossover(karatsubaFrom, n, row(n, schoolbook, karatsuba));
+    }
+    size_t karatsuba = karatsubaFrom ? karatsubaFrom : saved.karatsuba;
+
+    cout << "Limbs    karatsuba us     toom-3 us" << endl;
+    for (size_t n : {128, 192, 256, 384, 512, 768, 1024})
+    {
+        BigInt a = randomNumber(n), b = randomNumber(n);
+        Thresholds{karatsuba, SIZE_MAX, SIZE_MAX}.apply();
+        double plain = timePerCall([&] { sink += (a * b).limbs.size(); });
+        Thresholds{karatsuba, n, SIZE_MAX}.apply();
+        double toom = timePerCall([&] { sink += (a * b).limbs.size(); });
+        crossover(toomFrom, n, row(n, plain, toom));
+    }
+    size_t toom = toomFrom ? toomFrom : saved.toom;
+
+    cout << "Limbs  knuth (2n/n) us    newton us" << endl;
+    for (size_t n : {128, 256, 384, 512, 768, 1024, 1536, 2048})
+    {
+        BigInt b = randomNumber(n), a = randomNumber(2 * n);
+        Thresholds{karatsuba, toom, SIZE_MAX}.apply();
+        double knuth = timePerCall([&] { sink += (a / b).limbs.size(); });
+        Thresholds{karatsuba, toom, n}.apply();
+        double newton = timePerCall([&] { sink += (a / b).limbs.size(); });
+        crossover(newtonFrom, n, row(n, knuth, newton));
+    }
+
+    saved.apply();
+    cout << "Crossovers: karatsuba " << karatsuba << ", toom-3 " << toom << ", newton "
+         << (newtonFrom ? newtonFrom : saved.newton) << " limbs (built in: " << saved.karatsuba << ", "
+         << saved.toom << ", " << saved.newton << ")" << endl;
+    return 0;
+}
+
+// Multiplies, divides and converts numbers of each size, checking every
+// method against the others
+int benchmarkBignum(const vector<size_t> &sizes)
+{
+    const Thresholds tuned = Thresholds::current();
+    mt19937_64 rng(47);
+    bool allGood = true;
+    // Runs body, then reports its time and whether check() holds afterwards
+    auto measure = [&allGood](const string &label, auto body, auto check) {
+        auto start = chrono::steady_clock::now();
+        body();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        bool good = check();
+        cout << "  " << left << setw(34) << label << right << fixed << setprecision(1) << setw(10) << seconds * 1000
+             << " ms" << (good ? "" : "  MISMATCH") << endl;
+        cout.unsetf(ios::floatfield);
+        allGood = allGood && good;
+    };
+
+    for (size_t digits : sizes)
+    {
+        string textA = randomDigits(rng, digits), textB = randomDigits(rng, digits);
+        cout << digits << " digits (" << digits * 3322 / 32000 + 1 << " limbs):" << endl;
+
+        BigInt a, b;
+        measure(
+            "parse both",
+            [&] {
+                a = parseDigits(textA.data(), textA.size());
+                b = parseDigits(textB.data(), textB.size());
+            },
+            [&] { return a.bitLength() >= (digits - 1) * 3321 / 1000; });
+
+        BigInt product, check;
+        measure("multiply (toom-3)", [&] { product = a * b; }, [] { return true; });
+        Thresholds{tuned.karatsuba, SIZE_MAX, tuned.newton}.apply();
+        measure("multiply (karatsuba only)", [&] { check = a * b; }, [&] { return check == product; });
+        if (digits <= 200000)
+        {
+            Thresholds{SIZE_MAX, SIZE_MAX, tuned.newton}.apply();
+            measure("multiply (schoolbook only)", [&] { check = a * b; }, [&] { return check == product; });
+        }
+        tuned.apply();
+
+        BigInt half = a >> 1, dividend = product + half, q, r;
+        auto divided = [&] { return q == b && r == half; };
+        measure("divide 2n by n (newton)", [&] { divmod(dividend, a, q, r); }, divided);
+        if (digits <= 200000)
+        {
+            Thresholds{tuned.karatsuba, tuned.toom, SIZE_MAX}.apply();
+            measure("divide 2n by n (knuth)", [&] { divmod(dividend, a, q, r); }, divided);
+            tuned.apply();
+        }
+        BigInt negativeDividend = dividend;
+        negativeDividend.negative = true;
+        measure("divide -2n by n (newton)", [&] { divmod(negativeDividend, a, q, r); },
+                [&] { return q.negative && r.negative && compareMagnitude(q, b) == 0 && compareMagnitude(r, half) == 0; });
+
+        string text, slow;
+        measure("print product (divide and conquer)", [&] { text = toString(product); },
+                [&] { return text.size() >= 2 * digits - 1 && text.size() <= 2 * digits; });
+        if (digits <= 100000)
+            measure("print product (quadratic)", [&] { slow = smallToString(product.limbs); },
+                    [&] { return slow == text; });
+        BigInt back;
+        measure("parse product back", [&] { back = parseDigits(text.data(), text.size()); },
+                [&] { return back == product; });
+        measure("check: a parses back from print", [&] { text = toString(a); }, [&] { return text == textA; });
+        BigInt negativeA = a;
+        negativeA.negative = true;
+        measure("check: -a prints its digits", [&] { text = toString(negativeA); },
+                [&] { return text == "-" + textA; });
+        BigInt negativeProduct = product;
+        negativeProduct.negative = true;
+        measure("check: -product prints its digits", [&] { text = toString(negativeProduct); },
+                [&] { return text.size() > 1 && text[0] == '-' && parseDigits(text.data() + 1, text.size() - 1) == product; });
+    }
+    return allGood ? 0 : 2;
+}
+
+// ===== Interactive =====
+
+struct Session
+{
+    Environment env;
+    Compiler compiler;
+    Program program;
+    ExactMachine exact;
+    string lastResult;
+};
+
+const char *modeName(NumberMode mode)
+{
+    switch (mode)
+    {
+    case NumberMode::INTEGER:
+        return "int";
+    case NumberMode::RATIONAL:
+        return "rational";
+    case NumberMode::DECIMAL:
+        return "decimal";
+    default:
+        return "float";
+    }
+}
+
+// "mode", "mode float|int|rational", "mode decimal [digits]"
+void changeMode(const string &input, Session &session)
+{
+    istringstream words(input);
+    string command, name;
+    size_t digits = session.exact.digits();
+    words >> command >> name;
+    if (!name.empty())
+    {
+        if (name == "float")
+            session.exact.mode = NumberMode::FLOAT;
+        else if (name == "int")
+            session.exact.mode = NumberMode::INTEGER;
+        else if (name == "rational")
+            session.exact.mode = NumberMode::RATIONAL;
+        else if (name == "decimal" && (words >> digits || words.eof()) && digits <= 10000000)
+        {
+            session.exact.mode = NumberMode::DECIMAL;
+            if (digits != session.exact.digits())
+                session.exact.setDigits(digits);
+        }
+        else
+        {
+            cout << "  Modes: float, int, rational, decimal [digits]" << endl;
+            return;
+        }
+    }
+    cout << "  Mode: " << modeName(session.exact.mode);
+    if (session.exact.mode == NumberMode::DECIMAL)
+        cout << " (" << session.exact.digits() << " digits)";
+    cout << endl;
+}
+
+void evaluateLine(const string &input, Session &session)
+{
+    bool exact = session.exact.mode != NumberMode::FLOAT;
+    Program &program = session.program;
+    if (!session.compiler.compile(input.data(), input.size(), session.env, program, exact))
+    {
+        cout << "  " << string(session.compiler.errorPosition, ' ') << "^ " << session.compiler.error << endl;
+        return;
+    }
+
+    if (!exact)
+    {
+        double result = execute(program, session.env.values.data());
+        session.env.values[0] = result;
+        session.exact.invalidate(0);
+        if (program.assigns)
+            session.exact.invalidate(program.code.back().index);
+        session.lastResult = formatNumber(result);
+        cout << "= " << session.lastResult << endl;
+        return;
+    }
+
+    Rational result;
+    auto start = chrono::steady_clock::now();
+    if (!session.exact.run(program, session.env, result))
+    {
+        cout << "  " << session.exact.error << endl;
+        return;
     }
+    session.lastResult = session.exact.format(result);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const string &text = session.lastResult;
+    if (text.size() <= 400)
+    {
+        cout << "= " << text << endl;
+        return;
+    }
+    cout << "= " << text.substr(0, 150) << " ... " << text.substr(text.size() - 150) << endl;
+    cout << "  (" << text.size() << " characters in " << fixed << setprecision(1) << seconds * 1000
+         << " ms; 'show' prints them all)" << endl;
+    cout.unsetf(ios::floatfield);
 }
 
 int main(int argc, char *argv[])
 {
+    if (argc >= 3 && string(argv[1]) == "--batch")
+    {
+        return runBatch(argv[2], argc >= 4 ? argv[3] : "");
+    }
+    if (argc >= 4 && string(argv[1]) == "--columns")
+    {
+        return runColumns(argv[2], argv[3]);
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-batch")
+    {
+        diskLedger.open(false);
+        return benchmarkBatch(argc >= 3 ? stoul(argv[2]) : 1000000);
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-columns")
+    {
+        return benchmarkColumns(argc >= 3 ? stoul(argv[2]) : 10000000);
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-bignum")
+    {
+        vector<size_t> sizes;
+        for (int i = 2; i < argc; i++)
+            sizes.push_back(stoul(argv[i]));
+        return benchmarkBignum(sizes.empty() ? vector<size_t>{100000, 1000000} : sizes);
+    }
+    if (argc >= 2 && string(argv[1]) == "--tune-bignum")
+    {
+        return tuneBignum();
+    }
+
     if (argc < 4)
     {
         cerr << "Usage: calculator <pid> <memory_required> <disk_required>" << endl;
+        cerr << "       " << argv[0] << " --batch <expressions file> [results file]" << endl;
+        cerr << "       " << argv[0] << " --columns <expression> <columns file>" << endl;
+        cerr << "       " << argv[0] << " --bench-batch [expressions]" << endl;
+        cerr << "       " << argv[0] << " --bench-columns [rows]" << endl;
+        cerr << "       " << argv[0] << " --bench-bignum [digits ...]" << endl;
+        cerr << "       " << argv[0] << " --tune-bignum" << endl;
         return 1;
     }
 
     int pid = stoi(argv[1]);
     int memoryRequired = stoi(argv[2]);
     int diskRequired = stoi(argv[3]);
+    taskPid = pid;
+    diskLedger.open(false);
 
     cout << "Calculator started with PID: " << pid << endl;
     cout << "Memory: " << memoryRequired << " MB, Disk: " << diskRequired << " MB" << endl;
     this_thread::sleep_for(chrono::seconds(2));
 
-    double num1, num2, result;
-    char op;
-    bool running = true;
+    Session session;
+    Environment &env = session.env;
+    env.define("ans", 0);
 
-    while (running)
-    {
-        clearScreen();
-        cout << "===== Calculator (PID: " << pid << ") =====" << endl;
-        cout << "Enter calculation (e.g., 5 + 3) or 'q' to quit:" << endl;
-        cout << "> ";
-
-        string input;
-        getline(cin, input);
+    clearScreen();
+    cout << "===== Calculator (PID: " << pid << ") =====" << endl;
+    cout << "Enter an expression, e.g. 2 * (3 + 4)^2, r = 5, pi * r^2, hypot(3, 4)" << endl;
+    cout << "Operators: + - * / % ^   Constants: pi e   Last result: ans" << endl;
+    cout << "Exact arithmetic: 'mode int', 'mode rational', 'mode decimal [digits]', back with 'mode float'" << endl;
+    cout << "Type 'vars' to list variables, 'funcs' for functions, 'q' to quit." << endl;
 
-        if (input == "q" || input == "Q")
+    string input;
+    while (true)
+    {
+        cout << "> " << flush;
+        if (!getline(cin, input) || input == "q" || input == "Q")
+            break;
+        if (input.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        if (input == "vars")
         {
-            running = false;
+            for (size_t i = 0; i < env.names.size(); i++)
+                cout << "  " << env.names[i] << " = " << formatNumber(env.values[i]) << endl;
             continue;
         }
-
-        // Parse input
-        istringstream iss(input);
-        if (iss >> num1 >> op >> num2)
+        if (input == "funcs")
         {
-            result = calculate(num1, num2, op);
-            cout << "Result: " << num1 << " " << op << " " << num2 << " = " << result << endl;
+            cout << " ";
+            for (const Function &function : FUNCTIONS)
+                cout << " " << function.name << (function.arity == 1 ? "(x)" : "(x, y)");
+            cout << endl;
+            continue;
         }
-        else
+        if (input.compare(0, 4, "mode") == 0 && (input.size() == 4 || input[4] == ' '))
+        {
+            changeMode(input, session);
+            continue;
+        }
+        if (input == "show")
         {
-            cout << "Invalid input format. Please try again." << endl;
+            cout << session.lastResult << endl;
+            continue;
         }
-
-        cout << "\nPress Enter to continue...";
-        cin.get();
+        evaluateLine(input, session);
     }
 
     cout << "Calculator task completed." << endl;
@@ -2,16 +2,1586 @@
 #include <string>
 #include <chrono>
 #include <ctime>
-#include <thread>
 #include <iomanip>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/DiskLedger.h"
 
 using namespace std;
 
+DiskLedger diskLedger;
+int taskPid = 0;
+
+const string EVENTS_PATH = "simulated_disk/calendar_events.bin";
+
+// ===== Date arithmetic =====
+
+// Days are counted from 1970-01-01 in the proleptic Gregorian calendar and
+// times are wall clock minutes on that count. Years are shifted by whole
+// 400 year eras before dividing, so every division is of a non-negative
+// number and the conversions compile without branches.
+const int64_t SHIFT_ERAS = 25000;
+const int64_t DAYS_PER_ERA = 146097;
+const int64_t SHIFT_DAYS = SHIFT_ERAS * DAYS_PER_ERA;
+const int64_t MINUTES_PER_DAY = 1440;
+
+struct CivilDate
+{
+    int64_t year;
+    unsigned month; // 1-12
+    unsigned day;   // 1-31
+};
+
+inline int64_t daysFromCivil(int64_t year, unsigned month, unsigned day)
+{
+    // Count from March so the leap day is the last day of the year
+    uint64_t y = static_cast<uint64_t>(year - (month <= 2) + SHIFT_ERAS * 400);
+    uint64_t era = y / 400;
+    uint64_t yearOfEra = y - era * 400;
+    uint64_t dayOfYear = (153 * ((month + 9) % 12) + 2) / 5 + day - 1;
+    uint64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return static_cast<int64_t>(era * DAYS_PER_ERA + dayOfEra) - 719468 - SHIFT_DAYS;
+}
+
+inline CivilDate civilFromDays(int64_t days)
+{
+    uint64_t z = static_cast<uint64_t>(days + 719468 + SHIFT_DAYS);
+    uint64_t era = z / DAYS_PER_ERA;
+    uint64_t dayOfEra = z - era * DAYS_PER_ERA;
+    uint64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    uint64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    uint64_t shiftedMonth = (5 * dayOfYear + 2) / 153;
+    unsigned day = static_cast<unsigned>(dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+    unsigned month = static_cast<unsigned>(shiftedMonth + 3 - 12 * (shiftedMonth >= 10));
+    int64_t year = static_cast<int64_t>(yearOfEra + era * 400) - SHIFT_ERAS * 400 + (month <= 2);
+    return {year, month, day};
+}
+
+// 0 = Monday ... 6 = Sunday; 1970-01-01 was a Thursday
+inline unsigned weekdayFromDays(int64_t days)
+{
+    return static_cast<unsigned>((days + SHIFT_DAYS + 3) % 7);
+}
+
+inline bool isLeapYear(int64_t year)
+{
+    uint64_t y = static_cast<uint64_t>(year + SHIFT_ERAS * 400);
+    return (y % 4 == 0) & ((y % 100 != 0) | (y % 400 == 0));
+}
+
+// Two bits per month hold the days beyond 28
+inline unsigned daysInMonth(int64_t year, unsigned month)
+{
+    return 28 + ((0x3bbeecc >> (month * 2)) & 3) + (month == 2) * isLeapYear(year);
+}
+
+// Division rounding down and up, for a positive divisor
+inline int64_t floorDiv(int64_t a, int64_t b)
+{
+    return a / b - (a % b < 0);
+}
+
+inline int64_t ceilDiv(int64_t a, int64_t b)
+{
+    return -floorDiv(-a, b);
+}
+
+// Floor division of minutes into days, shifted like the year above
+inline int64_t dayOfMinute(int64_t minute)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(minute + SHIFT_DAYS * MINUTES_PER_DAY) / MINUTES_PER_DAY) - SHIFT_DAYS;
+}
+
+const char *MONTH_NAMES[] = {"January", "February", "March", "April", "May", "June", "July",
+                             "August", "September", "October", "November", "December"};
+
+string formatDate(int64_t days)
+{
+    CivilDate date = civilFromDays(days);
+    char text[32];
+    snprintf(text, sizeof(text), "%04lld-%02u-%02u", static_cast<long long>(date.year), date.month, date.day);
+    return text;
+}
+
+string formatMinute(int64_t minute)
+{
+    int64_t day = dayOfMinute(minute);
+    int64_t inDay = minute - day * MINUTES_PER_DAY;
+    char text[48];
+    snprintf(text, sizeof(text), "%s %02lld:%02lld", formatDate(day).c_str(),
+             static_cast<long long>(inDay / 60), static_cast<long long>(inDay % 60));
+    return text;
+}
+
+bool parseDate(const string &text, int64_t &days)
+{
+    long long year;
+    unsigned month, day;
+    char tail;
+    if (sscanf(text.c_str(), "%lld-%u-%u%c", &year, &month, &day, &tail) != 3 ||
+        month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month))
+        return false;
+    days = daysFromCivil(year, month, day);
+    return true;
+}
+
+bool parseTime(const string &text, int64_t &minutes)
+{
+    unsigned hour, minute;
+    char tail;
+    if (sscanf(text.c_str(), "%u:%u%c", &hour, &minute, &tail) != 2 || hour > 23 || minute > 59)
+        return false;
+    minutes = hour * 60 + minute;
+    return true;
+}
+
+// The local clock as minutes on the day count. The zone offset is read
+// once at startup rather than converting through localtime on every call.
+int64_t localOffsetMinutes()
+{
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    return local.tm_gmtoff / 60;
+}
+
+int64_t currentMinute(int64_t offsetMinutes)
+{
+    int64_t seconds = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    return (seconds >= 0 ? seconds / 60 : (seconds - 59) / 60) + offsetMinutes;
+}
+
+// ===== Event index =====
+
+// The whole index is one position independent image: a header, the single
+// events and the recurring series, each sorted by start with a centered
+// interval tree over them, the skipped occurrences of every series and the
+// titles. Saving writes the image as is and loading maps it, so a calendar
+// is usable after one bounds-checking pass, with no parsing or rebuilding.
+struct EventRecord
+{
+    int64_t start;        // Minutes
+    uint32_t duration;    // Minutes, at least one
+    uint32_t id;          // Stable across rebuilds and saves
+    uint32_t titleOffset; // Into the title area
+    uint16_t titleLength;
+    uint16_t flags;
+
+    int64_t end() const { return start + duration; } // Exclusive
+};
+
+enum Frequency : uint8_t
+{
+    DAILY,
+    WEEKLY,
+    MONTHLY
+};
+
+// A recurring series is stored once, as its rule, and expanded on demand.
+// In the tree it stands for the span from its first occurrence to the end
+// of its last one.
+struct SeriesRecord
+{
+    int64_t start;           // First occurrence, minutes
+    int64_t until;           // Occurrences start before this
+    uint32_t duration;       // Of every occurrence, minutes
+    uint32_t id;             // Shared with single events
+    uint32_t titleOffset;
+    uint32_t firstException; // Slice of the skipped occurrence starts, ascending
+    uint32_t exceptionCount;
+    uint16_t interval;       // Every n days, weeks or months
+    uint16_t titleLength;
+    uint8_t frequency;
+    uint8_t weekdays;        // Weekly: bit 0 is Monday
+    uint16_t flags;
+    uint32_t reserved;
+
+    int64_t end() const { return until + duration; }
+};
+
+// Every node holds the records containing its center, once sorted by start
+// and once by descending end. Records entirely before the center are in the
+// left subtree and records entirely after it in the right one.
+struct IndexNode
+{
+    int64_t center;
+    int32_t left;
+    int32_t right;
+    uint32_t first; // Slice of byStart and byEnd
+    uint32_t count;
+};
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t eventCount;
+    uint32_t nodeCount;
+    int32_t root;
+    uint32_t nextId;
+    uint32_t seriesCount;
+    uint32_t seriesNodeCount;
+    int32_t seriesRoot;
+    uint32_t exceptionCount;
+    uint64_t titleBytes;
+    uint64_t imageBytes;
+};
+
+static_assert(sizeof(EventRecord) == 24 && sizeof(SeriesRecord) == 48 && sizeof(IndexNode) == 24 &&
+                  sizeof(IndexHeader) == 56,
+              "The image layout is stored on disk");
+
+const char INDEX_MAGIC[8] = {'C', 'A', 'L', 'I', 'D', 'X', '2', '\0'};
+const uint16_t EVENT_REMOVED = 1;
+const size_t MAX_TITLE = 65535;
+const int64_t OPEN_ENDED = daysFromCivil(10000, 1, 1) * MINUTES_PER_DAY;
+
+struct ImageLayout
+{
+    size_t events, nodes, byStart, byEnd;
+    size_t series, seriesNodes, seriesByStart, seriesByEnd;
+    size_t exceptions, titles, total;
+
+    explicit ImageLayout(const IndexHeader &header)
+    {
+        events = sizeof(IndexHeader);
+        nodes = events + uint64_t(header.eventCount) * sizeof(EventRecord);
+        byStart = nodes + uint64_t(header.nodeCount) * sizeof(IndexNode);
+        byEnd = byStart + uint64_t(header.eventCount) * sizeof(uint32_t);
+        series = byEnd + uint64_t(header.eventCount) * sizeof(uint32_t);
+        seriesNodes = series + uint64_t(header.seriesCount) * sizeof(SeriesRecord);
+        seriesByStart = seriesNodes + uint64_t(header.seriesNodeCount) * sizeof(IndexNode);
+        seriesByEnd = seriesByStart + uint64_t(header.seriesCount) * sizeof(uint32_t);
+        exceptions = seriesByEnd + uint64_t(header.seriesCount) * sizeof(uint32_t);
+        titles = exceptions + uint64_t(header.exceptionCount) * sizeof(int64_t);
+        total = titles + header.titleBytes;
+    }
+};
+
+// Records sorted by start and the flattened tree over them, read in place
+// from the image
+template <typename Record>
+struct IntervalTree
+{
+    const Record *records = nullptr;
+    const IndexNode *nodes = nullptr;
+    const uint32_t *byStart = nullptr;
+    const uint32_t *byEnd = nullptr;
+    int32_t root = -1;
+
+    // Report the position of every record overlapping [from, to)
+    template <typename Report>
+    void query(int32_t node, int64_t from, int64_t to, Report &report) const
+    {
+        while (node >= 0)
+        {
+            const IndexNode &current = nodes[node];
+            const uint32_t *slice;
+            if (to <= current.center)
+            {
+                // Every record here ends after the center, so only the start matters
+                slice = byStart + current.first;
+                for (uint32_t i = 0; i < current.count && records[slice[i]].start < to; i++)
+                    report(slice[i]);
+                node = current.left;
+            }
+            else if (from > current.center)
+            {
+                // Every record here starts at or before the center, so only the end matters
+                slice = byEnd + current.first;
+                for (uint32_t i = 0; i < current.count && records[slice[i]].end() > from; i++)
+                    report(slice[i]);
+                node = current.right;
+            }
+            else
+            {
+                // The center is inside the range, so all of them overlap
+                slice = byStart + current.first;
+                for (uint32_t i = 0; i < current.count; i++)
+                    report(slice[i]);
+                query(current.left, from, to, report);
+                node = current.right;
+            }
+        }
+    }
+
+    // Check a tree read from a file: every index in range and children
+    // after their parent, as the builder lays them out, so queries always
+    // terminate. The depth bound keeps the recursion shallow.
+    bool valid(uint32_t nodeCount, uint32_t recordCount) const
+    {
+        const int MAX_DEPTH = 64;
+        if (recordCount == 0)
+            return true;
+        if (nodeCount == 0 || root != 0)
+            return false;
+        vector<uint8_t> depth(nodeCount, 0);
+        depth[0] = 1;
+        for (uint32_t i = 0; i < nodeCount; i++)
+        {
+            const IndexNode &node = nodes[i];
+            if (depth[i] == 0 || depth[i] > MAX_DEPTH || uint64_t(node.first) + node.count > recordCount)
+                return false;
+            for (int32_t child : {node.left, node.right})
+            {
+                if (child == -1)
+                    continue;
+                if (child <= static_cast<int32_t>(i) || static_cast<uint32_t>(child) >= nodeCount || depth[child] != 0)
+                    return false;
+                depth[child] = depth[i] + 1;
+            }
+        }
+        for (uint32_t i = 0; i < recordCount; i++)
+        {
+            if (byStart[i] >= recordCount || byEnd[i] >= recordCount)
+                return false;
+        }
+        return true;
+    }
+};
+
+template <typename Record>
+class IndexBuilder
+{
+    const vector<Record> &records;
+    vector<IndexNode> &nodes;
+    vector<uint32_t> &byStart;
+    vector<uint32_t> &byEnd;
+
+public:
+    IndexBuilder(const vector<Record> &records, vector<IndexNode> &nodes,
+                 vector<uint32_t> &byStart, vector<uint32_t> &byEnd)
+        : records(records), nodes(nodes), byStart(byStart), byEnd(byEnd) {}
+
+    // ids are ascending, which is also ascending by start. The center is the
+    // median start, so the node is never empty and each side keeps at most
+    // half of the records.
+    int32_t build(vector<uint32_t> &ids)
+    {
+        if (ids.empty())
+            return -1;
+
+        int64_t center = records[ids[ids.size() / 2]].start;
+        vector<uint32_t> left, right;
+        size_t first = byStart.size();
+        for (uint32_t id : ids)
+        {
+            if (records[id].end() <= center)
+                left.push_back(id);
+            else if (records[id].start > center)
+                right.push_back(id);
+            else
+                byStart.push_back(id);
+        }
+        ids.clear();
+        ids.shrink_to_fit();
+
+        byEnd.insert(byEnd.end(), byStart.begin() + first, byStart.end());
+        stable_sort(byEnd.begin() + first, byEnd.end(), [this](uint32_t a, uint32_t b)
+                    { return records[a].end() > records[b].end(); });
+
+        int32_t index = static_cast<int32_t>(nodes.size());
+        nodes.push_back({center, -1, -1, static_cast<uint32_t>(first), static_cast<uint32_t>(byStart.size() - first)});
+        int32_t leftNode = build(left);
+        int32_t rightNode = build(right);
+        nodes[index].left = leftNode;
+        nodes[index].right = rightNode;
+        return index;
+    }
+};
+
+// Sort the records by start and build the tree over them, returns the root
+template <typename Record>
+int32_t buildTree(vector<Record> &records, vector<IndexNode> &nodes, vector<uint32_t> &byStart, vector<uint32_t> &byEnd)
+{
+    sort(records.begin(), records.end(), [](const Record &a, const Record &b)
+         { return a.start != b.start ? a.start < b.start : a.end() < b.end(); });
+    byStart.reserve(records.size());
+    byEnd.reserve(records.size());
+    vector<uint32_t> ids(records.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        ids[i] = static_cast<uint32_t>(i);
+    return IndexBuilder<Record>(records, nodes, byStart, byEnd).build(ids);
+}
+
+// Build both trees and lay everything out as one image. The exception
+// slices of the series are positions in exceptions, so they survive the sort.
+vector<char> buildImage(vector<EventRecord> events, vector<SeriesRecord> series, const vector<int64_t> &exceptions,
+                        const string &titles, uint32_t nextId)
+{
+    vector<IndexNode> nodes, seriesNodes;
+    vector<uint32_t> byStart, byEnd, seriesByStart, seriesByEnd;
+    int32_t root = buildTree(events, nodes, byStart, byEnd);
+    int32_t seriesRoot = buildTree(series, seriesNodes, seriesByStart, seriesByEnd);
+
+    IndexHeader header = {};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.eventCount = static_cast<uint32_t>(events.size());
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.root = root;
+    header.nextId = nextId;
+    header.seriesCount = static_cast<uint32_t>(series.size());
+    header.seriesNodeCount = static_cast<uint32_t>(seriesNodes.size());
+    header.seriesRoot = seriesRoot;
+    header.exceptionCount = static_cast<uint32_t>(exceptions.size());
+    header.titleBytes = titles.size();
+    ImageLayout layout(header);
+    header.imageBytes = layout.total;
+
+    vector<char> image(layout.total);
+    auto put = [&image](size_t offset, const void *data, size_t bytes)
+    {
+        if (bytes > 0)
+            memcpy(image.data() + offset, data, bytes);
+    };
+    put(0, &header, sizeof(header));
+    put(layout.events, events.data(), events.size() * sizeof(EventRecord));
+    put(layout.nodes, nodes.data(), nodes.size() * sizeof(IndexNode));
+    put(layout.byStart, byStart.data(), byStart.size() * sizeof(uint32_t));
+    put(layout.byEnd, byEnd.data(), byEnd.size() * sizeof(uint32_t));
+    put(layout.series, series.data(), series.size() * sizeof(SeriesRecord));
+    put(layout.seriesNodes, seriesNodes.data(), seriesNodes.size() * sizeof(IndexNode));
+    put(layout.seriesByStart, seriesByStart.data(), seriesByStart.size() * sizeof(uint32_t));
+    put(layout.seriesByEnd, seriesByEnd.data(), seriesByEnd.size() * sizeof(uint32_t));
+    put(layout.exceptions, exceptions.data(), exceptions.size() * sizeof(int64_t));
+    put(layout.titles, titles.data(), titles.size());
+    return image;
+}
+
+bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written <= 0)
+            return false;
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// ===== Recurrence =====
+
+// Walks the occurrences of one series that overlap [from, to) in start
+// order. The first period that can overlap is computed from the window,
+// so a series that began years ago costs nothing for the periods before.
+class OccurrenceIterator
+{
+    const SeriesRecord &series;
+    const int64_t *exception;
+    const int64_t *exceptionsEnd;
+    int64_t lowest;       // Occurrences starting earlier end before the window
+    int64_t stop;         // Occurrences start before this
+    int64_t timeOfDay;
+    int64_t base;         // Daily: first start, weekly: Monday of the first week, monthly: month number
+    int64_t period;       // Periods since base
+    unsigned weekday = 0; // Weekly: next day of the period to try
+    unsigned dayOfMonth = 0;
+
+    // The next start the rule produces, ignoring the window's lower end and
+    // the exceptions; false once starts reach the stop
+    bool candidate(int64_t &start)
+    {
+        int64_t interval = series.interval;
+        if (series.frequency == DAILY)
+        {
+            start = base + period++ * interval * MINUTES_PER_DAY;
+            return start < stop;
+        }
+
+        if (series.frequency == WEEKLY)
+        {
+            while (weekday < 7 && !((series.weekdays >> weekday) & 1))
+            {
+                weekday++;
+                if (weekday == 7)
+                {
+                    weekday = 0;
+                    period++;
+                    if ((base + period * interval * 7) * MINUTES_PER_DAY + timeOfDay >= stop)
+                        return false;
+                }
+            }
+            start = (base + period * interval * 7 + weekday) * MINUTES_PER_DAY + timeOfDay;
+            if (++weekday == 7)
+            {
+                weekday = 0;
+                period++;
+            }
+            return start < stop;
+        }
+
+        // Monthly on a fixed day, months too short for it are skipped
+        while (true)
+        {
+            int64_t month = base + period++ * interval;
+            int64_t year = floorDiv(month, 12);
+            unsigned monthOfYear = static_cast<unsigned>(month - year * 12 + 1);
+            int64_t firstDay = daysFromCivil(year, monthOfYear, 1);
+            if (firstDay * MINUTES_PER_DAY >= stop)
+                return false;
+            if (dayOfMonth <= daysInMonth(year, monthOfYear))
+            {
+                start = (firstDay + dayOfMonth - 1) * MINUTES_PER_DAY + timeOfDay;
+                return start < stop;
+            }
+        }
+    }
+
+public:
+    OccurrenceIterator(const SeriesRecord &series, const int64_t *exceptions, int64_t from, int64_t to)
+        : series(series), exceptionsEnd(exceptions + series.exceptionCount)
+    {
+        lowest = max(series.start, from - static_cast<int64_t>(series.duration) + 1);
+        stop = min(to, series.until);
+        int64_t startDay = dayOfMinute(series.start);
+        timeOfDay = series.start - startDay * MINUTES_PER_DAY;
+        int64_t interval = series.interval;
+        if (series.frequency == DAILY)
+        {
+            base = series.start;
+            period = ceilDiv(lowest - base, interval * MINUTES_PER_DAY);
+        }
+        else if (series.frequency == WEEKLY)
+        {
+            base = startDay - weekdayFromDays(startDay);
+            period = floorDiv(lowest - (base * MINUTES_PER_DAY + timeOfDay), interval * 7 * MINUTES_PER_DAY);
+        }
+        else
+        {
+            CivilDate first = civilFromDays(startDay);
+            CivilDate low = civilFromDays(dayOfMinute(lowest));
+            base = first.year * 12 + first.month - 1;
+            dayOfMonth = first.day;
+            period = floorDiv(low.year * 12 + low.month - 1 - base, interval);
+        }
+        exception = lower_bound(exceptions, exceptionsEnd, lowest);
+    }
+
+    // The next occurrence start, false once the window is exhausted
+    bool next(int64_t &start)
+    {
+        while (candidate(start))
+        {
+            if (start < lowest)
+                continue;
+            while (exception < exceptionsEnd && *exception < start)
+                exception++;
+            if (exception < exceptionsEnd && *exception == start)
+                continue;
+            return true;
+        }
+        return false;
+    }
+};
+
+string describeRule(const SeriesRecord &series)
+{
+    static const char *UNITS[] = {"day", "week", "month"};
+    static const char *DAYS[] = {"Mo", "Tu", "We", "Th", "Fr", "Sa", "Su"};
+    string text = "every ";
+    if (series.interval > 1)
+        text += to_string(series.interval) + " " + UNITS[series.frequency] + "s";
+    else
+        text += UNITS[series.frequency];
+    if (series.frequency == WEEKLY)
+    {
+        text += " on";
+        for (unsigned day = 0; day < 7; day++)
+            if ((series.weekdays >> day) & 1)
+                text += string(" ") + DAYS[day];
+    }
+    if (series.until < OPEN_ENDED)
+        text += " until " + formatMinute(series.until);
+    return text;
+}
+
+// "daily", "weekly/2", "weekly:mo,we,fr" or "monthly/3"
+bool parseRule(const string &text, Frequency &frequency, unsigned &interval, unsigned &weekdays)
+{
+    static const char *DAYS[] = {"mo", "tu", "we", "th", "fr", "sa", "su"};
+    size_t end = text.find_first_of("/:");
+    string name = text.substr(0, end);
+    if (name == "daily")
+        frequency = DAILY;
+    else if (name == "weekly")
+        frequency = WEEKLY;
+    else if (name == "monthly")
+        frequency = MONTHLY;
+    else
+        return false;
+
+    interval = 1;
+    weekdays = 0;
+    size_t slash = text.find('/');
+    if (slash != string::npos)
+    {
+        interval = static_cast<unsigned>(atoi(text.c_str() + slash + 1));
+        if (interval < 1 || interval > 65535)
+            return false;
+    }
+    size_t colon = text.find(':');
+    if (colon != string::npos)
+    {
+        if (frequency != WEEKLY)
+            return false;
+        stringstream days(text.substr(colon + 1));
+        string day;
+        while (getline(days, day, ','))
+        {
+            unsigned index = find(DAYS, DAYS + 7, day.substr(0, 2)) - DAYS;
+            if (index == 7)
+                return false;
+            weekdays |= 1u << index;
+        }
+    }
+    return true;
+}
+
+// ===== Event store =====
+
+struct EventView
+{
+    uint32_t id;
+    int64_t start;
+    int64_t end;
+    const char *title;
+    uint16_t titleLength;
+    const SeriesRecord *series; // The rule of an occurrence, null for single events
+};
+
+// The indexed image, mapped from disk or built in memory, plus the events
+// and series added or changed since it was built. Pending entries are
+// folded into a new image on save and at the first query after enough of
+// them pile up, so bulk adds pay for one build. Ids are handed out by add
+// and never change.
+class EventStore
+{
+    static const size_t REBUILD_PENDING = 4096;
+
+    struct PendingSeries
+    {
+        SeriesRecord record;
+        vector<int64_t> exceptions;
+    };
+
+    const char *image = nullptr;
+    size_t imageSize = 0;
+    bool mapped = false;
+    vector<char> owned;
+
+    const IndexHeader *header = nullptr;
+    IntervalTree<EventRecord> events;
+    IntervalTree<SeriesRecord> series;
+    const int64_t *exceptions = nullptr;
+    const char *titles = nullptr;
+
+    // Indexed events, then indexed series, deleted since the build. Sized
+    // along with the id lookup on the first delete.
+    vector<uint8_t> removed;
+    size_t removedCount = 0;
+    vector<pair<uint32_t, uint32_t>> slots; // Id to slot in removed
+    vector<EventRecord> pending;            // Ascending ids
+    vector<PendingSeries> pendingSeries;
+    string pendingTitles;
+    uint32_t nextId = 1;
+    bool dirty = false;
+
+    void unmap()
+    {
+        if (mapped)
+            munmap(const_cast<char *>(image), imageSize);
+        mapped = false;
+        image = nullptr;
+        imageSize = 0;
+        header = nullptr;
+    }
+
+    bool attach(const char *data, size_t size)
+    {
+        if (size < sizeof(IndexHeader))
+            return false;
+        const IndexHeader *candidate = reinterpret_cast<const IndexHeader *>(data);
+        if (memcmp(candidate->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || candidate->imageBytes != size)
+            return false;
+        ImageLayout layout(*candidate);
+        if (layout.total != size)
+            return false;
+
+        // Everything the queries follow is checked once here, so a damaged
+        // or foreign file is refused instead of read outside the mapping
+        IntervalTree<EventRecord> candidateEvents = {
+            reinterpret_cast<const EventRecord *>(data + layout.events), reinterpret_cast<const IndexNode *>(data + layout.nodes),
+            reinterpret_cast<const uint32_t *>(data + layout.byStart), reinterpret_cast<const uint32_t *>(data + layout.byEnd),
+            candidate->eventCount > 0 ? candidate->root : -1};
+        IntervalTree<SeriesRecord> candidateSeries = {
+            reinterpret_cast<const SeriesRecord *>(data + layout.series), reinterpret_cast<const IndexNode *>(data + layout.seriesNodes),
+            reinterpret_cast<const uint32_t *>(data + layout.seriesByStart), reinterpret_cast<const uint32_t *>(data + layout.seriesByEnd),
+            candidate->seriesCount > 0 ? candidate->seriesRoot : -1};
+        if (!candidateEvents.valid(candidate->nodeCount, candidate->eventCount) ||
+            !candidateSeries.valid(candidate->seriesNodeCount, candidate->seriesCount))
+            return false;
+        auto validTitle = [candidate](uint32_t offset, uint16_t length)
+        { return uint64_t(offset) + length <= candidate->titleBytes; };
+        for (uint32_t i = 0; i < candidate->eventCount; i++)
+        {
+            const EventRecord &record = candidateEvents.records[i];
+            if (!validTitle(record.titleOffset, record.titleLength) || record.duration == 0)
+                return false;
+        }
+        for (uint32_t i = 0; i < candidate->seriesCount; i++)
+        {
+            const SeriesRecord &record = candidateSeries.records[i];
+            if (!validTitle(record.titleOffset, record.titleLength) || record.duration == 0 || record.interval == 0 ||
+                record.frequency > MONTHLY || (record.frequency == WEEKLY && (record.weekdays & 0x7f) == 0) ||
+                uint64_t(record.firstException) + record.exceptionCount > candidate->exceptionCount)
+                return false;
+        }
+
+        image = data;
+        imageSize = size;
+        header = candidate;
+        events = candidateEvents;
+        series = candidateSeries;
+        exceptions = reinterpret_cast<const int64_t *>(data + layout.exceptions);
+        titles = data + layout.titles;
+        nextId = max(nextId, header->nextId);
+        removed.clear();
+        removedCount = 0;
+        slots.clear();
+        return true;
+    }
+
+    uint32_t indexedCount() const
+    {
+        return header != nullptr ? header->eventCount : 0;
+    }
+
+    uint32_t indexedSeriesCount() const
+    {
+        return header != nullptr ? header->seriesCount : 0;
+    }
+
+    bool isRemoved(uint32_t slot) const
+    {
+        return removedCount > 0 && removed[slot];
+    }
+
+    // The slot of an indexed event or series that is still live
+    bool findIndexed(uint32_t id, uint32_t &slot)
+    {
+        if (slots.empty())
+        {
+            removed.assign(indexedCount() + indexedSeriesCount(), 0);
+            for (uint32_t position = 0; position < indexedCount(); position++)
+                slots.push_back({events.records[position].id, position});
+            for (uint32_t position = 0; position < indexedSeriesCount(); position++)
+                slots.push_back({series.records[position].id, indexedCount() + position});
+            sort(slots.begin(), slots.end());
+        }
+        auto found = lower_bound(slots.begin(), slots.end(), make_pair(id, 0u));
+        if (found == slots.end() || found->first != id || removed[found->second])
+            return false;
+        slot = found->second;
+        return true;
+    }
+
+    void markRemoved(uint32_t slot)
+    {
+        removed[slot] = 1;
+        removedCount++;
+        dirty = true;
+    }
+
+    // A series open for changes, an indexed one is moved to the pending list
+    PendingSeries *editableSeries(uint32_t id)
+    {
+        for (PendingSeries &entry : pendingSeries)
+            if (entry.record.id == id)
+                return (entry.record.flags & EVENT_REMOVED) ? nullptr : &entry;
+
+        uint32_t slot;
+        if (!findIndexed(id, slot) || slot < indexedCount())
+            return nullptr;
+        const SeriesRecord &record = series.records[slot - indexedCount()];
+        const int64_t *skipped = exceptions + record.firstException;
+        pendingSeries.push_back({record, vector<int64_t>(skipped, skipped + record.exceptionCount)});
+        pendingSeries.back().record.titleOffset = static_cast<uint32_t>(pendingTitles.size());
+        pendingTitles.append(titles + record.titleOffset, record.titleLength);
+        markRemoved(slot);
+        return &pendingSeries.back();
+    }
+
+    template <typename Visit>
+    static void expand(const SeriesRecord &record, const int64_t *skipped, const char *titleArea,
+                       int64_t from, int64_t to, Visit &visit)
+    {
+        OccurrenceIterator occurrences(record, skipped, from, to);
+        int64_t start;
+        while (occurrences.next(start))
+            visit(EventView{record.id, start, start + record.duration, titleArea + record.titleOffset, record.titleLength, &record});
+    }
+
+public:
+    EventStore() = default;
+    ~EventStore() { unmap(); }
+
+    EventStore(const EventStore &) = delete;
+    EventStore &operator=(const EventStore &) = delete;
+
+    // Map a saved image. The file must only ever be replaced by rename,
+    // never rewritten in place, while it is mapped.
+    bool load(const string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED)
+            return false;
+
+        clear();
+        if (!attach(static_cast<const char *>(address), info.st_size))
+        {
+            munmap(address, info.st_size);
+            return false;
+        }
+        mapped = true;
+        madvise(address, info.st_size, MADV_RANDOM);
+        return true;
+    }
+
+    // Fold pending and removed entries into a new in-memory image
+    void rebuild()
+    {
+        vector<EventRecord> liveEvents;
+        vector<SeriesRecord> liveSeries;
+        vector<int64_t> liveExceptions;
+        string liveTitles;
+        auto keepTitle = [&liveTitles](auto &record, const char *title)
+        {
+            record.titleOffset = static_cast<uint32_t>(liveTitles.size());
+            record.flags &= ~EVENT_REMOVED;
+            liveTitles.append(title, record.titleLength);
+        };
+        auto keepSeries = [&](SeriesRecord record, const int64_t *skipped, const char *title)
+        {
+            keepTitle(record, title);
+            record.firstException = static_cast<uint32_t>(liveExceptions.size());
+            liveExceptions.insert(liveExceptions.end(), skipped, skipped + record.exceptionCount);
+            liveSeries.push_back(record);
+        };
+
+        liveEvents.reserve(indexedCount() + pending.size());
+        for (uint32_t position = 0; position < indexedCount(); position++)
+        {
+            if (isRemoved(position))
+                continue;
+            liveEvents.push_back(events.records[position]);
+            keepTitle(liveEvents.back(), titles + events.records[position].titleOffset);
+        }
+        for (const EventRecord &event : pending)
+        {
+            if (event.flags & EVENT_REMOVED)
+                continue;
+            liveEvents.push_back(event);
+            keepTitle(liveEvents.back(), pendingTitles.data() + event.titleOffset);
+        }
+        for (uint32_t position = 0; position < indexedSeriesCount(); position++)
+        {
+            const SeriesRecord &record = series.records[position];
+            if (!isRemoved(indexedCount() + position))
+                keepSeries(record, exceptions + record.firstException, titles + record.titleOffset);
+        }
+        for (const PendingSeries &entry : pendingSeries)
+            if (!(entry.record.flags & EVENT_REMOVED))
+                keepSeries(entry.record, entry.exceptions.data(), pendingTitles.data() + entry.record.titleOffset);
+
+        vector<char> next = buildImage(move(liveEvents), move(liveSeries), liveExceptions, liveTitles, nextId);
+        unmap();
+        owned.swap(next);
+        attach(owned.data(), owned.size());
+        pending.clear();
+        pendingSeries.clear();
+        pendingTitles.clear();
+    }
+
+    // Write the image next to the old one and swap it in atomically
+    bool save(const string &path, uint64_t &chargedBytes)
+    {
+        if (!pending.empty() || !pendingSeries.empty() || removedCount > 0 || header == nullptr)
+            rebuild();
+
+        int64_t delta = static_cast<int64_t>(imageSize) - static_cast<int64_t>(chargedBytes);
+        if (!diskLedger.charge(taskPid, delta))
+        {
+            cerr << "Disk quota exceeded, calendar not saved" << endl;
+            return false;
+        }
+
+        string tempPath = path + ".tmp";
+        int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && writeAll(fd, image, imageSize) && fsync(fd) == 0;
+        if (fd >= 0)
+            close(fd);
+        if (!ok || rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            cerr << "Failed to write " << path << endl;
+            diskLedger.charge(taskPid, -delta);
+            return false;
+        }
+        chargedBytes = imageSize;
+        dirty = false;
+        return true;
+    }
+
+    void clear()
+    {
+        unmap();
+        owned.clear();
+        removed.clear();
+        removedCount = 0;
+        slots.clear();
+        pending.clear();
+        pendingSeries.clear();
+        pendingTitles.clear();
+    }
+
+    uint32_t add(int64_t start, int64_t end, const string &title)
+    {
+        int64_t duration = min<int64_t>(max<int64_t>(end - start, 1), UINT32_MAX);
+        EventRecord event = {start, static_cast<uint32_t>(duration), nextId++, static_cast<uint32_t>(pendingTitles.size()),
+                             static_cast<uint16_t>(min(title.size(), MAX_TITLE)), 0};
+        pendingTitles.append(title, 0, event.titleLength);
+        pending.push_back(event);
+        dirty = true;
+        return event.id;
+    }
+
+    // A series whose first occurrence is at start. Weekly series without
+    // weekdays repeat on the weekday of start; skipped must be ascending.
+    uint32_t addSeries(int64_t start, int64_t duration, Frequency frequency, unsigned interval, unsigned weekdays,
+                       int64_t until, const string &title, vector<int64_t> skipped = {})
+    {
+        SeriesRecord record = {};
+        record.start = start;
+        record.until = max(min(until, OPEN_ENDED), start + 1);
+        record.duration = static_cast<uint32_t>(min<int64_t>(max<int64_t>(duration, 1), UINT32_MAX));
+        record.id = nextId++;
+        record.titleOffset = static_cast<uint32_t>(pendingTitles.size());
+        record.titleLength = static_cast<uint16_t>(min(title.size(), MAX_TITLE));
+        record.exceptionCount = static_cast<uint32_t>(skipped.size());
+        record.interval = static_cast<uint16_t>(min(max(interval, 1u), 65535u));
+        record.frequency = frequency;
+        record.weekdays = static_cast<uint8_t>((weekdays & 0x7f) ? weekdays & 0x7f : 1u << weekdayFromDays(dayOfMinute(start)));
+        pendingTitles.append(title, 0, record.titleLength);
+        pendingSeries.push_back({record, move(skipped)});
+        dirty = true;
+        return record.id;
+    }
+
+    // Skip the occurrence of a series that starts on the given day
+    bool skipOccurrence(uint32_t id, int64_t day)
+    {
+        PendingSeries *entry = editableSeries(id);
+        if (entry == nullptr)
+            return false;
+        OccurrenceIterator occurrences(entry->record, entry->exceptions.data(), day * MINUTES_PER_DAY, (day + 1) * MINUTES_PER_DAY);
+        int64_t start;
+        while (occurrences.next(start))
+        {
+            if (dayOfMinute(start) != day)
+                continue;
+            entry->exceptions.insert(lower_bound(entry->exceptions.begin(), entry->exceptions.end(), start), start);
+            entry->record.exceptionCount++;
+            dirty = true;
+            return true;
+        }
+        return false;
+    }
+
+    // Stop a series before the given day
+    bool endSeries(uint32_t id, int64_t day)
+    {
+        PendingSeries *entry = editableSeries(id);
+        if (entry == nullptr || day * MINUTES_PER_DAY <= entry->record.start)
+            return false;
+        entry->record.until = min(entry->record.until, day * MINUTES_PER_DAY);
+        dirty = true;
+        return true;
+    }
+
+    // Delete a single event or a whole series
+    bool remove(uint32_t id)
+    {
+        auto byId = [](const EventRecord &event, uint32_t id)
+        { return event.id < id; };
+        auto inPending = lower_bound(pending.begin(), pending.end(), id, byId);
+        if (inPending != pending.end() && inPending->id == id)
+        {
+            if (inPending->flags & EVENT_REMOVED)
+                return false;
+            inPending->flags |= EVENT_REMOVED;
+            dirty = true;
+            return true;
+        }
+        for (PendingSeries &entry : pendingSeries)
+        {
+            if (entry.record.id != id)
+                continue;
+            if (entry.record.flags & EVENT_REMOVED)
+                return false;
+            entry.record.flags |= EVENT_REMOVED;
+            dirty = true;
+            return true;
+        }
+
+        uint32_t slot;
+        if (!findIndexed(id, slot))
+            return false;
+        markRemoved(slot);
+        return true;
+    }
+
+    // Single events plus series
+    size_t size() const
+    {
+        size_t live = indexedCount() + indexedSeriesCount() - removedCount;
+        for (const EventRecord &event : pending)
+            live += !(event.flags & EVENT_REMOVED);
+        for (const PendingSeries &entry : pendingSeries)
+            live += !(entry.record.flags & EVENT_REMOVED);
+        return live;
+    }
+
+    bool isDirty() const { return dirty; }
+    size_t bytes() const { return imageSize; }
+
+    // Visit every event and occurrence overlapping [from, to), in O(log n + k)
+    // for each tree plus the short pending lists. Order is unspecified.
+    template <typename Visit>
+    void overlapping(int64_t from, int64_t to, Visit visit)
+    {
+        if (from >= to)
+            return;
+        if (pending.size() + pendingSeries.size() >= REBUILD_PENDING)
+            rebuild();
+
+        auto single = [&](uint32_t position)
+        {
+            const EventRecord &event = events.records[position];
+            if (!isRemoved(position))
+                visit(EventView{event.id, event.start, event.end(), titles + event.titleOffset, event.titleLength, nullptr});
+        };
+        auto recurring = [&](uint32_t position)
+        {
+            const SeriesRecord &record = series.records[position];
+            if (!isRemoved(indexedCount() + position))
+                expand(record, exceptions + record.firstException, titles, from, to, visit);
+        };
+        events.query(events.root, from, to, single);
+        series.query(series.root, from, to, recurring);
+
+        for (const EventRecord &event : pending)
+            if (!(event.flags & EVENT_REMOVED) && event.start < to && event.end() > from)
+                visit(EventView{event.id, event.start, event.end(), pendingTitles.data() + event.titleOffset, event.titleLength, nullptr});
+        for (const PendingSeries &entry : pendingSeries)
+            if (!(entry.record.flags & EVENT_REMOVED) && entry.record.start < to && entry.record.end() > from)
+                expand(entry.record, entry.exceptions.data(), pendingTitles.data(), from, to, visit);
+    }
+
+    vector<EventView> collect(int64_t from, int64_t to)
+    {
+        vector<EventView> found;
+        overlapping(from, to, [&found](const EventView &event)
+                    { found.push_back(event); });
+        sort(found.begin(), found.end(), [](const EventView &a, const EventView &b)
+             { return a.start != b.start ? a.start < b.start : a.id < b.id; });
+        return found;
+    }
+
+    // Every live series with its skipped occurrences
+    template <typename Visit>
+    void forEachSeries(Visit visit) const
+    {
+        for (uint32_t position = 0; position < indexedSeriesCount(); position++)
+            if (!isRemoved(indexedCount() + position))
+                visit(series.records[position], exceptions + series.records[position].firstException);
+        for (const PendingSeries &entry : pendingSeries)
+            if (!(entry.record.flags & EVENT_REMOVED))
+                visit(entry.record, entry.exceptions.data());
+    }
+};
+
+// ===== Month grid =====
+
+// Lay out a month from the weekday of its first day and its length, one
+// range query marks the days that have events
+string renderMonth(EventStore &store, int64_t year, unsigned month, int64_t today)
+{
+    int64_t first = daysFromCivil(year, month, 1);
+    unsigned length = daysInMonth(year, month);
+    unsigned offset = weekdayFromDays(first);
+
+    vector<unsigned> busy(length, 0);
+    store.overlapping(first * MINUTES_PER_DAY, (first + length) * MINUTES_PER_DAY, [&](const EventView &event)
+                      {
+                          int64_t from = max(dayOfMinute(event.start), first);
+                          int64_t to = min(dayOfMinute(event.end - 1), first + length - 1);
+                          for (int64_t day = from; day <= to; day++)
+                              busy[day - first]++; });
+
+    ostringstream out;
+    string title = string(MONTH_NAMES[month - 1]) + " " + to_string(year);
+    out << string((28 - title.size()) / 2, ' ') << title << "\n";
+    out << " Mo  Tu  We  Th  Fr  Sa  Su\n";
+    out << string(offset * 4, ' ');
+    char cell[8];
+    for (unsigned day = 1; day <= length; day++)
+    {
+        int64_t days = first + day - 1;
+        if (days == today)
+            snprintf(cell, sizeof(cell), "[%2u]", day);
+        else
+            snprintf(cell, sizeof(cell), " %2u%c", day, busy[day - 1] ? '*' : ' ');
+        out << cell;
+        if ((offset + day) % 7 == 0 || day == length)
+            out << "\n";
+    }
+    return out.str();
+}
+
+void printEvents(const vector<EventView> &found)
+{
+    if (found.empty())
+    {
+        cout << "  (no events)" << endl;
+        return;
+    }
+    for (const EventView &event : found)
+    {
+        string to = formatMinute(event.end);
+        if (dayOfMinute(event.start) == dayOfMinute(event.end))
+            to = to.substr(11);
+        cout << "  #" << left << setw(8) << event.id << right << formatMinute(event.start) << " - " << to
+             << "  " << string(event.title, event.titleLength);
+        if (event.series != nullptr)
+            cout << "  (" << describeRule(*event.series) << ")";
+        cout << endl;
+    }
+}
+
+// ===== Benchmark =====
+
+template <typename Body>
+double millisecondsOf(Body body)
+{
+    auto begin = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+// Weekday of the first day and month length through mktime, one call per day
+void naiveMonthLayout(int year, int month, unsigned &offset, unsigned &length)
+{
+    offset = 0;
+    length = 0;
+    for (int day = 1; day <= 31; day++)
+    {
+        struct tm date = {};
+        date.tm_year = year - 1900;
+        date.tm_mon = month - 1;
+        date.tm_mday = day;
+        date.tm_hour = 12;
+        date.tm_isdst = -1;
+        mktime(&date);
+        if (date.tm_mon != month - 1)
+            break;
+        if (day == 1)
+            offset = (date.tm_wday + 6) % 7;
+        length = day;
+    }
+}
+
+int benchCalendar(size_t eventCount)
+{
+    system("mkdir -p simulated_disk");
+    cout << fixed << setprecision(2);
+
+    // Date math: round trips over 5,000 years and agreement with timegm
+    const int64_t spanDays = 5000 * 366;
+    bool ok = true;
+    volatile int64_t sink = 0;
+    double toCivil = millisecondsOf([&]
+                                    {
+                                        for (int64_t days = -spanDays; days < spanDays; days++)
+                                        {
+                                            CivilDate date = civilFromDays(days);
+                                            sink = sink + date.day;
+                                        } });
+    double fromCivil = millisecondsOf([&]
+                                      {
+                                          for (int64_t year = -2500; year < 2500; year++)
+                                              for (unsigned month = 1; month <= 12; month++)
+                                                  for (unsigned day = 1; day <= 28; day++)
+                                                      sink = sink + daysFromCivil(year, month, day); });
+    int64_t earliest = daysFromCivil(-5000, 1, 1);
+    for (int64_t days = earliest; days < -earliest; days++)
+    {
+        CivilDate date = civilFromDays(days);
+        ok = ok && daysFromCivil(date.year, date.month, date.day) == days && date.day <= daysInMonth(date.year, date.month);
+    }
+    size_t timegmCalls = 0;
+    double viaTimegm = millisecondsOf([&]
+                                      {
+                                          for (int year = 1900; year < 2100; year++)
+                                              for (int month = 1; month <= 12; month++)
+                                                  for (int day = 1; day <= 28; day++)
+                                                  {
+                                                      struct tm date = {};
+                                                      date.tm_year = year - 1900;
+                                                      date.tm_mon = month - 1;
+                                                      date.tm_mday = day;
+                                                      time_t seconds = timegm(&date);
+                                                      ok = ok && seconds / 86400 == daysFromCivil(year, month, day) &&
+                                                           static_cast<unsigned>((date.tm_wday + 6) % 7) == weekdayFromDays(seconds / 86400);
+                                                      timegmCalls++;
+                                                  } });
+    cout << "Date math" << (ok ? "" : "  MISMATCH") << endl;
+    cout << "  civilFromDays  " << toCivil * 1e6 / (2 * spanDays) << " ns" << endl;
+    cout << "  daysFromCivil  " << fromCivil * 1e6 / (5000 * 12 * 28) << " ns" << endl;
+    cout << "  timegm         " << viaTimegm * 1e6 / timegmCalls << " ns (checked)" << endl;
+
+    // Month layout for 200 years, arithmetic against a mktime per day
+    bool layoutOk = true;
+    double arithmetic = millisecondsOf([&]
+                                       {
+                                           for (int year = 1900; year < 2100; year++)
+                                               for (unsigned month = 1; month <= 12; month++)
+                                                   sink = sink + weekdayFromDays(daysFromCivil(year, month, 1)) + daysInMonth(year, month); });
+    double naive = millisecondsOf([&]
+                                  {
+                                      for (int year = 1900; year < 2100; year++)
+                                          for (int month = 1; month <= 12; month++)
+                                          {
+                                              unsigned offset, length;
+                                              naiveMonthLayout(year, month, offset, length);
+                                              layoutOk = layoutOk && offset == weekdayFromDays(daysFromCivil(year, month, 1)) &&
+                                                         length == daysInMonth(year, month);
+                                          } });
+    cout << "Month layout, 2400 months" << (layoutOk ? "" : "  MISMATCH") << endl;
+    cout << "  arithmetic     " << arithmetic << " ms" << endl;
+    cout << "  mktime per day " << naive << " ms" << endl;
+
+    // Event store
+    mt19937_64 random(48);
+    const int64_t from = daysFromCivil(2000, 1, 1) * MINUTES_PER_DAY;
+    const int64_t to = daysFromCivil(2040, 1, 1) * MINUTES_PER_DAY;
+    EventStore store;
+    string title;
+    double addTime = millisecondsOf([&]
+                                    {
+                                        for (size_t i = 0; i < eventCount; i++)
+                                        {
+                                            int64_t start = from + static_cast<int64_t>(random() % (to - from));
+                                            unsigned kind = random() % 100;
+                                            int64_t length = kind < 70   ? 15 + random() % 180
+                                                             : kind < 95 ? MINUTES_PER_DAY * (1 + random() % 3)
+                                                                         : MINUTES_PER_DAY * (1 + random() % 60);
+                                            title = "Event " + to_string(i);
+                                            store.add(start, start + length, title);
+                                        }
+                                        store.rebuild(); });
+    cout << "Event store, " << eventCount << " events" << endl;
+    cout << "  add and build  " << addTime << " ms" << endl;
+
+    string path = "simulated_disk/calendar_bench.bin";
+    uint64_t charged = 0;
+    double saveTime = millisecondsOf([&]
+                                     { ok = store.save(path, charged); });
+    cout << "  save           " << saveTime << " ms, " << store.bytes() << " bytes ("
+         << static_cast<double>(store.bytes()) / max<size_t>(eventCount, 1) << " per event)" << endl;
+
+    EventStore loaded;
+    double loadTime = millisecondsOf([&]
+                                     { ok = ok && loaded.load(path); });
+    cout << "  load (mapped)  " << loadTime * 1000 << " us" << endl;
+
+    // Week queries against the mapped image, a sample checked by full scans
+    const size_t queries = 100000;
+    vector<int64_t> starts(queries);
+    for (int64_t &start : starts)
+        start = from + static_cast<int64_t>(random() % (to - from));
+    size_t hits = 0;
+    double queryTime = millisecondsOf([&]
+                                      {
+                                          for (int64_t start : starts)
+                                              loaded.overlapping(start, start + 7 * MINUTES_PER_DAY, [&hits](const EventView &)
+                                                                 { hits++; }); });
+
+    // Delete some indexed events and add a few pending ones, then check a
+    // sample of queries against full scans
+    for (uint32_t id = 1; id <= eventCount; id += 100)
+        ok = ok && loaded.remove(id);
+    for (size_t q = 0; q < 100; q++)
+        loaded.add(starts[q], starts[q] + 90, "Pending");
+    vector<EventView> all = loaded.collect(INT64_MIN / 2, INT64_MAX / 2);
+    const size_t checked = 200;
+    vector<vector<uint32_t>> expected(checked);
+    double scanTime = millisecondsOf([&]
+                                     {
+                                         for (size_t q = 0; q < checked; q++)
+                                             for (const EventView &event : all)
+                                                 if (event.start < starts[q] + 7 * MINUTES_PER_DAY && event.end > starts[q])
+                                                     expected[q].push_back(event.id);
+                                     });
+    bool queryOk = all.size() == loaded.size();
+    for (size_t q = 0; q < checked; q++)
+    {
+        vector<uint32_t> actual;
+        loaded.overlapping(starts[q], starts[q] + 7 * MINUTES_PER_DAY, [&actual](const EventView &event)
+                           { actual.push_back(event.id); });
+        sort(actual.begin(), actual.end());
+        sort(expected[q].begin(), expected[q].end());
+        queryOk = queryOk && actual == expected[q];
+    }
+    cout << "  week query     " << queryTime * 1e6 / queries << " ns, " << static_cast<double>(hits) / queries
+         << " events each" << (queryOk ? "" : "  MISMATCH") << endl;
+    cout << "  linear scan    " << scanTime * 1e6 / checked << " ns" << endl;
+
+    unlink(path.c_str());
+    diskLedger.charge(taskPid, -static_cast<int64_t>(charged));
+    return ok && layoutOk && queryOk ? 0 : 1;
+}
+
+// Occurrence test straight from the rule, one day at a time
+bool occursOn(const SeriesRecord &series, int64_t day)
+{
+    int64_t startDay = dayOfMinute(series.start);
+    if (day < startDay)
+        return false;
+    if (series.frequency == DAILY)
+        return (day - startDay) % series.interval == 0;
+    if (series.frequency == WEEKLY)
+    {
+        int64_t weeks = (day - weekdayFromDays(day) - (startDay - weekdayFromDays(startDay))) / 7;
+        return weeks % series.interval == 0 && ((series.weekdays >> weekdayFromDays(day)) & 1);
+    }
+    CivilDate first = civilFromDays(startDay);
+    CivilDate date = civilFromDays(day);
+    int64_t months = (date.year - first.year) * 12 + date.month - first.month;
+    return date.day == first.day && months % series.interval == 0;
+}
+
+int benchRecurring(size_t seriesCount)
+{
+    system("mkdir -p simulated_disk");
+    cout << fixed << setprecision(2);
+
+    // Series starting between 2015 and mid 2026, half of them open ended
+    mt19937_64 random(49);
+    const int64_t firstDay = daysFromCivil(2015, 1, 1);
+    const int64_t lastDay = daysFromCivil(2026, 7, 1);
+    const unsigned MONTHLY_INTERVALS[] = {1, 1, 1, 3, 6, 12};
+    EventStore store;
+    size_t skips = 0;
+    double addTime = millisecondsOf([&]
+                                    {
+                                        for (size_t i = 0; i < seriesCount; i++)
+                                        {
+                                            int64_t day = firstDay + static_cast<int64_t>(random() % (lastDay - firstDay));
+                                            int64_t start = day * MINUTES_PER_DAY + 6 * 60 + static_cast<int64_t>(random() % 57) * 15;
+                                            unsigned kind = random() % 100;
+                                            Frequency frequency = kind < 35 ? DAILY : kind < 80 ? WEEKLY : MONTHLY;
+                                            unsigned interval = frequency == DAILY    ? 1 + random() % 3
+                                                                : frequency == WEEKLY ? 1 + random() % 2
+                                                                                      : MONTHLY_INTERVALS[random() % 6];
+                                            int64_t duration = random() % 10 == 0 ? MINUTES_PER_DAY : 15 + static_cast<int64_t>(random() % 8) * 15;
+                                            int64_t until = random() % 2 ? OPEN_ENDED : start + static_cast<int64_t>(1 + random() % 15) * 365 * MINUTES_PER_DAY;
+                                            store.addSeries(start, duration, frequency, interval, random() & 0x7f, until, "Series " + to_string(i));
+                                        }
+                                        store.rebuild();
+
+                                        // Skip a few occurrences in every fifth series, editing the indexed ones
+                                        for (uint32_t id = 1; id <= seriesCount; id += 5)
+                                            for (int attempt = 0; attempt < 8; attempt++)
+                                                skips += store.skipOccurrence(id, firstDay + static_cast<int64_t>(random() % (12 * 366)));
+                                        store.rebuild(); });
+    cout << "Recurring series: " << seriesCount << ", " << skips << " skipped occurrences" << endl;
+    cout << "  add and build  " << addTime << " ms" << endl;
+
+    // What storing every occurrence through 2039 would take instead
+    const int64_t horizon = daysFromCivil(2040, 1, 1) * MINUTES_PER_DAY;
+    size_t expanded = 0;
+    store.forEachSeries([&](const SeriesRecord &series, const int64_t *skipped)
+                        {
+                            OccurrenceIterator occurrences(series, skipped, series.start, horizon);
+                            int64_t start;
+                            while (occurrences.next(start))
+                                expanded++; });
+    cout << "  image          " << store.bytes() << " bytes, pre-expanded through 2039: " << expanded << " events, "
+         << expanded * sizeof(EventRecord) / (1 << 20) << " MB" << endl;
+
+    // Year, month and week views of 2026
+    const int64_t yearFrom = daysFromCivil(2026, 1, 1) * MINUTES_PER_DAY;
+    const int64_t yearTo = daysFromCivil(2027, 1, 1) * MINUTES_PER_DAY;
+    auto view = [&store](int64_t from, int64_t to, uint64_t &checksum)
+    {
+        size_t found = 0;
+        store.overlapping(from, to, [&](const EventView &event)
+                          {
+                              found++;
+                              checksum += static_cast<uint64_t>(event.start) * 31 + event.id; });
+        return found;
+    };
+    size_t yearCount = 0;
+    uint64_t yearChecksum = 0;
+    double yearTime = 1e300;
+    for (int round = 0; round < 3; round++)
+    {
+        uint64_t checksum = 0;
+        yearTime = min(yearTime, millisecondsOf([&]
+                                                { yearCount = view(yearFrom, yearTo, checksum); }));
+        yearChecksum = checksum;
+    }
+    size_t monthCount = 0, weekCount = 0;
+    uint64_t unused = 0;
+    double monthTime = millisecondsOf([&]
+                                      {
+                                          for (unsigned month = 1; month <= 12; month++)
+                                              monthCount += view(daysFromCivil(2026, month, 1) * MINUTES_PER_DAY,
+                                                                 (daysFromCivil(2026, month, 1) + daysInMonth(2026, month)) * MINUTES_PER_DAY, unused); });
+    const int64_t firstMonday = daysFromCivil(2026, 1, 5);
+    double weekTime = millisecondsOf([&]
+                                     {
+                                         for (int64_t week = 0; week < 52; week++)
+                                             weekCount += view((firstMonday + week * 7) * MINUTES_PER_DAY, (firstMonday + week * 7 + 7) * MINUTES_PER_DAY, unused); });
+    cout << "  year view      " << yearTime << " ms, " << yearCount << " occurrences" << endl;
+    cout << "  month view     " << monthTime / 12 << " ms, " << monthCount / 12 << " occurrences" << endl;
+    cout << "  week view      " << weekTime / 52 << " ms, " << weekCount / 52 << " occurrences" << endl;
+
+    // The same year by stepping every series from its first occurrence
+    size_t steppedCount = 0;
+    uint64_t steppedChecksum = 0;
+    double stepTime = millisecondsOf([&]
+                                     {
+                                         store.forEachSeries([&](const SeriesRecord &series, const int64_t *skipped)
+                                                             {
+                                                                 OccurrenceIterator occurrences(series, skipped, series.start, yearTo);
+                                                                 int64_t start;
+                                                                 while (occurrences.next(start))
+                                                                     if (start + series.duration > yearFrom)
+                                                                     {
+                                                                         steppedCount++;
+                                                                         steppedChecksum += static_cast<uint64_t>(start) * 31 + series.id;
+                                                                     } }); });
+    bool ok = steppedCount == yearCount && steppedChecksum == yearChecksum;
+    cout << "  stepping       " << stepTime << " ms" << (ok ? "" : "  MISMATCH") << endl;
+
+    // A sample of series checked day by day against the rule itself
+    size_t sampled = 0;
+    bool rulesOk = true;
+    store.forEachSeries([&](const SeriesRecord &series, const int64_t *skipped)
+                        {
+                            if (sampled++ >= 2000)
+                                return;
+                            vector<int64_t> expected, actual;
+                            int64_t lowest = max(series.start, yearFrom - static_cast<int64_t>(series.duration) + 1);
+                            int64_t timeOfDay = series.start - dayOfMinute(series.start) * MINUTES_PER_DAY;
+                            for (int64_t day = dayOfMinute(lowest); day * MINUTES_PER_DAY < min(yearTo, series.until); day++)
+                            {
+                                int64_t start = day * MINUTES_PER_DAY + timeOfDay;
+                                if (occursOn(series, day) && start >= lowest && start < min(yearTo, series.until) &&
+                                    !binary_search(skipped, skipped + series.exceptionCount, start))
+                                    expected.push_back(start);
+                            }
+                            OccurrenceIterator occurrences(series, skipped, yearFrom, yearTo);
+                            int64_t start;
+                            while (occurrences.next(start))
+                                actual.push_back(start);
+                            rulesOk = rulesOk && actual == expected; });
+    cout << "  rule check     " << min<size_t>(sampled, 2000) << " series" << (rulesOk ? "" : "  MISMATCH") << endl;
+
+    // Save, map and view the year again
+    string path = "simulated_disk/calendar_bench.bin";
+    uint64_t charged = 0;
+    ok = ok && store.save(path, charged);
+    EventStore loaded;
+    double loadTime = millisecondsOf([&]
+                                     { ok = ok && loaded.load(path); });
+    uint64_t loadedChecksum = 0;
+    size_t loadedCount = 0;
+    double loadedYear = millisecondsOf([&]
+                                       {
+                                           loaded.overlapping(yearFrom, yearTo, [&](const EventView &event)
+                                                              {
+                                                                  loadedCount++;
+                                                                  loadedChecksum += static_cast<uint64_t>(event.start) * 31 + event.id; }); });
+    ok = ok && loadedCount == yearCount && loadedChecksum == yearChecksum;
+    cout << "  load (mapped)  " << loadTime * 1000 << " us, cold year view " << loadedYear << " ms" << (ok ? "" : "  MISMATCH") << endl;
+
+    unlink(path.c_str());
+    diskLedger.charge(taskPid, -static_cast<int64_t>(charged));
+    return ok && rulesOk ? 0 : 1;
+}
+
+// ===== Interactive =====
+
+void printHelp()
+{
+    cout << "Commands:" << endl;
+    cout << "  n, p                             next / previous month" << endl;
+    cout << "  t                                back to today" << endl;
+    cout << "  g 2027-03                        go to a month" << endl;
+    cout << "  a 2026-10-20 14:30 90 Dentist    add an event: date, start, minutes, title" << endl;
+    cout << "  A 2026-12-24 3 Holidays          add an all-day event lasting some days" << endl;
+    cout << "  R weekly:mo,we 2026-10-19 09:00 15 Standup" << endl;
+    cout << "                                   add a series: daily, weekly or monthly, /n for every n" << endl;
+    cout << "  X <id> 2026-10-21                skip one occurrence of a series" << endl;
+    cout << "  U <id> 2027-01-01                end a series before a day" << endl;
+    cout << "  w                                events this week" << endl;
+    cout << "  d 2026-10-20                     events on a day" << endl;
+    cout << "  r 2026-10-01 2026-12-31          events in a range of days" << endl;
+    cout << "  x <id>                           delete an event or a whole series" << endl;
+    cout << "  s                                save" << endl;
+    cout << "  q                                save and quit" << endl;
+}
+
 int main(int argc, char *argv[])
 {
+    if (argc >= 2 && string(argv[1]) == "--bench-calendar")
+    {
+        return benchCalendar(argc >= 3 ? stoull(argv[2]) : 1000000);
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-recurring")
+    {
+        return benchRecurring(argc >= 3 ? stoull(argv[2]) : 100000);
+    }
+
     if (argc < 4)
     {
         cerr << "Usage: calendar <pid> <memory_required> <disk_required>" << endl;
+        cerr << "       calendar --bench-calendar [events]" << endl;
+        cerr << "       calendar --bench-recurring [series]" << endl;
         return 1;
     }
 
@@ -22,20 +1592,170 @@ int main(int argc, char *argv[])
     cout << "Calendar started with PID: " << pid << endl;
     cout << "Memory: " << memoryRequired << " MB, Disk: " << diskRequired << " MB" << endl;
 
-    // Main loop to display current date/time
-    for (int i = 0; i < 60; ++i)
+    system("mkdir -p simulated_disk");
+    taskPid = pid;
+    diskLedger.open(false);
+
+    // The saved calendar is mapped as is, its size is charged like a fresh write
+    EventStore store;
+    uint64_t chargedBytes = 0;
+    auto loadStart = chrono::steady_clock::now();
+    if (store.load(EVENTS_PATH))
     {
-        auto now = chrono::system_clock::now();
-        time_t now_time = chrono::system_clock::to_time_t(now);
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - loadStart).count();
+        chargedBytes = store.bytes();
+        diskLedger.charge(taskPid, chargedBytes);
+        cout << "Loaded " << store.size() << " events in " << fixed << setprecision(1) << micros << " us" << endl;
+    }
+
+    const int64_t offset = localOffsetMinutes();
+    int64_t today = dayOfMinute(currentMinute(offset));
+    CivilDate shown = civilFromDays(today);
 
-        cout << "\033[2J\033[1;1H"; // Clear screen
-        cout << "===== Calendar =====" << endl;
-        cout << "Current date and time: " << put_time(localtime(&now_time), "%Y-%m-%d %H:%M:%S") << endl;
-        cout << "Running for " << i << " seconds" << endl;
+    cout << "Now: " << formatMinute(currentMinute(offset)) << endl;
+    cout << renderMonth(store, shown.year, shown.month, today);
+    printHelp();
 
-        this_thread::sleep_for(chrono::seconds(1));
+    string line;
+    while (cout << "> " << flush, getline(cin, line))
+    {
+        istringstream in(line);
+        string command;
+        if (!(in >> command))
+            continue;
+
+        today = dayOfMinute(currentMinute(offset));
+        bool redraw = false;
+        if (command == "n" || command == "p")
+        {
+            int64_t index = shown.year * 12 + (shown.month - 1) + (command == "n" ? 1 : -1);
+            shown.year = index >= 0 ? index / 12 : (index - 11) / 12;
+            shown.month = static_cast<unsigned>(index - shown.year * 12 + 1);
+            redraw = true;
+        }
+        else if (command == "t")
+        {
+            shown = civilFromDays(today);
+            redraw = true;
+        }
+        else if (command == "g")
+        {
+            string month;
+            int64_t days;
+            if (in >> month && parseDate(month + "-01", days))
+            {
+                shown = civilFromDays(days);
+                redraw = true;
+            }
+            else
+                cout << "Expected a month like 2027-03" << endl;
+        }
+        else if (command == "a" || command == "A")
+        {
+            string date, time;
+            int64_t day, minutes = 0, length;
+            bool valid = in >> date && parseDate(date, day);
+            if (valid && command == "a")
+                valid = in >> time && parseTime(time, minutes);
+            valid = valid && in >> length && length > 0;
+            string title;
+            getline(in >> ws, title);
+            if (!valid || title.empty())
+            {
+                cout << "Expected: " << (command == "a" ? "a <date> <HH:MM> <minutes> <title>" : "A <date> <days> <title>") << endl;
+                continue;
+            }
+            int64_t start = day * MINUTES_PER_DAY + minutes;
+            int64_t end = command == "a" ? start + length : start + length * MINUTES_PER_DAY;
+            uint32_t id = store.add(start, end, title);
+            cout << "Added event #" << id << endl;
+            redraw = true;
+        }
+        else if (command == "R")
+        {
+            string rule, date, time;
+            Frequency frequency;
+            unsigned interval, weekdays;
+            int64_t day, minutes, length;
+            string title;
+            if (!(in >> rule >> date >> time >> length) || !parseRule(rule, frequency, interval, weekdays) ||
+                !parseDate(date, day) || !parseTime(time, minutes) || length <= 0 || !getline(in >> ws, title))
+            {
+                cout << "Expected: R <daily|weekly|monthly>[/n][:mo,tu,...] <date> <HH:MM> <minutes> <title>" << endl;
+                continue;
+            }
+            uint32_t id = store.addSeries(day * MINUTES_PER_DAY + minutes, length, frequency, interval, weekdays, OPEN_ENDED, title);
+            cout << "Added series #" << id << endl;
+            redraw = true;
+        }
+        else if (command == "X" || command == "U")
+        {
+            uint32_t id;
+            string date;
+            int64_t day;
+            if (!(in >> id >> date) || !parseDate(date, day))
+                cout << "Expected: " << command << " <id> <date>" << endl;
+            else if (command == "X" ? store.skipOccurrence(id, day) : store.endSeries(id, day))
+                redraw = true;
+            else
+                cout << (command == "X" ? "No occurrence of that series on " : "Cannot end that series on ") << date << endl;
+        }
+        else if (command == "w")
+        {
+            int64_t monday = today - weekdayFromDays(today);
+            cout << "Week of " << formatDate(monday) << ":" << endl;
+            printEvents(store.collect(monday * MINUTES_PER_DAY, (monday + 7) * MINUTES_PER_DAY));
+        }
+        else if (command == "d")
+        {
+            string date;
+            int64_t day;
+            if (in >> date && parseDate(date, day))
+                printEvents(store.collect(day * MINUTES_PER_DAY, (day + 1) * MINUTES_PER_DAY));
+            else
+                cout << "Expected a date like 2026-10-20" << endl;
+        }
+        else if (command == "r")
+        {
+            string first, last;
+            int64_t from, to;
+            if (in >> first >> last && parseDate(first, from) && parseDate(last, to) && from <= to)
+                printEvents(store.collect(from * MINUTES_PER_DAY, (to + 1) * MINUTES_PER_DAY));
+            else
+                cout << "Expected two dates like 2026-10-01 2026-12-31" << endl;
+        }
+        else if (command == "x")
+        {
+            uint32_t id;
+            if (in >> id && store.remove(id))
+            {
+                cout << "Deleted event #" << id << endl;
+                redraw = true;
+            }
+            else
+                cout << "No such event" << endl;
+        }
+        else if (command == "s")
+        {
+            if (store.save(EVENTS_PATH, chargedBytes))
+                cout << "Saved " << store.size() << " events and series (" << store.bytes() << " bytes)" << endl;
+        }
+        else if (command == "q")
+        {
+            break;
+        }
+        else
+        {
+            printHelp();
+        }
+
+        if (redraw)
+            cout << renderMonth(store, shown.year, shown.month, today);
     }
 
+    if (store.isDirty() && store.save(EVENTS_PATH, chargedBytes))
+        cout << "Saved " << store.size() << " events and series" << endl;
+
     cout << "Calendar task completed." << endl;
     return 0;
 }
@@ -6,8 +6,32 @@
 #include <signal.h>
 #include <sys/stat.h>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
 #include <unistd.h>
 #include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/statvfs.h>
+#include <unordered_map>
+#include <mutex>
+#include "../include/DiskLedger.h"
+#include "../include/DiskClient.h"
+#include <memory>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#include <sys/inotify.h>
+#endif
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -16,6 +40,43 @@ using namespace std;
 bool running = true;
 string currentDir = "simulated_disk";
 
+// Bytes this task writes are charged to its diskRequired quota in the OS ledger
+DiskLedger diskLedger;
+int taskPid = 0;
+
+// While the OS runs, copies go to its file store: content the store already
+// holds is kept once, and the space is charged to the OS disk rather than
+// to this task. Stored files are listed, read, moved and deleted alongside
+// the files in simulated_disk.
+DiskClient diskClient;
+
+// A path's name in the store, which is relative to simulated_disk
+std::string storeName(const std::string &path)
+{
+    const std::string root = "simulated_disk";
+    if (path == root)
+        return "";
+    return path.compare(0, root.size() + 1, root + "/") == 0 ? path.substr(root.size() + 1) : path;
+}
+
+// Prefix of the stored files inside a directory
+std::string storePrefix(const std::string &directory)
+{
+    std::string name = storeName(directory);
+    return name.empty() ? name : name + "/";
+}
+
+// Charge a change in stored bytes, printing why if the quota refuses it
+bool chargeDisk(int64_t bytes)
+{
+    if (diskLedger.charge(taskPid, bytes))
+        return true;
+    int64_t left = diskLedger.quota(taskPid) - diskLedger.used(taskPid);
+    std::cout << "Needs " << bytes << " bytes but only " << std::max<int64_t>(left, 0)
+              << " bytes of this task's disk quota are left" << std::endl;
+    return false;
+}
+
 // Signal handler for graceful shutdown
 void signalHandler(int signal)
 {
@@ -41,59 +102,407 @@ bool createDirectory(const std::string &path)
     }
 }
 
-// Function to list files and directories
-void listFiles(const std::string &path)
+#ifdef __linux__
+struct LinuxDirent64
 {
-    try
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// Call visit(name, type) for each entry of an open directory, type is a DT_* value
+template <typename Visit>
+bool readDirectory(int dirFd, Visit visit)
+{
+#ifdef __linux__
+    // getdents64 hands back many entries per syscall without any per-entry allocation
+    alignas(LinuxDirent64) char buffer[64 * 1024];
+    while (true)
     {
-        if (!fs::exists(path))
+        long count = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+        if (count < 0)
+            return false;
+        if (count == 0)
+            return true;
+
+        for (long offset = 0; offset < count;)
         {
-            std::cout << "Directory does not exist: " << path << std::endl;
-            return;
+            LinuxDirent64 *entry = reinterpret_cast<LinuxDirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            {
+                visit(entry->d_name, entry->d_type);
+            }
         }
+    }
+#else
+    DIR *dir = fdopendir(dup(dirFd));
+    if (dir == nullptr)
+        return false;
+    while (struct dirent *entry = readdir(dir))
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        {
+            visit(entry->d_name, entry->d_type);
+        }
+    }
+    closedir(dir);
+    return true;
+#endif
+}
+
+// Cached metadata for one directory entry. Sizes are fetched lazily, only
+// for entries that land on a displayed page.
+struct CachedEntry
+{
+    std::string name;
+    bool isDirectory;
+    bool sizeKnown;
+    uint64_t size;
+};
+
+// Sorted listing of one directory, kept coherent with inotify on Linux and
+// with the directory mtime elsewhere
+struct DirectoryCache
+{
+    std::vector<CachedEntry> entries; // Sorted by name
+    int watch = -1;
+    struct timespec mtime = {0, 0};
+    uint64_t lastUsed = 0;
+};
 
-        std::cout << "\nContents of " << path << ":\n"
-                  << std::endl;
-        std::cout << std::left << std::setw(30) << "Name"
-                  << std::setw(10) << "Type"
-                  << std::setw(10) << "Size (B)" << std::endl;
-        std::cout << std::string(50, '-') << std::endl;
+const size_t PAGE_ENTRIES = 50;
+const size_t MAX_CACHED_DIRECTORIES = 32;
+const size_t MAX_EVENTS_PER_REFRESH = 1024; // Past this, rescanning beats patching
 
-        for (const auto &entry : fs::directory_iterator(path))
+std::unordered_map<std::string, DirectoryCache> directoryCache;
+std::unordered_map<int, std::string> watchedDirectories; // inotify watch -> path
+int inotifyFd = -1;
+uint64_t cacheClock = 0;
+
+bool entryLess(const CachedEntry &a, const CachedEntry &b)
+{
+    return a.name < b.name;
+}
+
+void dropDirectoryCache(const std::string &path)
+{
+    auto it = directoryCache.find(path);
+    if (it == directoryCache.end())
+        return;
+#ifdef __linux__
+    if (it->second.watch >= 0)
+    {
+        inotify_rm_watch(inotifyFd, it->second.watch);
+        watchedDirectories.erase(it->second.watch);
+    }
+#endif
+    directoryCache.erase(it);
+}
+
+// Fetch type and size for one entry with a single statx/fstatat call
+bool statEntry(int dirFd, const char *name, bool &isDirectory, uint64_t &size)
+{
+#if defined(__linux__) && defined(STATX_SIZE)
+    struct statx info;
+    if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE, &info) != 0)
+        return false;
+    isDirectory = S_ISDIR(info.stx_mode);
+    size = S_ISREG(info.stx_mode) ? info.stx_size : 0;
+#else
+    struct stat info;
+    if (fstatat(dirFd, name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+        return false;
+    isDirectory = S_ISDIR(info.st_mode);
+    size = S_ISREG(info.st_mode) ? info.st_size : 0;
+#endif
+    return true;
+}
+
+// Apply queued inotify events to the cached listings
+void refreshDirectoryCaches()
+{
+#ifdef __linux__
+    if (inotifyFd < 0)
+        return;
+
+    std::unordered_map<std::string, size_t> eventCounts;
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t offset = 0; offset < length;)
         {
-            std::string type = entry.is_directory() ? "DIR" : "FILE";
-            uintmax_t fileSize = entry.is_regular_file() ? fs::file_size(entry) : 0;
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // Events were lost, nothing cached can be trusted
+                while (!directoryCache.empty())
+                    dropDirectoryCache(directoryCache.begin()->first);
+                continue;
+            }
+
+            auto watched = watchedDirectories.find(event->wd);
+            if (watched == watchedDirectories.end())
+                continue;
+            std::string path = watched->second;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED) ||
+                ++eventCounts[path] > MAX_EVENTS_PER_REFRESH)
+            {
+                dropDirectoryCache(path);
+                continue;
+            }
+
+            DirectoryCache &cache = directoryCache[path];
+            CachedEntry probe = {event->name, (event->mask & IN_ISDIR) != 0, false, 0};
+            auto it = std::lower_bound(cache.entries.begin(), cache.entries.end(), probe, entryLess);
+            bool found = it != cache.entries.end() && it->name == probe.name;
 
-            std::cout << std::left << std::setw(30) << entry.path().filename().string()
-                      << std::setw(10) << type
-                      << std::setw(10) << fileSize << std::endl;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                if (found)
+                    cache.entries.erase(it);
+            }
+            else if (event->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                if (found)
+                    *it = probe;
+                else
+                    cache.entries.insert(it, probe);
+            }
+            else if (found)
+            {
+                // Modified in place, fetch the size again when it is next shown
+                it->sizeKnown = false;
+            }
         }
     }
-    catch (const std::exception &e)
+#endif
+}
+
+// Return the cached listing for a directory, scanning it if needed
+DirectoryCache *getDirectoryCache(const std::string &path)
+{
+    refreshDirectoryCaches();
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+        return nullptr;
+
+    auto it = directoryCache.find(path);
+#ifndef __linux__
+    // Without inotify, a changed directory mtime means the listing is stale
+    if (it != directoryCache.end() && (it->second.mtime.tv_sec != info.st_mtimespec.tv_sec ||
+                                       it->second.mtime.tv_nsec != info.st_mtimespec.tv_nsec))
+    {
+        dropDirectoryCache(path);
+        it = directoryCache.end();
+    }
+#endif
+    if (it != directoryCache.end())
+    {
+        it->second.lastUsed = ++cacheClock;
+        return &it->second;
+    }
+
+    // Evict the least recently listed directory to bound memory and watches
+    if (directoryCache.size() >= MAX_CACHED_DIRECTORIES)
+    {
+        auto oldest = std::min_element(directoryCache.begin(), directoryCache.end(), [](const auto &a, const auto &b)
+                                       { return a.second.lastUsed < b.second.lastUsed; });
+        dropDirectoryCache(oldest->first);
+    }
+
+    DirectoryCache cache;
+#ifdef __linux__
+    // Watch before scanning so no change slips in between
+    if (inotifyFd >= 0)
+    {
+        cache.watch = inotify_add_watch(inotifyFd, path.c_str(),
+                                        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+                                            IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+        if (cache.watch >= 0)
+            watchedDirectories[cache.watch] = path;
+    }
+#else
+    cache.mtime = info.st_mtimespec;
+#endif
+
+    // One pass over the directory for names and types. Only filesystems that
+    // don't report d_type need a stat here, and then the size comes for free.
+    int dirFd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0)
+        return nullptr;
+    readDirectory(dirFd, [&cache, dirFd](const char *name, unsigned char type)
+                  {
+        CachedEntry entry = {name, type == DT_DIR, false, 0};
+        if (type == DT_UNKNOWN)
+            entry.sizeKnown = statEntry(dirFd, name, entry.isDirectory, entry.size);
+        cache.entries.push_back(std::move(entry)); });
+    close(dirFd);
+
+    std::sort(cache.entries.begin(), cache.entries.end(), entryLess);
+    cache.lastUsed = ++cacheClock;
+    return &(directoryCache[path] = std::move(cache));
+}
+
+// Append text padded to a column width
+void appendColumn(std::string &out, const std::string &text, size_t width)
+{
+    out += text;
+    if (text.size() < width)
+        out.append(width - text.size(), ' ');
+}
+
+// Print one page of a directory listing, returns the number of pages
+size_t showDirectoryPage(const std::string &path, size_t page)
+{
+    DirectoryCache *cache = getDirectoryCache(path);
+    if (cache == nullptr)
+    {
+        std::cout << "Directory does not exist: " << path << std::endl;
+        return 0;
+    }
+
+    size_t pages = std::max<size_t>(1, (cache->entries.size() + PAGE_ENTRIES - 1) / PAGE_ENTRIES);
+    page = std::min(page, pages - 1);
+    size_t first = page * PAGE_ENTRIES;
+    size_t last = std::min(first + PAGE_ENTRIES, cache->entries.size());
+
+    // Only the entries on this page are ever stat'ed
+    int dirFd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    std::string out = "\nContents of " + path + ":\n\n";
+    appendColumn(out, "Name", 30);
+    appendColumn(out, "Type", 10);
+    out += "Size (B)\n";
+    out.append(50, '-');
+    out += '\n';
+
+    for (size_t i = first; i < last; i++)
+    {
+        CachedEntry &entry = cache->entries[i];
+#ifdef __linux__
+        bool refetch = !entry.sizeKnown;
+#else
+        bool refetch = true; // No change notifications, so sizes aren't trusted
+#endif
+        if (refetch && dirFd >= 0 && !entry.isDirectory)
+        {
+            entry.sizeKnown = statEntry(dirFd, entry.name.c_str(), entry.isDirectory, entry.size);
+        }
+
+        appendColumn(out, entry.name, 30);
+        appendColumn(out, entry.isDirectory ? "DIR" : "FILE", 10);
+        out += std::to_string(entry.isDirectory ? 0 : entry.size);
+        out += '\n';
+    }
+    if (dirFd >= 0)
+        close(dirFd);
+
+    // Files the OS stores in this directory follow the last page
+    std::vector<std::pair<std::string, uint64_t>> stored;
+    std::string prefix = storePrefix(path);
+    if (page == pages - 1 && diskClient.storeList(prefix, stored))
+    {
+        stored.erase(std::remove_if(stored.begin(), stored.end(), [&prefix](const auto &file)
+                                    { return file.first.find('/', prefix.size()) != std::string::npos; }),
+                     stored.end());
+        for (const auto &file : stored)
+        {
+            appendColumn(out, file.first.substr(prefix.size()), 30);
+            appendColumn(out, "STORED", 10);
+            out += std::to_string(file.second);
+            out += '\n';
+        }
+    }
+
+    out += "\nPage " + std::to_string(page + 1) + " of " + std::to_string(pages) + " (" +
+           std::to_string(cache->entries.size()) + " entries";
+    if (!stored.empty())
     {
-        std::cerr << "Error listing files: " << e.what() << std::endl;
+        out += ", " + std::to_string(stored.size()) + " stored files";
+    }
+    out += ")\n";
+    std::cout << out << std::flush;
+    return pages;
+}
+
+// Function to list files and directories, one page at a time
+void listFiles(const std::string &path)
+{
+    size_t page = 0;
+    while (true)
+    {
+        size_t pages = showDirectoryPage(path, page);
+        if (pages <= 1)
+            return;
+
+        std::cout << "[n]ext, [p]revious, page number, or Enter to return: ";
+        std::string input;
+        std::getline(std::cin, input);
+        if (input == "n")
+            page = std::min(page + 1, pages - 1);
+        else if (input == "p")
+            page = page > 0 ? page - 1 : 0;
+        else if (input.empty())
+            return;
+        else
+        {
+            char *end;
+            errno = 0;
+            unsigned long number = std::strtoul(input.c_str(), &end, 10);
+            if (std::isdigit(static_cast<unsigned char>(input[0])) && *end == '\0' && errno == 0 &&
+                number >= 1 && number <= pages)
+                page = number - 1;
+            else
+                std::cout << "Enter n, p, or a page number from 1 to " << pages << std::endl;
+        }
     }
 }
 
 // Function to create a file
 bool createFile(const std::string &path, const std::string &content)
 {
+    // Overwriting a file only costs the growth
+    struct stat info;
+    int64_t existing = stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) ? info.st_size : 0;
+    int64_t charged = static_cast<int64_t>(content.size()) - existing;
+    if (!chargeDisk(charged))
+    {
+        return false;
+    }
+
+    bool written = false;
     try
     {
         std::ofstream file(path);
-        if (!file)
+        if (file)
         {
-            return false;
+            file << content;
+            file.close();
+            written = !file.fail();
         }
-        file << content;
-        file.close();
-        return true;
     }
     catch (const std::exception &e)
     {
         std::cerr << "Error creating file: " << e.what() << std::endl;
-        return false;
     }
+    if (written)
+    {
+        return true;
+    }
+
+    // Settle the charge against what is on disk now: a failed open left the
+    // old file as it was, a failed write may have truncated it
+    int64_t now = stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) ? info.st_size : 0;
+    diskLedger.charge(taskPid, now - existing - charged);
+    return false;
 }
 
 // Function to read a file
@@ -103,7 +512,8 @@ std::string readFile(const std::string &path)
     {
         if (!fs::exists(path))
         {
-            return "File does not exist: " + path;
+            std::string content;
+            return diskClient.storeRead(storeName(path), content) ? content : "File does not exist: " + path;
         }
 
         std::ifstream file(path);
@@ -129,11 +539,42 @@ bool deleteFileOrDir(const std::string &path)
     {
         if (!fs::exists(path))
         {
+            if (diskClient.storeRemove(storeName(path)))
+            {
+                std::cout << "Removed 1 stored file" << std::endl;
+                return true;
+            }
             std::cout << "File or directory does not exist: " << path << std::endl;
             return false;
         }
 
+        // Whatever is removed is handed back to the quota
+        uint64_t freed = 0;
+        if (fs::is_directory(path))
+        {
+            for (const auto &entry : fs::recursive_directory_iterator(path))
+            {
+                if (entry.is_regular_file())
+                    freed += entry.file_size();
+            }
+
+            // Stored files don't count against the quota, they just go too
+            std::vector<std::pair<std::string, uint64_t>> stored;
+            if (diskClient.storeList(storePrefix(path), stored))
+            {
+                for (const auto &file : stored)
+                    diskClient.storeRemove(file.first);
+                if (!stored.empty())
+                    std::cout << "Removed " << stored.size() << " stored files" << std::endl;
+            }
+        }
+        else if (fs::is_regular_file(path))
+        {
+            freed = fs::file_size(path);
+        }
+
         uintmax_t count = fs::remove_all(path);
+        diskLedger.charge(taskPid, -static_cast<int64_t>(freed));
         std::cout << "Removed " << count << " files/directories" << std::endl;
         return true;
     }
@@ -144,25 +585,772 @@ bool deleteFileOrDir(const std::string &path)
     }
 }
 
-// Function to copy a file
-bool copyFile(const std::string &source, const std::string &destination)
+// A regular file to be copied by the copy engine
+struct CopyJob
 {
-    try
+    std::string source;
+    std::string destination;
+    uint64_t size;
+    mode_t mode;
+    uint64_t replacedSize = 0; // Size of the file being overwritten, if any
+};
+
+// Shared progress counters, updated by the copy workers
+struct CopyProgress
+{
+    std::atomic<uint64_t> bytesCopied{0};
+    std::atomic<uint64_t> filesCopied{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<size_t> nextJob{0};
+};
+
+const size_t COPY_CHUNK = 8 * 1024 * 1024; // Bytes per kernel copy call, also the progress granularity
+const unsigned MAX_COPY_WORKERS = 8;
+
+// Walk a source tree relative to open directory fds, recording the
+// directories to create and the files to copy
+bool scanTree(int dirFd, const std::string &source, const std::string &destination,
+              std::vector<std::string> &directories, std::vector<CopyJob> &files, uint64_t &totalBytes)
+{
+    directories.push_back(destination);
+
+    bool ok = readDirectory(dirFd, [&](const char *name, unsigned char type)
+                            {
+        struct stat info;
+        if (type == DT_UNKNOWN || type == DT_REG || type == DT_DIR)
+        {
+            if (fstatat(dirFd, name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+                return;
+        }
+        else
+        {
+            return; // Links, devices and sockets are not copied
+        }
+
+        std::string childSource = source + "/" + name;
+        std::string childDestination = destination + "/" + name;
+        if (S_ISDIR(info.st_mode))
+        {
+            int childFd = openat(dirFd, name, O_RDONLY | O_DIRECTORY);
+            if (childFd >= 0)
+            {
+                scanTree(childFd, childSource, childDestination, directories, files, totalBytes);
+                close(childFd);
+            }
+        }
+        else if (S_ISREG(info.st_mode))
+        {
+            files.push_back({childSource, childDestination, static_cast<uint64_t>(info.st_size), info.st_mode & 0777});
+            totalBytes += info.st_size;
+        } });
+    return ok;
+}
+
+// Copy one file in the kernel where possible: copy_file_range, then sendfile,
+// then a plain read/write loop
+bool copyFileData(const CopyJob &job, CopyProgress &progress)
+{
+    int in = open(job.source.c_str(), O_RDONLY);
+    if (in < 0)
+        return false;
+    int out = open(job.destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, job.mode);
+    if (out < 0)
     {
-        if (!fs::exists(source))
+        close(in);
+        return false;
+    }
+
+    uint64_t remaining = job.size;
+    bool ok = true;
+#ifdef __linux__
+    bool useCopyRange = true;
+    while (remaining > 0)
+    {
+        ssize_t copied;
+        if (useCopyRange)
         {
-            std::cout << "Source file does not exist: " << source << std::endl;
+            copied = copy_file_range(in, nullptr, out, nullptr, std::min<uint64_t>(remaining, COPY_CHUNK), 0);
+            if (copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+            {
+                useCopyRange = false;
+                continue;
+            }
+        }
+        else
+        {
+            copied = sendfile(out, in, nullptr, std::min<uint64_t>(remaining, COPY_CHUNK));
+        }
+
+        if (copied <= 0)
+        {
+            // The file shrank under us, or the fast paths are unavailable
+            ok = copied == 0;
+            break;
+        }
+        remaining -= copied;
+        progress.bytesCopied += copied;
+    }
+#endif
+    if (ok && remaining > 0)
+    {
+        std::vector<char> buffer(std::min<uint64_t>(remaining, 1024 * 1024));
+        ssize_t count;
+        while ((count = read(in, buffer.data(), buffer.size())) > 0)
+        {
+            if (write(out, buffer.data(), count) != count)
+            {
+                ok = false;
+                break;
+            }
+            progress.bytesCopied += count;
+        }
+        ok = ok && count == 0;
+    }
+
+    close(in);
+    close(out);
+    return ok;
+}
+
+void copyWorker(const std::vector<CopyJob> &files, CopyProgress &progress)
+{
+    // Workers pull the next file off a shared counter until the list is exhausted
+    size_t index;
+    while ((index = progress.nextJob.fetch_add(1)) < files.size())
+    {
+        if (copyFileData(files[index], progress))
+            progress.filesCopied++;
+        else
+            progress.failures++;
+    }
+}
+
+void printCopyProgress(const CopyProgress &progress, uint64_t totalBytes, size_t totalFiles, double seconds)
+{
+    uint64_t bytes = progress.bytesCopied;
+    uint64_t files = progress.filesCopied;
+    int percent = totalBytes > 0 ? static_cast<int>(bytes * 100 / totalBytes) : 100;
+    double mbPerSecond = seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0;
+    double filesPerSecond = seconds > 0 ? files / seconds : 0;
+
+    std::cout << "\r[" << std::setw(3) << percent << "%] " << files << "/" << totalFiles << " files, "
+              << std::fixed << std::setprecision(1) << mbPerSecond << " MB/s, "
+              << filesPerSecond << " files/s   " << std::defaultfloat << std::flush;
+}
+
+// Copy a file or a whole directory tree using a pool of workers. Copying
+// into an existing directory keeps the source's name, as cp does.
+// Read a whole host file, for copies into the store
+bool readWholeFile(const std::string &path, uint64_t size, std::string &data)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    data.resize(size);
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t count = read(fd, &data[done], data.size() - done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        done += count;
+    }
+    close(fd);
+    data.resize(done);
+    return done == size;
+}
+
+// Store one host file under the destination's name. A host file by that
+// name would hide the stored copy, so it goes, and its charge with it.
+bool storeCopy(const CopyJob &job)
+{
+    std::string data;
+    if (!readWholeFile(job.source, job.size, data) || !diskClient.storeWrite(storeName(job.destination), data))
+        return false;
+    if (job.replacedSize > 0 && unlink(job.destination.c_str()) == 0)
+        diskLedger.charge(taskPid, -static_cast<int64_t>(job.replacedSize));
+    return true;
+}
+
+bool copyFile(const std::string &source, const std::string &target)
+{
+    std::string destination = target;
+    struct stat targetInfo;
+    if (stat(target.c_str(), &targetInfo) == 0 && S_ISDIR(targetInfo.st_mode))
+    {
+        std::string name = source.substr(0, source.find_last_not_of('/') + 1);
+        name = name.substr(name.find_last_of('/') + 1);
+        destination = target + (target.back() == '/' ? "" : "/") + name;
+    }
+
+    struct stat info;
+    if (stat(source.c_str(), &info) != 0)
+    {
+        // A stored source is copied inside the store, where the copy shares its content
+        if (diskClient.storeCopy(storeName(source), storeName(destination)))
+            return true;
+        std::cout << "Source file does not exist: " << source << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> directories;
+    std::vector<CopyJob> files;
+    uint64_t totalBytes = 0;
+    if (S_ISDIR(info.st_mode))
+    {
+        int dirFd = open(source.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dirFd < 0 || !scanTree(dirFd, source, destination, directories, files, totalBytes))
+        {
+            std::cerr << "Error reading directory: " << source << std::endl;
+            if (dirFd >= 0)
+                close(dirFd);
             return false;
         }
+        close(dirFd);
+    }
+    else
+    {
+        files.push_back({source, destination, static_cast<uint64_t>(info.st_size), info.st_mode & 0777});
+        totalBytes = info.st_size;
+    }
 
-        fs::copy(source, destination, fs::copy_options::overwrite_existing);
-        return true;
+    // Overwritten files only need their growth; the rest is charged in full
+    uint64_t growth = 0;
+    for (auto &file : files)
+    {
+        struct stat existing;
+        if (stat(file.destination.c_str(), &existing) == 0 && S_ISREG(existing.st_mode))
+            file.replacedSize = existing.st_size;
     }
-    catch (const std::exception &e)
+
+    // Files the store takes are not charged here, larger ones are copied on the host
+    std::vector<CopyJob> stored;
+    if (diskClient.connected())
+    {
+        auto large = std::stable_partition(files.begin(), files.end(), [](const CopyJob &file)
+                                           { return file.size <= DiskClient::MAX_STORED_FILE; });
+        stored.assign(files.begin(), large);
+        files.erase(files.begin(), large);
+    }
+    for (const auto &file : stored)
+    {
+        totalBytes -= file.size;
+    }
+    for (const auto &file : files)
+    {
+        growth += file.size > file.replacedSize ? file.size - file.replacedSize : 0;
+    }
+
+    // Refuse up front if the copy would exceed the host disk or this task's quota
+    struct statvfs disk;
+    if (statvfs(currentDir.c_str(), &disk) == 0 && growth > static_cast<uint64_t>(disk.f_bavail) * disk.f_frsize)
+    {
+        std::cout << "Copy needs " << growth << " bytes but the disk is nearly full" << std::endl;
+        return false;
+    }
+    if (!chargeDisk(growth))
+    {
+        return false;
+    }
+
+    for (const auto &directory : directories)
+    {
+        mkdir(directory.c_str(), 0755);
+    }
+
+    uint64_t storeFailures = 0;
+    for (const auto &file : stored)
+    {
+        storeFailures += storeCopy(file) ? 0 : 1;
+    }
+
+    // Files already stored under a source directory are copied inside the store
+    std::vector<std::pair<std::string, uint64_t>> storedSources;
+    std::string sourcePrefix = storePrefix(source);
+    if (S_ISDIR(info.st_mode) && diskClient.storeList(sourcePrefix, storedSources))
+    {
+        for (const auto &file : storedSources)
+        {
+            std::string name = storePrefix(destination) + file.first.substr(sourcePrefix.size());
+            storeFailures += diskClient.storeCopy(file.first, name) ? 0 : 1;
+        }
+    }
+    size_t storedCount = stored.size() + storedSources.size();
+    if (storedCount > 0)
+    {
+        std::cout << "Stored " << storedCount - storeFailures << " of " << storedCount
+                  << " files in the OS file store" << std::endl;
+        if (files.empty())
+            return storeFailures == 0;
+    }
+
+    // Small trees don't need the whole pool
+    CopyProgress progress;
+    unsigned workers = std::max(1u, std::min({std::thread::hardware_concurrency(), MAX_COPY_WORKERS,
+                                              static_cast<unsigned>(files.size())}));
+    std::vector<std::thread> pool;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < workers; i++)
+    {
+        pool.emplace_back(copyWorker, std::cref(files), std::ref(progress));
+    }
+
+    // Live progress until every file has been handed out and finished
+    auto elapsed = [&start]()
+    { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    while (progress.filesCopied + progress.failures < files.size())
+    {
+        printCopyProgress(progress, totalBytes, files.size(), elapsed());
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    for (auto &worker : pool)
+    {
+        worker.join();
+    }
+    printCopyProgress(progress, totalBytes, files.size(), elapsed());
+    std::cout << std::endl;
+
+    // Settle the charge against what the destinations actually grew or
+    // shrank by, which also hands back what failed files never used
+    int64_t change = 0;
+    for (const auto &file : files)
+    {
+        struct stat copied;
+        uint64_t size = stat(file.destination.c_str(), &copied) == 0 ? copied.st_size : 0;
+        change += static_cast<int64_t>(size) - static_cast<int64_t>(file.replacedSize);
+    }
+    diskLedger.charge(taskPid, change - static_cast<int64_t>(growth));
+    if (progress.failures + storeFailures > 0)
+    {
+        std::cerr << "Error copying " << progress.failures + storeFailures << " file(s)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ---- Content search ----
+//
+// Files are split into fixed segments that a pool of workers maps and scans
+// independently. The substring kernel compares the first and last byte of
+// the pattern at 16 or 32 positions at once and only runs memcmp on the
+// positions where both match. Line numbers are resolved per file once all of
+// its segments are done, so matches stream out file by file.
+
+const uint64_t SEARCH_SEGMENT = 16 * 1024 * 1024; // Multiple of the page size
+const size_t MAX_PRINTED_MATCHES = 1000;
+
+struct SearchMatch
+{
+    uint64_t offset; // Byte offset in the file
+    uint64_t line;   // Newlines before the match inside its segment
+    int64_t column;  // Bytes since the last newline in the segment, -1 if none
+};
+
+struct SearchSegment
+{
+    size_t file;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t newlines = 0;
+    uint64_t tail = 0; // Bytes after the segment's last newline
+    bool hasNewline = false;
+    std::vector<SearchMatch> matches;
+};
+
+struct SearchFile
+{
+    std::string path;
+    uint64_t size;
+    size_t firstSegment;
+    size_t segmentCount;
+};
+
+struct SearchState
+{
+    std::string pattern;
+    std::vector<SearchFile> files;
+    std::vector<SearchSegment> segments;
+    std::unique_ptr<std::atomic<size_t>[]> segmentsLeft; // Per file
+    std::atomic<size_t> nextSegment{0};
+    std::atomic<uint64_t> bytesScanned{0};
+    std::atomic<uint64_t> matchCount{0};
+    std::atomic<uint64_t> matchedFiles{0};
+    std::atomic<uint64_t> printed{0};
+    std::mutex outputMutex;
+    bool quiet = false; // Count only, used by the benchmark
+};
+
+// Positions in [0, starts) where pattern occurs, data must hold starts + n - 1 bytes
+void findScalar(const char *data, size_t starts, const char *pattern, size_t n, std::vector<uint64_t> &hits)
+{
+    const char *end = data + starts;
+    for (const char *p = data; p < end;)
+    {
+        p = static_cast<const char *>(memchr(p, pattern[0], end - p));
+        if (p == nullptr)
+            break;
+        if (memcmp(p + 1, pattern + 1, n - 1) == 0)
+            hits.push_back(p - data);
+        p++;
+    }
+}
+
+size_t countScalar(const char *data, size_t length, char byte)
+{
+    return std::count(data, data + length, byte);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+void findSSE2(const char *data, size_t starts, const char *pattern, size_t n, std::vector<uint64_t> &hits)
+{
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[n - 1]);
+    size_t i = 0;
+    for (; i + 16 <= starts; i += 16)
+    {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + n - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+        while (mask != 0)
+        {
+            unsigned bit = __builtin_ctz(mask);
+            if (n <= 2 || memcmp(data + i + bit + 1, pattern + 1, n - 2) == 0)
+                hits.push_back(i + bit);
+            mask &= mask - 1;
+        }
+    }
+    std::vector<uint64_t> rest;
+    findScalar(data + i, starts - i, pattern, n, rest);
+    for (uint64_t position : rest)
+        hits.push_back(i + position);
+}
+
+size_t countSSE2(const char *data, size_t length, char byte)
+{
+    const __m128i needle = _mm_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+    }
+    return count + countScalar(data + i, length - i, byte);
+}
+
+__attribute__((target("avx2"))) void findAVX2(const char *data, size_t starts, const char *pattern, size_t n,
+                                              std::vector<uint64_t> &hits)
+{
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[n - 1]);
+    size_t i = 0;
+    for (; i + 32 <= starts; i += 32)
+    {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + n - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first),
+                                                              _mm256_cmpeq_epi8(tail, last)));
+        while (mask != 0)
+        {
+            unsigned bit = __builtin_ctz(mask);
+            if (n <= 2 || memcmp(data + i + bit + 1, pattern + 1, n - 2) == 0)
+                hits.push_back(i + bit);
+            mask &= mask - 1;
+        }
+    }
+    std::vector<uint64_t> rest;
+    findSSE2(data + i, starts - i, pattern, n, rest);
+    for (uint64_t position : rest)
+        hits.push_back(i + position);
+}
+
+__attribute__((target("avx2"))) size_t countAVX2(const char *data, size_t length, char byte)
+{
+    const __m256i needle = _mm256_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+    }
+    return count + countSSE2(data + i, length - i, byte);
+}
+#endif
+
+// Kernels picked once at startup from what the CPU supports
+using FindKernel = void (*)(const char *, size_t, const char *, size_t, std::vector<uint64_t> &);
+using CountKernel = size_t (*)(const char *, size_t, char);
+FindKernel findKernel = findScalar;
+CountKernel countKernel = countScalar;
+const char *searchKernelName = "scalar";
+
+void selectSearchKernels()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        findKernel = findAVX2;
+        countKernel = countAVX2;
+        searchKernelName = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
     {
-        std::cerr << "Error copying file: " << e.what() << std::endl;
+        findKernel = findSSE2;
+        countKernel = countSSE2;
+        searchKernelName = "sse2";
+    }
+#endif
+}
+
+// Last occurrence of byte in [data, data + length), or nullptr
+const char *findLastByte(const char *data, size_t length, char byte)
+{
+#ifdef __linux__
+    return static_cast<const char *>(memrchr(data, byte, length));
+#else
+    for (size_t i = length; i > 0; i--)
+    {
+        if (data[i - 1] == byte)
+            return data + i - 1;
+    }
+    return nullptr;
+#endif
+}
+
+// Record every regular file under a directory, split into segments
+void scanSearchTree(int dirFd, const std::string &path, SearchState &state)
+{
+    readDirectory(dirFd, [&](const char *name, unsigned char type)
+                  {
+        if (type != DT_UNKNOWN && type != DT_REG && type != DT_DIR)
+            return;
+        struct stat info;
+        if (fstatat(dirFd, name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+            return;
+
+        std::string childPath = path + "/" + name;
+        if (S_ISDIR(info.st_mode))
+        {
+            int childFd = openat(dirFd, name, O_RDONLY | O_DIRECTORY);
+            if (childFd >= 0)
+            {
+                scanSearchTree(childFd, childPath, state);
+                close(childFd);
+            }
+        }
+        else if (S_ISREG(info.st_mode) && static_cast<uint64_t>(info.st_size) >= state.pattern.size())
+        {
+            SearchFile file{childPath, static_cast<uint64_t>(info.st_size), state.segments.size(), 0};
+            for (uint64_t offset = 0; offset < file.size; offset += SEARCH_SEGMENT)
+            {
+                SearchSegment segment;
+                segment.file = state.files.size();
+                segment.offset = offset;
+                segment.length = std::min(SEARCH_SEGMENT, file.size - offset);
+                state.segments.push_back(std::move(segment));
+                file.segmentCount++;
+            }
+            state.files.push_back(std::move(file));
+        } });
+}
+
+// Map one segment, plus enough of the next to finish a match that straddles it
+bool scanSegment(SearchState &state, SearchSegment &segment)
+{
+    const SearchFile &file = state.files[segment.file];
+    const std::string &pattern = state.pattern;
+    int fd = open(file.path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    uint64_t mapped = std::min(segment.length + pattern.size() - 1, file.size - segment.offset);
+    void *map = mmap(nullptr, mapped, PROT_READ, MAP_PRIVATE, fd, segment.offset);
+    close(fd);
+    if (map == MAP_FAILED)
         return false;
+    madvise(map, mapped, MADV_SEQUENTIAL);
+    const char *data = static_cast<const char *>(map);
+
+    // Only matches that start inside this segment belong to it
+    std::vector<uint64_t> hits;
+    uint64_t starts = mapped >= pattern.size() ? std::min(segment.length, mapped - pattern.size() + 1) : 0;
+    findKernel(data, starts, pattern.data(), pattern.size(), hits);
+
+    // Count newlines up to each match, then to the end of the segment
+    uint64_t cursor = 0, newlines = 0;
+    const char *lastNewline = nullptr;
+    for (uint64_t hit : hits)
+    {
+        uint64_t found = countKernel(data + cursor, hit - cursor, '\n');
+        if (found > 0)
+        {
+            newlines += found;
+            lastNewline = findLastByte(data + cursor, hit - cursor, '\n');
+        }
+        cursor = hit;
+        int64_t column = lastNewline ? (data + hit) - lastNewline - 1 : -1;
+        segment.matches.push_back({segment.offset + hit, newlines, column});
+    }
+    uint64_t found = countKernel(data + cursor, segment.length - cursor, '\n');
+    if (found > 0)
+    {
+        newlines += found;
+        lastNewline = findLastByte(data + cursor, segment.length - cursor, '\n');
+    }
+    segment.newlines = newlines;
+    segment.hasNewline = lastNewline != nullptr;
+    segment.tail = lastNewline ? (data + segment.length) - lastNewline - 1 : segment.length;
+
+    munmap(map, mapped);
+    state.bytesScanned += segment.length;
+    return true;
+}
+
+// Turn segment-relative positions into file:line:column and print them
+void reportFile(SearchState &state, const SearchFile &file)
+{
+    uint64_t lineBase = 1, columnCarry = 0, total = 0;
+    std::string out;
+    for (size_t i = 0; i < file.segmentCount; i++)
+    {
+        const SearchSegment &segment = state.segments[file.firstSegment + i];
+        for (const SearchMatch &match : segment.matches)
+        {
+            uint64_t column = match.column >= 0 ? match.column
+                                                : columnCarry + (match.offset - segment.offset);
+            total++;
+            if (!state.quiet && state.printed.fetch_add(1) < MAX_PRINTED_MATCHES)
+            {
+                out += file.path + ":" + std::to_string(lineBase + match.line) + ":" +
+                       std::to_string(column + 1) + "\n";
+            }
+        }
+        lineBase += segment.newlines;
+        columnCarry = segment.hasNewline ? segment.tail : columnCarry + segment.tail;
+    }
+    if (total == 0)
+        return;
+
+    state.matchCount += total;
+    state.matchedFiles++;
+    if (!out.empty())
+    {
+        std::lock_guard<std::mutex> lock(state.outputMutex);
+        std::cout << out << std::flush;
+    }
+}
+
+void searchWorker(SearchState &state)
+{
+    size_t index;
+    while ((index = state.nextSegment.fetch_add(1)) < state.segments.size())
+    {
+        SearchSegment &segment = state.segments[index];
+        scanSegment(state, segment);
+
+        // Whoever finishes a file's last segment reports the whole file
+        if (state.segmentsLeft[segment.file].fetch_sub(1) == 1)
+        {
+            reportFile(state, state.files[segment.file]);
+            for (size_t i = 0; i < state.files[segment.file].segmentCount; i++)
+            {
+                std::vector<SearchMatch>().swap(state.segments[state.files[segment.file].firstSegment + i].matches);
+            }
+        }
+    }
+}
+
+// Search every file under root for pattern, returns the scan time in seconds
+double searchFiles(SearchState &state, const std::string &root)
+{
+    auto start = std::chrono::steady_clock::now();
+    int dirFd = open(root.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0)
+    {
+        std::cerr << "Error reading directory: " << root << std::endl;
+        return 0;
+    }
+    scanSearchTree(dirFd, root, state);
+    close(dirFd);
+
+    state.segmentsLeft.reset(new std::atomic<size_t>[state.files.size()]);
+    for (size_t i = 0; i < state.files.size(); i++)
+    {
+        state.segmentsLeft[i] = state.files[i].segmentCount;
+    }
+
+    unsigned workers = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), state.segments.size()));
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < workers; i++)
+    {
+        pool.emplace_back(searchWorker, std::ref(state));
     }
+    for (auto &worker : pool)
+    {
+        worker.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printSearchSummary(const SearchState &state, double seconds)
+{
+    double gbPerSecond = seconds > 0 ? state.bytesScanned / 1e9 / seconds : 0;
+    std::cout << state.matchCount << " match(es) in " << state.matchedFiles << " of " << state.files.size()
+              << " file(s), " << std::fixed << std::setprecision(1) << state.bytesScanned / (1024.0 * 1024.0)
+              << " MB in " << std::setprecision(3) << seconds << " s (" << std::setprecision(2) << gbPerSecond
+              << " GB/s, " << searchKernelName << ")" << std::defaultfloat << std::endl;
+    if (state.matchCount > MAX_PRINTED_MATCHES && !state.quiet)
+        std::cout << "Only the first " << MAX_PRINTED_MATCHES << " matches were printed" << std::endl;
+}
+
+// Compare the search engine against a plain ifstream + std::string::find loop
+void benchmarkSearch(const std::string &pattern, const std::string &root)
+{
+    // The naive scan reads each file whole, one after another
+    std::vector<std::string> paths;
+    {
+        SearchState listing;
+        listing.pattern = pattern;
+        int dirFd = open(root.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dirFd < 0)
+        {
+            std::cerr << "Error reading directory: " << root << std::endl;
+            return;
+        }
+        scanSearchTree(dirFd, root, listing);
+        close(dirFd);
+        for (const auto &file : listing.files)
+            paths.push_back(file.path);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t naiveBytes = 0, naiveMatches = 0;
+    for (const auto &path : paths)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        naiveBytes += content.size();
+        for (size_t pos = content.find(pattern); pos != std::string::npos; pos = content.find(pattern, pos + 1))
+            naiveMatches++;
+    }
+    double naiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    SearchState state;
+    state.pattern = pattern;
+    state.quiet = true;
+    double seconds = searchFiles(state, root);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "naive:  " << naiveMatches << " matches, " << naiveSeconds << " s, "
+              << (naiveSeconds > 0 ? naiveBytes / 1e9 / naiveSeconds : 0) << " GB/s" << std::endl;
+    std::cout << "engine: " << state.matchCount << " matches, " << seconds << " s, "
+              << (seconds > 0 ? state.bytesScanned / 1e9 / seconds : 0) << " GB/s ("
+              << searchKernelName << ", " << std::thread::hardware_concurrency() << " threads)" << std::endl;
+    if (naiveSeconds > 0 && seconds > 0)
+        std::cout << "speedup: " << naiveSeconds / seconds << "x" << std::endl;
+    std::cout << std::defaultfloat;
+    if (naiveMatches != state.matchCount)
+        std::cerr << "Match counts differ!" << std::endl;
 }
 
 // Function to move/rename a file
@@ -172,6 +1360,10 @@ bool moveFile(const std::string &source, const std::string &destination)
     {
         if (!fs::exists(source))
         {
+            // A stored file moves inside the store, the copy shares its content
+            if (diskClient.storeCopy(storeName(source), storeName(destination)) &&
+                diskClient.storeRemove(storeName(source)))
+                return true;
             std::cout << "Source file does not exist: " << source << std::endl;
             return false;
         }
@@ -195,19 +1387,30 @@ void displayMenu()
     std::cout << "3. Create Directory\n";
     std::cout << "4. Read File\n";
     std::cout << "5. Delete File/Directory\n";
-    std::cout << "6. Copy File\n";
+    std::cout << "6. Copy File/Directory\n";
     std::cout << "7. Move/Rename File\n";
     std::cout << "8. Change Directory\n";
     std::cout << "9. Exit\n";
+    std::cout << "10. Search File Contents\n";
     std::cout << "Enter choice: ";
 }
 
 int main(int argc, char *argv[])
 {
+    selectSearchKernels();
+
+    // Benchmark mode: file_manager --bench-search <pattern> [directory]
+    if (argc >= 3 && std::string(argv[1]) == "--bench-search")
+    {
+        benchmarkSearch(argv[2], argc >= 4 ? argv[3] : currentDir);
+        return 0;
+    }
+
     // Check command line arguments (pid, memory, disk)
     if (argc < 4)
     {
         std::cerr << "Usage: " << argv[0] << " <pid> <memory_required> <disk_required>" << std::endl;
+        std::cerr << "       " << argv[0] << " --bench-search <pattern> [directory]" << std::endl;
         return 1;
     }
 
@@ -226,6 +1429,16 @@ int main(int argc, char *argv[])
     // Create the simulated disk directory if it doesn't exist
     createDirectory(currentDir);
 
+    // Without the OS ledger (run standalone) writes are not metered
+    taskPid = pid;
+    diskLedger.open(false);
+    diskClient.connect();
+
+#ifdef __linux__
+    // Change notifications for cached directory listings
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
     int choice;
     while (running)
     {
@@ -319,9 +1532,9 @@ int main(int argc, char *argv[])
         }
 
         case 6:
-        { // Copy File
+        { // Copy File/Directory
             std::string source, destination;
-            std::cout << "Enter source filename: ";
+            std::cout << "Enter source file or directory: ";
             std::getline(std::cin, source);
             std::cout << "Enter destination filename: ";
             std::getline(std::cin, destination);
@@ -331,7 +1544,7 @@ int main(int argc, char *argv[])
 
             if (copyFile(fullSource, fullDestination))
             {
-                std::cout << "File copied successfully" << std::endl;
+                std::cout << "Copied successfully" << std::endl;
             }
             else
             {
@@ -403,6 +1616,24 @@ int main(int argc, char *argv[])
             running = false;
             break;
 
+        case 10:
+        { // Search File Contents
+            std::string pattern;
+            std::cout << "Enter text to search for: ";
+            std::getline(std::cin, pattern);
+            if (pattern.empty())
+            {
+                std::cout << "Nothing to search for" << std::endl;
+                break;
+            }
+
+            SearchState state;
+            state.pattern = pattern;
+            double seconds = searchFiles(state, currentDir);
+            printSearchSummary(state, seconds);
+            break;
+        }
+
         default:
             std::cout << "Invalid choice" << std::endl;
             break;
@@ -2,18 +2,48 @@
 #include <vector>
 #include <ctime>
 #include <cstdlib>
-//#include <iomanip>
+#include <cstdint>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include <signal.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../include/DiskLedger.h"
+#include "../include/DiskClient.h"
 
 using namespace std;
 
 bool running = true;
 
-// Game board dimensions
+// Swapped-out world chunks are charged to this task's disk quota, and
+// their file goes through the OS buffer cache when the OS is running
+DiskLedger diskLedger;
+DiskClient diskClient;
+int taskPid = 0;
+
+// Default game board
 const int ROWS = 8;
 const int COLS = 8;
 const int MINES = 10;
 
+// Largest board side a game can have
+const int MAX_SIDE = 10000;
+
+// Rows and columns shown at once, bigger boards are shown through a view
+const int VIEW_SIZE = 40;
+
 // Cell states
 enum CellState
 {
@@ -22,193 +52,1674 @@ enum CellState
     FLAGGED
 };
 
-// Cell structure
-struct Cell
+// Minesweeper board kept as bit-planes: one bit per cell for mines,
+// uncovered cells and flags, row-major with each row padded to whole 64-bit
+// words. A fourth plane marks the safe cells with no mine around them, the
+// ones a flood fill spreads through. A 10k x 10k board is 50 MB.
+//
+// Uncovering floods whole runs of a row at a time, with an explicit stack
+// instead of recursion, and counts the safe cells still covered so a win is
+// known without looking at the board.
+class Board
 {
-    bool hasMine;
-    int adjacentMines;
-    CellState state;
-};
+private:
+    int rows = 0;
+    int cols = 0;
+    int mines = 0;
+    size_t words = 0; // Words per row
+    vector<uint64_t> minePlane, uncoveredPlane, flagPlane, zeroPlane;
+    long long safeRemaining = 0;
+    long long flags = 0;
+    bool exploded = false;
+    vector<pair<int, int>> pending; // Runs waiting to be flooded
 
-// Game board
-vector<vector<Cell>> board(ROWS, vector<Cell>(COLS));
+    uint64_t *row(vector<uint64_t> &plane, int r) { return plane.data() + r * words; }
+    const uint64_t *row(const vector<uint64_t> &plane, int r) const { return plane.data() + r * words; }
 
-// Signal handler for graceful shutdown
-void signalHandler(int signal)
-{
-    if (signal == SIGINT)
+    static bool test(const uint64_t *bits, int c) { return (bits[c >> 6] >> (c & 63)) & 1; }
+
+    // Bits of word w that fall in columns a..b
+    static uint64_t spanMask(int w, int a, int b)
     {
-        cout << "Minesweeper shutting down..." << endl;
-        running = false;
+        int low = max(a - w * 64, 0), high = min(b - w * 64, 63);
+        if (low > high)
+            return 0;
+        uint64_t upper = high == 63 ? ~0ull : (2ull << high) - 1;
+        return upper & (~0ull << low);
     }
-}
 
-// Initialize the game board
-void initializeBoard()
-{
-    // Initialize all cells
-    for (int i = 0; i < ROWS; i++)
+    // Unflagged cells with no mine around them, one word of a row
+    static uint64_t openWord(const uint64_t *zero, const uint64_t *flag, size_t w) { return zero[w] & ~flag[w]; }
+
+    // First and last column of the run of open cells through column c
+    int runStart(const uint64_t *zero, const uint64_t *flag, int c) const
+    {
+        int w = c >> 6;
+        uint64_t closed = ~openWord(zero, flag, w) & ((c & 63) == 63 ? ~0ull : (2ull << (c & 63)) - 1);
+        while (closed == 0)
+        {
+            if (w-- == 0)
+                return 0;
+            closed = ~openWord(zero, flag, w);
+        }
+        return w * 64 + 64 - __builtin_clzll(closed);
+    }
+
+    int runEnd(const uint64_t *zero, const uint64_t *flag, int c) const
+    {
+        size_t w = c >> 6;
+        uint64_t closed = ~openWord(zero, flag, w) & (~0ull << (c & 63));
+        while (closed == 0)
+        {
+            if (++w == words)
+                return cols - 1;
+            closed = ~openWord(zero, flag, w);
+        }
+        return min(static_cast<int>(w * 64 + __builtin_ctzll(closed)), cols) - 1;
+    }
+
+    // A cell has no mine around it when its whole 3x3 block is clear
+    void buildZeroPlane()
+    {
+        uint64_t tail = cols % 64 == 0 ? ~0ull : (1ull << (cols % 64)) - 1;
+        for (int r = 0; r < rows; r++)
+        {
+            const uint64_t *above = r > 0 ? row(minePlane, r - 1) : nullptr;
+            const uint64_t *here = row(minePlane, r);
+            const uint64_t *below = r + 1 < rows ? row(minePlane, r + 1) : nullptr;
+            uint64_t *zero = row(zeroPlane, r);
+            uint64_t previous = 0;
+            uint64_t current = here[0] | (above ? above[0] : 0) | (below ? below[0] : 0);
+            for (size_t w = 0; w < words; w++)
+            {
+                uint64_t next = 0;
+                if (w + 1 < words)
+                    next = here[w + 1] | (above ? above[w + 1] : 0) | (below ? below[w + 1] : 0);
+                uint64_t block = current | (current << 1) | (previous >> 63) | (current >> 1) | (next << 63);
+                zero[w] = ~block & (w + 1 == words ? tail : ~0ull);
+                previous = current;
+                current = next;
+            }
+        }
+    }
+
+public:
+    // Start a new game with mines placed at random, false if the size is out of range
+    bool reset(int height, int width, int mineCount, uint64_t seed)
+    {
+        if (height < 1 || width < 1 || height > MAX_SIDE || width > MAX_SIDE)
+            return false;
+        rows = height;
+        cols = width;
+        long long cells = static_cast<long long>(rows) * cols;
+        mines = static_cast<int>(max(0ll, min<long long>(mineCount, cells - 1)));
+        words = (cols + 63) / 64;
+        minePlane.assign(rows * words, 0);
+        uncoveredPlane.assign(rows * words, 0);
+        flagPlane.assign(rows * words, 0);
+        zeroPlane.assign(rows * words, 0);
+        safeRemaining = cells - mines;
+        flags = 0;
+        exploded = false;
+
+        // Place mines randomly
+        mt19937_64 rng(seed);
+        uniform_int_distribution<long long> cell(0, cells - 1);
+        int minesPlaced = 0;
+        while (minesPlaced < mines)
+        {
+            long long index = cell(rng);
+            uint64_t &word = row(minePlane, index / cols)[(index % cols) >> 6];
+            uint64_t bit = 1ull << ((index % cols) & 63);
+            if (!(word & bit))
+            {
+                word |= bit;
+                minesPlaced++;
+            }
+        }
+        buildZeroPlane();
+        return true;
+    }
+
+    int height() const { return rows; }
+    int width() const { return cols; }
+    int mineCount() const { return mines; }
+    long long safeCellsLeft() const { return safeRemaining; }
+    bool won() const { return safeRemaining == 0 && !exploded; }
+    bool lost() const { return exploded; }
+    long long flagCount() const { return flags; }
+
+    // Cells neither uncovered nor flagged
+    long long hiddenCells() const
+    {
+        long long uncovered = static_cast<long long>(rows) * cols - mines - safeRemaining + (exploded ? 1 : 0);
+        return static_cast<long long>(rows) * cols - uncovered - flags;
+    }
+    size_t memoryBytes() const { return 4 * minePlane.size() * sizeof(uint64_t); }
+
+    bool inside(int r, int c) const { return r >= 0 && r < rows && c >= 0 && c < cols; }
+    bool hasMine(int r, int c) const { return test(row(minePlane, r), c); }
+
+    CellState state(int r, int c) const
     {
-        for (int j = 0; j < COLS; j++)
+        if (test(row(uncoveredPlane, r), c))
+            return UNCOVERED;
+        return test(row(flagPlane, r), c) ? FLAGGED : COVERED;
+    }
+
+    int adjacentMines(int r, int c) const
+    {
+        int count = 0;
+        for (int i = max(0, r - 1); i <= min(rows - 1, r + 1); i++)
+        {
+            const uint64_t *bits = row(minePlane, i);
+            for (int j = max(0, c - 1); j <= min(cols - 1, c + 1); j++)
+            {
+                if ((i != r || j != c) && test(bits, j))
+                    count++;
+            }
+        }
+        return count;
+    }
+
+    // Mine counts of a whole row. The eight neighbour planes are added as
+    // bit-sliced 4-bit counters, 128 cells per SSE2 step.
+    void rowCounts(int r, uint8_t *out) const
+    {
+        vector<uint64_t> inputs(8 * words);
+        int input = 0;
+        for (int i = r - 1; i <= r + 1; i++)
+        {
+            const uint64_t *bits = i >= 0 && i < rows ? row(minePlane, i) : nullptr;
+            for (int shift = -1; shift <= 1; shift++)
+            {
+                if (i == r && shift == 0)
+                    continue;
+                uint64_t *plane = inputs.data() + words * input++;
+                for (size_t w = 0; bits != nullptr && w < words; w++)
+                {
+                    uint64_t previous = w > 0 ? bits[w - 1] : 0;
+                    uint64_t next = w + 1 < words ? bits[w + 1] : 0;
+                    if (shift < 0)
+                        plane[w] = (bits[w] << 1) | (previous >> 63); // Neighbour to the left
+                    else if (shift > 0)
+                        plane[w] = (bits[w] >> 1) | (next << 63);     // Neighbour to the right
+                    else
+                        plane[w] = bits[w];
+                }
+            }
+        }
+
+        vector<uint64_t> sums(4 * words);
+        uint64_t *bit0 = sums.data(), *bit1 = bit0 + words, *bit2 = bit1 + words, *bit3 = bit2 + words;
+        size_t w = 0;
+#ifdef __SSE2__
+        for (; w + 2 <= words; w += 2)
+        {
+            __m128i c0 = _mm_setzero_si128(), c1 = c0, c2 = c0, c3 = c0;
+            for (int k = 0; k < 8; k++)
+            {
+                __m128i carry = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inputs.data() + k * words + w));
+                __m128i next = _mm_and_si128(c0, carry);
+                c0 = _mm_xor_si128(c0, carry);
+                carry = next;
+                next = _mm_and_si128(c1, carry);
+                c1 = _mm_xor_si128(c1, carry);
+                carry = next;
+                next = _mm_and_si128(c2, carry);
+                c2 = _mm_xor_si128(c2, carry);
+                c3 = _mm_or_si128(c3, next);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(bit0 + w), c0);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(bit1 + w), c1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(bit2 + w), c2);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(bit3 + w), c3);
+        }
+#endif
+        for (; w < words; w++)
         {
-            board[i][j].hasMine = false;
-            board[i][j].adjacentMines = 0;
-            board[i][j].state = COVERED;
+            uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+            for (int k = 0; k < 8; k++)
+            {
+                uint64_t carry = inputs[k * words + w];
+                uint64_t next = c0 & carry;
+                c0 ^= carry;
+                carry = next;
+                next = c1 & carry;
+                c1 ^= carry;
+                carry = next;
+                next = c2 & carry;
+                c2 ^= carry;
+                c3 |= next;
+            }
+            bit0[w] = c0, bit1[w] = c1, bit2[w] = c2, bit3[w] = c3;
+        }
+
+        for (int c = 0; c < cols; c++)
+        {
+            size_t word = c >> 6;
+            int shift = c & 63;
+            out[c] = ((bit0[word] >> shift) & 1) | (((bit1[word] >> shift) & 1) << 1) |
+                     (((bit2[word] >> shift) & 1) << 2) | (((bit3[word] >> shift) & 1) << 3);
         }
     }
 
-    // Place mines randomly
-    int minesPlaced = 0;
-    while (minesPlaced < MINES)
+    // Uncover a cell, flooding out from it when it has no mines around.
+    // Returns false if it was a mine.
+    bool uncover(int r, int c)
     {
-        int row = rand() % ROWS;
-        int col = rand() % COLS;
+        if (!inside(r, c) || state(r, c) != COVERED)
+            return true;
+
+        row(uncoveredPlane, r)[c >> 6] |= 1ull << (c & 63);
+        if (hasMine(r, c))
+        {
+            exploded = true;
+            return false;
+        }
+        safeRemaining--;
+        if (!test(row(zeroPlane, r), c))
+            return true;
 
-        if (!board[row][col].hasMine)
+        // Each step takes a run of open cells in one row and uncovers it and
+        // the cells around it. Open cells first uncovered there in the rows
+        // above and below start runs of their own.
+        pending.clear();
+        pending.push_back({r, c});
+        while (!pending.empty())
         {
-            board[row][col].hasMine = true;
-            minesPlaced++;
+            auto [runRow, runCol] = pending.back();
+            pending.pop_back();
+            int start = runStart(row(zeroPlane, runRow), row(flagPlane, runRow), runCol);
+            int end = runEnd(row(zeroPlane, runRow), row(flagPlane, runRow), runCol);
+            int low = max(start - 1, 0), high = min(end + 1, cols - 1);
 
-            // Update adjacent cells
-            for (int i = max(0, row - 1); i <= min(ROWS - 1, row + 1); i++)
+            for (int i = max(runRow - 1, 0); i <= min(runRow + 1, rows - 1); i++)
             {
-                for (int j = max(0, col - 1); j <= min(COLS - 1, col + 1); j++)
+                uint64_t *uncovered = row(uncoveredPlane, i);
+                const uint64_t *flags = row(flagPlane, i);
+                const uint64_t *zero = row(zeroPlane, i);
+                for (int w = low >> 6; w <= high >> 6; w++)
                 {
-                    if (i == row && j == col)
+                    uint64_t fresh = spanMask(w, low, high) & ~uncovered[w] & ~flags[w];
+                    if (fresh == 0)
                         continue;
-                    board[i][j].adjacentMines++;
+                    if (i != runRow)
+                    {
+                        uint64_t seeds = fresh & zero[w];
+                        seeds &= ~(seeds << 1); // First cell of each run
+                        for (; seeds != 0; seeds &= seeds - 1)
+                            pending.push_back({i, w * 64 + __builtin_ctzll(seeds)});
+                    }
+                    uncovered[w] |= fresh;
+                    safeRemaining -= __builtin_popcountll(fresh);
                 }
             }
         }
+        return true;
     }
-}
 
-// Print the game board
-void printBoard(bool showAll = false)
-{
-    cout << "    ";
-    for (int j = 0; j < COLS; j++)
+    void toggleFlag(int r, int c)
     {
-        cout << j << " ";
+        if (!inside(r, c) || state(r, c) == UNCOVERED)
+            return;
+        uint64_t &word = row(flagPlane, r)[c >> 6];
+        word ^= 1ull << (c & 63);
+        flags += (word >> (c & 63)) & 1 ? 1 : -1;
     }
-    cout << endl;
 
-    cout << "   ";
-    for (int j = 0; j < COLS; j++)
+    // Visit every uncovered cell next to a hidden one as visit(row, col),
+    // a word of 64 cells at a time
+    template <typename Visit>
+    void forEachFrontierCell(Visit visit) const
     {
-        cout << "--";
+        uint64_t tail = cols % 64 == 0 ? ~0ull : (1ull << (cols % 64)) - 1;
+        auto hidden = [&](int r, size_t w) -> uint64_t
+        {
+            if (r < 0 || r >= rows || w >= words)
+                return 0;
+            uint64_t bits = ~row(uncoveredPlane, r)[w] & ~row(flagPlane, r)[w];
+            return w + 1 == words ? bits & tail : bits;
+        };
+        for (int r = 0; r < rows; r++)
+        {
+            const uint64_t *uncovered = row(uncoveredPlane, r);
+            for (size_t w = 0; w < words; w++)
+            {
+                if (uncovered[w] == 0)
+                    continue;
+                uint64_t near = hidden(r - 1, w) | hidden(r, w) | hidden(r + 1, w);
+                uint64_t before = w > 0 ? hidden(r - 1, w - 1) | hidden(r, w - 1) | hidden(r + 1, w - 1) : 0;
+                uint64_t after = hidden(r - 1, w + 1) | hidden(r, w + 1) | hidden(r + 1, w + 1);
+                uint64_t frontier = uncovered[w] & (near | (near << 1) | (before >> 63) | (near >> 1) | (after << 63));
+                for (; frontier != 0; frontier &= frontier - 1)
+                    visit(r, static_cast<int>(w * 64 + __builtin_ctzll(frontier)));
+            }
+        }
     }
-    cout << endl;
+};
 
-    for (int i = 0; i < ROWS; i++)
+// Plays a game using only what a player sees: the numbers on uncovered
+// cells and its own flags. Each round turns the frontier into constraints,
+// one per uncovered number: its hidden neighbours hold exactly that many
+// mines, less the flagged ones. A round tries, in order:
+//  - single-cell rules: with no mines left every hidden neighbour is safe,
+//    with as many mines as hidden cells all of them are mines;
+//  - pairs of overlapping constraints: when A needs as many more mines
+//    than B as it has cells outside B, those cells are mines and the cells
+//    only B has are safe;
+//  - enumerating every assignment of each connected part of the frontier
+//    that satisfies its constraints, weighted by the ways to place the
+//    remaining mines off the frontier. Cells that are never or always a
+//    mine are certain, otherwise the safest cell is guessed.
+class Solver
+{
+public:
+    struct Stats
+    {
+        long long singles = 0;    // Cells decided by single-cell rules
+        long long subsets = 0;    // Cells decided by pairs of constraints
+        long long enumerated = 0; // Cells found certain by enumeration
+        long long guesses = 0;
+        long long rounds = 0;
+    };
+
+private:
+    // Backtracking steps a part of the frontier may take before its cells
+    // fall back to a per-constraint estimate
+    static const long long NODE_LIMIT = 1000000;
+
+    struct Constraint
+    {
+        int mines;         // Still to place among cells
+        vector<int> cells; // Indexes into hidden, sorted
+    };
+
+    // A connected part of the frontier and its solutions, grouped by mine count
+    struct Part
+    {
+        vector<int> cells;
+        vector<double> solutions;     // By number of mines, scaled to sum to 1
+        vector<vector<double>> hits;  // [mines][cell] solutions with the cell a mine, same scale
+        bool exact = true;
+    };
+
+    Board &board;
+    mt19937_64 rng;
+    Stats stats;
+
+    vector<pair<int, int>> hidden; // Hidden cells next to an uncovered number
+    unordered_map<long long, int> hiddenIndex;
+    vector<Constraint> constraints;
+    vector<vector<int>> constraintsOf;
+    vector<int8_t> decided; // Per hidden cell: -1 unknown, 0 safe, 1 mine
+
+    long long key(int r, int c) const { return static_cast<long long>(r) * board.width() + c; }
+
+    void collect()
     {
-        cout << i << " | ";
-        for (int j = 0; j < COLS; j++)
+        hidden.clear();
+        hiddenIndex.clear();
+        constraints.clear();
+        board.forEachFrontierCell([&](int r, int c)
         {
-            if (showAll || board[i][j].state == UNCOVERED)
+            Constraint constraint;
+            constraint.mines = board.adjacentMines(r, c);
+            for (int i = max(0, r - 1); i <= min(board.height() - 1, r + 1); i++)
             {
-                if (board[i][j].hasMine)
+                for (int j = max(0, c - 1); j <= min(board.width() - 1, c + 1); j++)
                 {
-                    cout << "* ";
+                    CellState state = board.state(i, j);
+                    if (state == FLAGGED)
+                    {
+                        constraint.mines--;
+                    }
+                    else if (state == COVERED)
+                    {
+                        auto [entry, added] = hiddenIndex.emplace(key(i, j), static_cast<int>(hidden.size()));
+                        if (added)
+                            hidden.push_back({i, j});
+                        constraint.cells.push_back(entry->second);
+                    }
                 }
-                else
+            }
+            sort(constraint.cells.begin(), constraint.cells.end());
+            constraints.push_back(move(constraint));
+        });
+
+        constraintsOf.assign(hidden.size(), vector<int>());
+        for (size_t i = 0; i < constraints.size(); i++)
+        {
+            for (int cell : constraints[i].cells)
+                constraintsOf[cell].push_back(static_cast<int>(i));
+        }
+        decided.assign(hidden.size(), -1);
+    }
+
+    // Uncover the safe cells and flag the mines decided this round, the
+    // number of cells acted on
+    long long apply()
+    {
+        long long moves = 0;
+        for (size_t i = 0; i < hidden.size(); i++)
+        {
+            auto [r, c] = hidden[i];
+            if (decided[i] < 0 || board.state(r, c) != COVERED)
+                continue;
+            if (decided[i] == 0)
+                board.uncover(r, c);
+            else
+                board.toggleFlag(r, c);
+            moves++;
+        }
+        return moves;
+    }
+
+    void decide(const vector<int> &cells, int8_t mine)
+    {
+        for (int cell : cells)
+            decided[cell] = mine;
+    }
+
+    long long singleCellRules()
+    {
+        for (const Constraint &constraint : constraints)
+        {
+            if (constraint.mines == 0)
+                decide(constraint.cells, 0);
+            else if (constraint.mines == static_cast<int>(constraint.cells.size()))
+                decide(constraint.cells, 1);
+        }
+        return apply();
+    }
+
+    long long subsetRules()
+    {
+        vector<int> onlyA, onlyB;
+        for (size_t cell = 0; cell < hidden.size(); cell++)
+        {
+            const vector<int> &shared = constraintsOf[cell];
+            for (size_t x = 0; x < shared.size(); x++)
+            {
+                for (size_t y = x + 1; y < shared.size(); y++)
                 {
-                    if (board[i][j].adjacentMines == 0)
+                    const Constraint &a = constraints[shared[x]], &b = constraints[shared[y]];
+                    onlyA.clear();
+                    onlyB.clear();
+                    set_difference(a.cells.begin(), a.cells.end(), b.cells.begin(), b.cells.end(), back_inserter(onlyA));
+                    set_difference(b.cells.begin(), b.cells.end(), a.cells.begin(), a.cells.end(), back_inserter(onlyB));
+                    if (a.mines - b.mines == static_cast<int>(onlyA.size()))
                     {
-                        cout << ". ";
+                        decide(onlyA, 1);
+                        decide(onlyB, 0);
                     }
-                    else
+                    else if (b.mines - a.mines == static_cast<int>(onlyB.size()))
                     {
-                        cout << board[i][j].adjacentMines << " ";
+                        decide(onlyB, 1);
+                        decide(onlyA, 0);
                     }
                 }
             }
-            else if (board[i][j].state == FLAGGED)
+        }
+        return apply();
+    }
+
+    // Split the frontier into parts that share no constraint
+    vector<Part> splitFrontier()
+    {
+        vector<int> partOf(hidden.size(), -1);
+        vector<Part> parts;
+        for (size_t first = 0; first < hidden.size(); first++)
+        {
+            if (partOf[first] >= 0)
+                continue;
+            Part part;
+            int id = static_cast<int>(parts.size());
+            partOf[first] = id;
+            part.cells.push_back(static_cast<int>(first));
+            // Breadth-first, so each cell's constraints fill up soon after it
+            for (size_t next = 0; next < part.cells.size(); next++)
             {
-                cout << "F ";
+                for (int constraint : constraintsOf[part.cells[next]])
+                {
+                    for (int cell : constraints[constraint].cells)
+                    {
+                        if (partOf[cell] < 0)
+                        {
+                            partOf[cell] = id;
+                            part.cells.push_back(cell);
+                        }
+                    }
+                }
             }
-            else
+            parts.push_back(move(part));
+        }
+        return parts;
+    }
+
+    // Count the part's solutions by backtracking over its cells in order
+    void solvePart(Part &part)
+    {
+        size_t n = part.cells.size();
+        unordered_map<int, int> local;
+        for (size_t i = 0; i < n; i++)
+            local[part.cells[i]] = static_cast<int>(i);
+
+        // Constraints of the part: mines still needed and cells not yet assigned
+        vector<int> ids;
+        for (int cell : part.cells)
+            ids.insert(ids.end(), constraintsOf[cell].begin(), constraintsOf[cell].end());
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        vector<int> need(ids.size()), open(ids.size());
+        vector<vector<int>> cellConstraints(n);
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            need[i] = constraints[ids[i]].mines;
+            open[i] = static_cast<int>(constraints[ids[i]].cells.size());
+            for (int cell : constraints[ids[i]].cells)
+                cellConstraints[local[cell]].push_back(static_cast<int>(i));
+        }
+
+        part.solutions.assign(n + 1, 0.0);
+        part.hits.assign(n + 1, vector<double>());
+        vector<int8_t> value(n, 0);
+        long long nodes = 0;
+        int mines = 0;
+
+        function<void(size_t)> search = [&](size_t position)
+        {
+            if (++nodes > NODE_LIMIT)
+                return;
+            if (position == n)
+            {
+                part.solutions[mines] += 1.0;
+                vector<double> &hits = part.hits[mines];
+                hits.resize(n, 0.0);
+                for (size_t i = 0; i < n; i++)
+                    hits[i] += value[i];
+                return;
+            }
+            for (int8_t mine = 0; mine <= 1; mine++)
             {
-                cout << "# ";
+                bool fits = true;
+                for (int constraint : cellConstraints[position])
+                {
+                    int left = need[constraint] - mine;
+                    fits = fits && left >= 0 && left <= open[constraint] - 1;
+                }
+                if (!fits)
+                    continue;
+                for (int constraint : cellConstraints[position])
+                {
+                    need[constraint] -= mine;
+                    open[constraint]--;
+                }
+                value[position] = mine;
+                mines += mine;
+                search(position + 1);
+                mines -= mine;
+                value[position] = 0;
+                for (int constraint : cellConstraints[position])
+                {
+                    need[constraint] += mine;
+                    open[constraint]++;
+                }
             }
+        };
+        search(0);
+
+        double total = 0.0;
+        for (double count : part.solutions)
+            total += count;
+        part.exact = nodes <= NODE_LIMIT && total > 0.0;
+        for (size_t k = 0; part.exact && k <= n; k++)
+        {
+            part.solutions[k] /= total;
+            for (double &hit : part.hits[k])
+                hit /= total;
         }
-        cout << endl;
     }
-}
 
-// Uncover a cell recursively
-bool uncoverCell(int row, int col)
+    static vector<double> convolve(const vector<double> &a, const vector<double> &b)
+    {
+        vector<double> result(a.size() + b.size() - 1, 0.0);
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            for (size_t j = 0; a[i] != 0.0 && j < b.size(); j++)
+                result[i + j] += a[i] * b[j];
+        }
+        return result;
+    }
+
+    // A hidden cell away from the frontier: a corner if one is left, since
+    // those open up most often, else a random one
+    pair<int, int> offFrontierCell()
+    {
+        int rows = board.height(), cols = board.width();
+        auto free = [&](int r, int c)
+        { return board.state(r, c) == COVERED && hiddenIndex.count(key(r, c)) == 0; };
+        const pair<int, int> corners[] = {{0, 0}, {0, cols - 1}, {rows - 1, 0}, {rows - 1, cols - 1}};
+        for (auto [r, c] : corners)
+        {
+            if (free(r, c))
+                return {r, c};
+        }
+        uniform_int_distribution<int> row(0, rows - 1), col(0, cols - 1);
+        for (int attempt = 0; attempt < 256; attempt++)
+        {
+            int r = row(rng), c = col(rng);
+            if (free(r, c))
+                return {r, c};
+        }
+        for (int r = 0; r < rows; r++)
+        {
+            for (int c = 0; c < cols; c++)
+            {
+                if (free(r, c))
+                    return {r, c};
+            }
+        }
+        return {-1, -1};
+    }
+
+    // Mine probabilities of the frontier: certain cells are acted on,
+    // otherwise the least likely mine, on or off the frontier, is uncovered
+    long long enumerate()
+    {
+        vector<Part> parts = splitFrontier();
+        long long offFrontier = board.hiddenCells() - static_cast<long long>(hidden.size());
+        long long minesLeft = board.mineCount() - board.flagCount();
+
+        // Parts too big to enumerate count as off the frontier
+        vector<Part *> exact;
+        vector<double> probability(hidden.size(), 0.0);
+        for (Part &part : parts)
+        {
+            solvePart(part);
+            if (part.exact)
+            {
+                exact.push_back(&part);
+                continue;
+            }
+            offFrontier += part.cells.size();
+            for (int cell : part.cells)
+            {
+                for (int constraint : constraintsOf[cell])
+                {
+                    const Constraint &c = constraints[constraint];
+                    probability[cell] = max(probability[cell], static_cast<double>(c.mines) / c.cells.size());
+                }
+            }
+        }
+
+        // Prefix and suffix products give each part the mine distribution of the others
+        size_t count = exact.size();
+        vector<vector<double>> prefix(count + 1, vector<double>(1, 1.0)), suffix(count + 1, vector<double>(1, 1.0));
+        for (size_t i = 0; i < count; i++)
+            prefix[i + 1] = convolve(prefix[i], exact[i]->solutions);
+        for (size_t i = count; i-- > 0;)
+            suffix[i] = convolve(suffix[i + 1], exact[i]->solutions);
+        const vector<double> &all = prefix[count];
+
+        // Ways to place the rest of the mines off the frontier, relative to the largest
+        vector<double> weight(all.size(), 0.0);
+        double best = -HUGE_VAL;
+        auto logWays = [&](long long onFrontier) -> double
+        {
+            long long rest = minesLeft - onFrontier;
+            if (rest < 0 || rest > offFrontier)
+                return -HUGE_VAL;
+            // lgamma_r, since lgamma sets the global signgam and solvers run on several threads
+            int sign;
+            return lgamma_r(offFrontier + 1.0, &sign) - lgamma_r(rest + 1.0, &sign) -
+                   lgamma_r(offFrontier - rest + 1.0, &sign);
+        };
+        for (size_t t = 0; t < all.size(); t++)
+        {
+            if (all[t] > 0.0)
+                best = max(best, logWays(t));
+        }
+        double total = 0.0, expected = 0.0;
+        for (size_t t = 0; t < all.size() && best > -HUGE_VAL; t++)
+        {
+            weight[t] = exp(logWays(t) - best);
+            total += all[t] * weight[t];
+            expected += t * all[t] * weight[t];
+        }
+        if (total <= 0.0)
+            return 0; // Constraints that can't be met, only after a wrong flag
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const Part &part = *exact[i];
+            vector<double> others = convolve(prefix[i], suffix[i + 1]);
+            for (size_t k = 0; k < part.solutions.size(); k++)
+            {
+                if (part.solutions[k] == 0.0)
+                    continue;
+                double factor = 0.0;
+                for (size_t t = 0; t < others.size() && k + t < weight.size(); t++)
+                    factor += others[t] * weight[k + t];
+                factor /= total;
+                for (size_t j = 0; j < part.cells.size(); j++)
+                    probability[part.cells[j]] += part.hits[k][j] * factor;
+            }
+        }
+
+        const double EPSILON = 1e-9;
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int cell : exact[i]->cells)
+            {
+                if (probability[cell] < EPSILON)
+                    decided[cell] = 0;
+                else if (probability[cell] > 1.0 - EPSILON)
+                    decided[cell] = 1;
+            }
+        }
+        long long certain = apply();
+        if (certain > 0)
+        {
+            stats.enumerated += certain;
+            return certain;
+        }
+
+        // Guess the safest cell
+        stats.guesses++;
+        double offProbability = offFrontier > 0 ? (minesLeft - expected / total) / offFrontier : 1.0;
+        int safest = -1;
+        for (size_t cell = 0; cell < hidden.size(); cell++)
+        {
+            if (safest < 0 || probability[cell] < probability[safest])
+                safest = static_cast<int>(cell);
+        }
+        if (safest < 0 || offProbability < probability[safest])
+        {
+            auto [r, c] = offFrontierCell();
+            if (r >= 0)
+            {
+                board.uncover(r, c);
+                return 1;
+            }
+        }
+        if (safest < 0)
+            return 0;
+        board.uncover(hidden[safest].first, hidden[safest].second);
+        return 1;
+    }
+
+public:
+    Solver(Board &board, uint64_t seed) : board(board), rng(seed) {}
+
+    // Play until the game is won or lost, or no move is left
+    const Stats &play()
+    {
+        while (!board.won() && !board.lost())
+        {
+            stats.rounds++;
+            collect();
+            long long moves = singleCellRules();
+            stats.singles += moves;
+            if (moves > 0)
+                continue;
+            moves = subsetRules();
+            stats.subsets += moves;
+            if (moves > 0)
+                continue;
+            if (enumerate() == 0)
+                break;
+        }
+        return stats;
+    }
+};
+
+// Endless board made of 64 x 64 chunks, one word per chunk row. Whether a
+// cell holds a mine is a hash of the world seed and the cell's coordinates,
+// so a chunk can be generated on its own, in any order, and comes out the
+// same every time. Only chunks in use are kept: resident chunks sit in
+// slots linked in LRU order, and past the limit the least recently used one
+// is dropped, after writing its uncovered cells and flags to a record in a
+// file on the simulated disk if it has any. It's read back from there the
+// next time it's needed. Memory follows the area explored, not the world.
+//
+// Floods work as on the Board, in runs of open cells that continue into
+// the next chunk. Below about 10% mines the open cells percolate and a
+// flood would never end, so worlds have at least 12%.
+class World
 {
-    // Check bounds
-    if (row < 0 || row >= ROWS || col < 0 || col >= COLS)
+public:
+    static const int CHUNK = 64;
+    static constexpr double MIN_DENSITY = 0.12;
+
+    struct Stats
     {
-        return true;
+        size_t resident = 0;
+        size_t stored = 0;        // Chunk records in the file
+        uint64_t generated = 0;   // Chunks made resident
+        uint64_t evictions = 0;
+        uint64_t loads = 0;       // Chunks read back from the file
+        uint64_t refused = 0;     // Evictions the disk quota didn't allow
+        long long uncovered = 0;  // Safe cells uncovered so far
+    };
+
+private:
+    static const uint32_t NONE = UINT32_MAX;
+
+    struct Chunk
+    {
+        uint64_t key;
+        uint32_t prev, next; // LRU links, prev is more recent
+        bool dirty;          // Changed since it was last written out
+        bool touched;        // Has uncovered cells or flags
+        uint64_t mines[CHUNK], zero[CHUNK], uncovered[CHUNK], flags[CHUNK];
+    };
+
+    struct ChunkRecord
+    {
+        uint64_t key;
+        uint64_t uncovered[CHUNK];
+        uint64_t flags[CHUNK];
+    };
+
+    uint64_t seed = 0;
+    uint64_t threshold = 0; // A cell is a mine when its hash is below this
+    double density = 0.0;
+    size_t limit = 0;
+
+    vector<Chunk> slots;
+    vector<uint32_t> freeSlots;
+    unordered_map<uint64_t, uint32_t> resident;
+    uint32_t head = NONE, tail = NONE;
+    unordered_map<uint64_t, uint64_t> records; // Chunk key to record number
+    string fileName;                           // In the simulated disk, one per task
+    DiskFile file;
+
+    Stats counters;
+    bool exploded = false;
+    vector<pair<long long, long long>> pending;
+
+    static uint64_t chunkKey(long long cx, long long cy)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
     }
 
-    // Skip if already uncovered or flagged
-    if (board[row][col].state == UNCOVERED || board[row][col].state == FLAGGED)
+    static uint64_t mix64(uint64_t x)
     {
-        return true;
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
     }
 
-    // Uncover the cell
-    board[row][col].state = UNCOVERED;
+    void unlink(uint32_t slot)
+    {
+        Chunk &chunk = slots[slot];
+        (chunk.prev == NONE ? head : slots[chunk.prev].next) = chunk.next;
+        (chunk.next == NONE ? tail : slots[chunk.next].prev) = chunk.prev;
+    }
+
+    void pushFront(uint32_t slot)
+    {
+        slots[slot].prev = NONE;
+        slots[slot].next = head;
+        (head == NONE ? tail : slots[head].prev) = slot;
+        head = slot;
+    }
 
-    // Check if it's a mine
-    if (board[row][col].hasMine)
+    // Write a chunk's state to its record, adding one if it has none yet
+    bool store(const Chunk &chunk)
     {
+        auto found = records.find(chunk.key);
+        uint64_t number = found == records.end() ? records.size() : found->second;
+        if (found == records.end() && !diskLedger.charge(taskPid, sizeof(ChunkRecord)))
+            return false;
+        ChunkRecord record;
+        record.key = chunk.key;
+        memcpy(record.uncovered, chunk.uncovered, sizeof(record.uncovered));
+        memcpy(record.flags, chunk.flags, sizeof(record.flags));
+        if (!file.write(number * sizeof(record), reinterpret_cast<const char *>(&record), sizeof(record)))
+        {
+            if (found == records.end())
+                diskLedger.charge(taskPid, -static_cast<int64_t>(sizeof(ChunkRecord)));
+            return false;
+        }
+        records[chunk.key] = number;
+        return true;
+    }
+
+    // Free the least recently used slot, writing its chunk out first if it
+    // has state that isn't on disk yet. Chunks that can't be written stay.
+    bool evict()
+    {
+        for (uint32_t slot = tail; slot != NONE; slot = slots[slot].prev)
+        {
+            Chunk &chunk = slots[slot];
+            if (chunk.touched && chunk.dirty && !store(chunk))
+            {
+                counters.refused++;
+                continue;
+            }
+            unlink(slot);
+            resident.erase(chunk.key);
+            freeSlots.push_back(slot);
+            counters.evictions++;
+            return true;
+        }
         return false;
     }
 
-    // If it's a zero, uncover adjacent cells
-    if (board[row][col].adjacentMines == 0)
+    // Mines of a chunk and the open cells, those with no mine in their 3x3
+    // block, which needs the mines just outside it as well
+    void generate(Chunk &chunk, long long cx, long long cy)
     {
-        for (int i = max(0, row - 1); i <= min(ROWS - 1, row + 1); i++)
+        long long x0 = cx * CHUNK, y0 = cy * CHUNK;
+        uint64_t rows[CHUNK + 2], left[CHUNK + 2], right[CHUNK + 2];
+        for (int r = 0; r < CHUNK + 2; r++)
+        {
+            long long y = y0 + r - 1;
+            uint64_t bits = 0;
+            for (int c = 0; c < CHUNK; c++)
+                bits |= static_cast<uint64_t>(mineAt(x0 + c, y)) << c;
+            rows[r] = bits;
+            left[r] = mineAt(x0 - 1, y);
+            right[r] = mineAt(x0 + CHUNK, y);
+        }
+        for (int r = 0; r < CHUNK; r++)
         {
-            for (int j = max(0, col - 1); j <= min(COLS - 1, col + 1); j++)
+            chunk.mines[r] = rows[r + 1];
+            uint64_t block = rows[r] | rows[r + 1] | rows[r + 2];
+            uint64_t leftBit = left[r] | left[r + 1] | left[r + 2];
+            uint64_t rightBit = right[r] | right[r + 1] | right[r + 2];
+            chunk.zero[r] = ~(block | (block << 1) | leftBit | (block >> 1) | (rightBit << 63));
+        }
+        counters.generated++;
+    }
+
+    // The chunk, made resident and most recently used
+    Chunk &chunk(long long cx, long long cy)
+    {
+        uint64_t key = chunkKey(cx, cy);
+        auto found = resident.find(key);
+        if (found != resident.end())
+        {
+            if (head != found->second)
             {
-                if (i == row && j == col)
-                    continue;
-                uncoverCell(i, j);
+                unlink(found->second);
+                pushFront(found->second);
             }
+            return slots[found->second];
+        }
+
+        if (resident.size() >= limit)
+            evict();
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+
+        Chunk &chunk = slots[slot];
+        chunk.key = key;
+        chunk.dirty = false;
+        chunk.touched = false;
+        generate(chunk, cx, cy);
+        memset(chunk.uncovered, 0, sizeof(chunk.uncovered));
+        memset(chunk.flags, 0, sizeof(chunk.flags));
+        auto stored = records.find(key);
+        if (stored != records.end())
+        {
+            ChunkRecord record;
+            size_t count;
+            if (file.read(stored->second * sizeof(record), reinterpret_cast<char *>(&record), sizeof(record), count) &&
+                count == sizeof(record))
+            {
+                memcpy(chunk.uncovered, record.uncovered, sizeof(chunk.uncovered));
+                memcpy(chunk.flags, record.flags, sizeof(chunk.flags));
+                chunk.touched = true;
+                counters.loads++;
+            }
+        }
+        resident[key] = slot;
+        pushFront(slot);
+        return chunk;
+    }
+
+    static uint64_t columnMask(long long x0, long long a, long long b)
+    {
+        int low = static_cast<int>(max(a - x0, 0ll)), high = static_cast<int>(min(b - x0, 63ll));
+        uint64_t upper = high == 63 ? ~0ull : (2ull << high) - 1;
+        return upper & (~0ull << low);
+    }
+
+    // Visit the chunk rows covering columns a..b of row y as
+    // visit(chunk, row, mask, x0), mask holding the columns in the chunk
+    template <typename Visit>
+    void forSpan(long long y, long long a, long long b, Visit visit)
+    {
+        for (long long cx = a >> 6; cx <= b >> 6; cx++)
+        {
+            Chunk &c = chunk(cx, y >> 6);
+            visit(c, static_cast<int>(y & 63), columnMask(cx * CHUNK, a, b), cx * CHUNK);
         }
     }
 
+    static uint64_t openWord(const Chunk &chunk, int row) { return chunk.zero[row] & ~chunk.flags[row]; }
+
+    // First and last column of the run of open cells through x
+    long long runStart(long long x, long long y)
+    {
+        long long cx = x >> 6;
+        int bit = static_cast<int>(x & 63);
+        uint64_t closed = ~openWord(chunk(cx, y >> 6), y & 63) & (bit == 63 ? ~0ull : (2ull << bit) - 1);
+        while (closed == 0)
+            closed = ~openWord(chunk(--cx, y >> 6), y & 63);
+        return cx * CHUNK + 64 - __builtin_clzll(closed);
+    }
+
+    long long runEnd(long long x, long long y)
+    {
+        long long cx = x >> 6;
+        uint64_t closed = ~openWord(chunk(cx, y >> 6), y & 63) & (~0ull << (x & 63));
+        while (closed == 0)
+            closed = ~openWord(chunk(++cx, y >> 6), y & 63);
+        return cx * CHUNK + __builtin_ctzll(closed) - 1;
+    }
+
+public:
+    World() = default;
+    World(const World &) = delete;
+    World &operator=(const World &) = delete;
+    ~World() { close(); }
+
+    // Start a new world, dropping the records of the last one
+    void reset(uint64_t worldSeed, double mineDensity, size_t residentChunks)
+    {
+        close();
+        seed = mix64(worldSeed);
+        density = max(MIN_DENSITY, min(0.9, mineDensity));
+        threshold = static_cast<uint64_t>(density * 18446744073709551616.0);
+        limit = max<size_t>(residentChunks, 16);
+        slots.reserve(limit + 1);
+        exploded = false;
+        counters = Stats();
+        system("mkdir -p simulated_disk");
+        fileName = "minesweeper_world_" + to_string(taskPid);
+        file.open(diskClient, fileName, O_CREAT | O_TRUNC);
+    }
+
+    void close()
+    {
+        // Records only mean something to the world that wrote them
+        if (file.isOpen())
+        {
+            file.close();
+            ::unlink(("simulated_disk/" + fileName).c_str());
+        }
+        diskLedger.charge(taskPid, -static_cast<int64_t>(records.size() * sizeof(ChunkRecord)));
+        slots.clear();
+        freeSlots.clear();
+        resident.clear();
+        records.clear();
+        head = tail = NONE;
+    }
+
+    double mineDensity() const { return density; }
+    bool lost() const { return exploded; }
+
+    bool mineAt(long long x, long long y) const
+    {
+        return mix64(seed ^ (static_cast<uint64_t>(x) * 0xD6E8FEB86659FD93ull) ^
+                     (static_cast<uint64_t>(y) * 0xA0761D6478BD642Full)) < threshold;
+    }
+
+    int adjacentMines(long long x, long long y) const
+    {
+        int count = 0;
+        for (long long j = y - 1; j <= y + 1; j++)
+        {
+            for (long long i = x - 1; i <= x + 1; i++)
+                count += (i != x || j != y) && mineAt(i, j);
+        }
+        return count;
+    }
+
+    CellState state(long long x, long long y)
+    {
+        Chunk &c = chunk(x >> 6, y >> 6);
+        uint64_t bit = 1ull << (x & 63);
+        if (c.uncovered[y & 63] & bit)
+            return UNCOVERED;
+        return c.flags[y & 63] & bit ? FLAGGED : COVERED;
+    }
+
+    void toggleFlag(long long x, long long y)
+    {
+        Chunk &c = chunk(x >> 6, y >> 6);
+        uint64_t bit = 1ull << (x & 63);
+        if (c.uncovered[y & 63] & bit)
+            return;
+        c.flags[y & 63] ^= bit;
+        c.dirty = c.touched = true;
+    }
+
+    // Uncover a cell, flooding across chunks when it has no mines around.
+    // Returns false if it was a mine.
+    bool uncover(long long x, long long y)
+    {
+        {
+            Chunk &c = chunk(x >> 6, y >> 6);
+            int row = static_cast<int>(y & 63);
+            uint64_t bit = 1ull << (x & 63);
+            if ((c.uncovered[row] | c.flags[row]) & bit)
+                return true;
+            c.uncovered[row] |= bit;
+            c.dirty = c.touched = true;
+            if (c.mines[row] & bit)
+            {
+                exploded = true;
+                return false;
+            }
+            counters.uncovered++;
+            if (!(c.zero[row] & bit))
+                return true;
+        }
+
+        pending.clear();
+        pending.push_back({x, y});
+        while (!pending.empty())
+        {
+            auto [runX, runY] = pending.back();
+            pending.pop_back();
+            long long start = runStart(runX, runY), end = runEnd(runX, runY);
+            for (long long y = runY - 1; y <= runY + 1; y++)
+            {
+                forSpan(y, start - 1, end + 1, [&](Chunk &c, int row, uint64_t mask, long long x0)
+                {
+                    uint64_t fresh = mask & ~c.uncovered[row] & ~c.flags[row];
+                    if (fresh == 0)
+                        return;
+                    if (y != runY)
+                    {
+                        uint64_t seeds = fresh & c.zero[row];
+                        seeds &= ~(seeds << 1); // First cell of each run
+                        for (; seeds != 0; seeds &= seeds - 1)
+                            pending.push_back({x0 + __builtin_ctzll(seeds), y});
+                    }
+                    c.uncovered[row] |= fresh;
+                    c.dirty = c.touched = true;
+                    counters.uncovered += __builtin_popcountll(fresh);
+                });
+            }
+        }
+        return true;
+    }
+
+    Stats stats() const
+    {
+        Stats result = counters;
+        result.resident = resident.size();
+        result.stored = records.size();
+        return result;
+    }
+
+    size_t residentBytes() const { return slots.capacity() * sizeof(Chunk); }
+    static size_t recordBytes() { return sizeof(ChunkRecord); }
+};
+
+// Game board
+Board board;
+int viewRow = 0;
+int viewCol = 0;
+
+// Endless game
+World world;
+const double WORLD_DENSITY = 0.16;
+const size_t WORLD_CHUNKS = 1024; // 2 MB of resident chunks
+
+// Signal handler for graceful shutdown
+void signalHandler(int signal)
+{
+    if (signal == SIGINT)
+    {
+        cout << "Minesweeper shutting down..." << endl;
+        running = false;
+    }
+}
+
+// Initialize the game board
+bool initializeBoard(int rows = ROWS, int cols = COLS, int mines = MINES)
+{
+    if (!board.reset(rows, cols, mines, static_cast<uint64_t>(time(nullptr)) ^ rand()))
+    {
+        return false;
+    }
+    viewRow = 0;
+    viewCol = 0;
     return true;
 }
 
-// Toggle flag on a cell
-void toggleFlag(int row, int col)
+// Center the view on a cell
+void focusView(int row, int col)
+{
+    viewRow = max(0, min(row - VIEW_SIZE / 2, board.height() - VIEW_SIZE));
+    viewCol = max(0, min(col - VIEW_SIZE / 2, board.width() - VIEW_SIZE));
+}
+
+// Print rows top.. and columns first.. of a grid with their labels,
+// symbol(row, col) giving the character of each cell
+template <typename Symbol>
+void printCells(long long top, long long first, int height, int width, Symbol symbol)
+{
+    long long lastRow = top + height - 1, lastCol = first + width - 1;
+    int labelWidth = static_cast<int>(max(to_string(top).size(), to_string(lastRow).size()));
+    int cellWidth = static_cast<int>(max<size_t>(2, max(to_string(first).size(), to_string(lastCol).size()) + 1));
+
+    cout << string(labelWidth + 3, ' ');
+    for (long long j = first; j <= lastCol; j++)
+    {
+        cout << left << setw(cellWidth) << j;
+    }
+    cout << right << endl;
+
+    cout << string(labelWidth + 2, ' ');
+    for (long long j = first; j <= lastCol; j++)
+    {
+        cout << string(cellWidth, '-');
+    }
+    cout << endl;
+
+    for (long long i = top; i <= lastRow; i++)
+    {
+        cout << setw(labelWidth) << i << " | ";
+        for (long long j = first; j <= lastCol; j++)
+        {
+            cout << left << setw(cellWidth) << symbol(i, j);
+        }
+        cout << right << endl;
+    }
+}
+
+char cellSymbol(bool shown, bool mine, int count, CellState state)
+{
+    if (shown)
+        return mine ? '*' : count == 0 ? '.' : static_cast<char>('0' + count);
+    return state == FLAGGED ? 'F' : '#';
+}
+
+// Print the game board, or the part of it in view
+void printBoard(bool showAll = false)
+{
+    int height = min(board.height() - viewRow, VIEW_SIZE);
+    int width = min(board.width() - viewCol, VIEW_SIZE);
+    if (height < board.height() || width < board.width())
+    {
+        cout << "Rows " << viewRow << "-" << viewRow + height - 1 << ", columns " << viewCol << "-"
+             << viewCol + width - 1 << " of " << board.height() << " x " << board.width() << endl;
+    }
+
+    vector<uint8_t> counts(board.width());
+    long long countedRow = -1;
+    printCells(viewRow, viewCol, height, width, [&](long long i, long long j)
+    {
+        if (i != countedRow)
+        {
+            board.rowCounts(static_cast<int>(i), counts.data());
+            countedRow = i;
+        }
+        CellState state = board.state(i, j);
+        return cellSymbol(showAll || state == UNCOVERED, board.hasMine(i, j), counts[j], state);
+    });
+}
+
+// Print the view of the endless world, rows top.. and columns first..
+void printWorld(long long top, long long first, bool showAll = false)
+{
+    World::Stats stats = world.stats();
+    cout << "Rows " << top << "-" << top + VIEW_SIZE - 1 << ", columns " << first << "-" << first + VIEW_SIZE - 1
+         << " of an endless world. " << stats.uncovered << " safe cells uncovered, " << stats.resident
+         << " chunks in memory, " << stats.stored << " on disk" << endl;
+    printCells(top, first, VIEW_SIZE, VIEW_SIZE, [&](long long i, long long j)
+    {
+        CellState state = world.state(j, i);
+        bool shown = showAll || state == UNCOVERED;
+        return cellSymbol(shown, world.mineAt(j, i), shown ? world.adjacentMines(j, i) : 0, state);
+    });
+}
+
+// Endless game: there's no winning, only how much can be uncovered
+void playWorld()
+{
+    world.reset(static_cast<uint64_t>(time(nullptr)) ^ rand(), WORLD_DENSITY, WORLD_CHUNKS);
+    long long top = -VIEW_SIZE / 2, first = -VIEW_SIZE / 2;
+    cout << "\nAn endless world with " << WORLD_DENSITY * 100 << "% mines. Coordinates can be any size, negative too."
+         << endl;
+
+    while (running)
+    {
+        cout << endl;
+        printWorld(top, first);
+        cout << "\n===== Endless World =====\n";
+        cout << "1. Uncover a cell\n";
+        cout << "2. Toggle flag\n";
+        cout << "3. Move the view\n";
+        cout << "4. Back\n";
+        cout << "Enter choice: ";
+
+        int choice;
+        cin >> choice;
+        if (choice == 4 || !cin)
+        {
+            break;
+        }
+        if (choice < 1 || choice > 3)
+        {
+            cout << "Invalid choice. Try again." << endl;
+            continue;
+        }
+
+        long long row, col;
+        cout << "Enter row and column: ";
+        cin >> row >> col;
+        if (choice == 3 || choice == 1)
+        {
+            top = row - VIEW_SIZE / 2;
+            first = col - VIEW_SIZE / 2;
+        }
+        if (choice == 2)
+        {
+            world.toggleFlag(col, row);
+        }
+        else if (choice == 1 && !world.uncover(col, row))
+        {
+            cout << "\nBOOM! You hit a mine after uncovering " << world.stats().uncovered << " safe cells!" << endl;
+            printWorld(top, first, true);
+            break;
+        }
+    }
+    world.close();
+}
+
+// Time board generation, neighbour counts, flood fill and win detection on
+// a big board, checking the counts and the flood against plain versions
+void benchmarkBoard(int side, double density)
 {
-    if (row < 0 || row >= ROWS || col < 0 || col >= COLS)
+    using Clock = chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start)
+    { return chrono::duration<double>(Clock::now() - start).count(); };
+    long long cells = static_cast<long long>(side) * side;
+    cout << fixed << setprecision(2);
+
+    auto start = Clock::now();
+    if (!board.reset(side, side, static_cast<int>(cells * density / 100), 1))
     {
+        cerr << "Error: board side must be between 1 and " << MAX_SIDE << endl;
         return;
     }
+    cout << "Board " << side << " x " << side << ", " << board.mineCount() << " mines: generated in "
+         << elapsed(start) * 1000 << " ms, " << board.memoryBytes() / 1048576.0 << " MB of bit-planes" << endl;
 
-    if (board[row][col].state == COVERED)
+    vector<uint8_t> counts(side);
+    long long total = 0;
+    start = Clock::now();
+    for (int r = 0; r < side; r++)
+    {
+        board.rowCounts(r, counts.data());
+        total += counts[r % side];
+    }
+    double sliced = elapsed(start);
+    start = Clock::now();
+    long long scalarTotal = 0;
+    for (int r = 0; r < side; r++)
     {
-        board[row][col].state = FLAGGED;
+        scalarTotal += board.adjacentMines(r, r % side);
+        for (int c = 0; c < side; c++)
+            counts[c] = static_cast<uint8_t>(board.adjacentMines(r, c));
     }
-    else if (board[row][col].state == FLAGGED)
+    double scalar = elapsed(start);
+    bool countsMatch = total == scalarTotal;
+    for (int r = 0; r < side && countsMatch; r += max(1, side / 97))
     {
-        board[row][col].state = COVERED;
+        board.rowCounts(r, counts.data());
+        for (int c = 0; c < side; c++)
+            countsMatch = countsMatch && counts[c] == board.adjacentMines(r, c);
     }
+    cout << "Neighbour counts: " << cells / sliced / 1e6 << " M cells/s bit-sliced, " << cells / scalar / 1e6
+         << " M cells/s cell by cell, " << (countsMatch ? "match" : "MISMATCH") << endl;
+
+    // A sparse board opens up in one huge region
+    board.reset(side, side, static_cast<int>(cells / 200), 2);
+    int row = 0, col = 0;
+    while (board.adjacentMines(row, col) != 0 || board.hasMine(row, col))
+    {
+        col = (col + 1) % side;
+        row += col == 0;
+    }
+    long long before = board.safeCellsLeft();
+    start = Clock::now();
+    board.uncover(row, col);
+    double flood = elapsed(start);
+    long long opened = before - board.safeCellsLeft();
+    cout << "Flood fill: " << opened << " cells uncovered in " << flood * 1000 << " ms ("
+         << opened / max(flood, 1e-9) / 1e6 << " M cells/s), no recursion" << endl;
+
+    // Same flood with a plain queue on a smaller board
+    int small = min(side, 1500);
+    board.reset(small, small, small * small / 200, 3);
+    vector<vector<bool>> seen(small, vector<bool>(small, false));
+    deque<pair<int, int>> queue;
+    row = col = 0;
+    while (board.adjacentMines(row, col) != 0 || board.hasMine(row, col))
+    {
+        col = (col + 1) % small;
+        row += col == 0;
+    }
+    long long expected = 0;
+    seen[row][col] = true;
+    queue.push_back({row, col});
+    while (!queue.empty())
+    {
+        auto [r, c] = queue.front();
+        queue.pop_front();
+        expected++;
+        if (board.adjacentMines(r, c) != 0)
+            continue;
+        for (int i = max(0, r - 1); i <= min(small - 1, r + 1); i++)
+        {
+            for (int j = max(0, c - 1); j <= min(small - 1, c + 1); j++)
+            {
+                if (!seen[i][j])
+                {
+                    seen[i][j] = true;
+                    queue.push_back({i, j});
+                }
+            }
+        }
+    }
+    before = board.safeCellsLeft();
+    board.uncover(row, col);
+    cout << "Flood check on " << small << " x " << small << ": " << before - board.safeCellsLeft() << " cells, "
+         << (before - board.safeCellsLeft() == expected ? "matches" : "DIFFERS FROM") << " a queue-based fill" << endl;
+
+    // Uncover every safe cell, the win needs no scan
+    board.reset(side, side, static_cast<int>(cells * density / 100), 1);
+    start = Clock::now();
+    long long moves = 0;
+    for (int r = 0; r < side; r++)
+    {
+        for (int c = 0; c < side; c++)
+        {
+            if (!board.hasMine(r, c) && board.state(r, c) == COVERED)
+            {
+                board.uncover(r, c);
+                moves++;
+            }
+        }
+    }
+    cout << "Cleared the board in " << moves << " moves and " << elapsed(start) << " s, "
+         << (board.won() ? "won" : "NOT WON") << " with " << board.safeCellsLeft() << " safe cells left" << endl;
+    cout << defaultfloat;
 }
 
-// Check if the game is won
-bool checkWin()
+// Explore an endless world with a random walk of clicks on safe cells
+// while only a few chunks fit in memory, then revisit every click to check
+// that chunks come back from disk intact. Floods are checked against a
+// plain breadth-first search first.
+void benchmarkWorld(long clicks, size_t residentChunks)
 {
-    for (int i = 0; i < ROWS; i++)
+    using Clock = chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start)
+    { return chrono::duration<double>(Clock::now() - start).count(); };
+    auto cellKey = [](long long x, long long y)
+    { return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y); };
+    cout << fixed << setprecision(2);
+
+    // The smallest cache makes floods cross chunks that were just evicted
+    int matching = 0;
+    const int CHECKS = 20;
+    for (int check = 0; check < CHECKS; check++)
     {
-        for (int j = 0; j < COLS; j++)
+        world.reset(100 + check, WORLD_DENSITY, 16);
+        long long x = -1000 + check * 97;
+        while (world.mineAt(x, 7) || world.adjacentMines(x, 7) != 0)
+            x++;
+        unordered_map<uint64_t, bool> seen;
+        deque<pair<long long, long long>> queue = {{x, 7}};
+        seen[cellKey(x, 7)] = true;
+        long long expected = 0;
+        while (!queue.empty())
         {
-            if (!board[i][j].hasMine && board[i][j].state != UNCOVERED)
+            auto [cx, cy] = queue.front();
+            queue.pop_front();
+            expected++;
+            if (world.adjacentMines(cx, cy) != 0)
+                continue;
+            for (long long j = cy - 1; j <= cy + 1; j++)
             {
-                return false;
+                for (long long i = cx - 1; i <= cx + 1; i++)
+                {
+                    if (seen.emplace(cellKey(i, j), true).second)
+                        queue.push_back({i, j});
+                }
             }
         }
+        world.uncover(x, 7);
+        matching += world.stats().uncovered == expected;
     }
-    return true;
+    cout << "Flood check: " << matching << " of " << CHECKS << " floods match a breadth-first search" << endl;
+
+    world.reset(1, WORLD_DENSITY, residentChunks);
+    mt19937_64 rng(1);
+    uniform_int_distribution<int> step(-300, 300);
+    vector<pair<long long, long long>> visited;
+    long long x = 0, y = 0, minX = 0, maxX = 0, minY = 0, maxY = 0;
+    auto start = Clock::now();
+    for (long i = 0; i < clicks; i++)
+    {
+        x += step(rng);
+        y += step(rng);
+        while (world.mineAt(x, y))
+            x++;
+        world.uncover(x, y);
+        visited.push_back({x, y});
+        minX = min(minX, x), maxX = max(maxX, x);
+        minY = min(minY, y), maxY = max(maxY, y);
+    }
+    double seconds = elapsed(start);
+    World::Stats stats = world.stats();
+    double area = static_cast<double>(maxX - minX + 1) * (maxY - minY + 1);
+    cout << "Explored: " << clicks << " clicks in " << seconds << " s (" << clicks / seconds << " clicks/s), "
+         << stats.uncovered << " safe cells uncovered over " << maxX - minX + 1 << " x " << maxY - minY + 1 << " cells"
+         << endl;
+    cout << "Chunks: " << stats.generated << " generated, " << stats.evictions << " evicted, " << stats.loads
+         << " read back, " << stats.refused << " kept for lack of quota" << endl;
+    cout << "Memory: " << world.residentBytes() / 1048576.0 << " MB for " << stats.resident << " resident chunks, "
+         << stats.stored * World::recordBytes() / 1048576.0 << " MB on disk for " << stats.stored
+         << " chunks; a flat board of the same area would need " << area / 2 / 1048576.0 << " MB" << endl;
+
+    start = Clock::now();
+    long long intact = 0;
+    for (auto [cx, cy] : visited)
+        intact += world.state(cx, cy) == UNCOVERED;
+    stats = world.stats();
+    cout << "Revisit: " << intact << " of " << visited.size() << " clicked cells still uncovered, "
+         << stats.loads << " chunks read back in total, " << elapsed(start) << " s" << endl;
+    world.close();
+    cout << defaultfloat;
+}
+
+// Play seeded games with the solver on every core. Game i always uses seed
+// i + 1, so the results don't depend on the number of threads.
+void benchmarkSolver(int games, int rows, int cols, int mines, int threads)
+{
+    if (threads < 1)
+        threads = max(1u, thread::hardware_concurrency());
+    atomic<int> next{0};
+    vector<Solver::Stats> totals(threads);
+    vector<long long> wins(threads, 0);
+    vector<char> invalid(threads, 0); // Not vector<bool>, whose flags share bytes between threads
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            Board game;
+            for (int i = next++; i < games; i = next++)
+            {
+                if (!game.reset(rows, cols, mines, i + 1))
+                {
+                    invalid[t] = 1;
+                    return;
+                }
+                Solver solver(game, i + 1);
+                const Solver::Stats &stats = solver.play();
+                wins[t] += game.won();
+                totals[t].singles += stats.singles;
+                totals[t].subsets += stats.subsets;
+                totals[t].enumerated += stats.enumerated;
+                totals[t].guesses += stats.guesses;
+                totals[t].rounds += stats.rounds;
+            }
+        });
+    }
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (find(invalid.begin(), invalid.end(), 1) != invalid.end())
+    {
+        cerr << "Error: board side must be between 1 and " << MAX_SIDE << endl;
+        return;
+    }
+
+    Solver::Stats total;
+    long long won = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        won += wins[t];
+        total.singles += totals[t].singles;
+        total.subsets += totals[t].subsets;
+        total.enumerated += totals[t].enumerated;
+        total.guesses += totals[t].guesses;
+        total.rounds += totals[t].rounds;
+    }
+    cout << fixed << setprecision(2);
+    cout << "Played " << games << " games of " << rows << " x " << cols << " with " << mines << " mines on "
+         << threads << " threads in " << seconds << " s: " << games / seconds << " games/s" << endl;
+    cout << "Won " << won << " (" << 100.0 * won / max(games, 1) << "%), per game " << double(total.rounds) / games
+         << " rounds and " << double(total.guesses) / games << " guesses" << endl;
+    cout << "Cells decided by single-cell rules " << total.singles << ", constraint pairs " << total.subsets
+         << ", enumeration " << total.enumerated << endl;
+    cout << defaultfloat;
 }
 
 void displayMenu()
@@ -218,15 +1729,47 @@ void displayMenu()
     cout << "2. Toggle flag\n";
     cout << "3. New game\n";
     cout << "4. Exit\n";
+    cout << "5. New game with a custom size\n";
+    cout << "6. Move the view\n";
+    cout << "7. Let the solver play\n";
+    cout << "8. Explore an endless world\n";
     cout << "Enter choice: ";
 }
 
 int main(int argc, char *argv[])
 {
+    // Benchmark mode: minesweeper --bench-board [side] [mine percent]
+    if (argc >= 2 && string(argv[1]) == "--bench-board")
+    {
+        benchmarkBoard(argc >= 3 ? atoi(argv[2]) : MAX_SIDE, argc >= 4 ? atof(argv[3]) : 15.0);
+        return 0;
+    }
+
+    // Headless mode: minesweeper --bench-solver [games] [rows cols mines] [threads]
+    if (argc >= 2 && string(argv[1]) == "--bench-solver")
+    {
+        bool sized = argc >= 6;
+        benchmarkSolver(argc >= 3 ? atoi(argv[2]) : 1000, sized ? atoi(argv[3]) : 16, sized ? atoi(argv[4]) : 30,
+                        sized ? atoi(argv[5]) : 99, argc >= 7 ? atoi(argv[6]) : 0);
+        return 0;
+    }
+
+    // Benchmark mode: minesweeper --bench-world [clicks] [resident chunks]
+    // Swapped-out chunks go through the OS buffer cache if the OS is running
+    if (argc >= 2 && string(argv[1]) == "--bench-world")
+    {
+        diskClient.connect();
+        benchmarkWorld(argc >= 3 ? atol(argv[2]) : 100000, argc >= 4 ? atol(argv[3]) : 256);
+        return 0;
+    }
+
     // Check command line arguments (pid, memory, disk)
     if (argc < 4)
     {
         cerr << "Usage: " << argv[0] << " <pid> <memory_required> <disk_required>" << endl;
+        cerr << "       " << argv[0] << " --bench-board [side] [mine percent]" << endl;
+        cerr << "       " << argv[0] << " --bench-solver [games] [rows cols mines] [threads]" << endl;
+        cerr << "       " << argv[0] << " --bench-world [clicks] [resident chunks]" << endl;
         return 1;
     }
 
@@ -242,6 +1785,11 @@ int main(int argc, char *argv[])
     // Register signal handler
     signal(SIGINT, signalHandler);
 
+    // Swapped-out chunks are charged to this task's quota, unmetered when run standalone
+    taskPid = pid;
+    diskLedger.open(false);
+    diskClient.connect();
+
     // Seed random number generator
     srand(time(nullptr));
 
@@ -253,7 +1801,7 @@ int main(int argc, char *argv[])
 
     cout << "\nWelcome to Minesweeper!" << endl;
     cout << "Find all cells without mines to win." << endl;
-    cout << "There are " << MINES << " mines on the board." << endl;
+    cout << "There are " << board.mineCount() << " mines on the board." << endl;
 
     while (running && !gameOver)
     {
@@ -275,9 +1823,10 @@ int main(int argc, char *argv[])
             cout << "Enter row and column (e.g., 2 3): ";
             cin >> row >> col;
 
-            if (row >= 0 && row < ROWS && col >= 0 && col < COLS)
+            if (board.inside(row, col))
             {
-                bool safe = uncoverCell(row, col);
+                focusView(row, col);
+                bool safe = board.uncover(row, col);
                 if (!safe)
                 {
                     cout << "\nBOOM! You hit a mine!" << endl;
@@ -285,7 +1834,7 @@ int main(int argc, char *argv[])
                 }
                 else
                 {
-                    gameWon = checkWin();
+                    gameWon = board.won();
                     if (gameWon)
                     {
                         cout << "\nCongratulations! You found all the safe cells!" << endl;
@@ -306,9 +1855,9 @@ int main(int argc, char *argv[])
             cout << "Enter row and column to flag/unflag: ";
             cin >> row >> col;
 
-            if (row >= 0 && row < ROWS && col >= 0 && col < COLS)
+            if (board.inside(row, col))
             {
-                toggleFlag(row, col);
+                board.toggleFlag(row, col);
             }
             else
             {
@@ -318,7 +1867,7 @@ int main(int argc, char *argv[])
         }
 
         case 3: // New game
-            initializeBoard();
+            initializeBoard(board.height(), board.width(), board.mineCount());
             gameOver = false;
             gameWon = false;
             cout << "\nNew game started!" << endl;
@@ -328,6 +1877,49 @@ int main(int argc, char *argv[])
             running = false;
             break;
 
+        case 5:
+        { // New game with a custom size
+            int rows, cols, mines;
+            cout << "Enter rows, columns and mines (up to " << MAX_SIDE << " x " << MAX_SIDE << "): ";
+            cin >> rows >> cols >> mines;
+            if (initializeBoard(rows, cols, mines))
+            {
+                gameOver = false;
+                gameWon = false;
+                cout << "\nNew " << rows << " x " << cols << " game with " << board.mineCount() << " mines started!" << endl;
+            }
+            else
+            {
+                cout << "Invalid size. Try again." << endl;
+            }
+            break;
+        }
+
+        case 6:
+        { // Move the view
+            int row, col;
+            cout << "Enter the row and column to center the view on: ";
+            cin >> row >> col;
+            focusView(row, col);
+            break;
+        }
+
+        case 7:
+        { // Let the solver play
+            Solver solver(board, static_cast<uint64_t>(time(nullptr)));
+            const Solver::Stats &stats = solver.play();
+            cout << "\nThe solver decided " << stats.singles + stats.subsets + stats.enumerated << " cells and guessed "
+                 << stats.guesses << " times" << endl;
+            gameWon = board.won();
+            gameOver = gameWon || board.lost();
+            cout << (gameWon ? "\nThe solver found all the safe cells!" : board.lost() ? "\nBOOM! The solver hit a mine!" : "\nThe solver is stuck.") << endl;
+            break;
+        }
+
+        case 8: // Explore an endless world
+            playWorld();
+            break;
+
         default:
             cout << "Invalid choice. Try again." << endl;
             break;
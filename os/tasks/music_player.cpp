@@ -10,6 +10,26 @@
 #include <fstream>
 #include <unistd.h>
 #include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <deque>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <functional>
+#include <memory>
+#include <cmath>
+#include <ctime>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "../include/DiskLedger.h"
+#include "../include/DiskClient.h"
+#include "../include/HeapCounter.h"
 
 using namespace std;
 
@@ -26,9 +46,1542 @@ struct Song
     string genre;
 };
 
-vector<Song> playlist;
-int currentSongIndex = 0;
-int playbackPosition = 0;
+// Saved playlists are charged to this task's disk quota
+DiskLedger diskLedger;
+int taskPid = 0;
+
+// Recordings go through the OS buffer cache when the OS is running
+DiskClient diskClient;
+
+// A song as seen through the library, the strings point into its storage
+struct SongView
+{
+    string_view title;
+    string_view artist;
+    int duration;
+    string_view genre;
+};
+
+// On-disk library, version 1. The .songs file is this header followed by
+// count fixed-width records; the strings they point to live in the .strings
+// heap. Appends write the strings, then the record, then the header, so a
+// crash part way through leaves the previous library intact.
+const char LIBRARY_MAGIC[4] = {'M', 'P', 'L', 'B'};
+const uint32_t LIBRARY_VERSION = 1;
+
+struct LibraryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t count;    // Complete records
+    uint64_t heapSize; // Bytes of the string heap in use
+};
+
+struct SongRecord
+{
+    uint32_t title; // Offsets into the string heap
+    uint32_t artist;
+    uint32_t genre;
+    uint32_t duration;
+    uint16_t titleLength;
+    uint16_t artistLength;
+    uint16_t genreLength;
+    uint16_t flags; // Reserved, 0
+};
+
+static_assert(sizeof(LibraryHeader) == 32 && sizeof(SongRecord) == 24, "Library layout is part of the file format");
+
+// Song library backed by the mapped files. Loading maps them and checks the
+// header, nothing is parsed or copied, so it costs the same for ten songs
+// as for a million. Songs added since the load are kept in a small tail
+// that uses the same record layout, with heap offsets continuing past the
+// mapped heap.
+//
+// A library can be kept in the OS file store instead while the OS runs.
+// It is then read into memory rather than mapped, and each save only adds
+// the chunks that changed to the store.
+class SongLibrary
+{
+private:
+    string songsPath; // base.songs, base.strings
+    string heapPath;
+    DiskClient *store = nullptr; // Set when the library may be kept in the store
+    string songsName;            // The files' names in the store
+    string heapName;
+
+    const char *songsMap = nullptr;
+    size_t songsMapSize = 0;
+    const char *heapMap = nullptr;
+    size_t heapMapSize = 0;
+    const SongRecord *records = nullptr;
+    uint64_t mappedCount = 0;
+    uint64_t mappedHeap = 0;
+
+    string storedSongs; // What songsMap and heapMap point into when read from the store
+    string storedHeap;
+    bool fromStore = false;
+
+    vector<SongRecord> added;
+    string addedHeap;
+    uint64_t persisted = 0; // Songs that are in the files
+    bool onDisk = false;    // The files exist and match the mapping
+    uint64_t generation = 0; // Changes whenever songs may have been replaced
+
+    string_view text(uint32_t offset, uint16_t length) const
+    {
+        if (offset + static_cast<uint64_t>(length) <= mappedHeap)
+            return string_view(heapMap + offset, length);
+        if (offset >= mappedHeap && offset - mappedHeap + length <= addedHeap.size())
+            return string_view(addedHeap.data() + (offset - mappedHeap), length);
+        return string_view(); // Corrupt record
+    }
+
+    const SongRecord &record(size_t index) const
+    {
+        return index < mappedCount ? records[index] : added[index - mappedCount];
+    }
+
+    void unmap()
+    {
+        if (fromStore)
+        {
+            storedSongs = string();
+            storedHeap = string();
+        }
+        else
+        {
+            if (songsMap != nullptr)
+                munmap(const_cast<char *>(songsMap), songsMapSize);
+            if (heapMap != nullptr)
+                munmap(const_cast<char *>(heapMap), heapMapSize);
+        }
+        fromStore = false;
+        songsMap = heapMap = nullptr;
+        songsMapSize = heapMapSize = 0;
+        records = nullptr;
+        mappedCount = mappedHeap = 0;
+    }
+
+    static bool writeAt(int fd, const void *data, size_t size, uint64_t offset)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t written = pwrite(fd, bytes, size, offset);
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    static long long fileSize(const string &path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+    }
+
+    bool inStore() const { return store != nullptr && store->connected(); }
+
+    bool validHeader() const
+    {
+        if (songsMapSize < sizeof(LibraryHeader))
+            return false;
+        const LibraryHeader *header = reinterpret_cast<const LibraryHeader *>(songsMap);
+        return memcmp(header->magic, LIBRARY_MAGIC, sizeof(header->magic)) == 0 && header->version == LIBRARY_VERSION &&
+               header->recordSize == sizeof(SongRecord) &&
+               header->count <= (songsMapSize - sizeof(LibraryHeader)) / sizeof(SongRecord);
+    }
+
+    // Point the records at the loaded files, once the header is checked and the heap is in place
+    void attach()
+    {
+        const LibraryHeader *header = reinterpret_cast<const LibraryHeader *>(songsMap);
+        records = reinterpret_cast<const SongRecord *>(songsMap + sizeof(LibraryHeader));
+        mappedCount = header->count;
+        mappedHeap = header->heapSize;
+        persisted = mappedCount;
+        onDisk = true;
+    }
+
+    // Take over the two files' contents as the loaded library
+    void attachStored(string &&songs, string &&heap)
+    {
+        storedSongs = move(songs);
+        storedHeap = move(heap);
+        fromStore = true;
+        songsMap = storedSongs.data();
+        songsMapSize = storedSongs.size();
+        heapMap = storedHeap.data();
+        heapMapSize = storedHeap.size();
+    }
+
+    bool loadStored()
+    {
+        string songs, heap;
+        if (!store->storeRead(songsName, songs))
+            return false;
+        attachStored(move(songs), move(heap));
+        if (!validHeader())
+        {
+            unmap();
+            return false;
+        }
+        uint64_t heapSize = reinterpret_cast<const LibraryHeader *>(songsMap)->heapSize;
+        if (heapSize > 0 && (!store->storeRead(heapName, storedHeap) || storedHeap.size() < heapSize))
+        {
+            unmap();
+            return false;
+        }
+        heapMap = storedHeap.data();
+        heapMapSize = storedHeap.size();
+        attach();
+        return true;
+    }
+
+    // The heap goes first, so the stored .songs never points past it
+    bool storeFiles(const string &songs, const string &heap)
+    {
+        return store->storeWrite(heapName, heap) && store->storeWrite(songsName, songs);
+    }
+
+public:
+    explicit SongLibrary(const string &base) : songsPath(base + ".songs"), heapPath(base + ".strings") {}
+    ~SongLibrary() { unmap(); }
+
+    SongLibrary(const SongLibrary &) = delete;
+    SongLibrary &operator=(const SongLibrary &) = delete;
+
+    // Keep the library in the OS file store whenever client is connected.
+    // Files written by a run without the OS are loaded first, they are newer,
+    // and are removed once a save has put their songs in the store.
+    void useStore(DiskClient &client)
+    {
+        store = &client;
+        songsName = songsPath.substr(songsPath.find('/') + 1); // The paths are under simulated_disk
+        heapName = heapPath.substr(heapPath.find('/') + 1);
+    }
+
+    bool stored() const { return fromStore; }
+
+    size_t size() const { return mappedCount + added.size(); }
+    bool empty() const { return size() == 0; }
+
+    SongView song(size_t index) const
+    {
+        const SongRecord &entry = record(index);
+        return {text(entry.title, entry.titleLength), text(entry.artist, entry.artistLength),
+                static_cast<int>(entry.duration), text(entry.genre, entry.genreLength)};
+    }
+
+    uint64_t version() const { return generation; }
+
+    void clear()
+    {
+        generation++;
+        unmap();
+        added.clear();
+        addedHeap.clear();
+        persisted = 0;
+        onDisk = false;
+    }
+
+    // Add a song in memory only, save() writes it out
+    void add(string_view title, string_view artist, int duration, string_view genre)
+    {
+        auto put = [this](string_view value, uint32_t &offset, uint16_t &length)
+        {
+            length = static_cast<uint16_t>(min<size_t>(value.size(), UINT16_MAX));
+            offset = static_cast<uint32_t>(mappedHeap + addedHeap.size());
+            addedHeap.append(value.data(), length);
+        };
+        SongRecord entry{};
+        put(title, entry.title, entry.titleLength);
+        put(artist, entry.artist, entry.artistLength);
+        put(genre, entry.genre, entry.genreLength);
+        entry.duration = static_cast<uint32_t>(max(duration, 0));
+        added.push_back(entry);
+    }
+
+    // Add a song and write just its record and strings to the library files.
+    // Falls back to memory only when there are unsaved songs or no files yet.
+    // Returns false if the write was refused or failed.
+    bool append(string_view title, string_view artist, int duration, string_view genre)
+    {
+        size_t heapStart = addedHeap.size();
+        add(title, artist, duration, genre);
+        if (!onDisk || persisted + 1 != size())
+            return true;
+
+        if (fromStore)
+        {
+            // The store replaces whole files, but only the chunks at their ends are new to it
+            LibraryHeader header{};
+            memcpy(header.magic, LIBRARY_MAGIC, sizeof(header.magic));
+            header.version = LIBRARY_VERSION;
+            header.recordSize = sizeof(SongRecord);
+            header.count = size();
+            header.heapSize = mappedHeap + addedHeap.size();
+            string songs(reinterpret_cast<const char *>(&header), sizeof(header));
+            songs.append(reinterpret_cast<const char *>(records), mappedCount * sizeof(SongRecord));
+            songs.append(reinterpret_cast<const char *>(added.data()), added.size() * sizeof(SongRecord));
+            string heap(heapMap, mappedHeap);
+            heap += addedHeap;
+            if (!inStore() || !storeFiles(songs, heap))
+                return false;
+            persisted++;
+            return true;
+        }
+
+        size_t heapBytes = addedHeap.size() - heapStart;
+        long long charged = static_cast<long long>(heapBytes + sizeof(SongRecord));
+        if (!diskLedger.charge(taskPid, charged))
+            return false;
+
+        int songsFd = ::open(songsPath.c_str(), O_WRONLY | O_CLOEXEC);
+        int heapFd = ::open(heapPath.c_str(), O_WRONLY | O_CLOEXEC);
+        LibraryHeader header{};
+        memcpy(header.magic, LIBRARY_MAGIC, sizeof(header.magic));
+        header.version = LIBRARY_VERSION;
+        header.recordSize = sizeof(SongRecord);
+        header.count = size();
+        header.heapSize = mappedHeap + addedHeap.size();
+        bool ok = songsFd >= 0 && heapFd >= 0 &&
+                  writeAt(heapFd, addedHeap.data() + heapStart, heapBytes, mappedHeap + heapStart) &&
+                  writeAt(songsFd, &added.back(), sizeof(SongRecord), sizeof(header) + persisted * sizeof(SongRecord)) &&
+                  writeAt(songsFd, &header, sizeof(header), 0);
+        if (songsFd >= 0)
+            close(songsFd);
+        if (heapFd >= 0)
+            close(heapFd);
+        if (ok)
+            persisted++;
+        else
+            diskLedger.charge(taskPid, -charged);
+        return ok;
+    }
+
+    // Map the library files. Allocates nothing, records are checked as they are read.
+    // Without the files, a library kept in the store is read from there.
+    bool load()
+    {
+        clear();
+        if (loadFiles())
+            return true;
+        return inStore() && loadStored();
+    }
+
+    bool loadFiles()
+    {
+        int fd = ::open(songsPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(LibraryHeader))
+        {
+            close(fd);
+            return false;
+        }
+        void *songs = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (songs == MAP_FAILED)
+            return false;
+        songsMap = static_cast<const char *>(songs);
+        songsMapSize = info.st_size;
+
+        const LibraryHeader *header = reinterpret_cast<const LibraryHeader *>(songsMap);
+        if (!validHeader())
+        {
+            unmap();
+            return false;
+        }
+
+        if (header->heapSize > 0)
+        {
+            fd = ::open(heapPath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0 || fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < header->heapSize)
+            {
+                if (fd >= 0)
+                    close(fd);
+                unmap();
+                return false;
+            }
+            void *heap = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (heap == MAP_FAILED)
+            {
+                unmap();
+                return false;
+            }
+            heapMap = static_cast<const char *>(heap);
+            heapMapSize = info.st_size;
+        }
+        attach();
+        return true;
+    }
+
+    // Rewrite both files from the current songs, sharing repeated artist and
+    // genre strings, then map the result. Only growth is charged, and nothing
+    // when the files go to the store.
+    bool save()
+    {
+        vector<SongRecord> out(size());
+        string heap;
+        unordered_map<string_view, uint32_t> interned;
+        auto put = [&](string_view value, bool share, uint32_t &offset)
+        {
+            if (share)
+            {
+                auto found = interned.find(value);
+                if (found != interned.end())
+                {
+                    offset = found->second;
+                    return;
+                }
+            }
+            offset = static_cast<uint32_t>(heap.size());
+            heap.append(value.data(), value.size());
+            if (share)
+                interned.emplace(value, offset);
+        };
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            SongRecord entry = record(i);
+            SongView view = song(i);
+            put(view.title, false, entry.title);
+            put(view.artist, true, entry.artist);
+            put(view.genre, true, entry.genre);
+            out[i] = entry;
+        }
+
+        LibraryHeader header{};
+        memcpy(header.magic, LIBRARY_MAGIC, sizeof(header.magic));
+        header.version = LIBRARY_VERSION;
+        header.recordSize = sizeof(SongRecord);
+        header.count = out.size();
+        header.heapSize = heap.size();
+
+        // Same songs in the same order, so anything indexed by position stays valid
+        uint64_t unchanged = generation;
+        if (inStore())
+        {
+            string songs(reinterpret_cast<const char *>(&header), sizeof(header));
+            songs.append(reinterpret_cast<const char *>(out.data()), out.size() * sizeof(SongRecord));
+            if (!storeFiles(songs, heap))
+                return false;
+
+            // Files from a run without the OS are superseded, and stop counting against the quota
+            long long superseded = fileSize(songsPath) + fileSize(heapPath);
+            unlink(songsPath.c_str());
+            unlink(heapPath.c_str());
+            if (superseded > 0)
+                diskLedger.charge(taskPid, -superseded);
+
+            clear();
+            attachStored(move(songs), move(heap));
+            attach();
+            generation = unchanged;
+            return true;
+        }
+
+        long long bytes = sizeof(header) + out.size() * sizeof(SongRecord) + heap.size();
+        if (!diskLedger.charge(taskPid, bytes - fileSize(songsPath) - fileSize(heapPath)))
+            return false;
+
+        // Write both files aside and rename them in, the .songs file last
+        string songsTemp = songsPath + ".tmp", heapTemp = heapPath + ".tmp";
+        int songsFd = ::open(songsTemp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        int heapFd = ::open(heapTemp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = songsFd >= 0 && heapFd >= 0 && writeAt(heapFd, heap.data(), heap.size(), 0) &&
+                  writeAt(songsFd, out.data(), out.size() * sizeof(SongRecord), sizeof(header)) &&
+                  writeAt(songsFd, &header, sizeof(header), 0);
+        if (songsFd >= 0)
+            close(songsFd);
+        if (heapFd >= 0)
+            close(heapFd);
+        ok = ok && rename(heapTemp.c_str(), heapPath.c_str()) == 0 && rename(songsTemp.c_str(), songsPath.c_str()) == 0;
+        if (!ok)
+        {
+            diskLedger.charge(taskPid, fileSize(songsPath) + fileSize(heapPath) - bytes);
+            unlink(songsTemp.c_str());
+            unlink(heapTemp.c_str());
+            return false;
+        }
+
+        bool loaded = load();
+        generation = unchanged;
+        return loaded;
+    }
+
+    void remove()
+    {
+        clear();
+        unlink(songsPath.c_str());
+        unlink(heapPath.c_str());
+        if (inStore())
+        {
+            store->storeRemove(songsName);
+            store->storeRemove(heapName);
+        }
+    }
+};
+
+// Inverted index over the words of each song's title, artist and genre.
+// Terms are kept in text order for prefix lookups: the bulk of them in one
+// sorted array, terms first seen since the last merge in a small sorted side
+// list. A posting is a song id shifted left by 3 with the fields the term
+// appears in below it, and ids only grow, so adding a song only appends.
+// A forward index of each song's terms lets a query check a few candidates
+// against a broad prefix without walking its postings.
+class SongIndex
+{
+public:
+    static constexpr uint8_t TITLE = 1, ARTIST = 2, GENRE = 4, ANY_FIELD = 7;
+
+private:
+    struct Term
+    {
+        string text;
+        vector<uint32_t> postings;
+    };
+
+    // One word of a query, matching any term it is a prefix of
+    struct Clause
+    {
+        string prefix;
+        uint8_t fields;
+        vector<uint32_t> terms;
+        size_t cost; // Postings behind the matching terms
+    };
+
+    static constexpr size_t MERGE_THRESHOLD = 4096; // Side list size that triggers a merge
+    static constexpr size_t MAX_TOKEN = 64;
+
+    deque<Term> terms; // Stable, termIds points into the texts
+    unordered_map<string_view, uint32_t> termIds;
+    vector<uint32_t> sorted;
+    vector<uint32_t> recent;
+    vector<uint32_t> songTerms;  // Term id << 3 | field, song by song
+    vector<uint32_t> songStarts; // Each song's first entry in songTerms, and the end
+    size_t indexed = 0;
+    uint64_t libraryVersion = UINT64_MAX;
+
+    // Lowercase runs of letters and digits, bytes of UTF-8 sequences count as letters
+    template <typename Visit>
+    static void forEachToken(string_view text, Visit visit)
+    {
+        char token[MAX_TOKEN];
+        size_t length = 0;
+        for (size_t i = 0; i <= text.size(); i++)
+        {
+            unsigned char c = i < text.size() ? text[i] : ' ';
+            if (isalnum(c) || c >= 0x80)
+            {
+                if (length < MAX_TOKEN)
+                    token[length++] = static_cast<char>(tolower(c));
+            }
+            else if (length > 0)
+            {
+                visit(string_view(token, length));
+                length = 0;
+            }
+        }
+    }
+
+    bool textLess(uint32_t a, uint32_t b) const { return terms[a].text < terms[b].text; }
+
+    uint32_t termFor(string_view token)
+    {
+        auto found = termIds.find(token);
+        if (found != termIds.end())
+            return found->second;
+        uint32_t id = static_cast<uint32_t>(terms.size());
+        terms.push_back({string(token), {}});
+        termIds.emplace(terms.back().text, id);
+        recent.push_back(id);
+        return id;
+    }
+
+    void addSong(uint32_t id, const SongView &song)
+    {
+        auto addField = [&](string_view text, uint8_t field)
+        {
+            forEachToken(text, [&](string_view token)
+                         {
+                uint32_t term = termFor(token);
+                vector<uint32_t> &postings = terms[term].postings;
+                if (!postings.empty() && (postings.back() >> 3) == id)
+                    postings.back() |= field;
+                else
+                    postings.push_back(id << 3 | field);
+                songTerms.push_back(term << 3 | field); });
+        };
+        addField(song.title, TITLE);
+        addField(song.artist, ARTIST);
+        addField(song.genre, GENRE);
+        songStarts.push_back(static_cast<uint32_t>(songTerms.size()));
+    }
+
+    // Visit the ids of terms starting with prefix, from both lists
+    template <typename Visit>
+    void forEachTermWithPrefix(const string &prefix, Visit visit) const
+    {
+        for (const vector<uint32_t> *list : {&sorted, &recent})
+        {
+            auto it = lower_bound(list->begin(), list->end(), prefix, [this](uint32_t term, const string &key)
+                                  { return terms[term].text < key; });
+            for (; it != list->end() && terms[*it].text.compare(0, prefix.size(), prefix) == 0; ++it)
+            {
+                visit(*it);
+            }
+        }
+    }
+
+    // Set the bit of every song with a posting for the clause
+    void mark(const Clause &clause, vector<uint64_t> &bits) const
+    {
+        for (uint32_t term : clause.terms)
+        {
+            for (uint32_t posting : terms[term].postings)
+            {
+                if (posting & clause.fields)
+                    bits[posting >> 9] |= 1ull << ((posting >> 3) & 63);
+            }
+        }
+    }
+
+    static bool songMatches(const SongView &song, const Clause &clause)
+    {
+        bool found = false;
+        auto check = [&](string_view text, uint8_t field)
+        {
+            if (found || !(clause.fields & field))
+                return;
+            forEachToken(text, [&](string_view token)
+                         { found = found || token.compare(0, clause.prefix.size(), clause.prefix) == 0; });
+        };
+        check(song.title, TITLE);
+        check(song.artist, ARTIST);
+        check(song.genre, GENRE);
+        return found;
+    }
+
+    // Split a query into clauses, a word may be qualified as title:, artist: or genre:
+    static vector<Clause> parse(string_view query)
+    {
+        vector<Clause> clauses;
+        size_t pos = 0;
+        while (pos < query.size())
+        {
+            size_t end = query.find_first_of(" \t", pos);
+            if (end == string_view::npos)
+                end = query.size();
+            string_view word = query.substr(pos, end - pos);
+            pos = end + 1;
+
+            uint8_t fields = ANY_FIELD;
+            const pair<const char *, uint8_t> qualifiers[] = {{"title:", TITLE}, {"artist:", ARTIST}, {"genre:", GENRE}};
+            for (const auto &qualifier : qualifiers)
+            {
+                size_t length = strlen(qualifier.first);
+                if (word.size() >= length && strncasecmp(word.data(), qualifier.first, length) == 0)
+                {
+                    fields = qualifier.second;
+                    word.remove_prefix(length);
+                    break;
+                }
+            }
+            forEachToken(word, [&](string_view token)
+                         { clauses.push_back({string(token), fields, {}, 0}); });
+        }
+        return clauses;
+    }
+
+public:
+    // Index the songs added to the library since the last call. A reloaded
+    // library is indexed again from scratch.
+    void update(const SongLibrary &library)
+    {
+        if (library.version() != libraryVersion || library.size() < indexed)
+        {
+            terms.clear();
+            termIds.clear();
+            sorted.clear();
+            recent.clear();
+            songTerms.clear();
+            songStarts.assign(1, 0);
+            indexed = 0;
+            libraryVersion = library.version();
+        }
+        if (indexed == library.size())
+            return;
+
+        for (; indexed < library.size(); indexed++)
+        {
+            addSong(static_cast<uint32_t>(indexed), library.song(indexed));
+        }
+        auto less = [this](uint32_t a, uint32_t b)
+        { return textLess(a, b); };
+        sort(recent.begin(), recent.end(), less);
+        if (recent.size() > MERGE_THRESHOLD)
+        {
+            vector<uint32_t> merged(sorted.size() + recent.size());
+            merge(sorted.begin(), sorted.end(), recent.begin(), recent.end(), merged.begin(), less);
+            sorted.swap(merged);
+            recent.clear();
+        }
+    }
+
+    size_t termCount() const { return terms.size(); }
+    bool built(const SongLibrary &library) const { return library.version() == libraryVersion; }
+
+    // Ids of the songs matching every word of the query, in library order.
+    // Each word matches as a prefix.
+    vector<uint32_t> search(string_view query) const
+    {
+        vector<Clause> clauses = parse(query);
+        vector<uint32_t> result;
+        if (clauses.empty())
+            return result;
+
+        // Start from the clause with the fewest postings, the rest only filter
+        for (Clause &clause : clauses)
+        {
+            forEachTermWithPrefix(clause.prefix, [&](uint32_t term)
+                                  {
+                clause.terms.push_back(term);
+                clause.cost += terms[term].postings.size(); });
+        }
+        sort(clauses.begin(), clauses.end(), [](const Clause &a, const Clause &b)
+             { return a.cost < b.cost; });
+
+        // A prefix matching several terms is merged through a bitmap over song ids
+        const Clause &first = clauses.front();
+        vector<uint64_t> bits;
+        if (first.terms.size() == 1)
+        {
+            for (uint32_t posting : terms[first.terms[0]].postings)
+            {
+                if (posting & first.fields)
+                    result.push_back(posting >> 3);
+            }
+        }
+        else
+        {
+            bits.assign((indexed + 63) / 64, 0);
+            mark(first, bits);
+            for (size_t word = 0; word < bits.size(); word++)
+            {
+                for (uint64_t set = bits[word]; set != 0; set &= set - 1)
+                {
+                    result.push_back(static_cast<uint32_t>(word * 64 + __builtin_ctzll(set)));
+                }
+            }
+        }
+
+        for (size_t c = 1; c < clauses.size() && !result.empty(); c++)
+        {
+            const Clause &clause = clauses[c];
+            size_t kept = 0;
+
+            // Pick the cheapest way to filter: search the clause's lists for
+            // each candidate, check each candidate's own terms, or mark
+            // everything in the lists in one pass
+            size_t gallopCost = result.size() * clause.terms.size() * 8;
+            size_t forwardCost = result.size() * (songTerms.size() / max<size_t>(indexed, 1) + 1);
+            size_t bitmapCost = clause.cost + indexed / 64;
+            if (forwardCost < gallopCost && forwardCost < bitmapCost)
+            {
+                vector<uint64_t> wanted((terms.size() + 63) / 64, 0);
+                for (uint32_t term : clause.terms)
+                {
+                    wanted[term >> 6] |= 1ull << (term & 63);
+                }
+                for (uint32_t id : result)
+                {
+                    for (uint32_t k = songStarts[id]; k < songStarts[id + 1]; k++)
+                    {
+                        uint32_t term = songTerms[k] >> 3;
+                        if ((songTerms[k] & clause.fields) && (wanted[term >> 6] & (1ull << (term & 63))))
+                        {
+                            result[kept++] = id;
+                            break;
+                        }
+                    }
+                }
+                result.resize(kept);
+                continue;
+            }
+            if (bitmapCost < gallopCost)
+            {
+                bits.assign((indexed + 63) / 64, 0);
+                mark(clause, bits);
+                for (uint32_t id : result)
+                {
+                    if (bits[id >> 6] & (1ull << (id & 63)))
+                        result[kept++] = id;
+                }
+                result.resize(kept);
+                continue;
+            }
+
+            // Both sides are in id order, so each list is searched forward from
+            // where the previous candidate was found, with galloping steps
+            vector<size_t> cursors(clause.terms.size(), 0);
+            for (uint32_t id : result)
+            {
+                bool found = false;
+                uint32_t key = id << 3;
+                for (size_t t = 0; t < clause.terms.size(); t++)
+                {
+                    const vector<uint32_t> &postings = terms[clause.terms[t]].postings;
+                    size_t low = cursors[t], step = 1;
+                    while (low + step < postings.size() && postings[low + step] < key)
+                    {
+                        low += step;
+                        step <<= 1;
+                    }
+                    size_t high = min(postings.size(), low + step + 1);
+                    low = lower_bound(postings.begin() + low, postings.begin() + high, key) - postings.begin();
+                    cursors[t] = low;
+                    if (low < postings.size() && (postings[low] >> 3) == id && (postings[low] & clause.fields))
+                    {
+                        found = true;
+                        break;
+                    }
+                }
+                if (found)
+                    result[kept++] = id;
+            }
+            result.resize(kept);
+        }
+        return result;
+    }
+
+    // Same answer as search(), by checking every song
+    static vector<uint32_t> scan(string_view query, const SongLibrary &library)
+    {
+        vector<Clause> clauses = parse(query);
+        vector<uint32_t> result;
+        for (size_t id = 0; id < library.size() && !clauses.empty(); id++)
+        {
+            SongView song = library.song(id);
+            if (all_of(clauses.begin(), clauses.end(), [&](const Clause &clause)
+                       { return songMatches(song, clause); }))
+                result.push_back(static_cast<uint32_t>(id));
+        }
+        return result;
+    }
+};
+
+// ===== Audio =====
+// Playback runs as two threads joined by a lock-free ring: a producer
+// synthesizes each track into fixed-size blocks of 16-bit stereo PCM, and a
+// "device" thread takes one block per period and writes it to /dev/null or a
+// WAV file on the simulated disk. Neither thread takes a lock per block.
+
+const uint32_t SAMPLE_RATE = 44100;
+const uint32_t CHANNELS = 2;
+const uint32_t PERIOD_FRAMES = 512; // 11.6 ms per block
+const size_t RING_BLOCKS = 16;      // 186 ms of audio between the threads
+
+// Single-producer single-consumer ring. Each side keeps its own index and a
+// cached copy of the other's on its own cache line, so the shared indices
+// are read only when the ring looks full or empty. Slots are filled and read
+// in place.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert((N & (N - 1)) == 0, "Ring capacity must be a power of two");
+
+    alignas(64) atomic<size_t> head{0}; // Next slot the producer fills
+    size_t cachedTail = 0;
+    alignas(64) atomic<size_t> tail{0}; // Next slot the consumer reads
+    size_t cachedHead = 0;
+    alignas(64) T slots[N];
+
+public:
+    // Producer side: a free slot, or nullptr when full
+    T *reserve()
+    {
+        size_t position = head.load(memory_order_relaxed);
+        if (position - cachedTail == N)
+        {
+            cachedTail = tail.load(memory_order_acquire);
+            if (position - cachedTail == N)
+                return nullptr;
+        }
+        return &slots[position & (N - 1)];
+    }
+
+    void publish() { head.store(head.load(memory_order_relaxed) + 1, memory_order_release); }
+
+    // Consumer side: the oldest filled slot, or nullptr when empty
+    T *front()
+    {
+        size_t position = tail.load(memory_order_relaxed);
+        if (position == cachedHead)
+        {
+            cachedHead = head.load(memory_order_acquire);
+            if (position == cachedHead)
+                return nullptr;
+        }
+        return &slots[position & (N - 1)];
+    }
+
+    void pop() { tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release); }
+};
+
+// Procedural tones for one track, seeded from the song's metadata so a song
+// always sounds the same: a bass line, a two-voice pad following a four-bar
+// chord progression and a lead picking notes from the scale. Voices are sine
+// oscillators with an exponential decay, rendered four samples at a time
+// and mixed into planar float buffers.
+class ToneSynth
+{
+    static const int VOICES = 4;
+
+    struct Voice
+    {
+        float phase = 0.0f;     // Cycles, in [0, 1)
+        float increment = 0.0f; // Cycles per sample
+        float gain = 0.0f;
+        float decay = 1.0f;     // Gain multiplier per sample
+        float left = 0.5f, right = 0.5f;
+    };
+
+    Voice voices[VOICES];
+    uint64_t seed = 0;
+    uint64_t beat = 0;
+    uint32_t framesPerBeat = 1;
+    uint32_t framesToBeat = 0;
+    int root = 48;
+    const int *scale = nullptr;
+    int progression[4] = {0, 0, 0, 0};
+
+    static uint64_t mix64(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    static float frequency(int note) { return 440.0f * powf(2.0f, (note - 69) / 12.0f); }
+
+    // Degree of the scale, continuing into higher octaves
+    int note(int degree) const { return root + 12 * (degree / 7) + scale[degree % 7]; }
+
+    // Notes start at phase 0 where the sine is 0, so a new note doesn't click
+    void trigger(Voice &voice, int midi, float gain, float halfLife)
+    {
+        voice.phase = 0.0f;
+        voice.increment = frequency(midi) / SAMPLE_RATE;
+        voice.gain = gain;
+        voice.decay = expf(-0.693147f / (halfLife * SAMPLE_RATE));
+    }
+
+    void onBeat()
+    {
+        int chord = progression[(beat / 4) % 4];
+        uint64_t roll = mix64(seed ^ beat);
+        if (beat % 2 == 0)
+            trigger(voices[0], note(chord) - 12, 0.30f, 0.35f);
+        if (beat % 4 == 0)
+        {
+            trigger(voices[1], note(chord + 2) + 12, 0.12f, 1.5f);
+            trigger(voices[2], note(chord + 4) + 12, 0.12f, 1.5f);
+        }
+        if (roll % 4 != 0)
+            trigger(voices[3], note(static_cast<int>(roll >> 8) % 7 + chord % 2) + 24, 0.18f, 0.2f);
+        beat++;
+    }
+
+    // sin(pi u) for u in [-1, 1): a parabola with one correction step
+    static float sine(float u)
+    {
+        float y = 4.0f * u * (1.0f - fabsf(u));
+        return 0.225f * (y * fabsf(y) - y) + y;
+    }
+
+    static void renderVoice(Voice &voice, float *left, float *right, size_t frames)
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), four = _mm_set1_ps(4.0f);
+        const __m128 correction = _mm_set1_ps(0.225f);
+        const __m128 step = _mm_set1_ps(4.0f * voice.increment);
+        const __m128 panLeft = _mm_set1_ps(voice.left), panRight = _mm_set1_ps(voice.right);
+        float d = voice.decay, d2 = d * d;
+        const __m128 decay4 = _mm_set1_ps(d2 * d2);
+        __m128 phase = _mm_add_ps(_mm_set1_ps(voice.phase),
+                                  _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(voice.increment)));
+        __m128 gain = _mm_mul_ps(_mm_set1_ps(voice.gain), _mm_set_ps(d2 * d, d2, d, 1.0f));
+        for (; i + 4 <= frames; i += 4)
+        {
+            // Phases stay non-negative, so truncating takes the fraction
+            phase = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+            __m128 u = _mm_sub_ps(_mm_mul_ps(phase, two), one);
+            __m128 y = _mm_mul_ps(_mm_mul_ps(four, u), _mm_sub_ps(one, _mm_andnot_ps(sign, u)));
+            y = _mm_add_ps(_mm_mul_ps(correction, _mm_sub_ps(_mm_mul_ps(y, _mm_andnot_ps(sign, y)), y)), y);
+            __m128 sample = _mm_mul_ps(y, gain);
+            _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(sample, panLeft)));
+            _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(sample, panRight)));
+            phase = _mm_add_ps(phase, step);
+            gain = _mm_mul_ps(gain, decay4);
+        }
+        voice.phase = _mm_cvtss_f32(phase);
+        voice.gain = _mm_cvtss_f32(gain);
+#endif
+        for (; i < frames; i++)
+        {
+            voice.phase -= static_cast<int>(voice.phase);
+            float sample = sine(2.0f * voice.phase - 1.0f) * voice.gain;
+            left[i] += sample * voice.left;
+            right[i] += sample * voice.right;
+            voice.phase += voice.increment;
+            voice.gain *= voice.decay;
+        }
+        voice.phase -= static_cast<int>(voice.phase);
+    }
+
+public:
+    void start(uint64_t trackSeed)
+    {
+        static const int MAJOR[7] = {0, 2, 4, 5, 7, 9, 11};
+        static const int MINOR[7] = {0, 2, 3, 5, 7, 8, 10};
+        static const int PROGRESSIONS[4][4] = {{0, 4, 5, 3}, {0, 5, 3, 4}, {5, 3, 0, 4}, {0, 3, 4, 3}};
+
+        seed = mix64(trackSeed);
+        uint64_t roll = seed;
+        int bpm = 70 + roll % 90;
+        framesPerBeat = SAMPLE_RATE * 60 / bpm;
+        framesToBeat = 0;
+        beat = 0;
+        root = 45 + (roll >> 8) % 12;
+        scale = (roll >> 16) % 2 ? MAJOR : MINOR;
+        memcpy(progression, PROGRESSIONS[(roll >> 24) % 4], sizeof(progression));
+
+        for (Voice &voice : voices)
+            voice = Voice();
+        voices[1].left = 0.7f, voices[1].right = 0.3f;
+        voices[2].left = 0.3f, voices[2].right = 0.7f;
+        voices[3].left = 0.4f, voices[3].right = 0.6f;
+    }
+
+    // Add the next frames of the track to left and right
+    void render(float *left, float *right, size_t frames)
+    {
+        while (frames > 0)
+        {
+            if (framesToBeat == 0)
+            {
+                onBeat();
+                framesToBeat = framesPerBeat;
+            }
+            size_t run = min<size_t>(frames, framesToBeat);
+            for (Voice &voice : voices)
+            {
+                if (voice.gain > 1e-4f)
+                    renderVoice(voice, left, right, run);
+            }
+            left += run;
+            right += run;
+            frames -= run;
+            framesToBeat -= run;
+        }
+    }
+};
+
+// Apply the volume and convert planar float to interleaved 16-bit, saturating
+void mixToPcm(const float *left, const float *right, int16_t *out, size_t frames, float volume)
+{
+    float scale = volume * 32767.0f;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128 gain = _mm_set1_ps(scale);
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128i l = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(left + i), gain));
+        __m128i r = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(right + i), gain));
+        __m128i pcm = _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), pcm);
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        out[2 * i] = static_cast<int16_t>(max(-32768.0f, min(32767.0f, nearbyintf(left[i] * scale))));
+        out[2 * i + 1] = static_cast<int16_t>(max(-32768.0f, min(32767.0f, nearbyintf(right[i] * scale))));
+    }
+}
+
+// Where the device writes: /dev/null, or a WAV file in the simulated disk
+// whose header gets the final sizes when it's closed. WAV data is charged
+// to the disk quota.
+class AudioSink
+{
+    struct WavHeader
+    {
+        char riff[4];
+        uint32_t riffSize;
+        char wave[4];
+        char fmt[4];
+        uint32_t fmtSize;
+        uint16_t format;
+        uint16_t channels;
+        uint32_t sampleRate;
+        uint32_t byteRate;
+        uint16_t blockAlign;
+        uint16_t bitsPerSample;
+        char data[4];
+        uint32_t dataSize;
+    };
+    static_assert(sizeof(WavHeader) == 44, "WAV header layout is fixed");
+
+    int fd = -1; // /dev/null
+    DiskFile wav;
+    uint64_t dataBytes = 0;
+    string path = "/dev/null";
+
+    void writeHeader()
+    {
+        uint32_t size = static_cast<uint32_t>(min<uint64_t>(dataBytes, UINT32_MAX - sizeof(WavHeader)));
+        WavHeader header = {{'R', 'I', 'F', 'F'}, size + 36, {'W', 'A', 'V', 'E'}, {'f', 'm', 't', ' '}, 16, 1,
+                            CHANNELS, SAMPLE_RATE, SAMPLE_RATE * CHANNELS * 2, CHANNELS * 2, 16,
+                            {'d', 'a', 't', 'a'}, size};
+        if (!wav.write(0, reinterpret_cast<const char *>(&header), sizeof(header)))
+            cerr << "Warning: could not write the WAV header of " << path << endl;
+    }
+
+public:
+    ~AudioSink() { close(); }
+
+    bool openNull()
+    {
+        close();
+        fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+        path = "/dev/null";
+        dataBytes = 0;
+        return fd >= 0;
+    }
+
+    // Replaces any earlier recording, whose space is given back first. The
+    // name is relative to the simulated disk.
+    bool openWav(const string &name)
+    {
+        close();
+        string file = "simulated_disk/" + name;
+        struct stat info;
+        if (stat(file.c_str(), &info) == 0)
+            diskLedger.charge(taskPid, -static_cast<int64_t>(info.st_size));
+        if (!diskLedger.charge(taskPid, sizeof(WavHeader)))
+            return false;
+        if (!wav.open(diskClient, name, O_CREAT | O_TRUNC))
+        {
+            diskLedger.charge(taskPid, -static_cast<int64_t>(sizeof(WavHeader)));
+            return false;
+        }
+        path = file;
+        dataBytes = 0;
+        writeHeader();
+        return true;
+    }
+
+    // False when the write failed or the quota refused it
+    bool write(const int16_t *samples, size_t frames)
+    {
+        size_t bytes = frames * CHANNELS * sizeof(int16_t);
+        if (!wav.isOpen())
+            return fd >= 0 && ::write(fd, samples, bytes) == static_cast<ssize_t>(bytes);
+        if (!diskLedger.charge(taskPid, bytes))
+            return false;
+        if (!wav.write(sizeof(WavHeader) + dataBytes, reinterpret_cast<const char *>(samples), bytes))
+        {
+            diskLedger.charge(taskPid, -static_cast<int64_t>(bytes));
+            return false;
+        }
+        dataBytes += bytes;
+        return true;
+    }
+
+    void close()
+    {
+        if (wav.isOpen())
+        {
+            writeHeader();
+            wav.close();
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool recording() const { return wav.isOpen(); }
+    const string &target() const { return path; }
+    uint64_t bytesWritten() const { return dataBytes; }
+};
+
+// The track the producer synthesizes, chosen by the pipeline's picker
+struct AudioTrack
+{
+    int song = 0;
+    uint64_t seed = 0;
+    uint64_t frames = SAMPLE_RATE;
+};
+
+// Seed a song's tones from everything that describes it
+uint64_t trackSeed(const SongView &song)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (string_view text : {song.title, song.artist, song.genre})
+    {
+        for (char c : text)
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        hash = (hash ^ 0xFF) * 1099511628211ull;
+    }
+    return hash ^ static_cast<uint64_t>(song.duration);
+}
+
+struct AudioStats
+{
+    uint64_t framesSynthesized = 0;
+    uint64_t framesPlayed = 0;  // Track audio that reached the sink
+    uint64_t underruns = 0;     // Periods the device had no block for and played silence
+    uint64_t dropped = 0;       // Blocks thrown away after a skip
+    uint64_t transitions = 0;   // Tracks that followed another inside one block
+    double synthCpu = 0.0;      // Thread CPU seconds
+    double deviceCpu = 0.0;
+};
+
+class AudioPipeline
+{
+public:
+    // Picks the song the producer synthesizes next. restart is true to
+    // (re)start at the player's current song, false when the previous track
+    // ended; generation is that of the blocks the track will fill.
+    using TrackPicker = function<bool(uint32_t generation, bool restart, AudioTrack &track)>;
+
+private:
+    struct AudioBlock
+    {
+        uint32_t generation; // Bumped by every skip, older blocks are dropped
+        int32_t song;        // Song at the first frame
+        uint64_t songFrame;  // Its position at the first frame
+        uint32_t boundary;   // Frame the next song starts at, PERIOD_FRAMES if none
+        int32_t nextSong;
+        int16_t samples[PERIOD_FRAMES * CHANNELS];
+    };
+
+    SpscRing<AudioBlock, RING_BLOCKS> ring;
+    TrackPicker picker;
+    bool realtime = true; // Paced by the clock, or as fast as the producer goes
+    thread producer, device;
+    atomic<bool> stopping{false};
+    atomic<bool> playing{false};
+    atomic<uint32_t> currentGeneration{0};
+    atomic<float> volume{0.8f};
+
+    atomic<int32_t> playingSong{0};
+    atomic<uint64_t> playingFrame{0};
+
+    atomic<uint64_t> framesSynthesized{0}, framesPlayed{0}, underruns{0}, dropped{0}, transitions{0};
+    atomic<uint64_t> synthNanos{0}, deviceNanos{0};
+
+    // Sink changes are applied by the device thread between blocks
+    mutex sinkMutex;
+    AudioSink sink;
+    atomic<bool> sinkRequested{false};
+    string requestedWav; // Empty for /dev/null
+    atomic<bool> quotaStopped{false};
+
+    static uint64_t threadNanos()
+    {
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return now.tv_sec * 1000000000ull + now.tv_nsec;
+    }
+
+    void produce()
+    {
+        ToneSynth synth;
+        AudioTrack track;
+        bool haveTrack = false;
+        uint32_t generation = 0;
+        uint64_t frame = 0;
+        alignas(16) float left[PERIOD_FRAMES], right[PERIOD_FRAMES];
+        auto wait = realtime ? chrono::microseconds(1000000 * PERIOD_FRAMES / SAMPLE_RATE / 2) : chrono::microseconds(50);
+
+        while (!stopping.load(memory_order_relaxed))
+        {
+            AudioBlock *block = ring.reserve();
+            if (block == nullptr)
+            {
+                this_thread::sleep_for(wait);
+                continue;
+            }
+
+            uint32_t current = currentGeneration.load(memory_order_acquire);
+            if (!haveTrack || current != generation)
+            {
+                generation = current;
+                haveTrack = picker(generation, true, track);
+                if (!haveTrack)
+                {
+                    this_thread::sleep_for(chrono::milliseconds(100));
+                    continue;
+                }
+                synth.start(track.seed);
+                frame = 0;
+            }
+
+            block->generation = generation;
+            block->song = track.song;
+            block->songFrame = frame;
+            block->boundary = PERIOD_FRAMES;
+            block->nextSong = track.song;
+            memset(left, 0, sizeof(left));
+            memset(right, 0, sizeof(right));
+
+            size_t done = 0;
+            while (done < PERIOD_FRAMES && haveTrack)
+            {
+                size_t run = min<uint64_t>(PERIOD_FRAMES - done, track.frames - frame);
+                synth.render(left + done, right + done, run);
+                done += run;
+                frame += run;
+                if (frame < track.frames)
+                    continue;
+
+                // Gapless: the next track starts in the same block
+                haveTrack = picker(generation, false, track);
+                if (haveTrack && block->boundary == PERIOD_FRAMES)
+                {
+                    block->boundary = done;
+                    block->nextSong = track.song;
+                }
+                synth.start(track.seed);
+                frame = 0;
+            }
+
+            mixToPcm(left, right, block->samples, PERIOD_FRAMES, volume.load(memory_order_relaxed));
+            ring.publish();
+            framesSynthesized.fetch_add(PERIOD_FRAMES, memory_order_relaxed);
+            synthNanos.store(threadNanos(), memory_order_relaxed);
+        }
+        synthNanos.store(threadNanos(), memory_order_relaxed);
+    }
+
+    void applySinkRequest()
+    {
+        lock_guard<mutex> lock(sinkMutex);
+        sinkRequested.store(false, memory_order_relaxed);
+        if (requestedWav.empty() || !sink.openWav(requestedWav))
+            sink.openNull();
+    }
+
+    // Throw away blocks made before the last skip, true if there were any
+    bool dropStale()
+    {
+        bool any = false;
+        uint32_t generation = currentGeneration.load(memory_order_acquire);
+        for (AudioBlock *block = ring.front(); block != nullptr && block->generation != generation; block = ring.front())
+        {
+            ring.pop();
+            dropped.fetch_add(1, memory_order_relaxed);
+            any = true;
+        }
+        return any;
+    }
+
+    void consume()
+    {
+        using Clock = chrono::steady_clock;
+        const auto period = chrono::nanoseconds(1000000000ull * PERIOD_FRAMES / SAMPLE_RATE);
+        int16_t silence[PERIOD_FRAMES * CHANNELS] = {};
+        Clock::time_point deadline = Clock::now();
+        bool wasPlaying = false;
+
+        while (!stopping.load(memory_order_relaxed))
+        {
+            if (sinkRequested.load(memory_order_acquire))
+                applySinkRequest();
+            bool skipped = dropStale();
+
+            if (!playing.load(memory_order_relaxed))
+            {
+                wasPlaying = false;
+                this_thread::sleep_for(chrono::milliseconds(10));
+                continue;
+            }
+            if (realtime)
+            {
+                // Give the producer a period to fill in after a pause or skip
+                Clock::time_point now = Clock::now();
+                if (!wasPlaying || skipped)
+                    deadline = now + period;
+                else if (now - deadline > period * static_cast<int>(RING_BLOCKS))
+                {
+                    // Stopped for longer than the ring covers, catch up instead of rushing
+                    underruns.fetch_add(1, memory_order_relaxed);
+                    deadline = now;
+                }
+                this_thread::sleep_until(deadline);
+                deadline += period;
+            }
+            wasPlaying = true;
+
+            AudioBlock *block = ring.front();
+            if (block != nullptr && block->generation != currentGeneration.load(memory_order_acquire))
+                continue; // A skip came in while sleeping
+            const int16_t *samples = silence;
+            if (block != nullptr)
+            {
+                samples = block->samples;
+            }
+            else if (realtime)
+            {
+                underruns.fetch_add(1, memory_order_relaxed);
+            }
+            else
+            {
+                this_thread::sleep_for(chrono::microseconds(50));
+                continue;
+            }
+
+            {
+                // Sink swaps happen on this thread, the lock covers the UI's getters
+                lock_guard<mutex> lock(sinkMutex);
+                if (!sink.write(samples, PERIOD_FRAMES) && sink.recording())
+                {
+                    // Out of quota: stop recording but keep playing
+                    quotaStopped.store(true, memory_order_relaxed);
+                    sink.openNull();
+                }
+            }
+
+            if (block != nullptr)
+            {
+                if (block->boundary < PERIOD_FRAMES)
+                {
+                    transitions.fetch_add(1, memory_order_relaxed);
+                    playingSong.store(block->nextSong, memory_order_relaxed);
+                    playingFrame.store(PERIOD_FRAMES - block->boundary, memory_order_relaxed);
+                }
+                else
+                {
+                    playingSong.store(block->song, memory_order_relaxed);
+                    playingFrame.store(block->songFrame + PERIOD_FRAMES, memory_order_relaxed);
+                }
+                ring.pop();
+                framesPlayed.fetch_add(PERIOD_FRAMES, memory_order_relaxed);
+            }
+            deviceNanos.store(threadNanos(), memory_order_relaxed);
+        }
+        deviceNanos.store(threadNanos(), memory_order_relaxed);
+        lock_guard<mutex> lock(sinkMutex);
+        sink.close();
+    }
+
+public:
+    AudioPipeline() = default;
+    AudioPipeline(const AudioPipeline &) = delete;
+    AudioPipeline &operator=(const AudioPipeline &) = delete;
+    ~AudioPipeline() { stop(); }
+
+    void start(TrackPicker trackPicker, bool paced = true)
+    {
+        stop();
+        picker = move(trackPicker);
+        realtime = paced;
+        stopping = false;
+        {
+            lock_guard<mutex> lock(sinkMutex);
+            sink.openNull();
+        }
+        producer = thread(&AudioPipeline::produce, this);
+        device = thread(&AudioPipeline::consume, this);
+    }
+
+    void stop()
+    {
+        stopping = true;
+        if (producer.joinable())
+            producer.join();
+        if (device.joinable())
+            device.join();
+    }
+
+    void setPlaying(bool on) { playing = on; }
+
+    // Start over from the player's current song, dropping what was buffered
+    void skip() { currentGeneration.fetch_add(1, memory_order_release); }
+    uint32_t generation() const { return currentGeneration.load(memory_order_acquire); }
+
+    void setVolume(float level) { volume = max(0.0f, min(1.0f, level)); }
+    float getVolume() const { return volume; }
+
+    // Record to a WAV file in the simulated disk, or go back to /dev/null with an empty name
+    void setSink(const string &wavName)
+    {
+        lock_guard<mutex> lock(sinkMutex);
+        requestedWav = wavName;
+        quotaStopped = false;
+        sinkRequested.store(true, memory_order_release);
+    }
+
+    bool recording()
+    {
+        lock_guard<mutex> lock(sinkMutex);
+        return sink.recording();
+    }
+
+    string sinkTarget()
+    {
+        lock_guard<mutex> lock(sinkMutex);
+        return sink.target();
+    }
+
+    uint64_t sinkBytes()
+    {
+        lock_guard<mutex> lock(sinkMutex);
+        return sink.bytesWritten();
+    }
+
+    bool stoppedByQuota() const { return quotaStopped; }
+
+    // Song the device is playing and the frame it has reached
+    int nowPlaying(uint64_t &frame) const
+    {
+        frame = playingFrame.load(memory_order_relaxed);
+        return playingSong.load(memory_order_relaxed);
+    }
+
+    AudioStats stats() const
+    {
+        AudioStats result;
+        result.framesSynthesized = framesSynthesized;
+        result.framesPlayed = framesPlayed;
+        result.underruns = underruns;
+        result.dropped = dropped;
+        result.transitions = transitions;
+        result.synthCpu = synthNanos / 1e9;
+        result.deviceCpu = deviceNanos / 1e9;
+        return result;
+    }
+};
+
+SongLibrary playlist("simulated_disk/music_library");
+SongIndex songIndex;       // Brought up to date before each search
+deque<uint32_t> playQueue; // Songs queued by query, played before the rest
+int currentSongIndex = 0;  // Song the audio producer is synthesizing
+AudioPipeline audio;
 
 // Signal handler for graceful shutdown
 void signalHandler(int signal)
@@ -41,25 +1594,84 @@ void signalHandler(int signal)
     }
 }
 
-// Function to simulate playing a song
-void playSong()
+// Move to the next song: queued songs first, then random or sequential.
+// Caller holds playlistMutex.
+void advanceSong()
+{
+    if (!playQueue.empty())
+    {
+        currentSongIndex = playQueue.front();
+        playQueue.pop_front();
+    }
+    else if (shuffleMode)
+    {
+        currentSongIndex = rand() % playlist.size();
+    }
+    else
+    {
+        currentSongIndex = (currentSongIndex + 1) % playlist.size();
+    }
+}
+
+// Track picker for the player: the current song on start and after a skip,
+// the next one when a track ends. A track that ends while a skip is pending
+// doesn't advance, the skip has already chosen the song.
+bool pickPlayerTrack(uint32_t generation, bool restart, AudioTrack &track)
+{
+    lock_guard<mutex> lock(playlistMutex);
+    if (playlist.empty())
+    {
+        return false;
+    }
+    if (!restart && generation == audio.generation())
+    {
+        advanceSong();
+    }
+    if (currentSongIndex < 0 || static_cast<size_t>(currentSongIndex) >= playlist.size())
+    {
+        currentSongIndex = 0;
+    }
+
+    SongView song = playlist.song(currentSongIndex);
+    track.song = currentSongIndex;
+    track.seed = trackSeed(song);
+    track.frames = static_cast<uint64_t>(max(song.duration, 1)) * SAMPLE_RATE;
+    return true;
+}
+
+// Show what the audio device is playing once a second. The song is copied
+// under the lock and printed after it's released.
+void showPlayback()
 {
     while (running)
     {
-        if (playing && !playlist.empty())
+        if (playing)
         {
-            lock_guard<mutex> lock(playlistMutex);
-            if (currentSongIndex >= 0 && currentSongIndex < playlist.size())
+            uint64_t frame;
+            int index = audio.nowPlaying(frame);
+            string title, artist;
+            int duration = 0;
+            bool known;
             {
-                Song currentSong = playlist[currentSongIndex];
+                lock_guard<mutex> lock(playlistMutex);
+                known = index >= 0 && static_cast<size_t>(index) < playlist.size();
+                if (known)
+                {
+                    SongView song = playlist.song(index);
+                    title = string(song.title);
+                    artist = string(song.artist);
+                    duration = max(song.duration, 1);
+                }
+            }
 
-                // Print playback progress
-                cout << "\rNow playing: " << currentSong.title << " - " << currentSong.artist
-                     << " [";
+            if (known)
+            {
+                int playbackPosition = static_cast<int>(frame / SAMPLE_RATE);
+                cout << "\rNow playing: " << title << " - " << artist << " [";
 
                 // Progress bar
                 int barLength = 20;
-                int position = (playbackPosition * barLength) / currentSong.duration;
+                int position = (playbackPosition * barLength) / duration;
                 for (int i = 0; i < barLength; i++)
                 {
                     if (i < position)
@@ -70,26 +1682,7 @@ void playSong()
                         cout << " ";
                 }
 
-                cout << "] " << playbackPosition << "/" << currentSong.duration << "s" << flush;
-
-                // Increment playback position
-                playbackPosition++;
-
-                // If song is finished, move to next
-                if (playbackPosition >= currentSong.duration)
-                {
-                    playbackPosition = 0;
-                    if (shuffleMode)
-                    {
-                        // Random next song
-                        currentSongIndex = rand() % playlist.size();
-                    }
-                    else
-                    {
-                        // Sequential next song
-                        currentSongIndex = (currentSongIndex + 1) % playlist.size();
-                    }
-                }
+                cout << "] " << playbackPosition << "/" << duration << "s" << flush;
             }
         }
 
@@ -98,11 +1691,16 @@ void playSong()
     }
 }
 
-// Initialize playlist with some sample songs
+// Open the saved library, or start from some sample songs
 void initializePlaylist()
 {
     lock_guard<mutex> lock(playlistMutex);
-    playlist = {
+    if (playlist.load())
+    {
+        return;
+    }
+
+    const Song samples[] = {
         {"Bohemian Rhapsody", "Queen", 355, "Rock"},
         {"Imagine", "John Lennon", 183, "Pop"},
         {"Billie Jean", "Michael Jackson", 292, "Pop"},
@@ -114,6 +1712,10 @@ void initializePlaylist()
         {"Hotel California", "Eagles", 391, "Rock"},
         {"Sweet Child O' Mine", "Guns N' Roses", 355, "Rock"}
     };
+    for (const auto& song : samples)
+    {
+        playlist.add(song.title, song.artist, song.duration, song.genre);
+    }
 }
 
 // Add a song to the playlist
@@ -136,8 +1738,131 @@ void addSong()
     cin.ignore();
     getline(cin, newSong.genre);
 
-    playlist.push_back(newSong);
-    cout << "Song added to playlist!" << endl;
+    // A saved library gets just the new record appended
+    if (!playlist.append(newSong.title, newSong.artist, newSong.duration, newSong.genre))
+    {
+        cerr << "Error: Disk quota exceeded, song added but not saved." << endl;
+    }
+    else
+    {
+        cout << "Song added to playlist!" << endl;
+    }
+
+    // Keep an index that is in use current, an unused one is built on the first search
+    if (songIndex.built(playlist))
+    {
+        songIndex.update(playlist);
+    }
+}
+
+// Run a query against the index, bringing it up to date first. Caller
+// holds playlistMutex.
+vector<uint32_t> runQuery(const string &query, double &micros)
+{
+    auto start = chrono::steady_clock::now();
+    songIndex.update(playlist);
+    vector<uint32_t> matches = songIndex.search(query);
+    micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    return matches;
+}
+
+string readQuery()
+{
+    string query;
+    cout << "Search (words match by prefix, title:/artist:/genre: limit a word to a field): ";
+    cin.ignore();
+    getline(cin, query);
+    return query;
+}
+
+// Search the library by title, artist and genre
+void searchLibrary()
+{
+    string query = readQuery();
+    lock_guard<mutex> lock(playlistMutex);
+    double micros;
+    vector<uint32_t> matches = runQuery(query, micros);
+
+    const size_t SHOWN = 20;
+    cout << "\n===== Search Results =====\n" << endl;
+    for (size_t i = 0; i < matches.size() && i < SHOWN; i++)
+    {
+        SongView song = playlist.song(matches[i]);
+        cout << "  " << (matches[i] + 1) << ". " << song.title << " - " << song.artist << " [" << song.genre << "]" << endl;
+    }
+    if (matches.size() > SHOWN)
+    {
+        cout << "  ... and " << matches.size() - SHOWN << " more" << endl;
+    }
+    cout << matches.size() << " songs found in " << fixed << setprecision(1) << micros << " us" << defaultfloat << endl;
+}
+
+// Queue every song matching a query to play next, in library order
+void queueByQuery()
+{
+    string query = readQuery();
+    lock_guard<mutex> lock(playlistMutex);
+    double micros;
+    vector<uint32_t> matches = runQuery(query, micros);
+    playQueue.insert(playQueue.end(), matches.begin(), matches.end());
+    cout << matches.size() << " songs queued, " << playQueue.size() << " in the queue" << endl;
+}
+
+// Print a stream's cost: CPU seconds per second of audio as a share of a core
+void printAudioCost(const AudioStats &stats)
+{
+    double synthSeconds = max(stats.framesSynthesized / double(SAMPLE_RATE), 1e-9);
+    double playedSeconds = max(stats.framesPlayed / double(SAMPLE_RATE), 1e-9);
+    double synthLoad = stats.synthCpu / synthSeconds;
+    double deviceLoad = stats.deviceCpu / playedSeconds;
+    cout << "CPU per stream: " << 100.0 * synthLoad << "% synthesis + " << 100.0 * deviceLoad
+         << "% device of one core, about " << static_cast<long>(1.0 / max(synthLoad + deviceLoad, 1e-9))
+         << " streams per core" << endl;
+}
+
+// What the audio pipeline has played and what it costs
+void showAudioStatus()
+{
+    AudioStats stats = audio.stats();
+    cout << "\n===== Audio =====\n" << endl;
+    cout << fixed << setprecision(2);
+    cout << "Output: " << audio.sinkTarget() << ", " << audio.sinkBytes() / 1048576.0 << " MB written" << endl;
+    cout << "Format: " << SAMPLE_RATE << " Hz 16-bit stereo, " << PERIOD_FRAMES << "-frame periods, "
+         << RING_BLOCKS << " blocks buffered, volume " << static_cast<int>(audio.getVolume() * 100 + 0.5f) << "%" << endl;
+    cout << "Played " << stats.framesPlayed / double(SAMPLE_RATE) << " s, " << stats.transitions
+         << " gapless transitions, " << stats.underruns << " underruns, " << stats.dropped
+         << " blocks dropped by skips" << endl;
+    printAudioCost(stats);
+    cout << defaultfloat;
+    if (audio.stoppedByQuota())
+    {
+        cout << "Recording stopped: disk quota exceeded" << endl;
+    }
+}
+
+void setVolume()
+{
+    int percent;
+    cout << "Volume (0-100): ";
+    cin >> percent;
+    audio.setVolume(percent / 100.0f);
+    cout << "Volume set to " << static_cast<int>(audio.getVolume() * 100 + 0.5f) << "%" << endl;
+}
+
+// Send the device's output to a WAV file on the simulated disk, or back to /dev/null
+void toggleRecording()
+{
+    if (audio.recording())
+    {
+        string file = audio.sinkTarget();
+        audio.setSink("");
+        cout << "Recording stopped, saved to " << file << endl;
+        return;
+    }
+    system("mkdir -p simulated_disk");
+    string name = "music_player_" + to_string(taskPid) + ".wav";
+    audio.setSink(name);
+    cout << "Recording to simulated_disk/" << name << " while playing" << endl;
 }
 
 // Display playlist
@@ -154,75 +1879,369 @@ void displayPlaylist()
 
     for (size_t i = 0; i < playlist.size(); i++)
     {
-        cout << (i == currentSongIndex ? "▶ " : "  ")
-             << (i + 1) << ". " << playlist[i].title << " - " << playlist[i].artist
-             << " (" << playlist[i].duration / 60 << ":" << setw(2) << setfill('0') << playlist[i].duration % 60
-             << ") [" << playlist[i].genre << "]" << endl;
+        SongView song = playlist.song(i);
+        cout << (i == static_cast<size_t>(currentSongIndex) ? "▶ " : "  ")
+             << (i + 1) << ". " << song.title << " - " << song.artist
+             << " (" << song.duration / 60 << ":" << setw(2) << setfill('0') << song.duration % 60
+             << setfill(' ') << ") [" << song.genre << "]" << endl;
     }
 }
 
-// Save playlist to file
+// Save playlist to the binary library
 void savePlaylist()
 {
     lock_guard<mutex> lock(playlistMutex);
-    string filename = "simulated_disk/playlist.txt";
 
     // Create directory if it doesn't exist
     system("mkdir -p simulated_disk");
 
-    ofstream outFile(filename);
-    if (!outFile)
+    if (!playlist.save())
     {
-        cerr << "Error: Could not open file for writing." << endl;
+        cerr << "Error: Disk quota exceeded or write failed, playlist not saved." << endl;
         return;
     }
+    cout << "Playlist saved to " << (playlist.stored() ? "the OS file store" : "simulated_disk/music_library") << " ("
+         << playlist.size() << " songs)" << endl;
+}
 
-    for (const auto& song : playlist)
+// Older versions saved a four-lines-per-song text file, read it once so it
+// can be saved in the new format
+bool importLegacyPlaylist()
+{
+    ifstream inFile("simulated_disk/playlist.txt");
+    if (!inFile)
     {
-        outFile << song.title << "\n"
-                << song.artist << "\n"
-                << song.duration << "\n"
-                << song.genre << "\n";
+        return false;
     }
 
-    outFile.close();
-    cout << "Playlist saved to " << filename << endl;
+    playlist.clear();
+    Song song;
+    while (getline(inFile, song.title))
+    {
+        getline(inFile, song.artist);
+        inFile >> song.duration;
+        inFile.ignore(); // Skip newline
+        getline(inFile, song.genre);
+        playlist.add(song.title, song.artist, song.duration, song.genre);
+    }
+    return true;
 }
 
-// Load playlist from file
+// Load playlist by mapping the library
 void loadPlaylist()
 {
     lock_guard<mutex> lock(playlistMutex);
-    string filename = "simulated_disk/playlist.txt";
+    if (playlist.load())
+    {
+        cout << "Playlist loaded from " << (playlist.stored() ? "the OS file store" : "simulated_disk/music_library")
+             << " (" << playlist.size() << " songs)" << endl;
+    }
+    else if (importLegacyPlaylist())
+    {
+        cout << "Imported simulated_disk/playlist.txt, save to convert it to the library format" << endl;
+    }
+    else
+    {
+        cerr << "Error: Could not open the library for reading." << endl;
+        return;
+    }
 
-    ifstream inFile(filename);
-    if (!inFile)
+    // Song ids refer to the old library
+    playQueue.clear();
+    currentSongIndex = 0;
+    audio.skip();
+}
+
+// Allocation counts only exist in bench builds (make bench)
+string allocationsText(long allocations)
+{
+    return heapAllocationCount() < 0 ? "heap allocations not counted" : to_string(allocations) + " heap allocations";
+}
+
+// Time saving, mapping, scanning and appending to a generated library of
+// the given size, against parsing the same songs from the old text format
+void benchmarkLibrary(long songs)
+{
+    using Clock = chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start)
+    { return chrono::duration<double>(Clock::now() - start).count(); };
+
+    system("mkdir -p simulated_disk");
+    SongLibrary library("simulated_disk/bench_library");
+    library.remove();
+
+    const char *genres[] = {"Rock", "Pop", "Jazz", "Blues", "Classical", "Hip Hop",
+                            "Electronic", "Folk", "Country", "Metal", "Reggae", "Soul"};
+    mt19937 rng(42);
+    for (long i = 0; i < songs; i++)
+    {
+        library.add("Track " + to_string(i) + " of the Simulated Sessions",
+                    "Artist " + to_string(rng() % (songs / 10 + 1)), 120 + rng() % 300, genres[rng() % 12]);
+    }
+
+    auto start = Clock::now();
+    if (!library.save())
     {
-        cerr << "Error: Could not open file for reading." << endl;
+        cerr << "Error: could not write the benchmark library" << endl;
         return;
     }
+    double saveSeconds = elapsed(start);
+    struct stat info;
+    long long fileBytes = 0;
+    if (stat("simulated_disk/bench_library.songs", &info) == 0)
+        fileBytes += info.st_size;
+    if (stat("simulated_disk/bench_library.strings", &info) == 0)
+        fileBytes += info.st_size;
 
-    playlist.clear();
-    Song song;
+    library.clear();
+    long allocationsBefore = heapAllocationCount();
+    start = Clock::now();
+    bool loaded = library.load();
+    double loadSeconds = elapsed(start);
+    long loadAllocations = heapAllocationCount() - allocationsBefore;
 
-    while (getline(inFile, song.title))
+    // Touch every record and string once
+    start = Clock::now();
+    uint64_t totalDuration = 0, textBytes = 0;
+    for (size_t i = 0; i < library.size(); i++)
     {
-        getline(inFile, song.artist);
-        inFile >> song.duration;
-        inFile.ignore(); // Skip newline
-        getline(inFile, song.genre);
+        SongView song = library.song(i);
+        totalDuration += song.duration;
+        textBytes += song.title.size() + song.artist.size() + song.genre.size();
+    }
+    double scanSeconds = elapsed(start);
+
+    const int APPENDS = 1000;
+    start = Clock::now();
+    for (int i = 0; i < APPENDS; i++)
+    {
+        library.append("Appended Track", "Bench Artist", 200, "Rock");
+    }
+    double appendSeconds = elapsed(start);
+
+    // The same songs through the old text format
+    {
+        ofstream text("simulated_disk/bench_playlist.txt");
+        for (long i = 0; i < songs; i++)
+        {
+            SongView song = library.song(i);
+            text << song.title << "\n" << song.artist << "\n" << song.duration << "\n" << song.genre << "\n";
+        }
+    }
+    allocationsBefore = heapAllocationCount();
+    start = Clock::now();
+    vector<Song> legacy;
+    {
+        ifstream inFile("simulated_disk/bench_playlist.txt");
+        Song song;
+        while (getline(inFile, song.title))
+        {
+            getline(inFile, song.artist);
+            inFile >> song.duration;
+            inFile.ignore();
+            getline(inFile, song.genre);
+            legacy.push_back(song);
+        }
+    }
+    double legacySeconds = elapsed(start);
+    long legacyAllocations = heapAllocationCount() - allocationsBefore;
 
-        playlist.push_back(song);
+    unlink("simulated_disk/bench_playlist.txt");
+    library.remove();
+
+    cout << fixed << setprecision(3);
+    cout << "\n===== Music Library Benchmark =====\n"
+         << "Songs: " << songs << " (" << fileBytes / 1024 << " KB on disk, " << sizeof(SongRecord) << "-byte records)\n"
+         << "Save: " << saveSeconds * 1000 << " ms\n"
+         << "Load (mmap): " << loadSeconds * 1000 << " ms, " << allocationsText(loadAllocations)
+         << (loaded ? "" : " (FAILED)") << "\n"
+         << "Scan all songs: " << scanSeconds * 1000 << " ms (" << textBytes / 1024 << " KB of strings, "
+         << totalDuration / 3600 << " h of music)\n"
+         << "Append: " << appendSeconds * 1e6 / APPENDS << " us per song\n"
+         << "Legacy text load: " << legacySeconds * 1000 << " ms, " << allocationsText(legacyAllocations) << " ("
+         << legacy.size() << " songs)" << endl;
+}
+
+// Build the index over a generated library and time a mix of queries
+// against it, checking each answer against a full scan
+void benchmarkSearch(long songs)
+{
+    using Clock = chrono::steady_clock;
+    auto micros = [](Clock::time_point start)
+    { return chrono::duration<double, micro>(Clock::now() - start).count(); };
+
+    // Made-up words from syllables, so there are thousands of distinct terms
+    const char *syllables[] = {"la", "mo", "ri", "ven", "sha", "dor", "ka", "tel",
+                               "nu", "bri", "zan", "qui", "fro", "gle", "pa", "sto"};
+    const char *genres[] = {"Rock", "Pop", "Jazz", "Blues", "Classical", "Hip Hop",
+                            "Electronic", "Folk", "Country", "Metal", "Reggae", "Soul"};
+    mt19937 rng(7);
+    auto word = [&](int parts)
+    {
+        string text;
+        for (int i = 0; i < parts; i++)
+            text += syllables[rng() % 16];
+        text[0] = static_cast<char>(toupper(text[0]));
+        return text;
+    };
+
+    SongLibrary library("simulated_disk/bench_search");
+    vector<string> artists;
+    for (int i = 0; i < 5000; i++)
+    {
+        artists.push_back(word(2) + " " + word(3));
+    }
+    for (long i = 0; i < songs; i++)
+    {
+        string title = word(2 + rng() % 2);
+        for (int w = 1 + rng() % 3; w > 0; w--)
+            title += " " + word(2 + rng() % 2);
+        library.add(title, artists[rng() % artists.size()], 120 + rng() % 300, genres[rng() % 12]);
     }
 
-    inFile.close();
-    cout << "Playlist loaded from " << filename << endl;
+    SongIndex index;
+    auto start = Clock::now();
+    index.update(library);
+    double buildMs = micros(start) / 1000;
+
+    // Queries built from a song in the middle of the library
+    SongView sample = library.song(songs / 2);
+    string titleWord(sample.title.substr(0, sample.title.find(' ')));
+    string artistName(sample.artist);
+    string lastName = artistName.substr(artistName.find(' ') + 1);
+    const string queries[] = {
+        titleWord,
+        titleWord.substr(0, 3),
+        "genre:jazz",
+        artistName,
+        "artist:" + lastName + " genre:" + string(sample.genre),
+        titleWord + " " + lastName.substr(0, 4),
+        "rock " + titleWord.substr(0, 2),
+    };
 
-    if (!playlist.empty())
+    cout << "\n===== Music Search Benchmark =====\n"
+         << "Songs: " << songs << ", terms: " << index.termCount() << ", index build: " << fixed << setprecision(1)
+         << buildMs << " ms\n";
+    cout << left << setw(36) << "Query" << right << setw(10) << "Matches" << setw(12) << "Index us" << setw(12)
+         << "Scan us" << setw(8) << "Check" << endl;
+    for (const string &query : queries)
     {
-        currentSongIndex = 0;
-        playbackPosition = 0;
+        const int REPEATS = 20;
+        vector<uint32_t> matches;
+        start = Clock::now();
+        for (int r = 0; r < REPEATS; r++)
+        {
+            matches = index.search(query);
+        }
+        double indexMicros = micros(start) / REPEATS;
+
+        start = Clock::now();
+        vector<uint32_t> expected = SongIndex::scan(query, library);
+        double scanMicros = micros(start);
+        cout << left << setw(36) << query << right << setw(10) << matches.size() << setw(12) << indexMicros
+             << setw(12) << scanMicros << setw(8) << (matches == expected ? "ok" : "WRONG") << endl;
+    }
+
+    // Incremental updates, one song at a time
+    const int ADDS = 1000;
+    start = Clock::now();
+    for (int i = 0; i < ADDS; i++)
+    {
+        library.add("Freshly Added " + word(3), artists[i % artists.size()], 200, "Jazz");
+        index.update(library);
+    }
+    double addMicros = micros(start) / ADDS;
+    vector<uint32_t> fresh = index.search("freshly");
+    cout << "Incremental add: " << addMicros << " us per song, " << fresh.size() << " found after adding" << endl;
+    cout << defaultfloat;
+}
+
+// Measure what a stream costs: render ten minutes of audio with the device
+// unpaced for CPU per second of audio, then run real-time pipelines side by
+// side for the given seconds and count their underruns
+void benchmarkAudio(int streams, double seconds, bool wav)
+{
+    using Clock = chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start)
+    { return chrono::duration<double>(Clock::now() - start).count(); };
+
+    // Short songs so the run crosses plenty of track boundaries
+    const char *genres[] = {"Rock", "Pop", "Jazz", "Blues", "Classical", "Hip Hop",
+                            "Electronic", "Folk", "Country", "Metal", "Reggae", "Soul"};
+    mt19937 rng(7);
+    for (int i = 0; i < 64; i++)
+    {
+        playlist.add("Bench Track " + to_string(i), "Artist " + to_string(i % 9), 2 + rng() % 10, genres[rng() % 12]);
+    }
+    auto sequential = [](size_t first)
+    {
+        return [next = first](uint32_t, bool restart, AudioTrack &track) mutable
+        {
+            if (!restart)
+                next = (next + 1) % playlist.size();
+            SongView song = playlist.song(next);
+            track.song = static_cast<int>(next);
+            track.seed = trackSeed(song);
+            track.frames = static_cast<uint64_t>(max(song.duration, 1)) * SAMPLE_RATE;
+            return true;
+        };
+    };
+
+    const double FREE_RUN_SECONDS = 600.0;
+    cout << fixed << setprecision(2);
+    {
+        AudioPipeline pipeline;
+        if (wav)
+        {
+            system("mkdir -p simulated_disk");
+            pipeline.setSink("music_player_bench.wav");
+        }
+        pipeline.setPlaying(true);
+        auto start = Clock::now();
+        pipeline.start(sequential(0), false);
+        while (pipeline.stats().framesPlayed < FREE_RUN_SECONDS * SAMPLE_RATE)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        pipeline.stop();
+        double wall = elapsed(start);
+        AudioStats stats = pipeline.stats();
+        double audioSeconds = stats.framesPlayed / double(SAMPLE_RATE);
+        cout << "Free run: " << audioSeconds << " s of audio in " << wall << " s (" << audioSeconds / wall
+             << "x real time) to " << pipeline.sinkTarget() << ", " << pipeline.sinkBytes() / 1048576.0 << " MB" << endl;
+        cout << "Synthesis: " << 1e6 * stats.synthCpu / (stats.framesSynthesized / PERIOD_FRAMES) << " us per "
+             << PERIOD_FRAMES << "-frame block, " << stats.transitions << " gapless transitions, "
+             << stats.underruns << " underruns" << endl;
+        printAudioCost(stats);
+    }
+
+    vector<unique_ptr<AudioPipeline>> pipelines;
+    for (int i = 0; i < streams; i++)
+    {
+        pipelines.push_back(make_unique<AudioPipeline>());
+        pipelines.back()->setPlaying(true);
+        pipelines.back()->start(sequential(i * 7 % playlist.size()));
+    }
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    AudioStats total;
+    uint64_t worst = 0;
+    for (auto &pipeline : pipelines)
+    {
+        pipeline->stop();
+        AudioStats stats = pipeline->stats();
+        total.framesSynthesized += stats.framesSynthesized;
+        total.framesPlayed += stats.framesPlayed;
+        total.underruns += stats.underruns;
+        total.transitions += stats.transitions;
+        total.synthCpu += stats.synthCpu;
+        total.deviceCpu += stats.deviceCpu;
+        worst = max(worst, stats.underruns);
     }
+    cout << "Real time: " << streams << " streams for " << seconds << " s on " << thread::hardware_concurrency()
+         << " hardware threads, " << total.underruns << " underruns (at most " << worst << " in one stream), "
+         << total.transitions << " gapless transitions" << endl;
+    printAudioCost(total);
+    cout << defaultfloat;
 }
 
 void displayMenu()
@@ -237,15 +2256,45 @@ void displayMenu()
     cout << "7. Save Playlist\n";
     cout << "8. Load Playlist\n";
     cout << "9. Exit\n";
+    cout << "10. Search Library\n";
+    cout << "11. Queue Songs Matching a Query\n";
+    cout << "12. Audio Status\n";
+    cout << "13. Set Volume\n";
+    cout << "14. Start/Stop Recording to WAV\n";
     cout << "Enter choice: ";
 }
 
 int main(int argc, char* argv[])
 {
+    // Benchmark mode: music_player --bench-library [songs]
+    if (argc >= 2 && string(argv[1]) == "--bench-library")
+    {
+        benchmarkLibrary(argc >= 3 ? atol(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // Benchmark mode: music_player --bench-search [songs]
+    if (argc >= 2 && string(argv[1]) == "--bench-search")
+    {
+        benchmarkSearch(argc >= 3 ? atol(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // Benchmark mode: music_player --bench-audio [streams] [seconds] [null|wav]
+    if (argc >= 2 && string(argv[1]) == "--bench-audio")
+    {
+        benchmarkAudio(argc >= 3 ? atoi(argv[2]) : 16, argc >= 4 ? atof(argv[3]) : 5.0,
+                       argc >= 5 && string(argv[4]) == "wav");
+        return 0;
+    }
+
     // Check command line arguments (pid, memory, disk)
     if (argc < 4)
     {
         cerr << "Usage: " << argv[0] << " <pid> <memory_required> <disk_required>" << endl;
+        cerr << "       " << argv[0] << " --bench-library [songs]" << endl;
+        cerr << "       " << argv[0] << " --bench-search [songs]" << endl;
+        cerr << "       " << argv[0] << " --bench-audio [streams] [seconds] [null|wav]" << endl;
         return 1;
     }
 
@@ -261,14 +2310,22 @@ int main(int argc, char* argv[])
     // Register signal handler
     signal(SIGINT, signalHandler);
 
+    // Writes are charged to this task's quota, unmetered when run standalone,
+    // and recordings are cached by the OS when it is there to connect to
+    taskPid = pid;
+    diskLedger.open(false);
+    diskClient.connect();
+    playlist.useStore(diskClient);
+
     // Seed random for shuffle
     srand(time(nullptr));
 
     // Initialize the playlist
     initializePlaylist();
 
-    // Start the playback thread
-    thread playbackThread(playSong);
+    // Start synthesizing, and the thread that shows playback progress
+    audio.start(pickPlayerTrack);
+    thread playbackThread(showPlayback);
     playbackThread.detach();
 
     int choice;
@@ -281,32 +2338,30 @@ int main(int argc, char* argv[])
         {
             case 1: // Play/Pause
                 playing = !playing;
+                audio.setPlaying(playing);
                 cout << (playing ? "Playing" : "Paused") << endl;
                 break;
 
             case 2: // Next Song
             {
                 lock_guard<mutex> lock(playlistMutex);
-                playbackPosition = 0;
-                if (shuffleMode)
-                    currentSongIndex = rand() % playlist.size();
-                else
-                    currentSongIndex = (currentSongIndex + 1) % playlist.size();
-                cout << "Now playing: " << playlist[currentSongIndex].title
-                     << " by " << playlist[currentSongIndex].artist << endl;
+                advanceSong();
+                audio.skip();
+                cout << "Now playing: " << playlist.song(currentSongIndex).title
+                     << " by " << playlist.song(currentSongIndex).artist << endl;
             }
                 break;
 
             case 3: // Previous Song
             {
                 lock_guard<mutex> lock(playlistMutex);
-                playbackPosition = 0;
                 if (shuffleMode)
                     currentSongIndex = rand() % playlist.size();
                 else
                     currentSongIndex = (currentSongIndex - 1 + playlist.size()) % playlist.size();
-                cout << "Now playing: " << playlist[currentSongIndex].title
-                     << " by " << playlist[currentSongIndex].artist << endl;
+                audio.skip();
+                cout << "Now playing: " << playlist.song(currentSongIndex).title
+                     << " by " << playlist.song(currentSongIndex).artist << endl;
             }
                 break;
 
@@ -336,12 +2391,33 @@ int main(int argc, char* argv[])
                 playing = false;
                 break;
 
+            case 10: // Search Library
+                searchLibrary();
+                break;
+
+            case 11: // Queue by query
+                queueByQuery();
+                break;
+
+            case 12: // Audio status
+                showAudioStatus();
+                break;
+
+            case 13: // Volume
+                setVolume();
+                break;
+
+            case 14: // Record to WAV
+                toggleRecording();
+                break;
+
             default:
                 cout << "Invalid choice" << endl;
                 break;
         }
     }
 
+    audio.stop();
     cout << "Music Player exiting..." << endl;
     return 0;
 }
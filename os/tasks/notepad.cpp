@@ -1,17 +1,417 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <thread>
 #include <chrono>
-//#include <vector>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <signal.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/DiskLedger.h"
+#include "../include/DiskClient.h"
 
-bool running = true;
-std::string content;
+// Piece table text buffer. The document is a sequence of pieces, each
+// pointing either into what it was loaded from (a read-only mmap of the
+// file, or the text read from the OS file store) or into an append-only
+// buffer holding everything typed since. Pieces are
+// kept in a treap ordered by position, with subtree byte and newline
+// counts, so inserts, deletes and line lookups are O(log n). Both backing
+// buffers are immutable once written, so a list of spans is a consistent
+// snapshot that can be saved without holding any lock.
+class PieceTable
+{
+private:
+    static constexpr uint32_t MAX_PIECE = 64 * 1024; // Bounds the scan inside a piece
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;  // Append buffer block size
+
+    struct Node
+    {
+        const char *text;
+        uint32_t length;
+        uint32_t newlines;
+        uint32_t priority;
+        int32_t left;
+        int32_t right;
+        uint64_t subtreeLength;
+        uint64_t subtreeNewlines;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> freeNodes;
+    int32_t root;
+
+    // Append buffer, blocks never move once allocated
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockUsed;
+
+    const char *mapped;
+    size_t mappedSize;
+    std::string loaded; // Owns the initial text when it wasn't mapped
+    uint32_t seed;
+
+    static uint32_t countNewlines(const char *text, size_t length)
+    {
+        uint32_t count = 0;
+        const char *end = text + length;
+        while ((text = static_cast<const char *>(memchr(text, '\n', end - text))) != nullptr)
+        {
+            count++;
+            text++;
+        }
+        return count;
+    }
+
+    uint64_t lengthOf(int32_t t) const { return t == -1 ? 0 : nodes[t].subtreeLength; }
+    uint64_t newlinesOf(int32_t t) const { return t == -1 ? 0 : nodes[t].subtreeNewlines; }
+
+    void update(int32_t t)
+    {
+        Node &node = nodes[t];
+        node.subtreeLength = node.length + lengthOf(node.left) + lengthOf(node.right);
+        node.subtreeNewlines = node.newlines + newlinesOf(node.left) + newlinesOf(node.right);
+    }
+
+    int32_t newNode(const char *text, uint32_t length, uint32_t newlines)
+    {
+        // xorshift32 priorities keep the treap balanced in expectation
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        Node node = {text, length, newlines, seed, -1, -1, length, newlines};
+        if (!freeNodes.empty())
+        {
+            int32_t t = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[t] = node;
+            return t;
+        }
+        nodes.push_back(node);
+        return static_cast<int32_t>(nodes.size() - 1);
+    }
+
+    void freeTree(int32_t t)
+    {
+        if (t == -1)
+            return;
+        freeTree(nodes[t].left);
+        freeTree(nodes[t].right);
+        freeNodes.push_back(t);
+    }
+
+    int32_t merge(int32_t a, int32_t b)
+    {
+        if (a == -1)
+            return b;
+        if (b == -1)
+            return a;
+
+        if (nodes[a].priority > nodes[b].priority)
+        {
+            int32_t right = merge(nodes[a].right, b);
+            nodes[a].right = right;
+            update(a);
+            return a;
+        }
+        int32_t left = merge(a, nodes[b].left);
+        nodes[b].left = left;
+        update(b);
+        return b;
+    }
+
+    // Split t into the first pos bytes (left) and the rest (right),
+    // cutting a piece in two when pos falls inside it
+    void split(int32_t t, uint64_t pos, int32_t &left, int32_t &right)
+    {
+        if (t == -1)
+        {
+            left = right = -1;
+            return;
+        }
+
+        uint64_t leftLength = lengthOf(nodes[t].left);
+        if (pos <= leftLength)
+        {
+            int32_t l, r;
+            split(nodes[t].left, pos, l, r);
+            nodes[t].left = r;
+            update(t);
+            left = l;
+            right = t;
+        }
+        else if (pos >= leftLength + nodes[t].length)
+        {
+            int32_t l, r;
+            split(nodes[t].right, pos - leftLength - nodes[t].length, l, r);
+            nodes[t].right = l;
+            update(t);
+            left = t;
+            right = r;
+        }
+        else
+        {
+            uint32_t keep = static_cast<uint32_t>(pos - leftLength);
+            uint32_t keepNewlines = countNewlines(nodes[t].text, keep);
+            int32_t tail = newNode(nodes[t].text + keep, nodes[t].length - keep, nodes[t].newlines - keepNewlines);
+
+            nodes[t].length = keep;
+            nodes[t].newlines = keepNewlines;
+            right = merge(tail, nodes[t].right);
+            nodes[t].right = -1;
+            update(t);
+            left = t;
+        }
+    }
+
+    // Copy text into the append buffer, calling emit for each contiguous run
+    template <typename Emit>
+    void appendToBuffer(const char *data, uint64_t length, Emit emit)
+    {
+        while (length > 0)
+        {
+            if (blockUsed == BLOCK_SIZE)
+            {
+                blocks.emplace_back(new char[BLOCK_SIZE]);
+                blockUsed = 0;
+            }
+            size_t chunk = std::min<uint64_t>(length, BLOCK_SIZE - blockUsed);
+            char *target = blocks.back().get() + blockUsed;
+            memcpy(target, data, chunk);
+            blockUsed += chunk;
+            emit(target, chunk);
+            data += chunk;
+            length -= chunk;
+        }
+    }
+
+    // Cut the initial text into bounded pieces; this pass is the line index build
+    void cut(const char *text, size_t size)
+    {
+        for (size_t offset = 0; offset < size; offset += MAX_PIECE)
+        {
+            uint32_t length = static_cast<uint32_t>(std::min<size_t>(MAX_PIECE, size - offset));
+            root = merge(root, newNode(text + offset, length, countNewlines(text + offset, length)));
+        }
+    }
+
+    template <typename Visit>
+    void visitRange(int32_t t, uint64_t base, uint64_t from, uint64_t to, Visit &visit) const
+    {
+        if (t == -1 || base >= to || base + nodes[t].subtreeLength <= from)
+            return;
+
+        const Node &node = nodes[t];
+        uint64_t start = base + lengthOf(node.left);
+        visitRange(node.left, base, from, to, visit);
+
+        uint64_t lo = std::max(start, from);
+        uint64_t hi = std::min(start + node.length, to);
+        if (lo < hi)
+        {
+            visit(node.text + (lo - start), static_cast<size_t>(hi - lo));
+        }
+
+        visitRange(node.right, start + node.length, from, to, visit);
+    }
+
+public:
+    PieceTable() : root(-1), blockUsed(BLOCK_SIZE), mapped(nullptr), mappedSize(0), seed(2463534242u) {}
+
+    ~PieceTable()
+    {
+        if (mapped != nullptr)
+        {
+            munmap(const_cast<char *>(mapped), mappedSize);
+        }
+    }
+
+    PieceTable(const PieceTable &) = delete;
+    PieceTable &operator=(const PieceTable &) = delete;
+
+    // Map a file as the initial document. The file must only ever be
+    // replaced by rename, never rewritten in place, while it is mapped.
+    bool load(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            close(fd);
+            return false;
+        }
+        if (info.st_size == 0)
+        {
+            close(fd);
+            return true;
+        }
+
+        void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED)
+            return false;
+
+        mapped = static_cast<const char *>(address);
+        mappedSize = info.st_size;
+        madvise(address, mappedSize, MADV_SEQUENTIAL);
+        cut(mapped, mappedSize);
+        return true;
+    }
+
+    // Take over text as the initial document
+    void adopt(std::string &&text)
+    {
+        loaded = std::move(text);
+        cut(loaded.data(), loaded.size());
+    }
+
+    uint64_t size() const { return lengthOf(root); }
+    bool empty() const { return root == -1 || size() == 0; }
+
+    uint64_t lineCount() const
+    {
+        uint64_t total = size();
+        if (total == 0)
+            return 0;
+
+        // A trailing partial line counts as a line
+        char last = '\n';
+        forEachSpan(total - 1, total, [&last](const char *text, size_t)
+                    { last = *text; });
+        return newlinesOf(root) + (last == '\n' ? 0 : 1);
+    }
+
+    void insert(uint64_t offset, const char *data, uint64_t length)
+    {
+        if (length == 0)
+            return;
+
+        int32_t left, right;
+        split(root, offset, left, right);
+        appendToBuffer(data, length, [&](const char *text, size_t chunk)
+                       { left = merge(left, newNode(text, static_cast<uint32_t>(chunk), countNewlines(text, chunk))); });
+        root = merge(left, right);
+    }
+
+    void erase(uint64_t offset, uint64_t length)
+    {
+        int32_t left, middle, right;
+        split(root, offset, left, right);
+        split(right, length, middle, right);
+        freeTree(middle);
+        root = merge(left, right);
+    }
+
+    // Offset where the given 0-based line starts, or size() past the last line
+    uint64_t lineStart(uint64_t line) const
+    {
+        if (line == 0)
+            return 0;
+        if (line > newlinesOf(root))
+            return size();
+
+        // Find the line-th newline and return the offset just after it
+        uint64_t offset = 0;
+        int32_t t = root;
+        while (t != -1)
+        {
+            const Node &node = nodes[t];
+            uint64_t leftNewlines = newlinesOf(node.left);
+            if (line <= leftNewlines)
+            {
+                t = node.left;
+                continue;
+            }
+
+            offset += lengthOf(node.left);
+            line -= leftNewlines;
+            if (line <= node.newlines)
+            {
+                const char *p = node.text;
+                while (true)
+                {
+                    p = static_cast<const char *>(memchr(p, '\n', node.text + node.length - p)) + 1;
+                    if (--line == 0)
+                        return offset + (p - node.text);
+                }
+            }
+
+            offset += node.length;
+            line -= node.newlines;
+            t = node.right;
+        }
+        return size();
+    }
+
+    // Call visit(text, length) for every span of bytes in [from, to), in order
+    template <typename Visit>
+    void forEachSpan(uint64_t from, uint64_t to, Visit visit) const
+    {
+        visitRange(root, 0, from, to, visit);
+    }
+
+    // Collect spans covering the whole document, cheap enough to take under a lock
+    void snapshot(std::vector<std::pair<const char *, size_t>> &spans) const
+    {
+        spans.clear();
+        forEachSpan(0, size(), [&spans](const char *text, size_t length)
+                    { spans.emplace_back(text, length); });
+    }
+};
+
+std::atomic<bool> running{true};
+PieceTable document;
 int pid = 0;
 std::string filename;
+std::string journalFilename;
+
+// The editor and the autosave thread share the document and the pending
+// journal. Edits only append their own record under the lock, and the
+// autosave thread swaps the pending records out, so neither side holds it
+// for long.
+std::mutex contentMutex;
+std::condition_variable autosaveCV;
+std::vector<char> pendingJournal; // Encoded edits not yet written to the journal
+
+// Journal state, only touched by the autosave thread (and main after it exits).
+// The journal goes through the OS buffer cache when the OS is running.
+DiskClient diskClient;
+DiskFile journal;
+uint64_t journalBytes = 0;
+
+// While the OS runs, the base goes to its file store, where an edit only
+// adds the chunks it changed and the space is charged to the OS disk
+// rather than to this task
+bool baseInStore = false;
+
+// Base plus journal bytes charged to this task's disk quota. Once a charge
+// is refused, edits stay in memory and the size trigger is ignored until a
+// save gets through again.
+DiskLedger diskLedger;
+uint64_t chargedBytes = 0;
+bool quotaExceeded = false;
+
+// Edit journal: an append-only log of the edits made since the base file was
+// last written. It starts with a header naming the base it applies to, then
+// one record per edit: op ('I' or 'D'), offset and length as 8-byte values,
+// and for inserts the inserted bytes.
+const char JOURNAL_MAGIC[4] = {'N', 'J', '1', '\0'};
+const size_t JOURNAL_HEADER_SIZE = 4 + 8 + 8;
+const size_t SYNC_BATCH_BYTES = 4096;         // Flush before the timer once this much is pending
+const uint64_t COMPACT_MIN_BYTES = 64 * 1024; // Journal size before compaction is considered
+const uint64_t PAGE_LINES = 40;               // Lines shown per page when viewing
 
 // Signal handler for graceful shutdown
 void signalHandler(int signal)
@@ -20,35 +420,446 @@ void signalHandler(int signal)
     {
         std::cout << "Notepad shutting down..." << std::endl;
         running = false;
+        autosaveCV.notify_all();
     }
 }
 
-// Function to autosave content to file
-void autoSave()
+// Streaming 64-bit hash, only used to match a journal with its base file.
+// Works a word at a time so hashing a large base stays cheap.
+struct ContentHash
 {
-    while (running)
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    uint64_t pending = 0;
+    unsigned pendingBytes = 0;
+    uint64_t total = 0;
+
+    void mix(uint64_t word)
+    {
+        state ^= word * 0xBF58476D1CE4E5B9ull;
+        state = ((state << 31) | (state >> 33)) * 0x94D049BB133111EBull;
+    }
+
+    void update(const char *data, size_t length)
     {
-        if (!content.empty())
+        total += length;
+        while (length > 0 && pendingBytes != 0)
         {
-            std::ofstream outFile("simulated_disk/" + filename);
-            if (outFile.is_open())
+            pending |= static_cast<uint64_t>(static_cast<uint8_t>(*data++)) << (8 * pendingBytes);
+            length--;
+            if (++pendingBytes == 8)
             {
-                outFile << content;
-                outFile.close();
-                std::cout << "Auto-saved content to " << filename << std::endl;
+                mix(pending);
+                pending = 0;
+                pendingBytes = 0;
             }
-            else
+        }
+        for (; length >= 8; data += 8, length -= 8)
+        {
+            uint64_t word;
+            memcpy(&word, data, sizeof(word));
+            mix(word);
+        }
+        while (length-- > 0)
+        {
+            pending |= static_cast<uint64_t>(static_cast<uint8_t>(*data++)) << (8 * pendingBytes++);
+        }
+    }
+
+    uint64_t finish()
+    {
+        mix(pending ^ total);
+        return state ^ (state >> 29);
+    }
+};
+
+void appendU64(std::vector<char> &buffer, uint64_t value)
+{
+    char bytes[8];
+    std::memcpy(bytes, &value, sizeof(value));
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+}
+
+uint64_t readU64(const char *data)
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
+        {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Move this task's quota charge to the given on-disk footprint
+bool chargeTo(uint64_t bytes)
+{
+    if (!diskLedger.charge(pid, static_cast<int64_t>(bytes) - static_cast<int64_t>(chargedBytes)))
+    {
+        return false;
+    }
+    chargedBytes = bytes;
+    return true;
+}
+
+// Apply an edit to the document and queue its journal record. Caller holds contentMutex.
+void applyEdit(char op, uint64_t offset, uint64_t length, const char *text)
+{
+    if (op == 'I')
+    {
+        document.insert(offset, text, length);
+    }
+    else
+    {
+        document.erase(offset, length);
+    }
+
+    pendingJournal.push_back(op);
+    appendU64(pendingJournal, offset);
+    appendU64(pendingJournal, length);
+    if (op == 'I')
+    {
+        pendingJournal.insert(pendingJournal.end(), text, text + length);
+    }
+}
+
+void insertText(uint64_t offset, const std::string &text)
+{
+    bool flushNow;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        applyEdit('I', offset, text.size(), text.data());
+        flushNow = pendingJournal.size() >= SYNC_BATCH_BYTES;
+    }
+    if (flushNow)
+    {
+        autosaveCV.notify_one();
+    }
+}
+
+void eraseText(uint64_t offset, uint64_t length)
+{
+    std::lock_guard<std::mutex> lock(contentMutex);
+    applyEdit('D', offset, length, nullptr);
+}
+
+// Start a fresh journal for a base file with the given contents
+bool resetJournal(uint64_t baseSize, uint64_t baseHash)
+{
+    if (!journal.open(diskClient, journalFilename, O_CREAT | O_TRUNC))
+    {
+        return false;
+    }
+
+    std::vector<char> header(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+    appendU64(header, baseSize);
+    appendU64(header, baseHash);
+    journalBytes = header.size();
+    return journal.write(0, header.data(), header.size()) && journal.sync();
+}
+
+// Append pending edits to the journal and make them durable
+bool flushJournal()
+{
+    std::vector<char> batch;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        batch.swap(pendingJournal);
+    }
+    if (batch.empty())
+    {
+        return true;
+    }
+
+    if (!chargeTo(chargedBytes + batch.size()))
+    {
+        // Put the edits back ahead of anything typed meanwhile
+        std::lock_guard<std::mutex> lock(contentMutex);
+        batch.insert(batch.end(), pendingJournal.begin(), pendingJournal.end());
+        pendingJournal.swap(batch);
+        if (!quotaExceeded)
+        {
+            std::cerr << "Disk quota exceeded, unsaved edits are kept in memory" << std::endl;
+        }
+        quotaExceeded = true;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        quotaExceeded = false;
+    }
+
+    if (!journal.isOpen() || !journal.write(journalBytes, batch.data(), batch.size()) || !journal.sync())
+    {
+        std::cerr << "Failed to write autosave journal" << std::endl;
+        return false;
+    }
+    journalBytes += batch.size();
+    return true;
+}
+
+// Fold the journal into the base file and start an empty journal
+bool compact()
+{
+    std::vector<std::pair<const char *, size_t>> spans;
+    uint64_t previousCharge = chargedBytes;
+    size_t foldedBytes;
+    bool toStore = diskClient.connected();
+    {
+        // The new base replaces the old base and journal, charge the difference first
+        std::lock_guard<std::mutex> lock(contentMutex);
+        if (!chargeTo((toStore ? 0 : document.size()) + JOURNAL_HEADER_SIZE))
+        {
+            return false;
+        }
+
+        // The snapshot already contains every pending edit. They are dropped
+        // once the new base is in place, so a failed write loses nothing.
+        document.snapshot(spans);
+        foldedBytes = pendingJournal.size();
+    }
+
+    ContentHash hash;
+    uint64_t size = 0;
+    std::string path = "simulated_disk/" + filename;
+    if (toStore)
+    {
+        // The store replaces whole files, and is made durable before the
+        // journal it replaces is dropped
+        std::string text;
+        for (const auto &span : spans)
+        {
+            hash.update(span.first, span.second);
+            text.append(span.first, span.second);
+        }
+        size = text.size();
+        if (!diskClient.storeWrite(filename, text, true))
+        {
+            std::cerr << "Failed to store " << filename << std::endl;
+            chargeTo(previousCharge);
+            return false;
+        }
+        unlink(path.c_str()); // Written by a run without the OS, the stored copy is newer now
+    }
+    else
+    {
+        // Stream the spans into a new base next to the old one and swap it in atomically
+        std::string tempPath = path + ".tmp";
+        int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open file for autosave" << std::endl;
+            chargeTo(previousCharge);
+            return false;
+        }
+
+        bool ok = true;
+        for (const auto &span : spans)
+        {
+            hash.update(span.first, span.second);
+            size += span.second;
+            ok = ok && writeAll(fd, span.first, span.second);
+        }
+        ok = ok && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            std::cerr << "Failed to write " << filename << std::endl;
+            chargeTo(previousCharge);
+            return false;
+        }
+    }
+    baseInStore = toStore;
+
+    // Edits typed since the snapshot follow the folded ones and belong to the new journal
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        pendingJournal.erase(pendingJournal.begin(), pendingJournal.begin() + foldedBytes);
+    }
+
+    // A crash before this point replays the old journal against the old base.
+    // Once the new base is in place the old journal no longer matches it and is ignored.
+    return resetJournal(size, hash.finish());
+}
+
+// Load the base and replay any journal left by a previous run, returns
+// the number of edits replayed
+size_t recover(uint64_t &baseSize, uint64_t &baseHash)
+{
+    // A base file is mapped. One only exists when the last save was made
+    // without the OS, so it is newer than anything in the store.
+    std::string stored;
+    if (!document.load("simulated_disk/" + filename) && diskClient.storeRead(filename, stored))
+    {
+        document.adopt(std::move(stored));
+        baseInStore = true;
+    }
+
+    ContentHash hash;
+    document.forEachSpan(0, document.size(), [&hash](const char *text, size_t length)
+                         { hash.update(text, length); });
+    baseSize = document.size();
+    baseHash = hash.finish();
+
+    // Read through the service too, the OS may still hold the tail of the last run's journal
+    uint64_t journalSize;
+    size_t readBytes;
+    if (!journal.open(diskClient, journalFilename, 0) || !journal.size(journalSize))
+    {
+        return 0;
+    }
+    std::string journalText(journalSize, '\0');
+    bool complete = journal.read(0, &journalText[0], journalText.size(), readBytes);
+    journal.close();
+    if (!complete)
+    {
+        return 0;
+    }
+    journalText.resize(readBytes);
+
+    // Only replay a journal written against exactly this base
+    if (journalText.size() < JOURNAL_HEADER_SIZE || std::memcmp(journalText.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+        readU64(journalText.data() + 4) != baseSize || readU64(journalText.data() + 12) != baseHash)
+    {
+        return 0;
+    }
+
+    size_t position = JOURNAL_HEADER_SIZE;
+    size_t replayed = 0;
+    while (position + 17 <= journalText.size())
+    {
+        char op = journalText[position];
+        uint64_t offset = readU64(journalText.data() + position + 1);
+        uint64_t length = readU64(journalText.data() + position + 9);
+
+        // Stop at a torn record from an interrupted write. The payload is
+        // bounded before it is added, so a corrupt length cannot wrap.
+        if ((op != 'I' && op != 'D') || (op == 'I' && length > journalText.size() - position - 17) ||
+            offset > document.size() || (op == 'D' && length > document.size() - offset))
+        {
+            break;
+        }
+        uint64_t recordSize = 17 + (op == 'I' ? length : 0);
+
+        applyEdit(op, offset, length, journalText.data() + position + 17);
+        position += recordSize;
+        replayed++;
+    }
+    pendingJournal.clear();
+
+    if (replayed > 0)
+    {
+        std::cout << "Recovered " << replayed << " unsaved edits from " << journalFilename << std::endl;
+    }
+    return replayed;
+}
+
+// Autosave thread: writes only what changed since the last save
+void autoSave()
+{
+    while (running)
+    {
+        {
+            // Wake every 10 seconds, or early once a batch of edits is waiting
+            std::unique_lock<std::mutex> lock(contentMutex);
+            autosaveCV.wait_for(lock, std::chrono::seconds(10), []()
+                                { return !running || (!quotaExceeded && pendingJournal.size() >= SYNC_BATCH_BYTES); });
+            if (!running)
+                break;
+            if (pendingJournal.empty())
+                continue;
+        }
+
+        if (flushJournal())
+        {
+            std::cout << "Auto-saved changes to " << journalFilename << std::endl;
+        }
+        else if (quotaExceeded && journalBytes > JOURNAL_HEADER_SIZE && compact())
+        {
             {
-                std::cerr << "Failed to open file for autosave" << std::endl;
+                // Folding the journal into the base freed enough of the quota
+                std::lock_guard<std::mutex> lock(contentMutex);
+                quotaExceeded = false;
             }
+            std::cout << "Auto-saved changes to " << filename << std::endl;
+            continue;
         }
 
-        // Sleep for 10 seconds before next autosave
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+        // Compact once the journal outgrows the document, keeping replay cheap
+        uint64_t documentSize;
+        {
+            std::lock_guard<std::mutex> lock(contentMutex);
+            documentSize = document.size();
+        }
+        if (journalBytes > COMPACT_MIN_BYTES && journalBytes > documentSize)
+        {
+            compact();
+        }
+    }
+}
 
-        // Exit if not running
-        if (!running)
-            break;
+// Print one page of lines starting at the given 1-based line
+void viewPage(uint64_t firstLine)
+{
+    std::lock_guard<std::mutex> lock(contentMutex);
+    uint64_t totalLines = document.lineCount();
+
+    std::cout << "\n--- Document Content ---" << std::endl;
+    if (document.empty())
+    {
+        std::cout << "[Empty document]" << std::endl;
+        return;
+    }
+
+    firstLine = std::max<uint64_t>(1, std::min(firstLine, totalLines));
+    uint64_t lastLine = std::min(firstLine + PAGE_LINES - 1, totalLines);
+    uint64_t from = document.lineStart(firstLine - 1);
+    uint64_t to = document.lineStart(lastLine);
+
+    document.forEachSpan(from, to, [](const char *text, size_t length)
+                         { std::cout.write(text, length); });
+    if (to == document.size() && to > from)
+    {
+        std::cout << std::endl;
+    }
+    std::cout << "--- Lines " << firstLine << "-" << lastLine << " of " << totalLines << " ---" << std::endl;
+}
+
+// Read lines until ':q' and return them as one block of text
+std::string readTextBlock()
+{
+    std::cout << "Enter text (type ':q' on a new line to finish):" << std::endl;
+    std::string text;
+    std::string line;
+    while (std::getline(std::cin, line) && line != ":q")
+    {
+        text += line + "\n";
+    }
+    return text;
+}
+
+uint64_t readNumber(const std::string &prompt, uint64_t defaultValue)
+{
+    std::cout << prompt;
+    std::string input;
+    std::getline(std::cin, input);
+    try
+    {
+        return input.empty() ? defaultValue : std::stoull(input);
+    }
+    catch (...)
+    {
+        return defaultValue;
     }
 }
 
@@ -59,6 +870,8 @@ void displayMenu()
     std::cout << "2. Add text\n";
     std::cout << "3. Clear content\n";
     std::cout << "4. Save and exit\n";
+    std::cout << "5. Insert text at line\n";
+    std::cout << "6. Delete lines\n";
     std::cout << "Enter choice: ";
 }
 
@@ -77,6 +890,7 @@ int main(int argc, char *argv[])
 
     // Set up the filename
     filename = "note_" + std::to_string(pid) + ".txt";
+    journalFilename = "note_" + std::to_string(pid) + ".journal";
 
     // Print task information
     std::cout << "Starting Notepad (PID: " << pid << ")" << std::endl;
@@ -89,48 +903,65 @@ int main(int argc, char *argv[])
     // Create directory if it doesn't exist
     system("mkdir -p simulated_disk");
 
+    // Writes are charged to this task's quota, unmetered when run standalone.
+    // When the OS is there to connect to, it caches the journal and stores the base.
+    diskLedger.open(false);
+    diskClient.connect();
+
+    // Pick up where a previous run left off. Replayed edits are folded into
+    // the base right away, otherwise the existing base is kept as is.
+    uint64_t baseSize, baseHash;
+    if (recover(baseSize, baseHash) > 0)
+    {
+        compact();
+    }
+    else
+    {
+        resetJournal(baseSize, baseHash);
+        if (!chargeTo((baseInStore ? 0 : baseSize) + JOURNAL_HEADER_SIZE))
+        {
+            std::cerr << "This note is larger than the task's disk quota, edits can't be saved" << std::endl;
+        }
+    }
+
     // Start autosave thread
     std::thread autosaveThread(autoSave);
-    autosaveThread.detach();
 
     // Main loop
     int choice;
-    std::string input;
 
     while (running)
     {
         displayMenu();
-        std::cin >> choice;
+        if (!(std::cin >> choice))
+        {
+            break; // Input closed, save and exit
+        }
         std::cin.ignore(); // Clear newline
 
         switch (choice)
         {
         case 1: // View content
-            std::cout << "\n--- Document Content ---" << std::endl;
-            if (content.empty())
-            {
-                std::cout << "[Empty document]" << std::endl;
-            }
-            else
+        {
+            uint64_t totalLines;
             {
-                std::cout << content << std::endl;
+                std::lock_guard<std::mutex> lock(contentMutex);
+                totalLines = document.lineCount();
             }
+            viewPage(totalLines > PAGE_LINES ? readNumber("Start at line (1-" + std::to_string(totalLines) + ") [1]: ", 1) : 1);
             break;
+        }
 
         case 2: // Add text
-            std::cout << "Enter text (type ':q' on a new line to finish):" << std::endl;
-            while (true)
-            {
-                std::string line;
-                std::getline(std::cin, line);
-                if (line == ":q")
-                    break;
-                content += line + "\n";
-            }
+        {
+            // Only this thread modifies the document, so reading its size unlocked is safe
+            std::string text = readTextBlock();
+            insertText(document.size(), text);
             break;
+        }
 
         case 3: // Clear content
-            content.clear();
+            eraseText(0, document.size());
             std::cout << "Content cleared" << std::endl;
             break;
 
@@ -138,20 +969,53 @@ int main(int argc, char *argv[])
             running = false;
             break;
 
+        case 5: // Insert text at line
+        {
+            uint64_t line = readNumber("Insert before line [1]: ", 1);
+            std::string text = readTextBlock();
+            insertText(document.lineStart(line > 0 ? line - 1 : 0), text);
+            break;
+        }
+
+        case 6: // Delete lines
+        {
+            uint64_t line = readNumber("First line to delete [1]: ", 1);
+            uint64_t count = readNumber("Number of lines [1]: ", 1);
+            uint64_t from = document.lineStart(line > 0 ? line - 1 : 0);
+            uint64_t to = document.lineStart((line > 0 ? line - 1 : 0) + count);
+            eraseText(from, to - from);
+            std::cout << "Deleted " << (to - from) << " bytes" << std::endl;
+            break;
+        }
+
         default:
             std::cout << "Invalid choice" << std::endl;
             break;
         }
     }
 
-    // Final save before exit
-    std::ofstream outFile("simulated_disk/" + filename);
-    if (outFile.is_open())
+    running = false;
+    autosaveCV.notify_all();
+    if (autosaveThread.joinable())
     {
-        outFile << content;
-        outFile.close();
+        autosaveThread.join();
+    }
+
+    // Final save before exit, a clean shutdown leaves no journal behind.
+    // The base is only rewritten if something changed since it was written.
+    bool unchanged = journalBytes == JOURNAL_HEADER_SIZE && pendingJournal.empty();
+    if (unchanged || compact())
+    {
+        journal.close();
+        unlink(("simulated_disk/" + journalFilename).c_str());
+        chargeTo(chargedBytes - journalBytes);
         std::cout << "Final save to " << filename << std::endl;
     }
+    else if (quotaExceeded)
+    {
+        // The journal still holds everything that was saved before the quota ran out
+        std::cerr << "Disk quota exceeded, " << pendingJournal.size() << " bytes of edits were not saved" << std::endl;
+    }
 
     std::cout << "Notepad exiting..." << std::endl;
     return 0;
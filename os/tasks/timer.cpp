@@ -0,0 +1,831 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+using namespace std;
+
+volatile sig_atomic_t running = 1;
+
+// Signal handler for graceful shutdown
+void signalHandler(int signal)
+{
+    if (signal == SIGINT)
+    {
+        running = 0;
+    }
+}
+
+int64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// ===== Timing wheel =====
+
+// A hierarchical timing wheel over ticks counted from its origin. A timer
+// due at tick e sits on the lowest level whose slot range still shares all
+// higher digits with the current tick: level 0 holds the next 64 ticks one
+// per slot, level 1 the next 64 spans of 64 ticks, and so on. When the
+// clock reaches a higher level slot its timers are cascaded down, each one
+// moving at most LEVELS - 1 times in its life.
+//
+// Timers live in one pool and are linked into buckets by index, so arm and
+// cancel are O(1). A bitmap of occupied slots per level finds the next tick
+// worth waking for in O(LEVELS), which is what the timerfd is armed for;
+// empty stretches of time are skipped without visiting them.
+//
+// Cascading a busy slot in one go stalls every timer due at that tick, so
+// the next slot of each higher level is sorted ahead of time, a little after
+// every advance, into the lower level slots its timers will occupy once it
+// starts. Slots map to buckets through a table, and when the slot comes due
+// its staged buckets are swapped in as the levels below.
+class TimingWheel
+{
+public:
+    static const int LEVEL_BITS = 6;
+    static const int SLOTS = 1 << LEVEL_BITS;
+    static const int LEVELS = 7; // 2^42 ticks, 139 years of milliseconds
+    static const uint64_t MAX_TICK = (uint64_t(1) << (LEVEL_BITS * LEVELS)) - 1;
+    static const size_t STAGE_BUDGET = 256; // Timers staged per level and step, unless running late
+
+    // Pool index in the low half, generation in the high half, so a handle
+    // kept after its timer fired or was cancelled is simply rejected
+    typedef uint64_t Handle;
+
+private:
+    static const uint32_t NIL = UINT32_MAX;
+    static const uint16_t FREE = UINT16_MAX;
+    static const int STAGED_LEVELS = LEVELS * (LEVELS - 1) / 2;
+    static const uint16_t FIRING = (LEVELS + STAGED_LEVELS) * SLOTS; // The batch being fired
+    static const uint16_t OVERDUE = FIRING + 1;              // Armed after their tick had started
+    static const int BUCKETS = OVERDUE + 1;
+
+    struct Node
+    {
+        int64_t deadline; // Absolute nanoseconds
+        int64_t period;   // Nanoseconds, 0 for one shot timers
+        uint64_t data;
+        uint32_t next;
+        uint32_t prev;
+        uint32_t generation;
+        uint16_t bucket;
+    };
+
+    int64_t origin;
+    int64_t tickNs;
+    uint64_t current = 0; // Every tick before this one has been processed
+    vector<Node> nodes;
+    uint32_t freeHead = NIL;
+    size_t armed = 0;
+
+    uint32_t heads[BUCKETS];
+    uint32_t counts[BUCKETS] = {};
+    uint16_t slotBucket[LEVELS][SLOTS];
+    uint16_t stageBucket[LEVELS][LEVELS - 1][SLOTS]; // Lower levels as of a staged slot's start
+    int8_t bucketLevel[BUCKETS];                     // -1 for staged and pseudo buckets
+    uint8_t bucketDigit[BUCKETS];
+    uint64_t occupied[LEVELS] = {};
+    int stagedDigit[LEVELS];                         // Slot being staged per level, -1 for none
+    uint64_t stageWake = UINT64_MAX;                 // Tick for the next staging step
+
+    // First tick starting at or after the deadline, so timers never fire early
+    uint64_t expiryTick(int64_t deadline) const
+    {
+        if (deadline <= origin)
+            return 0;
+        uint64_t tick = static_cast<uint64_t>((deadline - origin + tickNs - 1) / tickNs);
+        return min(tick, MAX_TICK);
+    }
+
+    void link(uint32_t index, uint16_t bucket)
+    {
+        Node &node = nodes[index];
+        node.bucket = bucket;
+        node.prev = NIL;
+        node.next = heads[bucket];
+        if (node.next != NIL)
+            nodes[node.next].prev = index;
+        heads[bucket] = index;
+        counts[bucket]++;
+        if (bucketLevel[bucket] >= 0)
+            occupied[bucketLevel[bucket]] |= uint64_t(1) << bucketDigit[bucket];
+    }
+
+    void unlink(uint32_t index)
+    {
+        Node &node = nodes[index];
+        if (node.prev != NIL)
+            nodes[node.prev].next = node.next;
+        else
+            heads[node.bucket] = node.next;
+        if (node.next != NIL)
+            nodes[node.next].prev = node.prev;
+        counts[node.bucket]--;
+        if (heads[node.bucket] == NIL && bucketLevel[node.bucket] >= 0)
+            occupied[bucketLevel[node.bucket]] &= ~(uint64_t(1) << bucketDigit[node.bucket]);
+        node.bucket = FREE;
+    }
+
+    // Lowest level whose slots tell the expiry apart from the given tick
+    static int levelOf(uint64_t expiry, uint64_t tick)
+    {
+        uint64_t differing = expiry ^ tick;
+        return differing < SLOTS ? 0 : (63 - __builtin_clzll(differing)) / LEVEL_BITS;
+    }
+
+    static int digitOf(uint64_t tick, int level)
+    {
+        return static_cast<int>((tick >> (level * LEVEL_BITS)) & (SLOTS - 1));
+    }
+
+    void place(uint32_t index)
+    {
+        uint64_t expiry = expiryTick(nodes[index].deadline);
+        if (expiry < current)
+        {
+            link(index, OVERDUE);
+            return;
+        }
+        int level = levelOf(expiry, current);
+        link(index, slotBucket[level][digitOf(expiry, level)]);
+    }
+
+    void release(uint32_t index)
+    {
+        Node &node = nodes[index];
+        node.generation++;
+        node.bucket = FREE;
+        node.next = freeHead;
+        freeHead = index;
+        armed--;
+    }
+
+    // Slots of a level that are still due. Level 0 slots are ticks of their
+    // own. A slot on a higher level is due at its first tick; it holds
+    // digits after the current one, or the current digit when current is
+    // exactly that first tick.
+    uint64_t ahead(int level, uint64_t slots) const
+    {
+        int shift = level * LEVEL_BITS;
+        unsigned digit = (current >> shift) & (SLOTS - 1);
+        bool atSlotStart = (current & ((uint64_t(1) << shift) - 1)) == 0;
+        return slots & (atSlotStart ? ~uint64_t(0) << digit : ~uint64_t(1) << digit);
+    }
+
+    // The next tick at or after current that has timers to fire or cascade
+    uint64_t nextEventTick() const
+    {
+        uint64_t best = UINT64_MAX;
+        for (int level = 0; level < LEVELS; level++)
+        {
+            uint64_t slots = occupied[level];
+            if (stagedDigit[level] >= 0)
+                slots |= uint64_t(1) << stagedDigit[level];
+            uint64_t due = ahead(level, slots);
+            if (due == 0)
+                continue;
+            int shift = level * LEVEL_BITS;
+            uint64_t span = uint64_t(1) << (shift + LEVEL_BITS);
+            best = min(best, (current & ~(span - 1)) | (uint64_t(__builtin_ctzll(due)) << shift));
+        }
+        return best;
+    }
+
+    // Sort timers of the next due slot of each level into its staging
+    // buckets, in small steps spread over the first half of the time left
+    // before the slot comes due
+    void stage()
+    {
+        stageWake = UINT64_MAX;
+        for (int level = 1; level < LEVELS; level++)
+        {
+            if (stagedDigit[level] < 0)
+            {
+                uint64_t due = ahead(level, occupied[level]);
+                if (due == 0)
+                    continue;
+                stagedDigit[level] = __builtin_ctzll(due);
+            }
+            uint16_t source = slotBucket[level][stagedDigit[level]];
+            int shift = level * LEVEL_BITS;
+            uint64_t span = uint64_t(1) << (shift + LEVEL_BITS);
+            uint64_t start = (current & ~(span - 1)) | (uint64_t(stagedDigit[level]) << shift);
+            uint64_t left = start > current ? (start - current) / 2 : 0;
+            uint64_t stride = max<uint64_t>(left / max<uint64_t>(counts[source] / STAGE_BUDGET, 1), 1);
+            size_t budget = max<size_t>(STAGE_BUDGET, counts[source] / max<uint64_t>(left / stride, 1));
+            while (budget > 0 && heads[source] != NIL)
+            {
+                uint32_t index = heads[source];
+                uint64_t expiry = expiryTick(nodes[index].deadline);
+                int below = levelOf(expiry, start);
+                unlink(index);
+                link(index, stageBucket[level][below][digitOf(expiry, below)]);
+                budget--;
+            }
+            if (heads[source] != NIL)
+                stageWake = min(stageWake, current + stride);
+        }
+    }
+
+    // The staged slot of a level is due: its staged buckets become the
+    // levels below. Those only hold timers armed at this very tick, unless
+    // a lower level was staging this tick too, and are merged in smaller
+    // list first.
+    void swapInStaged(int level)
+    {
+        for (int below = 0; below < level; below++)
+        {
+            occupied[below] = 0;
+            for (int digit = 0; digit < SLOTS; digit++)
+            {
+                uint16_t &bucket = slotBucket[below][digit];
+                uint16_t &previous = stageBucket[level][below][digit];
+                if (counts[previous] >= counts[bucket])
+                    swap(bucket, previous);
+                bucketLevel[bucket] = static_cast<int8_t>(below);
+                bucketDigit[bucket] = static_cast<uint8_t>(digit);
+                bucketLevel[previous] = -1;
+                while (heads[previous] != NIL)
+                {
+                    uint32_t index = heads[previous];
+                    unlink(index);
+                    link(index, bucket);
+                }
+                if (heads[bucket] != NIL)
+                    occupied[below] |= uint64_t(1) << digit;
+            }
+        }
+        stagedDigit[level] = -1;
+    }
+
+    // Fire a bucket's timers from a pseudo bucket, so callbacks can cancel any of them
+    template <typename Fire>
+    size_t fireBucket(uint16_t bucket, int64_t now, Fire &fire)
+    {
+        if (heads[bucket] == NIL)
+            return 0;
+        heads[FIRING] = heads[bucket];
+        counts[FIRING] = counts[bucket];
+        heads[bucket] = NIL;
+        counts[bucket] = 0;
+        if (bucketLevel[bucket] >= 0)
+            occupied[bucketLevel[bucket]] &= ~(uint64_t(1) << bucketDigit[bucket]);
+        for (uint32_t index = heads[FIRING]; index != NIL; index = nodes[index].next)
+            nodes[index].bucket = FIRING;
+
+        size_t fired = 0;
+        while (heads[FIRING] != NIL)
+        {
+            uint32_t index = heads[FIRING];
+            unlink(index);
+            Node &node = nodes[index];
+            Handle handle = (uint64_t(node.generation) << 32) | index;
+            int64_t deadline = node.deadline;
+            if (node.period > 0)
+            {
+                // Keep the timer armed through the callback so it can cancel itself
+                node.deadline += node.period * max<int64_t>(1, (now - node.deadline) / node.period + 1);
+                place(index);
+            }
+            else
+            {
+                release(index);
+            }
+            fired++;
+            fire(handle, nodes[index].data, deadline);
+        }
+        return fired;
+    }
+
+public:
+    TimingWheel(int64_t origin, int64_t tickNs) : origin(origin), tickNs(max<int64_t>(tickNs, 1))
+    {
+        fill(begin(heads), end(heads), NIL);
+        fill(begin(bucketLevel), end(bucketLevel), -1);
+        fill(begin(stagedDigit), end(stagedDigit), -1);
+        uint16_t next = 0;
+        for (int level = 0; level < LEVELS; level++)
+        {
+            for (int digit = 0; digit < SLOTS; digit++)
+            {
+                slotBucket[level][digit] = next;
+                bucketLevel[next] = static_cast<int8_t>(level);
+                bucketDigit[next] = static_cast<uint8_t>(digit);
+                next++;
+            }
+        }
+        for (int level = 1; level < LEVELS; level++)
+            for (int below = 0; below < level; below++)
+                for (int digit = 0; digit < SLOTS; digit++)
+                    stageBucket[level][below][digit] = next++;
+    }
+
+    Handle arm(int64_t deadline, uint64_t data, int64_t period = 0)
+    {
+        uint32_t index;
+        if (freeHead != NIL)
+        {
+            index = freeHead;
+            freeHead = nodes[index].next;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({0, 0, 0, NIL, NIL, 0, FREE});
+        }
+        Node &node = nodes[index];
+        node.deadline = deadline;
+        node.period = max<int64_t>(period, 0);
+        node.data = data;
+        place(index);
+        armed++;
+        if (bucketLevel[node.bucket] > 0)
+            stageWake = min(stageWake, current); // Its slot may need staging
+        return (uint64_t(node.generation) << 32) | index;
+    }
+
+    bool cancel(Handle handle)
+    {
+        uint32_t index = static_cast<uint32_t>(handle);
+        if (index >= nodes.size() || nodes[index].generation != handle >> 32 || nodes[index].bucket == FREE)
+            return false;
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    size_t size() const { return armed; }
+    int64_t tick() const { return tickNs; }
+
+    // Absolute time of the next tick to process, -1 when nothing is armed.
+    // Overdue timers ask for the tick that has already started, and leftover
+    // staging work for its next step even if nothing is due then.
+    int64_t nextWake() const
+    {
+        uint64_t tick = heads[OVERDUE] != NIL ? current - 1 : min(nextEventTick(), stageWake);
+        return tick == UINT64_MAX ? -1 : origin + static_cast<int64_t>(tick) * tickNs;
+    }
+
+    // Process every tick that has started by now. fire(handle, data,
+    // deadline) may arm and cancel timers, including ones in the same tick.
+    // Periodic timers are re-armed for their next deadline after now.
+    template <typename Fire>
+    size_t advance(int64_t now, Fire fire)
+    {
+        if (now < origin)
+            return 0;
+        uint64_t target = min(static_cast<uint64_t>((now - origin) / tickNs), MAX_TICK);
+        size_t fired = fireBucket(OVERDUE, now, fire);
+        while (current <= target)
+        {
+            uint64_t tick = nextEventTick();
+            if (tick > target)
+            {
+                current = target + 1;
+                break;
+            }
+            current = tick;
+
+            // Cascade every higher level slot that starts at this tick
+            for (int level = LEVELS - 1; level > 0; level--)
+            {
+                int shift = level * LEVEL_BITS;
+                if ((tick & ((uint64_t(1) << shift) - 1)) != 0)
+                    continue;
+                int digit = static_cast<int>((tick >> shift) & (SLOTS - 1));
+                if (stagedDigit[level] == digit)
+                    swapInStaged(level);
+                uint16_t bucket = slotBucket[level][digit];
+                uint32_t index = heads[bucket];
+                heads[bucket] = NIL;
+                counts[bucket] = 0;
+                occupied[level] &= ~(uint64_t(1) << digit);
+                while (index != NIL)
+                {
+                    uint32_t next = nodes[index].next;
+                    place(index);
+                    index = next;
+                }
+            }
+
+            // Timers armed by the callbacks are placed after this tick
+            current = tick + 1;
+            fired += fireBucket(slotBucket[0][tick & (SLOTS - 1)], now, fire);
+        }
+        stage();
+        return fired;
+    }
+};
+
+// Drives a wheel from one timerfd, armed for the nearest tick with work
+class TimerService
+{
+    int fd;
+    int64_t armedFor = -1;
+
+public:
+    TimingWheel wheel;
+    size_t wakeups = 0;
+
+    explicit TimerService(int64_t tickNs) : wheel(monotonicNs(), tickNs)
+    {
+        fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    }
+
+    ~TimerService()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    TimerService(const TimerService &) = delete;
+    TimerService &operator=(const TimerService &) = delete;
+
+    int descriptor() const { return fd; }
+
+    // Point the timerfd at the next tick, or disarm it when idle
+    void rearm()
+    {
+        int64_t wake = wheel.nextWake();
+        if (wake == armedFor)
+            return;
+        struct itimerspec spec = {};
+        if (wake >= 0)
+        {
+            spec.it_value.tv_sec = wake / 1000000000;
+            spec.it_value.tv_nsec = wake % 1000000000;
+            if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+                spec.it_value.tv_nsec = 1; // Zero would disarm it
+        }
+        timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+        armedFor = wake;
+    }
+
+    // Drain the timerfd, fire what is due and arm for the next tick
+    template <typename Fire>
+    size_t service(Fire fire)
+    {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            wakeups++;
+        armedFor = -1;
+        size_t fired = wheel.advance(monotonicNs(), fire);
+        rearm();
+        return fired;
+    }
+};
+
+// ===== Benchmark =====
+
+template <typename Body>
+double millisecondsOf(Body body)
+{
+    auto begin = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+int benchTimers(size_t count, double seconds, int64_t tickNs)
+{
+    cout << fixed << setprecision(2);
+    mt19937_64 random(50);
+    bool ok = true;
+
+    // Arm and cancel against an ordered set, deadlines up to an hour out
+    {
+        int64_t now = monotonicNs();
+        vector<int64_t> deadlines(count);
+        for (int64_t &deadline : deadlines)
+            deadline = now + 1000000 + static_cast<int64_t>(random() % 3600000000000ull);
+
+        TimingWheel wheel(now, tickNs);
+        vector<TimingWheel::Handle> handles(count);
+        double armTime = millisecondsOf([&]
+                                        {
+                                            for (size_t i = 0; i < count; i++)
+                                                handles[i] = wheel.arm(deadlines[i], i); });
+        size_t cancelled = 0;
+        double cancelTime = millisecondsOf([&]
+                                           {
+                                               for (size_t i = 0; i < count; i += 2)
+                                                   cancelled += wheel.cancel(handles[i]); });
+        for (size_t i = 0; i < count; i += 2)
+            ok = ok && !wheel.cancel(handles[i]);
+        ok = ok && cancelled == (count + 1) / 2 && wheel.size() == count - cancelled;
+
+        set<pair<int64_t, uint64_t>> ordered;
+        double setArm = millisecondsOf([&]
+                                       {
+                                           for (size_t i = 0; i < count; i++)
+                                               ordered.insert({deadlines[i], i}); });
+        double setCancel = millisecondsOf([&]
+                                          {
+                                              for (size_t i = 0; i < count; i += 2)
+                                                  ordered.erase({deadlines[i], i}); });
+        size_t half = max<size_t>((count + 1) / 2, 1);
+        cout << "Arm and cancel, " << count << " timers" << (ok ? "" : "  MISMATCH") << endl;
+        cout << "  wheel  arm " << armTime * 1e6 / max<size_t>(count, 1) << " ns, cancel " << cancelTime * 1e6 / half << " ns" << endl;
+        cout << "  set    arm " << setArm * 1e6 / max<size_t>(count, 1) << " ns, cancel " << setCancel * 1e6 / half << " ns" << endl;
+    }
+
+    // Real firing through the timerfd: deadlines spread over the run, a
+    // quarter cancelled before they are due. The first deadline leaves time
+    // to arm them all.
+    int64_t spread = static_cast<int64_t>(seconds * 1e9);
+    vector<TimingWheel::Handle> handles(count);
+    vector<int64_t> deadlines(count);
+    for (int64_t &deadline : deadlines)
+        deadline = static_cast<int64_t>(random() % max<int64_t>(spread, 1));
+    TimerService service(tickNs);
+    int64_t start = monotonicNs() + 500000000;
+    for (size_t i = 0; i < count; i++)
+    {
+        deadlines[i] += start;
+        handles[i] = service.wheel.arm(deadlines[i], i);
+    }
+    vector<uint8_t> expected(count, 1);
+    size_t live = count;
+    for (size_t i = 0; i < count; i += 4)
+    {
+        expected[i] = 0;
+        live -= service.wheel.cancel(handles[i]);
+    }
+
+    vector<uint8_t> fired(count, 0);
+    vector<int64_t> lateness;
+    lateness.reserve(live);
+    bool early = false, duplicate = false;
+    struct pollfd wait = {service.descriptor(), POLLIN, 0};
+    service.rearm();
+    double runTime = millisecondsOf([&]
+                                    {
+                                        while (service.wheel.size() > 0 && running)
+                                        {
+                                            if (poll(&wait, 1, -1) < 0 && errno != EINTR)
+                                                break;
+                                            service.service([&](TimingWheel::Handle, uint64_t data, int64_t deadline)
+                                                            {
+                                                                int64_t late = monotonicNs() - deadline;
+                                                                early = early || late < 0;
+                                                                duplicate = duplicate || fired[data];
+                                                                fired[data] = 1;
+                                                                lateness.push_back(late); });
+                                        } });
+    ok = ok && !early && !duplicate && fired == expected;
+
+    sort(lateness.begin(), lateness.end());
+    auto percentile = [&lateness](double p)
+    {
+        return lateness.empty() ? 0.0 : lateness[min(lateness.size() - 1, static_cast<size_t>(p * lateness.size()))] / 1000.0;
+    };
+    cout << "Firing, " << live << " timers over " << seconds << " s, " << tickNs / 1000.0 << " us ticks"
+         << (ok ? "" : "  MISMATCH") << endl;
+    cout << "  run " << runTime << " ms, " << service.wakeups << " timerfd wakeups" << endl;
+    cout << "  lateness us: p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999)
+         << ", max " << (lateness.empty() ? 0.0 : lateness.back() / 1000.0) << endl;
+    return ok ? 0 : 1;
+}
+
+// ===== Interactive =====
+
+struct Alarm
+{
+    TimingWheel::Handle handle;
+    int64_t deadline;
+    int64_t period;
+    string label;
+};
+
+// "90", "90s", "5m", "1.5h"
+bool parseDuration(const string &text, int64_t &nanoseconds)
+{
+    char *end;
+    double value = strtod(text.c_str(), &end);
+    string unit = end;
+    double scale = unit.empty() || unit == "s" ? 1 : unit == "m" ? 60 : unit == "h" ? 3600 : 0;
+    if (end == text.c_str() || scale == 0 || value <= 0 || value * scale > 1e9)
+        return false;
+    nanoseconds = static_cast<int64_t>(value * scale * 1e9);
+    return true;
+}
+
+// Time until the next HH:MM[:SS] on the local clock
+bool parseAlarmTime(const string &text, int64_t &nanoseconds)
+{
+    unsigned hour, minute, second = 0;
+    char tail;
+    int fields = sscanf(text.c_str(), "%u:%u:%u%c", &hour, &minute, &second, &tail);
+    if ((fields != 2 && fields != 3) || hour > 23 || minute > 59 || second > 59)
+        return false;
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    struct tm local;
+    localtime_r(&wall.tv_sec, &local);
+    int64_t nowInDay = ((local.tm_hour * 60 + local.tm_min) * 60 + local.tm_sec) * 1000000000ll + wall.tv_nsec;
+    int64_t target = ((hour * 60 + minute) * 60 + second) * 1000000000ll;
+    nanoseconds = target > nowInDay ? target - nowInDay : target - nowInDay + 86400 * 1000000000ll;
+    return true;
+}
+
+string formatRemaining(int64_t nanoseconds)
+{
+    int64_t total = max<int64_t>(nanoseconds, 0) / 1000000000;
+    char text[32];
+    snprintf(text, sizeof(text), "%02lld:%02lld:%02lld", static_cast<long long>(total / 3600),
+             static_cast<long long>(total / 60 % 60), static_cast<long long>(total % 60));
+    return text;
+}
+
+void printHelp()
+{
+    cout << "Commands:" << endl;
+    cout << "  t 5m tea          countdown (seconds, or with s, m, h)" << endl;
+    cout << "  e 30s stretch     repeat every interval" << endl;
+    cout << "  a 07:30 wake up   alarm at the next HH:MM[:SS]" << endl;
+    cout << "  c <id>            cancel" << endl;
+    cout << "  l                 list" << endl;
+    cout << "  q                 quit" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && string(argv[1]) == "--bench-timers")
+    {
+        size_t count = argc >= 3 ? stoull(argv[2]) : 2000000;
+        double seconds = argc >= 4 ? stod(argv[3]) : 4;
+        int64_t tickNs = argc >= 5 ? stoll(argv[4]) * 1000 : 100000;
+        signal(SIGINT, signalHandler);
+        return benchTimers(count, seconds, tickNs);
+    }
+
+    // Check command line arguments (pid, memory, disk)
+    if (argc < 4)
+    {
+        cerr << "Usage: " << argv[0] << " <pid> <memory_required> <disk_required>" << endl;
+        cerr << "       " << argv[0] << " --bench-timers [timers] [seconds] [tick_us]" << endl;
+        return 1;
+    }
+
+    int pid = stoi(argv[1]);
+    int memoryRequired = stoi(argv[2]);
+    int diskRequired = stoi(argv[3]);
+
+    // Print task information
+    cout << "Starting Timer (PID: " << pid << ")" << endl;
+    cout << "Memory required: " << memoryRequired << " MB" << endl;
+    cout << "Disk required: " << diskRequired << " MB" << endl;
+
+    // Register signal handler
+    signal(SIGINT, signalHandler);
+
+    // One thread waits on the keyboard and the timerfd together
+    TimerService service(1000000);
+    unordered_map<uint64_t, Alarm> alarms;
+    uint64_t nextId = 1;
+    printHelp();
+
+    auto fire = [&alarms](TimingWheel::Handle, uint64_t id, int64_t deadline)
+    {
+        auto found = alarms.find(id);
+        if (found == alarms.end())
+            return;
+        Alarm &alarm = found->second;
+        cout << "\a[timer] #" << id << " " << alarm.label << " went off, " << setprecision(2) << fixed
+             << (monotonicNs() - deadline) / 1e6 << " ms late" << endl;
+        if (alarm.period > 0)
+            alarm.deadline = deadline + alarm.period * max<int64_t>(1, (monotonicNs() - deadline) / alarm.period + 1);
+        else
+            alarms.erase(found);
+    };
+
+    string pending;
+    bool inputOpen = true;
+    cout << "> " << flush;
+    // Once input ends, wait for the one shot timers still pending
+    auto waiting = [&]
+    {
+        return inputOpen || any_of(alarms.begin(), alarms.end(), [](const pair<const uint64_t, Alarm> &entry)
+                                   { return entry.second.period == 0; });
+    };
+    while (running && waiting())
+    {
+        struct pollfd waits[2] = {{service.descriptor(), POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        if (poll(waits, inputOpen ? 2 : 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (waits[0].revents & POLLIN)
+            service.service(fire);
+        if (!inputOpen || !(waits[1].revents & (POLLIN | POLLHUP)))
+            continue;
+
+        // Read whatever is there and run each complete line
+        char buffer[4096];
+        ssize_t got = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (got <= 0)
+        {
+            inputOpen = false;
+            continue;
+        }
+        pending.append(buffer, got);
+        size_t newline;
+        while ((newline = pending.find('\n')) != string::npos)
+        {
+            istringstream in(pending.substr(0, newline));
+            pending.erase(0, newline + 1);
+            string command, when, label;
+            if (!(in >> command))
+            {
+                cout << "> " << flush;
+                continue;
+            }
+
+            if (command == "t" || command == "e" || command == "a")
+            {
+                int64_t delay;
+                bool valid = in >> when && (command == "a" ? parseAlarmTime(when, delay) : parseDuration(when, delay));
+                getline(in >> ws, label);
+                if (!valid)
+                {
+                    cout << "Expected: " << command << (command == "a" ? " HH:MM[:SS]" : " <duration>") << " [label]" << endl;
+                }
+                else
+                {
+                    uint64_t id = nextId++;
+                    int64_t deadline = monotonicNs() + delay;
+                    int64_t period = command == "e" ? delay : 0;
+                    if (label.empty())
+                        label = command == "a" ? "alarm" : "timer";
+                    alarms[id] = {service.wheel.arm(deadline, id, period), deadline, period, label};
+                    service.rearm();
+                    cout << "#" << id << " " << label << " in " << formatRemaining(delay) << (period ? ", repeating" : "") << endl;
+                }
+            }
+            else if (command == "c")
+            {
+                uint64_t id;
+                auto found = in >> id ? alarms.find(id) : alarms.end();
+                if (found != alarms.end() && service.wheel.cancel(found->second.handle))
+                {
+                    alarms.erase(found);
+                    service.rearm();
+                    cout << "Cancelled #" << id << endl;
+                }
+                else
+                {
+                    cout << "No such timer" << endl;
+                }
+            }
+            else if (command == "l")
+            {
+                vector<pair<int64_t, uint64_t>> order;
+                for (const auto &entry : alarms)
+                    order.push_back({entry.second.deadline, entry.first});
+                sort(order.begin(), order.end());
+                int64_t now = monotonicNs();
+                for (const auto &entry : order)
+                {
+                    const Alarm &alarm = alarms[entry.second];
+                    cout << "  #" << left << setw(6) << entry.second << right << formatRemaining(alarm.deadline - now) << "  "
+                         << alarm.label << (alarm.period ? "  (repeating)" : "") << endl;
+                }
+                if (order.empty())
+                    cout << "  (no timers)" << endl;
+            }
+            else if (command == "q")
+            {
+                running = 0;
+                break;
+            }
+            else
+            {
+                printHelp();
+            }
+            cout << "> " << flush;
+        }
+    }
+
+    cout << "\nTimer exiting..." << endl;
+    return 0;
+}